@@ -8,14 +8,17 @@ O_SRCS += \
 
 C_SRCS += \
 ../client.c \
+../finsChannel.c \
 ../socket_interceptor.c 
 
 OBJS += \
 ./client.o \
+./finsChannel.o \
 ./socket_interceptor.o 
 
 C_DEPS += \
 ./client.d \
+./finsChannel.d \
 ./socket_interceptor.d 
 
 
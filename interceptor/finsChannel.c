@@ -0,0 +1,794 @@
+/**
+ * @file finsChannel.c
+ *
+ *  @date Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "finsChannel.h"
+#include "finsdebug.h"
+
+#define FINS_CHANNEL_MASK (FINS_CHANNEL_RING_SIZE - 1)
+/** how often a producer waiting for room checks that its consumer is alive */
+#define FINS_CHANNEL_PEER_CHECK_MS 100
+/** how long a process attaching waits for the jinni to hand back the slot
+ * of a dead process, and how often it looks */
+#define FINS_CHANNEL_DRAIN_WAIT_MS 1000
+#define FINS_CHANNEL_DRAIN_CHECK_MS 10
+
+/** Head and Tail are each written by one process and read by the other */
+#define LOAD_ACQUIRE(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/** producer side, called after the new Head or Tail is published. The
+ * futexes live in a shared mapping, so the non private operations are used */
+static void fins_channel_ring(struct finsChannelBell *bell)
+{
+
+	/** orders the index store before the Sleepers load, pairs with the
+	 * increment of Sleepers in fins_channel_wait */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&bell->Sleepers, __ATOMIC_RELAXED) == 0)
+		return;
+
+	__atomic_add_fetch(&bell->Seq, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &bell->Seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+}
+
+/**@brief sleeps on bell unless ready(arg) already holds. May return
+ * spuriously or after ms milliseconds (0 waits for ever), callers re-check
+ * */
+static void fins_channel_wait(struct finsChannelBell *bell, int (*ready)(void *), void *arg, int ms)
+{
+	struct timespec timeout;
+	int key;
+
+	timeout.tv_sec = ms / 1000;
+	timeout.tv_nsec = (ms % 1000) * 1000000L;
+
+	__atomic_add_fetch(&bell->Sleepers, 1, __ATOMIC_SEQ_CST);
+	key = __atomic_load_n(&bell->Seq, __ATOMIC_SEQ_CST);
+
+	/** returns straight away if the other side rang since key was read */
+	if (!ready(arg))
+		syscall(SYS_futex, &bell->Seq, FUTEX_WAIT, key, ms > 0 ? &timeout : NULL, NULL, 0);
+
+	__atomic_sub_fetch(&bell->Sleepers, 1, __ATOMIC_RELAXED);
+
+}
+
+static void fins_channel_copy_in(struct finsChannelRing *ring, unsigned int pos,
+		const void *src, unsigned int len)
+{
+	unsigned int offset = pos & FINS_CHANNEL_MASK;
+	unsigned int first = FINS_CHANNEL_RING_SIZE - offset;
+
+	if (first > len)
+		first = len;
+	memcpy(ring->Data + offset, src, first);
+	memcpy(ring->Data, (const unsigned char *) src + first, len - first);
+
+}
+
+static void fins_channel_copy_out(struct finsChannelRing *ring, unsigned int pos,
+		void *dst, unsigned int len)
+{
+	unsigned int offset = pos & FINS_CHANNEL_MASK;
+	unsigned int first = FINS_CHANNEL_RING_SIZE - offset;
+
+	if (first > len)
+		first = len;
+	memcpy(dst, ring->Data + offset, first);
+	memcpy((unsigned char *) dst + first, ring->Data, len - first);
+
+}
+
+struct fins_channel_room
+{
+	struct finsChannelRing *ring;
+	unsigned int need;
+};
+
+static int fins_channel_has_room(void *arg)
+{
+	struct fins_channel_room *room = (struct fins_channel_room *) arg;
+
+	return (FINS_CHANNEL_RING_SIZE - (room->ring->Tail - LOAD_ACQUIRE(&room->ring->Head))
+			>= room->need);
+
+}
+
+static int fins_channel_has_data(void *arg)
+{
+	struct finsChannelRing *ring = (struct finsChannelRing *) arg;
+
+	return (LOAD_ACQUIRE(&ring->Tail) != ring->Head);
+
+}
+
+/**@brief reserves room for a record of up to len bytes, waiting for the
+ * consumer if the ring is full
+ * @param peer the consumer's pid, the wait is given up once it is gone (0 never)
+ * @return 0 on success, -1 if the record can never fit or the peer is gone
+ * */
+static int fins_channel_begin(struct finsChannelRing *ring, struct finsChannelBell *bell,
+		pid_t peer, struct finsChannelWriter *w, unsigned int len)
+{
+	struct fins_channel_room room;
+
+	if (len > FINS_CHANNEL_RING_SIZE - sizeof(uint32_t))
+	{
+		PRINT_DEBUG("a %u bytes record does not fit in the channel", len);
+		return (-1);
+	}
+
+	room.ring = ring;
+	room.need = sizeof(uint32_t) + len;
+	while (!fins_channel_has_room(&room))
+	{
+		if (peer > 0 && kill(peer, 0) == -1 && errno == ESRCH)
+			return (-1);
+		fins_channel_wait(&ring->SpaceBell, fins_channel_has_room, &room,
+				peer > 0 ? FINS_CHANNEL_PEER_CHECK_MS : 0);
+	}
+
+	w->Ring = ring;
+	w->Bell = bell;
+	w->Start = ring->Tail;
+	w->Pos = w->Start + sizeof(uint32_t);
+	w->End = w->Start + room.need;
+	return (0);
+
+}
+
+/**@brief appends len bytes to the record being written
+ * @return len, -1 if that overflows the room reserved for the record
+ * */
+int fins_channel_put(struct finsChannelWriter *w, const void *src, unsigned int len)
+{
+
+	if (len > w->End - w->Pos)
+	{
+		PRINT_DEBUG("record overflow, %u bytes left, %u written", w->End - w->Pos, len);
+		return (-1);
+	}
+	fins_channel_copy_in(w->Ring, w->Pos, src, len);
+	w->Pos += len;
+	return (len);
+
+}
+
+/**@brief publishes the record, the unused part of the reserved room is given back
+ * */
+void fins_channel_commit(struct finsChannelWriter *w)
+{
+	uint32_t len = w->Pos - w->Start - sizeof(uint32_t);
+
+	fins_channel_copy_in(w->Ring, w->Start, &len, sizeof(uint32_t));
+	STORE_RELEASE(&w->Ring->Tail, w->Pos);
+	fins_channel_ring(w->Bell);
+
+}
+
+/** @return 1 and opens the oldest record of ring, 0 if the ring is empty */
+static int fins_channel_open(struct finsChannelRing *ring, struct finsChannelReader *r)
+{
+	uint32_t len;
+
+	if (!fins_channel_has_data(ring))
+		return (0);
+
+	fins_channel_copy_out(ring, ring->Head, &len, sizeof(uint32_t));
+	r->Ring = ring;
+	r->Pos = ring->Head + sizeof(uint32_t);
+	r->End = r->Pos + len;
+	r->Open = 1;
+	r->Busy = NULL;
+	return (1);
+
+}
+
+/**@brief reads the next len bytes of the record, like read() does on a pipe
+ * @return the number of bytes read, less than len (0) at the end of the record
+ * */
+int fins_channel_get(struct finsChannelReader *r, void *dst, unsigned int len)
+{
+
+	if (!r->Open)
+		return (0);
+	if (len > r->End - r->Pos)
+		len = r->End - r->Pos;
+	fins_channel_copy_out(r->Ring, r->Pos, dst, len);
+	r->Pos += len;
+	return (len);
+
+}
+
+/**@brief reads the next bytes of the record in place: *src points to as many
+ * of them as are contiguous in the ring, len at most. They are consumed as by
+ * fins_channel_get and stay in the ring until fins_channel_finish, for the
+ * caller to copy them its own way (see jinni_get_payload)
+ * @return the number of bytes, 0 at the end of the record
+ * */
+int fins_channel_get_inplace(struct finsChannelReader *r, const void **src, unsigned int len)
+{
+	unsigned int offset = r->Pos & FINS_CHANNEL_MASK;
+
+	if (!r->Open)
+		return (0);
+	if (len > r->End - r->Pos)
+		len = r->End - r->Pos;
+	if (len > FINS_CHANNEL_RING_SIZE - offset)
+		len = FINS_CHANNEL_RING_SIZE - offset;
+	*src = r->Ring->Data + offset;
+	r->Pos += len;
+	return (len);
+
+}
+
+/**@brief gives the record back to the producer, what was not read is skipped.
+ * Does nothing if the record was already finished
+ * */
+void fins_channel_finish(struct finsChannelReader *r)
+{
+
+	if (!r->Open)
+		return;
+	r->Open = 0;
+	STORE_RELEASE(&r->Ring->Head, r->End);
+	fins_channel_ring(&r->Ring->SpaceBell);
+	if (r->Busy != NULL)
+	{
+		/** the next record of the ring may be handed out */
+		__atomic_store_n(r->Busy, 0, __ATOMIC_SEQ_CST);
+		fins_channel_ring(r->Wake);
+	}
+
+}
+
+/**@brief takes a buffer from the pool, with one reference for the caller
+ * @return the buffer, -1 if none is free
+ * */
+int fins_channel_buffer_alloc(struct finsChannelControl *ctrl)
+{
+	uint64_t top = LOAD_ACQUIRE(&ctrl->FreeBuffers);
+	uint64_t next;
+	int buffer;
+
+	do
+	{
+		buffer = (int) (uint32_t) top - 1;
+		if (buffer < 0)
+			return (-1);
+		next = ((top >> 32) + 1) << 32 | (uint32_t) LOAD_ACQUIRE(&ctrl->Buffers[buffer].Next);
+	} while (!__atomic_compare_exchange_n(&ctrl->FreeBuffers, &top, next, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	ctrl->Buffers[buffer].Holder = 0;
+	STORE_RELEASE(&ctrl->Buffers[buffer].Refs, 1);
+	return (buffer);
+
+}
+
+/**@brief adds a reference to buffer on behalf of the client of slot client,
+ * put back by the client (or for it, if it dies first). A buffer is lent to
+ * one client at a time
+ * @return 0, -1 if the buffer is already lent
+ * */
+int fins_channel_buffer_lend(struct finsChannelControl *ctrl, int buffer, int client)
+{
+	int none = 0;
+
+	if (!__atomic_compare_exchange_n(&ctrl->Buffers[buffer].Holder, &none, client + 1, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return (-1);
+	__atomic_add_fetch(&ctrl->Buffers[buffer].Refs, 1, __ATOMIC_RELAXED);
+	return (0);
+
+}
+
+/**@brief drops a reference to buffer, the last one gives it back to the pool
+ * */
+void fins_channel_buffer_put(struct finsChannelControl *ctrl, int buffer)
+{
+	uint64_t top;
+	uint64_t next;
+
+	if (__atomic_sub_fetch(&ctrl->Buffers[buffer].Refs, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	top = LOAD_ACQUIRE(&ctrl->FreeBuffers);
+	do
+	{
+		STORE_RELEASE(&ctrl->Buffers[buffer].Next, (int) (uint32_t) top);
+		next = ((top >> 32) + 1) << 32 | (uint32_t) (buffer + 1);
+	} while (!__atomic_compare_exchange_n(&ctrl->FreeBuffers, &top, next, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+}
+
+/**@brief puts back the reference buffer was lent to the client of slot client
+ * with, if it still holds it
+ * */
+void fins_channel_buffer_return(struct finsChannelControl *ctrl, int buffer, int client)
+{
+	int holder = client + 1;
+
+	if (__atomic_compare_exchange_n(&ctrl->Buffers[buffer].Holder, &holder, 0, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		fins_channel_buffer_put(ctrl, buffer);
+
+}
+
+/** @return the buffer holding the byte p points to, -1 if p is not in the pool */
+int fins_channel_buffer_find(struct finsChannelControl *ctrl, const void *p)
+{
+	const unsigned char *first = (const unsigned char *) ctrl->Buffers;
+
+	if ((const unsigned char *) p < first
+			|| (const unsigned char *) p >= (const unsigned char *) &ctrl->Buffers[FINS_CHANNEL_BUFFERS])
+		return (-1);
+	return (((const unsigned char *) p - first) / sizeof(struct finsChannelBuffer));
+
+}
+
+/** puts back the references of the buffers lent to the dead client of slot client */
+static void fins_channel_buffer_reclaim(struct finsChannelControl *ctrl, int client)
+{
+	int i;
+
+	for (i = 0; i < FINS_CHANNEL_BUFFERS; i++)
+		fins_channel_buffer_return(ctrl, i, client);
+
+}
+
+/**@brief maps the channel created by the jinni and claims a free client slot
+ * for the calling process. The slot of a process that died is marked draining
+ * for the jinni to hand it back (see fins_channel_release), a jinni worker may
+ * still be reading a request from it: the process waits for a while if no
+ * other slot is free
+ * @return 0 on success, -1 if the jinni is not running or all slots are busy
+ * */
+int fins_channel_attach(struct finsChannel *ch)
+{
+	struct finsChannelControl *ctrl = ch->Control;
+	struct finsChannelClient *client;
+	struct timespec pause;
+	pid_t pid = getpid();
+	pid_t owner;
+	int waited;
+	int draining;
+	int fd;
+	int i;
+
+	if (ctrl == NULL)
+	{
+		fd = shm_open(FINS_CHANNEL_NAME, O_RDWR, 0);
+		if (fd == -1)
+			return (-1);
+		ctrl = (struct finsChannelControl *) mmap(NULL, sizeof(struct finsChannelControl),
+				PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (ctrl == MAP_FAILED)
+			return (-1);
+		if (LOAD_ACQUIRE(&ctrl->Magic) != FINS_CHANNEL_MAGIC
+				|| ctrl->Size != sizeof(struct finsChannelControl))
+		{
+			PRINT_DEBUG("the channel was created by an incompatible jinni");
+			munmap(ctrl, sizeof(struct finsChannelControl));
+			return (-1);
+		}
+	}
+
+	pause.tv_sec = 0;
+	pause.tv_nsec = FINS_CHANNEL_DRAIN_CHECK_MS * 1000000L;
+	for (waited = 0; waited <= FINS_CHANNEL_DRAIN_WAIT_MS; waited += FINS_CHANNEL_DRAIN_CHECK_MS)
+	{
+		draining = 0;
+		for (i = 0; i < FINS_CHANNEL_MAX_CLIENTS; i++)
+		{
+			client = &ctrl->Clients[i];
+			owner = LOAD_ACQUIRE(&client->Pid);
+			if (owner > 0 && kill(owner, 0) == -1 && errno == ESRCH
+					&& __atomic_compare_exchange_n(&client->Pid, &owner, FINS_CHANNEL_DRAINING, 0,
+							__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			{
+				/** the jinni hands the slot back once nothing reads it */
+				PRINT_DEBUG("process %d of channel slot %d is gone", owner, i);
+				fins_channel_ring(&ctrl->RequestBell);
+				owner = FINS_CHANNEL_DRAINING;
+			}
+			if (owner == FINS_CHANNEL_DRAINING)
+				draining++;
+			if (owner != 0)
+				continue;
+			/** a free slot was emptied by the jinni (or never used) */
+			if (!__atomic_compare_exchange_n(&client->Pid, &owner, pid, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				continue;
+
+			ch->Control = ctrl;
+			ch->Client = client;
+			ch->Pid = pid;
+			ch->Issued = 0;
+			PRINT_DEBUG("process %d attached to channel slot %d", pid, i);
+			return (0);
+		}
+		if (draining == 0)
+			break;
+		nanosleep(&pause, NULL);
+	}
+
+	PRINT_DEBUG("all the %d channel slots are in use", FINS_CHANNEL_MAX_CLIENTS);
+	return (-1);
+
+}
+
+/**@brief starts a request record of up to len bytes on the client's request ring
+ * @return 0 on success, -1 if len can never fit
+ * */
+int fins_channel_request(struct finsChannel *ch, struct finsChannelWriter *w, unsigned int len)
+{
+
+	return (fins_channel_begin(&ch->Client->Request, &ch->Control->RequestBell, 0, w, len));
+
+}
+
+/**@brief waits for the next response record and opens it
+ * */
+void fins_channel_response(struct finsChannel *ch, struct finsChannelReader *r)
+{
+	struct finsChannelRing *ring = &ch->Client->Response;
+
+	while (!fins_channel_open(ring, r))
+		fins_channel_wait(&ring->DataBell, fins_channel_has_data, ring, 0);
+
+}
+
+static int fins_channel_has_credit(void *arg)
+{
+	struct finsChannel *ch = (struct finsChannel *) arg;
+
+	return (ch->Issued - LOAD_ACQUIRE(&ch->Client->Completed) < FINS_CHANNEL_CREDITS);
+
+}
+
+/**@brief takes a credit for an asynchronous request, waiting for the jinni
+ * to hand one back if all are in use. Called by one thread at a time, with
+ * the request ring
+ * @param wait 0 not to wait
+ * @return 0 on success, -1 if there was no credit and wait is 0
+ * */
+int fins_channel_credit(struct finsChannel *ch, int wait)
+{
+
+	while (!fins_channel_has_credit(ch))
+	{
+		if (!wait)
+			return (-1);
+		fins_channel_wait(&ch->Client->CreditBell, fins_channel_has_credit, ch, 0);
+	}
+	ch->Issued++;
+	return (0);
+
+}
+
+/**@brief creates (or recreates) the channel, to be called once by the jinni
+ * before any client starts
+ * */
+struct finsChannelControl *fins_channel_create()
+{
+	struct finsChannelControl *ctrl;
+	int fd;
+	int i;
+
+	shm_unlink(FINS_CHANNEL_NAME);
+	fd = shm_open(FINS_CHANNEL_NAME, O_RDWR | O_CREAT | O_EXCL, 0666);
+	if (fd == -1)
+	{
+		PRINT_DEBUG("cannot create the channel, errno %d", errno);
+		return (NULL);
+	}
+	/** every user's applications may be intercepted, whatever the umask */
+	fchmod(fd, 0666);
+	if (ftruncate(fd, sizeof(struct finsChannelControl)) == -1)
+	{
+		PRINT_DEBUG("cannot size the channel, errno %d", errno);
+		close(fd);
+		return (NULL);
+	}
+	ctrl = (struct finsChannelControl *) mmap(NULL, sizeof(struct finsChannelControl),
+			PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ctrl == MAP_FAILED)
+		return (NULL);
+
+	/** a new segment is zero filled: every slot is free and every ring empty */
+	for (i = 0; i < FINS_CHANNEL_BUFFERS; i++)
+		ctrl->Buffers[i].Next = (i + 1 < FINS_CHANNEL_BUFFERS) ? i + 2 : 0;
+	ctrl->FreeBuffers = 1;
+	ctrl->Size = sizeof(struct finsChannelControl);
+	STORE_RELEASE(&ctrl->Magic, FINS_CHANNEL_MAGIC);
+	return (ctrl);
+
+}
+
+struct fins_channel_scan
+{
+	struct finsChannelControl *ctrl;
+	int *busy;
+};
+
+/** @return 1 when the slot of a dead client is no longer read and can be
+ * handed back */
+static int fins_channel_drained(struct finsChannelControl *ctrl, int *busy, int client)
+{
+
+	return (LOAD_ACQUIRE(&ctrl->Clients[client].Pid) == FINS_CHANNEL_DRAINING
+			&& (busy == NULL || !LOAD_ACQUIRE(&busy[client])));
+
+}
+
+/** @return 1 when a client that is not busy has a request waiting, or a
+ * drained slot is to be handed back */
+static int fins_channel_any_request(void *arg)
+{
+	struct fins_channel_scan *s = (struct fins_channel_scan *) arg;
+	int i;
+
+	for (i = 0; i < FINS_CHANNEL_MAX_CLIENTS; i++)
+	{
+		if (fins_channel_drained(s->ctrl, s->busy, i))
+			return (1);
+		if (LOAD_ACQUIRE(&s->ctrl->Clients[i].Pid) > 0
+				&& (s->busy == NULL || !LOAD_ACQUIRE(&s->busy[i]))
+				&& fins_channel_has_data(&s->ctrl->Clients[i].Request))
+			return (1);
+	}
+	return (0);
+
+}
+
+/**@brief waits for a request from any client and opens it. The clients are
+ * served round robin, scan keeps the position between calls
+ * @param busy NULL, or a flag per slot, so that the records of a client can
+ * be read by other threads: the flag of the returned client is set until r
+ * is finished, and the clients whose flag is set are skipped meanwhile
+ * @return the slot of the client, to reply through. -1 when nothing was
+ * opened but the slot of a dead client is drained, the caller hands it back
+ * with fins_channel_release
+ * */
+int fins_channel_next_request(struct finsChannelControl *ctrl, struct finsChannelReader *r, int *scan,
+		int *busy)
+{
+	struct fins_channel_scan s = { ctrl, busy };
+	int i;
+	int n;
+
+	while (1)
+	{
+		for (n = 0; n < FINS_CHANNEL_MAX_CLIENTS; n++)
+		{
+			i = (*scan + n) % FINS_CHANNEL_MAX_CLIENTS;
+			if (fins_channel_drained(ctrl, busy, i))
+				return (-1);
+			if (LOAD_ACQUIRE(&ctrl->Clients[i].Pid) <= 0)
+				continue;
+			if (busy != NULL && LOAD_ACQUIRE(&busy[i]))
+				continue;
+			if (fins_channel_open(&ctrl->Clients[i].Request, r))
+			{
+				*scan = (i + 1) % FINS_CHANNEL_MAX_CLIENTS;
+				if (busy != NULL)
+				{
+					__atomic_store_n(&busy[i], 1, __ATOMIC_SEQ_CST);
+					r->Busy = &busy[i];
+					r->Wake = &ctrl->RequestBell;
+				}
+				return (i);
+			}
+		}
+		fins_channel_wait(&ctrl->RequestBell, fins_channel_any_request, &s, 0);
+	}
+
+}
+
+/**@brief hands the slot client back if its process died and no request of
+ * it is being read any more: the rings are emptied and the buffers lent to the
+ * process are put back, then a new process may attach to the slot. The
+ * caller makes sure no response to the slot is being written meanwhile
+ * @param busy as for fins_channel_next_request
+ * @return 0 if the slot was handed back, -1 if it is not drained
+ * */
+int fins_channel_release(struct finsChannelControl *ctrl, int client, int *busy)
+{
+	struct finsChannelClient *c = &ctrl->Clients[client];
+
+	if (!fins_channel_drained(ctrl, busy, client))
+		return (-1);
+
+	c->Request.Head = c->Request.Tail = 0;
+	c->Response.Head = c->Response.Tail = 0;
+	c->Completed = 0;
+	fins_channel_buffer_reclaim(ctrl, client);
+	STORE_RELEASE(&c->Pid, 0);
+	PRINT_DEBUG("channel slot %d is free again", client);
+	return (0);
+
+}
+
+/** @return the slot of the client process pid, -1 if it is not attached */
+int fins_channel_find(struct finsChannelControl *ctrl, pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < FINS_CHANNEL_MAX_CLIENTS; i++)
+		if (LOAD_ACQUIRE(&ctrl->Clients[i].Pid) == pid)
+			return (i);
+	return (-1);
+
+}
+
+/**@brief starts a response record of up to len bytes to the client of slot
+ * client, waiting for room while the client is alive
+ * @return 0 on success, -1 if len can never fit or the client is gone
+ * */
+int fins_channel_reply(struct finsChannelControl *ctrl, int client, struct finsChannelWriter *w,
+		unsigned int len)
+{
+	struct finsChannelClient *c = &ctrl->Clients[client];
+	pid_t pid = LOAD_ACQUIRE(&c->Pid);
+
+	/** the process may have been found dead since its slot was looked up */
+	if (pid <= 0)
+		return (-1);
+	return (fins_channel_begin(&c->Response, &c->Response.DataBell, pid, w, len));
+
+}
+
+/**@brief hands back the credit of an asynchronous request of process pid,
+ * once it is handled. Nothing is done if pid is gone, its slot may belong
+ * to another process by now
+ * */
+void fins_channel_complete(struct finsChannelControl *ctrl, pid_t pid)
+{
+	struct finsChannelClient *c;
+	int client;
+
+	client = fins_channel_find(ctrl, pid);
+	if (client == -1)
+		return;
+	c = &ctrl->Clients[client];
+	__atomic_add_fetch(&c->Completed, 1, __ATOMIC_RELEASE);
+	fins_channel_ring(&c->CreditBell);
+
+}
+
+/**@brief creates the socket table the jinni publishes, all the entries free
+ * @return the table, NULL on failure
+ * */
+struct finsSocketTable *fins_sockets_create()
+{
+	struct finsSocketTable *table;
+	int fd;
+
+	shm_unlink(FINS_SOCKETS_NAME);
+	fd = shm_open(FINS_SOCKETS_NAME, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd == -1)
+	{
+		PRINT_DEBUG("cannot create the socket table, errno %d", errno);
+		return (NULL);
+	}
+	/** every user's applications read it, only the jinni writes it */
+	fchmod(fd, 0644);
+	if (ftruncate(fd, sizeof(struct finsSocketTable)) == -1)
+	{
+		PRINT_DEBUG("cannot size the socket table, errno %d", errno);
+		close(fd);
+		return (NULL);
+	}
+	table = (struct finsSocketTable *) mmap(NULL, sizeof(struct finsSocketTable),
+			PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (table == MAP_FAILED)
+		return (NULL);
+
+	table->Size = sizeof(struct finsSocketTable);
+	STORE_RELEASE(&table->Magic, FINS_CHANNEL_MAGIC);
+	return (table);
+
+}
+
+/**@brief replaces the entry index of the table with entry. The updates of
+ * one entry have to be serialized by the caller
+ * */
+void fins_sockets_publish(struct finsSocketTable *table, int index, const struct finsSocketEntry *entry)
+{
+	struct finsSocketEntry *e = &table->Sockets[index];
+	unsigned int seq = e->Seq;
+
+	__atomic_store_n(&e->Seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	e->Pid = entry->Pid;
+	e->Fd = entry->Fd;
+	e->Type = entry->Type;
+	e->Protocol = entry->Protocol;
+	e->HostPort = entry->HostPort;
+	e->DstPort = entry->DstPort;
+	e->HostIP = entry->HostIP;
+	e->DstIP = entry->DstIP;
+	e->Error = entry->Error;
+	e->Errors = entry->Errors;
+	STORE_RELEASE(&e->Seq, seq + 2);
+
+}
+
+/**@brief maps the socket table published by the jinni, read only
+ * @return the table, NULL if there is none
+ * */
+struct finsSocketTable *fins_sockets_attach()
+{
+	struct finsSocketTable *table;
+	int fd;
+
+	fd = shm_open(FINS_SOCKETS_NAME, O_RDONLY, 0);
+	if (fd == -1)
+		return (NULL);
+	table = (struct finsSocketTable *) mmap(NULL, sizeof(struct finsSocketTable),
+			PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (table == MAP_FAILED)
+		return (NULL);
+	if (LOAD_ACQUIRE(&table->Magic) != FINS_CHANNEL_MAGIC
+			|| table->Size != sizeof(struct finsSocketTable))
+	{
+		PRINT_DEBUG("the socket table was created by an incompatible jinni");
+		munmap(table, sizeof(struct finsSocketTable));
+		return (NULL);
+	}
+	return (table);
+
+}
+
+/**@brief copies the entry of the socket fd of process pid out of the table,
+ * consistent with itself however the jinni updates it meanwhile
+ * @return 0, -1 if the table has no such socket
+ * */
+int fins_sockets_lookup(struct finsSocketTable *table, pid_t pid, int fd, struct finsSocketEntry *entry)
+{
+	struct finsSocketEntry *e;
+	unsigned int seq;
+	int i;
+
+	for (i = 0; i < FINS_SOCKETS_MAX; i++)
+	{
+		e = &table->Sockets[i];
+		if (__atomic_load_n(&e->Pid, __ATOMIC_RELAXED) != pid)
+			continue;
+		do
+		{
+			while ((seq = LOAD_ACQUIRE(&e->Seq)) & 1)
+				;
+			*entry = *e;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		} while (__atomic_load_n(&e->Seq, __ATOMIC_RELAXED) != seq);
+		if (entry->Pid == pid && entry->Fd == fd)
+			return (0);
+	}
+	return (-1);
+
+}
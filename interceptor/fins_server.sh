@@ -1,6 +1,7 @@
 #!/bin/bash
 clear
 gcc -fPIC -c -o socket_interceptor.o socket_interceptor.c
-gcc -shared -o socket_interceptor.so socket_interceptor.o -ldl -lpcap -lpthread
+gcc -fPIC -c -o finsChannel.o finsChannel.c
+gcc -shared -o socket_interceptor.so socket_interceptor.o finsChannel.o -ldl -lpcap -lpthread -lrt
 LD_PRELOAD="./socket_interceptor.so" ./server
 
@@ -39,6 +39,8 @@
 
 
 #include <fcntl.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
 /* to handle pcap functions */
 #include <pcap.h>
 #include "socket_interceptor.h"
@@ -62,6 +64,50 @@
 extern int errorno;
 
 
+/**@brief resolves the GNU C library functions the wrappers fall back to, once
+ * when the library is loaded rather than on every call
+ */
+static void __attribute__ ((constructor)) fins_interceptor_init()
+{
+	char *errormsg;
+
+	_socket = (int (*)(int domain, int type, int protocol)) dlsym(RTLD_NEXT, "socket");
+	_bind = ( int (*) (int sockfd, const struct sockaddr *addr, socklen_t addrlen) ) dlsym(RTLD_NEXT, "bind");
+	_recv = ( ssize_t (*) (int sockfd, void *buf, size_t len, int flags) ) dlsym(RTLD_NEXT, "recv");
+	_recvfrom = ( ssize_t (*) (int sockfd, void *buf, size_t len, int flags,
+			struct sockaddr *src_addr, socklen_t *addrlen) ) dlsym(RTLD_NEXT, "recvfrom");
+	_recvmsg = ( ssize_t (*) (int sockfd, struct msghdr *msg, int flags) ) dlsym(RTLD_NEXT, "recvmsg");
+	_send = ( ssize_t (*) (int sockfd, const void *buf, size_t len, int flags)) dlsym(RTLD_NEXT, "send");
+	_sendto = ( ssize_t (*) (int sockfd, const void *buf, size_t len, int flags,
+			const struct sockaddr *dest_addr, socklen_t addrlen)) dlsym(RTLD_NEXT, "sendto");
+	_sendmsg = (ssize_t (*) (int sockfd, const struct msghdr *msg, int flags) ) dlsym(RTLD_NEXT, "sendmsg");
+	_sendmmsg = (int (*) (int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) )
+			dlsym(RTLD_NEXT, "sendmmsg");
+	_recvmmsg = (int (*) (int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+			struct timespec *timeout) ) dlsym(RTLD_NEXT, "recvmmsg");
+	_shutdown = (int (*) (int fd, int how) ) dlsym(RTLD_NEXT, "shutdown");
+	_write = (ssize_t (*) (int sockfd, const void *buf, size_t count) ) dlsym(RTLD_NEXT, "write");
+	_close = (int (*) (int fd) ) dlsym(RTLD_NEXT, "close");
+	_fcntl = (int (*) (int fd, int cmd, ...) ) dlsym(RTLD_NEXT, "fcntl");
+	_ioctl = (int (*) (int fd, unsigned long int request, ...) ) dlsym(RTLD_NEXT, "ioctl");
+	_getsockname = (int (*) (int fd, struct sockaddr *addr, socklen_t *addrlen) )
+			dlsym(RTLD_NEXT, "getsockname");
+	_getpeername = (int (*) (int fd, struct sockaddr *addr, socklen_t *addrlen) )
+			dlsym(RTLD_NEXT, "getpeername");
+	_getsockopt = (int (*) (int fd, int level, int optname, void *optval, socklen_t *optlen) )
+			dlsym(RTLD_NEXT, "getsockopt");
+
+	fins_send_async = (getenv("FINS_SEND_ASYNC") != NULL);
+
+	errormsg = dlerror();
+	if (errormsg != NULL)
+	{
+		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
+	}
+
+}
+
+
 /** functions needed for functionality of the test */
 
 /** @brief
@@ -90,68 +136,52 @@ uint32_t gen_IP_addrs(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
  * TODO free and close/DESTORY all the semaphores before exit !!!
  *
  */
+/**@brief attaches the calling process to the channel, unless it already is.
+ * A process forked after the channel was attached gets a slot of its own.
+ * Called with fins_channel_lock held
+ */
+static void fins_channel_check()
+{
+
+	if (fins_channel.Pid == getpid())
+		return;
+	if (fins_channel_attach(&fins_channel) != 0)
+	{
+		PRINT_DEBUG("unable to attach to the socket jinni channel");
+		exit(-1);
+	}
+	/** the calls of the parent are not ours to wait for */
+	pthread_mutex_lock(&fins_calls_lock);
+		fins_calls = NULL;
+		fins_calls_reading = 0;
+	pthread_mutex_unlock(&fins_calls_lock);
+
+}
+
 void init_socketChannel()
 {
 
 	int i;
-	 /** Notice that the main_channel_Semaphore is a semaphore shared among processes
-	  * (It is processes level semaphore, NOT threads level)
+	 /** Notice that the channel is shared among processes, it is created by
+	  * the socket jinni which therefore has to be started first
 	  */
 
-	/** Needs NPTL because LinuxThreads does not support sharing semaphores between processes */
-
-
-	/** the semaphore is initially locked */
+	pthread_mutex_lock(&fins_channel_lock);
+		fins_channel_check();
+	pthread_mutex_unlock(&fins_channel_lock);
 
-	//main_channel_semaphore1 = sem_open(main_sem_name1,O_CREAT|O_EXCL,0644,0);
-	main_channel_semaphore1 = sem_open(main_sem_name1,0,0644,0);
-	PRINT_DEBUG();
-	if (main_channel_semaphore1 == SEM_FAILED)
+	if (fins_sockets == NULL)
 	{
-
-		main_channel_semaphore1 = sem_open(main_sem_name1,0);
-		PRINT_DEBUG();
-
+		fins_sockets = fins_sockets_attach();
+		if (fins_sockets == NULL)
+		{
+			PRINT_DEBUG("unable to attach to the socket table of the jinni");
+			exit(-1);
+		}
 	}
-	 if(main_channel_semaphore1 == SEM_FAILED)
-	    {
-	      perror("unable to create semaphore");
-	      sem_unlink(main_sem_name1);
-	      exit(-1);
-	    }
-
-	// main_channel_semaphore2 = sem_open(main_sem_name2,O_CREAT|O_EXCL,0644,0);
-	 main_channel_semaphore2 = sem_open(main_sem_name2,0,0644,0);
-	 PRINT_DEBUG();
-	 if (main_channel_semaphore2 == SEM_FAILED)
-	 	{
-	 		main_channel_semaphore2 = sem_open(main_sem_name2,0);
-	 		PRINT_DEBUG();
-
-	 	}
-	 	 if(main_channel_semaphore2 == SEM_FAILED)
-	 	    {
-	 	      perror("unable to create semaphore");
-	 	      sem_unlink(main_sem_name2);
-	 	      exit(-1);
-	 	    }
-
-
 
 	 PRINT_DEBUG("111");
 
-	//	mkfifo(MAIN_SOCKET_CHANNEL,0777);
-		socket_channel_desc = open (MAIN_SOCKET_CHANNEL,O_WRONLY);
-
-	 int tester;
-	 sem_getvalue(main_channel_semaphore1,&tester);
-	 PRINT_DEBUG("tester = %d",tester);
-	//sem_wait(main_channel_semaphore);
-	 PRINT_DEBUG("222");
-
-
-	 PRINT_DEBUG("333");
-
 	/** initialize the sockets database
 	 * this is a simplified version from the full detailed database available
 	 * on the socket jinni side
@@ -171,6 +201,164 @@ void init_socketChannel()
 }
 
 
+/**@brief starts the request of a call, its header is written and len bytes
+ * of arguments are to follow before fins_call_commit
+ * @return 0 on success, -1 if the request can never fit in the ring
+ */
+int fins_call_request(struct finsCall *call, struct finsChannelWriter *request, u_int opcode,
+		unsigned int len)
+{
+	struct finsChannelHeader header;
+
+	pthread_mutex_lock(&fins_channel_lock);
+	fins_channel_check();
+	if (fins_channel_request(&fins_channel,request,sizeof (struct finsChannelHeader) + len) == -1)
+	{
+		pthread_mutex_unlock(&fins_channel_lock);
+		return (-1);
+	}
+
+	/** registered before the jinni can answer it */
+	pthread_mutex_lock(&fins_calls_lock);
+		call->Id = ++fins_calls_id;
+		call->Ready = 0;
+		call->Next = fins_calls;
+		fins_calls = call;
+	pthread_mutex_unlock(&fins_calls_lock);
+
+	header.Version = FINS_CHANNEL_VERSION;
+	header.Code = opcode;
+	header.Id = call->Id;
+	header.Pid = getpid();
+	fins_channel_put(request,&header,sizeof (struct finsChannelHeader));
+	return (0);
+
+}
+
+/**@brief starts an asynchronous request, which gets no response: the jinni
+ * only hands its credit back once it is handled. Its header is written and
+ * len bytes of arguments are to follow before fins_call_commit
+ * @param wait 0 to give up rather than wait for a credit
+ * @return 0 on success, -1 with errno set if there is no credit (EAGAIN) or
+ * the request can never fit in the ring (EMSGSIZE)
+ */
+int fins_call_async(struct finsChannelWriter *request, u_int opcode, unsigned int len, int wait)
+{
+	struct finsChannelHeader header;
+
+	pthread_mutex_lock(&fins_channel_lock);
+	fins_channel_check();
+	if (fins_channel_credit(&fins_channel,wait) == -1)
+	{
+		pthread_mutex_unlock(&fins_channel_lock);
+		errno = EAGAIN;
+		return (-1);
+	}
+	if (fins_channel_request(&fins_channel,request,sizeof (struct finsChannelHeader) + len) == -1)
+	{
+		/** the credit is lost with the request */
+		fins_channel.Issued--;
+		pthread_mutex_unlock(&fins_channel_lock);
+		errno = EMSGSIZE;
+		return (-1);
+	}
+
+	/** no call waits for a response, 0 is not an Id of fins_call_request */
+	header.Version = FINS_CHANNEL_VERSION;
+	header.Code = opcode;
+	header.Id = 0;
+	header.Pid = getpid();
+	fins_channel_put(request,&header,sizeof (struct finsChannelHeader));
+	return (0);
+
+}
+
+/**@brief sends the request, the channel is free for the other threads while
+ * the call waits for its response
+ */
+void fins_call_commit(struct finsChannelWriter *request)
+{
+
+	fins_channel_commit(request);
+	pthread_mutex_unlock(&fins_channel_lock);
+
+}
+
+/**@brief waits for the response of call. One thread at a time reads the
+ * response ring (the leader), the others wait: the leader hands every record
+ * it reads to the call with its Id, still in the ring, and lets that call
+ * become the leader until it finishes the record. So the threads do not
+ * wait for each other's calls, a blocking recvfrom included
+ * @return 1 if the response is an ACK, 0 otherwise (errno is set when the
+ * jinni sent one). The arguments of the response are read from
+ * call->Response, up to fins_call_finish
+ */
+int fins_call_response(struct finsCall *call)
+{
+	struct finsChannelReader r;
+	struct finsChannelHeader header;
+	struct finsCall **p;
+	struct finsCall *owner;
+	int numOfBytes;
+	int error;
+
+	pthread_mutex_lock(&fins_calls_lock);
+	while (!call->Ready)
+	{
+		if (fins_calls_reading)
+		{
+			pthread_cond_wait(&fins_calls_cond,&fins_calls_lock);
+			continue;
+		}
+		fins_calls_reading = 1;
+		pthread_mutex_unlock(&fins_calls_lock);
+
+		fins_channel_response(&fins_channel,&r);
+		numOfBytes = fins_channel_get(&r,&header,sizeof (struct finsChannelHeader));
+
+		pthread_mutex_lock(&fins_calls_lock);
+		for (p = &fins_calls; *p != NULL && (*p)->Id != header.Id; p = &(*p)->Next)
+			;
+		if (numOfBytes != sizeof (struct finsChannelHeader)
+				|| header.Version != FINS_CHANNEL_VERSION || *p == NULL)
+		{
+			PRINT_DEBUG("response %u matches no call, dropped",header.Id);
+			fins_channel_finish(&r);
+			fins_calls_reading = 0;
+			continue;
+		}
+		owner = *p;
+		*p = owner->Next;
+		owner->Header = header;
+		owner->Response = r;
+		owner->Ready = 1;
+		if (owner != call)
+			pthread_cond_broadcast(&fins_calls_cond);
+	}
+	pthread_mutex_unlock(&fins_calls_lock);
+
+	/** a NACK may carry the errno of the failure */
+	if (call->Header.Code != ACK && fins_channel_get(&call->Response,&error,sizeof (int)) == sizeof (int))
+		errno = error;
+	return (call->Header.Code == ACK);
+
+}
+
+/**@brief gives the response record back to the ring, and the reading of the
+ * ring to the next waiting call
+ */
+void fins_call_finish(struct finsCall *call)
+{
+
+	fins_channel_finish(&call->Response);
+	pthread_mutex_lock(&fins_calls_lock);
+		fins_calls_reading = 0;
+		pthread_cond_broadcast(&fins_calls_cond);
+	pthread_mutex_unlock(&fins_calls_lock);
+
+}
+
+
 
 
 /** @brief
@@ -219,17 +407,14 @@ int fins_socket(int domain, int type, int protocol)
 	 * protect them with multi-processes semaphore
 	 */
 	static int numberOfcalls=1000;
-	//static int numofcall =0;
-	int numOfBytes=-1;
 	u_int callcode;
 	char clientname[240];
 	int tempdescriptor;
 	int fakeid;
-	int flags;
-	int writtenBytes=-1;
 	int confirmation;
 	pid_t processid;
-	int index;
+	struct finsCall call;
+	struct finsChannelWriter request;
 	processid =getpid();
 	callcode = socket_call;
 	// TODO lock the locker protect the static variable
@@ -243,141 +428,52 @@ int fins_socket(int domain, int type, int protocol)
 	fakeid = numberOfcalls;
 
 
-	 PRINT_DEBUG("34535");
-
-	/** TODO lock access to the MAIN SOCKET CHANNEL
-	* to force synchronization with the socket jinni ,
-	* we need also to lock access to the
-	* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-	* RX_channel but the current thread
-	* */
-
 	 PRINT_DEBUG("%d", processid);
 
-	sem_wait(main_channel_semaphore2);
-			writtenBytes = write(socket_channel_desc,&processid, sizeof (pid_t) );
-			writtenBytes = write(socket_channel_desc,&callcode, sizeof (u_int) );
-			writtenBytes = write(socket_channel_desc,&domain, sizeof (int) );
-			writtenBytes = write(socket_channel_desc,&type, sizeof (int) );
-			writtenBytes = write(socket_channel_desc,&protocol, sizeof (int) );
-			//write(socket_channel_desc,&tempdescriptor, sizeof (int) );
-			/** send the fakeid twice once as fake ID and once as a real pipe descriptor */
-			writtenBytes = write(socket_channel_desc,&fakeid, sizeof (int) );
-			writtenBytes = write(socket_channel_desc,&fakeid, sizeof (int) );
-
-			sem_post(main_channel_semaphore1);
-		/** Remember to unlock the MAIN CHANNEL */
-	sem_post(main_channel_semaphore2);
-
-
-		 if (writtenBytes > 0)
-		 {
-				PRINT_DEBUG("written bytes %d", writtenBytes);
-
-				PRINT_DEBUG("34535..2342");
-
-		 }
-	sprintf(clientname, CLIENT_CHANNEL_RX,processid,fakeid);
-/** The default will be NON_BLOCKING so that the jinni can open for writing successfully
- *
- *  later we can set/reset the blocking option
- * according to the later desire of the application
- * */
+	/** the request fits in the ring, only a jinni gone away refuses it */
+	if (fins_call_request(&call,&request,callcode,5 * sizeof (int)) == -1)
+	{
+		errno = EIO;
+		return (-1);
+	}
+		fins_channel_put(&request,&domain, sizeof (int) );
+		fins_channel_put(&request,&type, sizeof (int) );
+		fins_channel_put(&request,&protocol, sizeof (int) );
+		/** send the fakeid twice once as fake ID and once as a real pipe descriptor */
+		fins_channel_put(&request,&fakeid, sizeof (int) );
+		fins_channel_put(&request,&fakeid, sizeof (int) );
+	fins_call_commit(&request);
+
+	confirmation = fins_call_response(&call);
+	fins_call_finish(&call);
+
+	if (!confirmation)
+		return (-1);
 
-/** client pipe is initialized as NONBlOCKING to be able to open and
- * proceed even if the writing side did not open yet OR
- * EVEN IF MKFIFO HAS NOT BEEN CALLED YET !!
+/** The jinni created the client pipe and holds it open for writing before
+ * it sent the ACK, so opening our end does not block. The descriptor is what
+ * the application gets back as its socket: the jinni keeps a token byte in
+ * the pipe while datagrams wait on the socket, so that poll, select and epoll
+ * report it readable as they would a kernel socket. Opened read-write, it is
+ * reported writable too, sending on a FINS socket never blocks
  */
-
-/** 1.The interceptor will MAKE FIFO THEN OPEN IT as a blocking reading until the Jinni side opens for writing !
- * 2. Jinni side opens the semaphore & WAIT , then OPEN the file for writing
- * 3. The block on this side will release then it we call WAIT on the semaphore
- * 4. Since semaphore has been already taken by the Jinni then we avoided any dead lock
- *  */
-	//mkfifo(clientname,0777);
-	//PRINT_DEBUG("0000");
-	//tempdescriptor = open (namebuffer,O_RDONLY | O_NONBLOCK);
-
-
-
-	//tempdescriptor = open(clientname,O_RDONLY | O_NONBLOCK);
-	tempdescriptor = open(clientname,O_RDONLY);
+	sprintf(clientname, CLIENT_CHANNEL_RX,processid,fakeid);
+	tempdescriptor = open(clientname,O_RDWR);
+	if (tempdescriptor == -1)
+	{
+		PRINT_DEBUG("unable to open %s", clientname);
+		return (-1);
+	}
 	 PRINT_DEBUG("0001");
 
 
 	sem_wait(&FinsHistory_semaphore);
-	/** insertFinsHistory takes care of initializing the new socket
-	 * and its corresponding Clinet channel semaphore name and semaphore pointer
-	 */
 	insertFinsHistory(processid,tempdescriptor, fakeid) ;
 	sem_post(&FinsHistory_semaphore);
 
-	 PRINT_DEBUG("0002");
-
-/** TODO We depend on the initialization value of the semaphore since it is producing-consuming also known
- * as writing-reading semaphore !  to make sure not to fail into dead lock
- * but in case this fails then we have to implement our own synchronization to avoid
- * dead lock between the client reading side (the interceptor),and the writing side (socket Jinni)
- */
-	 index = searchFinsHistory(processid,tempdescriptor);
-
-		 if (index < 0)
-			{
-				PRINT_DEBUG("incorrect index !! Crash");
-				exit(1);
-
-			}
-
-	 PRINT_DEBUG("index = %d",index);
-	 PRINT_DEBUG("");
-	 sem_wait(FinsHistory[index].as);
-		sem_wait(FinsHistory[index].s);
-				 PRINT_DEBUG("");
-
-				numOfBytes = read(tempdescriptor,&confirmation,sizeof (int));
-
-/** locking the semaphore has been moved below to make sure that deadlock does not occure....*/
-
-			if (confirmation != processid)
-			{
-
-
-				PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
-				sem_post(FinsHistory[searchFinsHistory(processid,tempdescriptor)].s);
-
-				return (-1);
-
-			}
-			numOfBytes = read(tempdescriptor,&confirmation,sizeof (int));
-			if (confirmation != fakeid)
-					{
-
-					PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
-					sem_post(FinsHistory[searchFinsHistory(processid,tempdescriptor)].s);
-					return (-1);
-					}
-			numOfBytes = read(tempdescriptor,&confirmation,sizeof (int));
-			sem_post(FinsHistory[searchFinsHistory(processid,tempdescriptor)].s);
-
-			if (confirmation != ACK)
-					{
-
-					PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
-
-					return (-1);
-					}
-			/**
-			 * Writing a new record to our database after receiving a confirmation
-			 * that a new recorded has been created and added to the master database
-			 */
-
 			PRINT_DEBUG();
 			return(tempdescriptor);
 
-
-
-
-
 } // end of fins_socket
 
 
@@ -402,7 +498,8 @@ int socket(int domain, int type, int protocol)
 	struct socket *sock;
 	int flags;
 	int fins_sock;
-	char *errormsg;
+	/** SOCK_NONBLOCK and SOCK_CLOEXEC may be or'ed into type */
+	int fins_type = type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
 
 
 	/** with the first interception takes place , we initialize the socket channel */
@@ -415,14 +512,6 @@ int socket(int domain, int type, int protocol)
 	print_protocol(domain, type, protocol);
 
 
-	_socket = (int (*)(int domain, int type, int protocol)) dlsym(RTLD_NEXT, "socket");
-
-	errormsg = dlerror();
-	if (errormsg != NULL)
-	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-	}
-
 		if( (domain == AF_UNIX) | (domain == AF_INET6 ) | (domain == AF_NETLINK )
 				| (domain == AF_PACKET) )
 		{
@@ -433,13 +522,20 @@ int socket(int domain, int type, int protocol)
 		else if ( domain == AF_INET )
 
 		{
-			if (type == SOCK_DGRAM ) /** Handle UDP sockets */
+			if (fins_type == SOCK_DGRAM ) /** Handle UDP sockets */
 				{
 				 PRINT_DEBUG("123");
 
-				retval = fins_socket(domain,type, protocol);
+				retval = fins_socket(domain,fins_type, protocol);
 					if (retval != -1)
 						{
+						if (type & SOCK_NONBLOCK)
+						{
+							_fcntl(retval,F_SETFL,O_RDWR | O_NONBLOCK);
+							fins_fd_set_nonblocking(retval,1);
+						}
+						if (type & SOCK_CLOEXEC)
+							_fcntl(retval,F_SETFD,FD_CLOEXEC);
 				// TODO lock the locker protect the static variable
 						numberOfSockets = numberOfSockets +1;
 				// TODO unlock the locker protect the static variable
@@ -471,14 +567,13 @@ int socket(int domain, int type, int protocol)
 int fins_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 {
 
-	int numOfBytes=-1;
 	u_int opcode;
-	char namebuffer[240];
-	int tempdescriptor;
 	pid_t processid;
 	int confirmation;
 	int sockfd_alter;
 	int index;
+	struct finsCall call;
+	struct finsChannelWriter request;
 
 	processid =getpid();
 	opcode = bind_call;
@@ -495,65 +590,26 @@ int fins_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 
 	PRINT_DEBUG();
 
-
-
-
-	/** TODO lock access to the MAIN SOCKET CHANNEL
-	* to force synchronization with the socket jinni ,
-	* we need also to lock access to the
-	* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-	* RX_channel but the current thread
-	* */
-	sem_wait(main_channel_semaphore2);
-		write(socket_channel_desc,&processid, sizeof (pid_t) );
-		write(socket_channel_desc,&opcode, sizeof (u_int) );
-		write(socket_channel_desc,&sockfd_alter, sizeof (int) );
-		write(socket_channel_desc,&addrlen, sizeof (socklen_t) );
-		/** TODO check if writing the whole struct sockaddr at once working properly or not */
-		write(socket_channel_desc,addr, addrlen );
-		sem_post(main_channel_semaphore1);
-	/**TODO remember to unlock the main channel */
-	sem_post(main_channel_semaphore2);
-	PRINT_DEBUG();
-
-/** The code below needs to force kind of synchronization
- * it might be hard to achieve , test this code throughly later
- */
-	sem_wait(FinsHistory[index].as);
-		sem_wait(FinsHistory[index].s);
-		PRINT_DEBUG();
-
-		numOfBytes = read(sockfd,&confirmation,sizeof (int));
-	if (confirmation != processid)
+	if (fins_call_request(&call,&request,opcode,sizeof (int) + sizeof (socklen_t) + addrlen) == -1)
 	{
-		sem_post(FinsHistory[index].s);
+		errno = EIO;
 		return (-1);
 	}
+		fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+		fins_channel_put(&request,&addrlen, sizeof (socklen_t) );
+		fins_channel_put(&request,addr, addrlen );
+	fins_call_commit(&request);
+		PRINT_DEBUG();
 
-	numOfBytes = read(sockfd,&confirmation,sizeof (int));
-
-		if (confirmation != sockfd_alter)
-			{
-			sem_post(FinsHistory[index].s);
-			return (-1);
-
-			}
-
-	numOfBytes = read(sockfd,&confirmation,sizeof (int));
-	sem_post(FinsHistory[index].s);
-	if (confirmation != ACK)
-				{
+	confirmation = fins_call_response(&call);
+	fins_call_finish(&call);
 
+	if (!confirmation)
 		return (-1);
-				}
 
 	/** on success ZERo is returned and on failures , it return (-1) */
 	return (0);
 
-
-
-
-
 }
 
 
@@ -571,28 +627,22 @@ int fins_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 {
 
-
 	 int 	retval;
 
-_bind = ( int (*) (int sockfd, const struct sockaddr *addr, socklen_t addrlen) ) dlsym(RTLD_NEXT, "bind");
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_bind(sockfd, addr, addrlen));
 
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
+	if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
+		retval = fins_bind(sockfd,addr,addrlen);
+		return(retval);
+	}
+	else
+	{
+		PRINT_DEBUG("original bind has been called, socket descriptor is out of range");
+		return (  _bind(sockfd, addr, addrlen)    );
 	}
-
-		if (checkFinsHistory(getpid(),sockfd) != 0)
-		{
-			retval = fins_bind(sockfd,addr,addrlen);
-			return(retval);
-		}
-		else
-		{
-			PRINT_DEBUG("original bind has been called, socket descriptor is out of range");
-			return (  _bind(sockfd, addr, addrlen)    );
-		}
 
 
 } // end of bind fun
@@ -605,84 +655,26 @@ errormsg = dlerror();
 /****************** END OF the bind function ---------------------------------*/
 /*----------------------------------------------------------------------------*/
 
+ssize_t fins_recvfrom(int sockfd, void *buf, size_t len, int flags,
+                        struct sockaddr *src_addr, socklen_t *addrlen);
+
 ssize_t fins_recv(int sockfd, void *buf, size_t len, int flags)
 {
 
-			int bytesread;
-
-			int numOfBytes=-1;
-			u_int opcode;
-			opcode = recvfrom_call;
-
-			pid_t processid;
-			int confirmation;
-			processid =getpid();
-
-			/** TODO lock access to the MAIN SOCKET CHANNEL
-			* to force synchronization with the socket jinni ,
-			* we need also to lock access to the
-			* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-			* RX_channel but the current thread
-			* */
-		sem_wait(main_channel_semaphore2);
-			write(socket_channel_desc,&processid, sizeof (pid_t) );
-			write(socket_channel_desc,&opcode, sizeof (u_int) );
-			write(socket_channel_desc,&sockfd, sizeof (int) );
-			write(socket_channel_desc,&len, sizeof(size_t) );
-			write(socket_channel_desc,&flags, sizeof(int) );
-			sem_post(main_channel_semaphore1);
-		sem_post(main_channel_semaphore2);
-			/**TODO remember to unlock the main channel */
-
-
-			do
-				{
-
-					numOfBytes = read(sockfd,&confirmation,sizeof (int));
-
-				} while (numOfBytes <=0);
-
-				if (confirmation != processid)
-					return (-1);
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-				if (confirmation != sockfd)
-					return (-1);
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-					if (confirmation != ACK)
-							return (-1);
-				/** The socket jinni sent us, the number of bytes to be received
-				 * we have to check that our buffer size is enough to read
-				 * */
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-				if (numOfBytes == -1)
-					return(-1);
-				if (confirmation <=len)
-				{
-					bytesread = read(sockfd,buf,confirmation);
-				return (bytesread);
-				}
-PRINT_DEBUG("passed buffer length sent from the application is not enough to hold the data");
-		return (-1);
-			/**TODO remember to unlock the RX_CHANNEL */
-
-
+	/** recv is recvfrom without the source address */
+	return ( fins_recvfrom(sockfd, buf, len, flags, NULL, NULL) );
 
 } // end of fins_recv
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags)
 {
 
-
-_recv = ( ssize_t (*) (int sockfd, void *buf, size_t len, int flags) ) dlsym(RTLD_NEXT, "recv");
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
-	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-	}
-
 	int bytesread;
 
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_recv(sockfd,buf, len, flags));
+
 	PRINT_DEBUG ("sockfd from process %d got into recv = %d",getpid(),sockfd);
 
 	if (checkFinsHistory(getpid(),sockfd) != 0)
@@ -714,9 +706,7 @@ errormsg = dlerror();
 ssize_t fins_recvfrom(int sockfd, void *buf, size_t len, int flags,
                         struct sockaddr *src_addr, socklen_t *addrlen)
 {
-		int bytesread;
-
-		int numOfBytes=-1;
+		int bytesread = -1;
 		u_int opcode;
 		int index;
 		int sockfd_alter;
@@ -725,142 +715,71 @@ ssize_t fins_recvfrom(int sockfd, void *buf, size_t len, int flags,
 
 		pid_t processid;
 		int confirmation;
+		struct finsCall call;
+		struct finsChannelWriter request;
 		processid =getpid();
 
 		index = searchFinsHistory(processid,sockfd);
 		sockfd_alter = FinsHistory[index].fakeID;
+		if (src_addr == NULL)
+			symbol = 0;
+		if (fins_fd_nonblocking(sockfd))
+			flags |= MSG_DONTWAIT;
 
-		/** TODO lock access to the MAIN SOCKET CHANNEL
-		* to force synchronization with the socket jinni ,
-		* we need also to lock access to the
-		* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-		* RX_channel but the current thread
-		* */
 		PRINT_DEBUG();
-		sem_wait(main_channel_semaphore2);
-			write(socket_channel_desc,&processid, sizeof (pid_t) );
-			write(socket_channel_desc,&opcode, sizeof (u_int) );
-			write(socket_channel_desc,&sockfd_alter, sizeof (int) );
-			write(socket_channel_desc,&len, sizeof(size_t) );
-			write(socket_channel_desc,&flags, sizeof(int) );
-			if (src_addr !=NULL)
-				write(socket_channel_desc,&symbol, sizeof (int));
-			else
+		if (fins_call_request(&call,&request,opcode,3 * sizeof (int) + sizeof (size_t)) == -1)
+		{
+			errno = EIO;
+			return (-1);
+		}
+			fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+			fins_channel_put(&request,&len, sizeof(size_t) );
+			fins_channel_put(&request,&flags, sizeof(int) );
+			fins_channel_put(&request,&symbol, sizeof (int));
+		fins_call_commit(&request);
+
+			/** The socket jinni sends the source address if we asked for it,
+			 * then the number of bytes received and the bytes themselves
+			 */
+			if (!fins_call_response(&call))
 			{
-				symbol =0;
-				write(socket_channel_desc,&symbol, sizeof (int));
+				PRINT_DEBUG("recvfrom refused by the socket jinni");
 			}
+			else if (symbol == 1 &&
+					fins_channel_get(&call.Response,src_addr,sizeof(struct sockaddr_in)) != sizeof(struct sockaddr_in))
+			{
+				PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
+			}
+			else if (fins_channel_get(&call.Response,&confirmation,sizeof (int)) != sizeof (int))
+			{
+				PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
+			}
+			else if (confirmation > len)
+			{
+				PRINT_DEBUG("passed buffer length sent from the application is not enough to hold the data");
+			}
+			else
+				bytesread = fins_channel_get(&call.Response,buf,confirmation);
+			fins_call_finish(&call);
 
-			sem_post(main_channel_semaphore1);
-		sem_post(main_channel_semaphore2);
-
+				PRINT_DEBUG();
 
-		/**TODO remember to unlock the main channel */
+				return (bytesread);
 
-		PRINT_DEBUG();
+} // end of fins_recvfrom
 
-	sem_wait(FinsHistory[index].as);
-		PRINT_DEBUG();
-	sem_wait(FinsHistory[index].s);
-		PRINT_DEBUG();
-		numOfBytes = read(sockfd,&confirmation,sizeof (int));
 
-				if (confirmation != processid)
-				{
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
+                        struct sockaddr *src_addr, socklen_t *addrlen)
+{
 
-				sem_post(FinsHistory[index].s);
+int bytesread;
 
-					return (-1);
-				}
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_recvfrom(sockfd,buf, len, flags,src_addr,addrlen));
 
-		numOfBytes = read(sockfd,&confirmation,sizeof (int));
-				if (confirmation != sockfd_alter)
-				{
-				sem_post(FinsHistory[index].s);
-
-					return (-1);
-				}
-		numOfBytes = read(sockfd,&confirmation,sizeof (int));
-				if (confirmation != ACK)
-				{
-					sem_post(FinsHistory[index].s);
-
-					return (-1);
-
-				}
-		if (symbol == 1)
-		{
-		numOfBytes = read(sockfd,src_addr,sizeof(struct sockaddr_in));
-					if (numOfBytes != sizeof(struct sockaddr_in))
-							{
-								sem_post(FinsHistory[index].s);
-									return (-1);
-
-							}
-		}
-	//	sem_post(FinsHistory[index].s);
-				/** The socket jinni sent us, the number of bytes to be received
-				 * we have to check that our buffer size is enough to read
-				 * */
-		numOfBytes = read(sockfd,&confirmation,sizeof (int));
-				if (numOfBytes <= 0)
-				{
-				sem_post(FinsHistory[index].s);
-
-					return (-1);
-
-				}
-				if (confirmation <=len)
-				{
-					bytesread = read(sockfd,buf,confirmation);
-					sem_post(FinsHistory[index].s);
-						if (bytesread < 0)
-							{
-
-									return (-1);
-
-							}
-				}
-
-				else
-				{
-PRINT_DEBUG("passed buffer length sent from the application is not enough to hold the data");
-
-sem_post(FinsHistory[index].s);
-return(-1);
-
-				}
-
-		/**TODO remember to unlock the RX_CHANNEL */
-
-				PRINT_DEBUG();
-
-				return (bytesread);
-
-
-
-
-} // end of fins_recvfrom
-
-
-ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
-                        struct sockaddr *src_addr, socklen_t *addrlen)
-{
-
-
-_recvfrom = ( ssize_t (*) (int sockfd, void *buf, size_t len, int flags,
-                        struct sockaddr *src_addr, socklen_t *addrlen) ) dlsym(RTLD_NEXT, "recvfrom");
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
-	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-	}
-
-
-int bytesread;
-
-PRINT_DEBUG ("sockfd got into recvfrom = %d",sockfd);
+	PRINT_DEBUG ("sockfd got into recvfrom = %d",sockfd);
 
 	if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
@@ -888,62 +807,14 @@ PRINT_DEBUG ("sockfd got into recvfrom = %d",sockfd);
 ssize_t fins_recvmsg(int sockfd, struct msghdr *msg, int flags)
 {
 
-			int bytesent;
-
-			int numOfBytes=-1;
-			u_int opcode;
-			opcode = recvmsg_call;
-
-			pid_t processid;
-			int confirmation;
-			processid =getpid();
-
-			/** TODO lock access to the MAIN SOCKET CHANNEL
-			* to force synchronization with the socket jinni ,
-			* we need also to lock access to the
-			* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-			* RX_channel but the current thread
-			* */
-			write(socket_channel_desc,&processid, sizeof (pid_t) );
-			write(socket_channel_desc,&opcode, sizeof (u_int) );
-			write(socket_channel_desc,&sockfd, sizeof (int) );
-			write(socket_channel_desc,&flags, sizeof(int) );
-
-			/**TODO remember to unlock the main channel */
-
-			do
-				{
-
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-
-				} while (numOfBytes <=0);
-
-				if (confirmation != processid)
-					return (-1);
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-				if (confirmation != sockfd)
-					return (-1);
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-					if (confirmation != ACK)
-						return (-1);
-		/**TODO reading msg as one piece can not work
-		 * this need element by element and element by subelement
-		 * writing for every sub field in the msghdr struct
-		 *
-		 */
-
-		bytesent = read_msghdr_from_pipe(sockfd,msg);
-		/** return the length of the data as calculated from the
-		* msghdr data entities
-		 */
-				return (bytesent);
-
-/**TODO remember to unlock the RX_CHANNEL */
-
-
-
-
+		struct mmsghdr mmsg;
 
+		/** a recvmmsg of one datagram */
+		mmsg.msg_hdr = *msg;
+		if (fins_recvmmsg(sockfd,&mmsg,1,flags,NULL) != 1)
+			return (-1);
+		*msg = mmsg.msg_hdr;
+		return (mmsg.msg_len);
 
 } // end of fins_recvmsg
 
@@ -951,17 +822,11 @@ ssize_t fins_recvmsg(int sockfd, struct msghdr *msg, int flags)
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
 {
 
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_recvmsg(sockfd, msg,flags));
 
-_recvmsg = ( ssize_t (*) (int sockfd, struct msghdr *msg, int flags) ) dlsym(RTLD_NEXT, "recvmsg");
-
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
-	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-	}
-
-PRINT_DEBUG ("sockfd got into recvmsg = %d",sockfd);
+	PRINT_DEBUG ("sockfd got into recvmsg = %d",sockfd);
 
 if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
@@ -985,6 +850,86 @@ if (checkFinsHistory(getpid(),sockfd) != 0)
 /*----------------------------------------------------------------------------*/
 
 
+/**@brief receives the next datagram of a FINS UDP socket without any copy:
+ * the payload is read in place, in the shared buffer the jinni received the
+ * packet into. The buffer stays the caller's until fins_recv_release(*ptr),
+ * recvfrom keeps working on the same socket meanwhile
+ * @return 0 on success, -1 otherwise
+ */
+int fins_recv_zc(int sockfd, void **ptr, size_t *len)
+{
+		int index;
+		int sockfd_alter;
+		int flags = 0;
+		int buffer;
+		unsigned int offset;
+		int length;
+		int ret = -1;
+		struct finsCall call;
+		struct finsChannelWriter request;
+
+		if (!fins_fd_owned(sockfd) || checkFinsHistory(getpid(),sockfd) == 0)
+		{
+			errno = ENOTSOCK;
+			return (-1);
+		}
+		index = searchFinsHistory(getpid(),sockfd);
+		sockfd_alter = FinsHistory[index].fakeID;
+		if (fins_fd_nonblocking(sockfd))
+			flags |= MSG_DONTWAIT;
+
+		if (fins_call_request(&call,&request,recv_zc_call,2 * sizeof (int)) == -1)
+		{
+			errno = EIO;
+			return (-1);
+		}
+			fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+			fins_channel_put(&request,&flags, sizeof(int) );
+		fins_call_commit(&request);
+
+			/** the buffer, the offset of the payload in it and its length */
+			if (!fins_call_response(&call))
+			{
+				PRINT_DEBUG("zero copy receive refused by the socket jinni");
+			}
+			else if (fins_channel_get(&call.Response,&buffer,sizeof (int)) != sizeof (int)
+					|| fins_channel_get(&call.Response,&offset,sizeof (int)) != sizeof (int)
+					|| fins_channel_get(&call.Response,&length,sizeof (int)) != sizeof (int)
+					|| buffer < 0 || buffer >= FINS_CHANNEL_BUFFERS
+					|| offset + length > FINS_CHANNEL_BUFFER_SIZE)
+			{
+				PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
+			}
+			else
+			{
+				*ptr = fins_channel.Control->Buffers[buffer].Data + offset;
+				*len = length;
+				ret = 0;
+			}
+			fins_call_finish(&call);
+
+			return (ret);
+
+} // end of fins_recv_zc
+
+/**@brief gives back the buffer of a payload returned by fins_recv_zc
+ */
+void fins_recv_release(void *ptr)
+{
+	int buffer;
+
+	buffer = fins_channel_buffer_find(fins_channel.Control,ptr);
+	if (buffer == -1)
+	{
+		PRINT_DEBUG("%p was not returned by fins_recv_zc",ptr);
+		return;
+	}
+	fins_channel_buffer_return(fins_channel.Control,buffer,
+			fins_channel.Client - fins_channel.Control->Clients);
+
+}
+
+
 
 ssize_t fins_send(int sockfd, const void *buf, size_t len, int flags)
 {
@@ -1001,19 +946,12 @@ ssize_t fins_send(int sockfd, const void *buf, size_t len, int flags)
 ssize_t send(int sockfd, const void *buf, size_t len, int flags)
 {
 
-_send = ( ssize_t (*) (int sockfd, const void *buf, size_t len, int flags)) dlsym(RTLD_NEXT, "send");
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
-	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-	}
-
-
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_send(sockfd,buf,len,flags));
 
 	PRINT_DEBUG ("sockfd got into sendto = %d",sockfd);
 
-
 	if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
 		return ( fins_send(sockfd,buf,len,flags) );
@@ -1039,83 +977,69 @@ ssize_t fins_sendto(int sockfd, const void *buf, size_t len, int flags,
 {
 
 			PRINT_DEBUG("");
-			int bytesread;
-			int numOfBytes=-1;
 			u_int opcode;
 			opcode = sendto_call;
 			pid_t processid;
 			int confirmation;
 			int sockfd_alter;
 			int index;
+			struct finsCall call;
+			struct finsChannelWriter request;
 
 			processid =getpid();
 
 			index = searchFinsHistory(processid,sockfd);
 			sockfd_alter = FinsHistory[index].fakeID;
+			/** the credits bound the requests in flight, the jinni then waits
+			 * for room as a blocking sendto does */
+			if (fins_send_async)
+			{
+				confirmation = fins_socket_error(sockfd,NULL);
+				if (confirmation != 0)
+				{
+					errno = confirmation;
+					return (-1);
+				}
+				if (fins_call_async(&request,sendto_async_call,2 * sizeof (int)
+						+ sizeof (size_t) + len + sizeof (socklen_t) + addrlen,
+						!fins_fd_nonblocking(sockfd) && (flags == -1000 || !(flags & MSG_DONTWAIT))) == -1)
+					return (-1);
+				fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+				fins_channel_put(&request,&len, sizeof(size_t));
+				fins_channel_put(&request,buf, len);
+				fins_channel_put(&request,&flags, sizeof(int));
+				fins_channel_put(&request,&addrlen, sizeof(socklen_t));
+				fins_channel_put(&request,dest_addr, addrlen);
+				fins_call_commit(&request);
+				return (len);
+			}
 
-			PRINT_DEBUG("");
-
-
-/** TODO lock access to the MAIN SOCKET CHANNEL
-* to force synchronization with the socket jinni ,
-* we need also to lock access to the
-* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-* RX_channel but the current thread
-* */
-			sem_wait(main_channel_semaphore2);
-				PRINT_DEBUG("");
-						write(socket_channel_desc,&processid, sizeof (pid_t) );
-						write(socket_channel_desc,&opcode, sizeof (u_int) );
-						write(socket_channel_desc,&sockfd_alter, sizeof (int) );
-						write(socket_channel_desc,&len, sizeof(size_t));
-						write(socket_channel_desc,buf, len);
-						write(socket_channel_desc,&flags, sizeof(int));
-						write(socket_channel_desc,&addrlen, sizeof(socklen_t));
-						write(socket_channel_desc,dest_addr, addrlen);
-				sem_post(main_channel_semaphore1);
-				PRINT_DEBUG("");
-			sem_post(main_channel_semaphore2);
-
-			PRINT_DEBUG("");
-
+			/** -1000 marks a write, see fins_write */
+			if (fins_fd_nonblocking(sockfd) && flags != -1000)
+				flags |= MSG_DONTWAIT;
 
-			/**TODO remember to unlock the main channel */
-			/** The code below needs to force kind of synchronization
-			 * it might be hard to achieve , test this code throughly later
-			 */
-		sem_wait(FinsHistory[index].as);
-			sem_wait(FinsHistory[index].s);
 			PRINT_DEBUG("");
 
-			numOfBytes = read(sockfd,&confirmation,sizeof (int));
-			PRINT_DEBUG("");
-				if (confirmation != processid)
+				/** the payload is copied straight into the ring */
+				if (fins_call_request(&call,&request,opcode,2 * sizeof (int)
+						+ sizeof (size_t) + len + sizeof (socklen_t) + addrlen) == -1)
 				{
-						//sem_post(main_channel_semaphore1);
-					sem_post(FinsHistory[index].s);
-					PRINT_DEBUG("read processid = %d", confirmation);
-
+					errno = EMSGSIZE;
 					return (-1);
 				}
+						fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+						fins_channel_put(&request,&len, sizeof(size_t));
+						fins_channel_put(&request,buf, len);
+						fins_channel_put(&request,&flags, sizeof(int));
+						fins_channel_put(&request,&addrlen, sizeof(socklen_t));
+						fins_channel_put(&request,dest_addr, addrlen);
+				fins_call_commit(&request);
 				PRINT_DEBUG("");
 
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-					if (confirmation != sockfd_alter)
-					{
-							//sem_post(main_channel_semaphore1);
-						sem_post(FinsHistory[index].s);
-						PRINT_DEBUG("read sockfd = %d", confirmation);
-
-						return (-1);
-					}
-					PRINT_DEBUG("");
+				confirmation = fins_call_response(&call);
+				fins_call_finish(&call);
 
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
-					//sem_post(main_channel_semaphore1);
-				sem_post(FinsHistory[index].s);
-				PRINT_DEBUG("");
-
-				if (confirmation != ACK)
+				if (!confirmation)
 							return (-1);
 
 			/** On Success returns the number of characters sent
@@ -1132,18 +1056,12 @@ ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
                       const struct sockaddr *dest_addr, socklen_t addrlen)
 {
 
-_sendto = ( ssize_t (*) (int sockfd, const void *buf, size_t len, int flags,
-           const struct sockaddr *dest_addr, socklen_t addrlen)) dlsym(RTLD_NEXT, "sendto");
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
-	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-	}
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_sendto(sockfd,buf,len,flags,dest_addr,addrlen));
 
 	PRINT_DEBUG ("sockfd got into sendto = %d",sockfd);
 
-
 	if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
 		return ( fins_sendto(sockfd,buf,len,flags,dest_addr,addrlen) );
@@ -1168,150 +1086,301 @@ errormsg = dlerror();
 ssize_t fins_sendmsg(int sockfd, const struct msghdr *msg, int flags)
 {
 
-	int bytessent;
+		struct mmsghdr mmsg;
 
-		int numOfBytes=-1;
-		u_int opcode;
-		opcode = sendmsg_call;
+		/** a sendmmsg of one datagram */
+		mmsg.msg_hdr = *msg;
+		if (fins_sendmmsg(sockfd,&mmsg,1,flags) != 1)
+			return (-1);
+		return (mmsg.msg_len);
 
-		pid_t processid;
-		int confirmation;
-		processid =getpid();
+} // end of fins_sendmsg
 
-/** TODO lock access to the MAIN SOCKET CHANNEL
-* to force synchronization with the socket jinni ,
-* we need also to lock access to the
-* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-* RX_channel but the current thread
-* */
-		write(socket_channel_desc,&processid, sizeof (pid_t) );
-		write(socket_channel_desc,&opcode, sizeof (u_int) );
-		write(socket_channel_desc,&sockfd, sizeof (int) );
-		write(socket_channel_desc,&flags, sizeof(int));
-		/**
-		 * TODO Write msg as one piece can not work
-		 * this need element by element and element by subelement
-		 * writing for every sub field in the msghdr struct
-		 *
-		 */
-		bytessent = write_msghdr_to_pipe(socket_channel_desc,msg);
 
-		/**TODO remember to unlock the main channel */
-		/** The code below needs to force kind of synchronization
-		 * it might be hard to achieve , test this code throughly later
-		 */
-			do
-			{
+ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
 
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_sendmsg(sockfd,msg,flags));
 
-			} while (numOfBytes <=0);
+	PRINT_DEBUG ("sockfd got into sendmsg = %d",sockfd);
 
-			if (confirmation != processid)
-				return (-1);
-			numOfBytes = read(sockfd,&confirmation,sizeof (int));
-			if (confirmation != sockfd)
-					return (-1);
-			numOfBytes = read(sockfd,&confirmation,sizeof (int));
-			if (confirmation != ACK)
-						return (-1);
-			/** return the length of the data as calculated from the
-			 * msghdr data entities
-			 */
-			return (bytessent);
+	if (checkFinsHistory(getpid(),sockfd) != 0)
+	{
+		return ( fins_sendmsg(sockfd,msg,flags) );
 
-/**TODO remember to unlock the RX_CHANNEL */
+	}
+	else
 
+	{
 
-} // end of fins_sendmsg
+		PRINT_DEBUG("The original sendmsg should not be called ,something is WRONG!!!");
+		return ( _sendmsg(sockfd,msg,flags)  );
+	}
 
 
-ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
+} // end of sendmsg
+
+
+/*----------------------------------------------------------------------------*/
+/****************** END OF the sendmsg function------------------------------*/
+/*----------------------------------------------------------------------------*/
+
+
+/**@brief sends up to vlen datagrams in one request to the jinni, which
+ * queues them towards the switch in one burst. A batch is cut short at
+ * FINS_CHANNEL_MAX_BATCH datagrams or FINS_CHANNEL_BATCH_BYTES bytes, the
+ * caller sends the rest again as with the kernel sendmmsg
+ * @return the number of datagrams sent, their msg_len is set; -1 on failure
+ */
+int fins_sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
 {
+		u_int opcode;
+		opcode = sendmmsg_call;
+		int index;
+		int sockfd_alter;
+		unsigned int len;
+		unsigned int msglen;
+		int n;
+		int sent = -1;
+		struct finsCall call;
+		struct finsChannelWriter request;
+
+		index = searchFinsHistory(getpid(),sockfd);
+		sockfd_alter = FinsHistory[index].fakeID;
+		if (fins_fd_nonblocking(sockfd))
+			flags |= MSG_DONTWAIT;
 
-_sendmsg = (ssize_t (*) (int sockfd, const struct msghdr *msg, int flags) ) dlsym(RTLD_NEXT, "sendmsg");
+		len = 3 * sizeof (int);
+		for (n = 0; n < vlen && n < FINS_CHANNEL_MAX_BATCH; n++)
+		{
+			msglen = sizeof (socklen_t) + sizeof (size_t) + msghdr_datalen(&msgvec[n].msg_hdr);
+			if (msgvec[n].msg_hdr.msg_name != NULL)
+				msglen += msgvec[n].msg_hdr.msg_namelen;
+			if (n > 0 && len + msglen > FINS_CHANNEL_BATCH_BYTES)
+				break;
+			len += msglen;
+		}
 
-char *errormsg;
-errormsg = dlerror();
-	if (errormsg != NULL)
+		if (n == 0 || fins_call_request(&call,&request,opcode,len) == -1)
+		{
+			errno = EMSGSIZE;
+			return (-1);
+		}
+		fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+		fins_channel_put(&request,&flags, sizeof(int));
+		fins_channel_put(&request,&n, sizeof(int));
+		for (index = 0; index < n; index++)
+			write_msghdr_to_channel(&request,&msgvec[index].msg_hdr);
+		fins_call_commit(&request);
+
+			if (fins_call_response(&call)
+					&& fins_channel_get(&call.Response,&sent,sizeof (int)) != sizeof (int))
+			{
+				PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
+				sent = -1;
+			}
+			fins_call_finish(&call);
+
+		for (index = 0; index < sent; index++)
+			msgvec[index].msg_len = msghdr_datalen(&msgvec[index].msg_hdr);
+		return (sent);
+
+} // end of fins_sendmmsg
+
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_sendmmsg(sockfd,msgvec,vlen,flags));
+
+	PRINT_DEBUG ("sockfd got into sendmmsg = %d",sockfd);
+
+	if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
-		PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
+		return ( fins_sendmmsg(sockfd,msgvec,vlen,flags) );
+
+	}
+	else
+
+	{
+
+		PRINT_DEBUG("The original sendmmsg should not be called ,something is WRONG!!!");
+		return ( _sendmmsg(sockfd,msgvec,vlen,flags)  );
 	}
 
-PRINT_DEBUG ("sockfd got into sendmsg = %d",sockfd);
+} // end of sendmmsg
+
+/**@brief receives up to vlen datagrams in one response from the jinni. It
+ * blocks until one datagram at least is there and returns the ones already
+ * queued on the socket, timeout is not supported. A datagram longer than its
+ * buffers is truncated and flagged MSG_TRUNC
+ * @return the number of datagrams received; -1 on failure
+ */
+int fins_recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+		struct timespec *timeout)
+{
+		u_int opcode;
+		opcode = recvmmsg_call;
+		int index;
+		int sockfd_alter;
+		int datalens[FINS_CHANNEL_MAX_BATCH];
+		unsigned int len;
+		size_t datalen;
+		int n;
+		int received = -1;
+		struct finsCall call;
+		struct finsChannelWriter request;
+
+		index = searchFinsHistory(getpid(),sockfd);
+		sockfd_alter = FinsHistory[index].fakeID;
+		if (fins_fd_nonblocking(sockfd))
+			flags |= MSG_DONTWAIT;
+
+		/** the response has to fit in the ring along with the others */
+		len = sizeof (int);
+		for (n = 0; n < vlen && n < FINS_CHANNEL_MAX_BATCH; n++)
+		{
+			datalen = msghdr_datalen(&msgvec[n].msg_hdr);
+			if (datalen > FINS_CHANNEL_BATCH_BYTES)
+				datalen = FINS_CHANNEL_BATCH_BYTES;
+			if (n > 0 && len + sizeof (struct sockaddr_in) + 2 * sizeof (int) + datalen
+					> FINS_CHANNEL_BATCH_BYTES)
+				break;
+			len += sizeof (struct sockaddr_in) + 2 * sizeof (int) + datalen;
+			datalens[n] = datalen;
+		}
+		if (n == 0)
+		{
+			errno = EINVAL;
+			return (-1);
+		}
 
+		if (fins_call_request(&call,&request,opcode,(3 + n) * sizeof (int)) == -1)
+		{
+			errno = EIO;
+			return (-1);
+		}
+			fins_channel_put(&request,&sockfd_alter, sizeof (int) );
+			fins_channel_put(&request,&flags, sizeof(int) );
+			fins_channel_put(&request,&n, sizeof(int) );
+			fins_channel_put(&request,datalens, n * sizeof(int) );
+		fins_call_commit(&request);
+
+			if (!fins_call_response(&call))
+			{
+				PRINT_DEBUG("recvmmsg refused by the socket jinni");
+			}
+			else if (fins_channel_get(&call.Response,&received,sizeof (int)) != sizeof (int)
+					|| received > n)
+			{
+				PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
+				received = -1;
+			}
+			for (index = 0; index < received; index++)
+			{
+				msgvec[index].msg_len = read_msghdr_from_channel(&call.Response,&msgvec[index].msg_hdr);
+				if ((int) msgvec[index].msg_len == -1)
+				{
+					PRINT_DEBUG("READING ERROR!! Probably Sync Failed!!");
+					received = index;
+					break;
+				}
+			}
+			fins_call_finish(&call);
+
+		return (received);
+
+} // end of fins_recvmmsg
+
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+		struct timespec *timeout)
+{
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_recvmmsg(sockfd,msgvec,vlen,flags,timeout));
+
+	PRINT_DEBUG ("sockfd got into recvmmsg = %d",sockfd);
 
 	if (checkFinsHistory(getpid(),sockfd) != 0)
 	{
-		return ( fins_sendmsg(sockfd,msg,flags) );
+		return ( fins_recvmmsg(sockfd,msgvec,vlen,flags,timeout) );
 
 	}
 	else
 
 	{
 
-		PRINT_DEBUG("The original sendmsg should not be called ,something is WRONG!!!");
-		return ( _sendmsg(sockfd,msg,flags)  );
+		PRINT_DEBUG("The original recvmmsg should not be called ,something is WRONG!!!");
+		return ( _recvmmsg(sockfd,msgvec,vlen,flags,timeout)  );
 	}
 
-
-} // end of sendmsg
+} // end of recvmmsg
 
 
 /*----------------------------------------------------------------------------*/
-/****************** END OF the sendmsg function------------------------------*/
+/****************** END OF the sendmmsg and recvmmsg functions----------------*/
 /*----------------------------------------------------------------------------*/
 
-int fins_shutdown(int sockfd,int how)
+/**@brief drops the FINS socket sockfd: its descriptor stops being one in
+ * FinsHistory, the jinni is told to remove the socket and the pipe is closed.
+ * The descriptor bits are cleared first, so that a descriptor the kernel
+ * hands out again with the same number is not taken for a FINS socket
+ * @return 0 on success, -1 with errno set on errors
+ */
+static int fins_release(int sockfd,int how)
 {
 
-			int bytessent;
-
-			int numOfBytes=-1;
 			u_int opcode;
 			opcode = shutdown_call;
 			pid_t processid;
+			int index;
+			int fakeid;
 			int confirmation;
+			struct finsCall call;
+			struct finsChannelWriter request;
 			processid =getpid();
 
-			/** TODO lock access to the MAIN SOCKET CHANNEL
-			* to force synchronization with the socket jinni ,
-			* we need also to lock access to the
-			* CLIENT_CHANNEL_RX to make sure no one (NO OTHER THREAD from the same application) reads from the
-			* RX_channel but the current thread
-			* */
-	write(socket_channel_desc,&processid, sizeof (pid_t) );
-	write(socket_channel_desc,&opcode, sizeof (u_int) );
-	write(socket_channel_desc,&sockfd, sizeof (int) );
-	write(socket_channel_desc,&how, sizeof(int));
-
-	/**TODO remember to unlock the main channel */
-	do
-			{
+	sem_wait(&FinsHistory_semaphore);
+		index = searchFinsHistory(processid,sockfd);
+		fakeid = (index == -1) ? -1 : FinsHistory[index].fakeID;
+		removeFinsHistory(processid,sockfd);
+	sem_post(&FinsHistory_semaphore);
 
-				numOfBytes = read(sockfd,&confirmation,sizeof (int));
+	confirmation = 0;
+	if (fakeid == -1)
+		errno = EBADF;
+	else if (fins_call_request(&call,&request,opcode,2 * sizeof (int)) == -1)
+		errno = EIO;
+	else
+	{
+		fins_channel_put(&request,&fakeid, sizeof (int) );
+		fins_channel_put(&request,&how, sizeof(int));
+		fins_call_commit(&request);
 
-			} while (numOfBytes <=0);
+		confirmation = fins_call_response(&call);
+		fins_call_finish(&call);
+	}
 
-			if (confirmation != processid)
+			if (_close (sockfd) !=0 )
 				return (-1);
-			numOfBytes = read(sockfd,&confirmation,sizeof (int));
-			if (confirmation != sockfd)
-					return (-1);
-			numOfBytes = read(sockfd,&confirmation,sizeof (int));
-			if (confirmation != ACK)
-						return (-1);
 
-			if (close (sockfd) !=0 )
-				return (-1);
-			if ( !removeFinsHistory(processid,sockfd)  )
-				return(-1);
+ /** return 0 on success and -1 on errors */
+	return (confirmation ? 0 : -1);
 
+} // end of fins_release
 
- /** return 0 on success and -1 on errors */
-	return (0);
 
+/**@brief the jinni removes the socket on shutdown, whatever how is, so its
+ * descriptor is closed along as well
+ */
+int fins_shutdown(int sockfd,int how)
+{
 
+	return ( fins_release(sockfd,how) );
 
 } // end of fins_shutdown
 
@@ -1321,13 +1390,10 @@ int fins_shutdown(int sockfd,int how)
 
 int shutdown(int sockfd, int how)
 {
-	_shutdown = (int (*) (int fd, int how) ) dlsym(RTLD_NEXT, "shutdown");
-	char *errormsg;
-	errormsg = dlerror();
-		if (errormsg != NULL)
-		{
-			PRINT_DEBUG("\n failed to load the original symbol %s", errormsg);
-		}
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_shutdown(sockfd,how));
 
 	PRINT_DEBUG ("sockfd from process %d got into shutdown = %d",getpid(),sockfd);
 
@@ -1352,6 +1418,45 @@ int shutdown(int sockfd, int how)
 /*----------------------------------------------------------------------------*/
 
 
+int fins_close(int fd)
+{
+
+	return ( fins_release(fd,SHUT_RDWR) );
+
+} // end of fins_close
+
+
+int close(int fd)
+{
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(fd))
+		return (_close(fd));
+
+	PRINT_DEBUG ("sockfd from process %d got into close = %d",getpid(),fd);
+
+	if (checkFinsHistory(getpid(),fd) != 0)
+		{
+			return ( fins_close(fd) );
+
+		}
+		else
+
+		{
+
+			PRINT_DEBUG("The original close has been called, The passed Descriptor does not "
+					"belong to FINS");
+			return ( _close(fd)  );
+		}
+
+}
+
+
+/*----------------------------------------------------------------------------*/
+/****************** END OF the close function---------------------------------*/
+/*----------------------------------------------------------------------------*/
+
+
 
 ssize_t fins_write(int fd, const void *buf, size_t count)
 {
@@ -1367,21 +1472,24 @@ ssize_t fins_write(int fd, const void *buf, size_t count)
 ssize_t write(int sockfd, const void *buf, size_t count)
 {
 
-	_write = (ssize_t (*) (int sockfd, const void *buf, size_t count) ) dlsym(RTLD_NEXT, "write");
-		if (checkFinsHistory(getpid(),sockfd) != 0)
-		{
-			PRINT_DEBUG();
-			return ( fins_write(sockfd,buf,count) );
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd))
+		return (_write(sockfd,buf,count));
 
-		}
-		else
+	if (checkFinsHistory(getpid(),sockfd) != 0)
+	{
+		PRINT_DEBUG();
+		return ( fins_write(sockfd,buf,count) );
 
-		{
+	}
+	else
 
-			PRINT_DEBUG("The original (write) has been called, The passed Descriptor does not "
-					"belong to FINS");
-			return ( _write(sockfd,buf,count)  );
-		}
+	{
+
+		PRINT_DEBUG("The original (write) has been called, The passed Descriptor does not "
+				"belong to FINS");
+		return ( _write(sockfd,buf,count)  );
+	}
 
 
 }
@@ -1391,16 +1499,264 @@ ssize_t write(int sockfd, const void *buf, size_t count)
 /*----------------------------------------------------------------------------*/
 
 
+/**@brief fcntl is passed on as is, the flags then stay on the pipe of a FINS
+ * socket for F_GETFL. O_NONBLOCK set on a FINS socket is tracked as well,
+ * see fins_fd_nonblocking
+ */
+int fcntl(int fd, int cmd, ...)
+{
+	va_list ap;
+	void *arg;
+	int ret;
+
+	va_start(ap,cmd);
+	arg = va_arg(ap,void *);
+	va_end(ap);
+
+	ret = _fcntl(fd,cmd,arg);
+	if (ret != -1 && cmd == F_SETFL && fins_fd_owned(fd))
+		fins_fd_set_nonblocking(fd,((long) arg & O_NONBLOCK) != 0);
+	return (ret);
+
+} // end of fcntl
+
+/**@brief ioctl is passed on as is, FIONBIO on a FINS socket is tracked as
+ * O_NONBLOCK is by fcntl
+ */
+int ioctl(int fd, unsigned long int request, ...)
+{
+	va_list ap;
+	void *arg;
+	int ret;
+
+	va_start(ap,request);
+	arg = va_arg(ap,void *);
+	va_end(ap);
+
+	ret = _ioctl(fd,request,arg);
+	if (ret != -1 && request == FIONBIO && fins_fd_owned(fd))
+		fins_fd_set_nonblocking(fd,*(int *) arg != 0);
+	return (ret);
+
+} // end of ioctl
+
+/**@brief looks the FINS socket sockfd up in the table published by the jinni
+ * @return 0 with the socket in entry, -1 with errno set to ENOTSOCK if sockfd
+ * is not a FINS socket of this process
+ */
+static int fins_socket_entry(int sockfd, struct finsSocketEntry *entry)
+{
+	int index;
+
+	index = searchFinsHistory(getpid(),sockfd);
+	if (index < 0 || fins_sockets == NULL
+			|| fins_sockets_lookup(fins_sockets,getpid(),FinsHistory[index].fakeID,entry) != 0)
+	{
+		errno = ENOTSOCK;
+		return (-1);
+	}
+	return (0);
+
+}
+
+/**@brief takes the pending error of the FINS socket sockfd, the failure of
+ * an asynchronous request the application was not told about yet
+ * @param entry the socket as looked up already, NULL to look it up
+ * @return the errno value, 0 if there is none
+ */
+int fins_socket_error(int sockfd, struct finsSocketEntry *entry)
+{
+	struct finsSocketEntry e;
+	int index;
+
+	if (entry == NULL)
+	{
+		if (fins_socket_entry(sockfd,&e) == -1)
+			return (0);
+		entry = &e;
+	}
+	index = searchFinsHistory(getpid(),sockfd);
+	if (index < 0 || __atomic_exchange_n(&FinsHistory[index].errors,entry->Errors,__ATOMIC_RELAXED)
+			== entry->Errors)
+		return (0);
+	return (entry->Error);
+
+}
+
+/**@brief copies the IPv4 address ip:port into addr, truncated to *addrlen
+ * bytes as the kernel does, *addrlen is set to the full length
+ */
+static void fins_socket_address(struct sockaddr *addr, socklen_t *addrlen, uint32_t ip, uint16_t port)
+{
+	struct sockaddr_in address;
+
+	memset(&address,0,sizeof (struct sockaddr_in));
+	address.sin_family = AF_INET;
+	address.sin_port = port;
+	address.sin_addr.s_addr = ip;
+	memcpy(addr,&address,(*addrlen < sizeof (struct sockaddr_in)) ? *addrlen : sizeof (struct sockaddr_in));
+	*addrlen = sizeof (struct sockaddr_in);
+
+}
+
+/**@brief answered from the socket table of the jinni, without a call
+ */
+int getsockname(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct finsSocketEntry entry;
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd) || checkFinsHistory(getpid(),sockfd) == 0)
+		return (_getsockname(sockfd,addr,addrlen));
+
+	if (fins_socket_entry(sockfd,&entry) == -1)
+		return (-1);
+	fins_socket_address(addr,addrlen,entry.HostIP,entry.HostPort);
+	return (0);
+
+} // end of getsockname
+
+/**@brief answered from the socket table of the jinni, without a call
+ */
+int getpeername(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct finsSocketEntry entry;
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd) || checkFinsHistory(getpid(),sockfd) == 0)
+		return (_getpeername(sockfd,addr,addrlen));
+
+	if (fins_socket_entry(sockfd,&entry) == -1)
+		return (-1);
+	if (entry.DstIP == 0 && entry.DstPort == 0)
+	{
+		errno = ENOTCONN;
+		return (-1);
+	}
+	fins_socket_address(addr,addrlen,entry.DstIP,entry.DstPort);
+	return (0);
+
+} // end of getpeername
+
+/**@brief the options the socket table holds are answered from it without a
+ * call, the jinni keeps no other option yet (ENOPROTOOPT)
+ */
+int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen)
+{
+	struct finsSocketEntry entry;
+	int value;
+
+	/** every other descriptor goes straight to the GNU C library */
+	if (!fins_fd_owned(sockfd) || checkFinsHistory(getpid(),sockfd) == 0)
+		return (_getsockopt(sockfd,level,optname,optval,optlen));
+
+	if (fins_socket_entry(sockfd,&entry) == -1)
+		return (-1);
+	if (level != SOL_SOCKET)
+	{
+		errno = ENOPROTOOPT;
+		return (-1);
+	}
+	switch (optname)
+	{
+	case SO_TYPE:
+		value = entry.Type;
+		break;
+	case SO_DOMAIN:
+		value = AF_INET;
+		break;
+	case SO_PROTOCOL:
+		value = (entry.Protocol != 0) ? entry.Protocol : IPPROTO_UDP;
+		break;
+	case SO_ERROR:
+		value = fins_socket_error(sockfd,&entry);
+		break;
+	case SO_ACCEPTCONN:
+		value = 0;
+		break;
+	default:
+		errno = ENOPROTOOPT;
+		return (-1);
+	}
+	memcpy(optval,&value,(*optlen < sizeof (int)) ? *optlen : sizeof (int));
+	*optlen = sizeof (int);
+	return (0);
+
+} // end of getsockopt
+
+
 
 /** --------------------------------------------------------------------------*/
-ssize_t write_msghdr_to_pipe(int sockfd,struct msghdr *msg)
+/** @return the payload bytes msg describes */
+size_t msghdr_datalen(const struct msghdr *msg)
 {
+	size_t len = 0;
+	size_t i;
+
+	for (i = 0; i < msg->msg_iovlen; i++)
+		len += msg->msg_iov[i].iov_len;
+	return (len);
 
-int byteswritten;
+}
 
+/**@brief writes the datagram of msg as the jinni reads it: the address length,
+ * the address, the payload length and the payload gathered from msg_iov.
+ * The control data is not sent
+ * @return the payload bytes written
+ */
+ssize_t write_msghdr_to_channel(struct finsChannelWriter *w,const struct msghdr *msg)
+{
 
+size_t byteswritten = msghdr_datalen(msg);
+socklen_t namelen = (msg->msg_name != NULL) ? msg->msg_namelen : 0;
+size_t i;
 
+	fins_channel_put(w,&namelen,sizeof (socklen_t));
+	fins_channel_put(w,msg->msg_name,namelen);
+	fins_channel_put(w,&byteswritten,sizeof (size_t));
+	for (i = 0; i < msg->msg_iovlen; i++)
+		fins_channel_put(w,msg->msg_iov[i].iov_base,msg->msg_iov[i].iov_len);
 
 return(byteswritten);
 }
 
+/**@brief reads a datagram written by the jinni (see ack_write_batch) into msg:
+ * the source address, the length of the datagram, the bytes that follow,
+ * scattered over msg_iov, and the bytes
+ * @return the bytes read into msg_iov, -1 on a short record
+ */
+ssize_t read_msghdr_from_channel(struct finsChannelReader *r,struct msghdr *msg)
+{
+
+int bytesread = 0;
+struct sockaddr_in addr;
+int length;
+int copied;
+int n;
+size_t i;
+
+	if (fins_channel_get(r,&addr,sizeof (struct sockaddr_in)) != sizeof (struct sockaddr_in)
+			|| fins_channel_get(r,&length,sizeof (int)) != sizeof (int)
+			|| fins_channel_get(r,&copied,sizeof (int)) != sizeof (int))
+		return (-1);
+
+	if (msg->msg_name != NULL)
+	{
+		memcpy(msg->msg_name,&addr,(msg->msg_namelen < sizeof (struct sockaddr_in))
+				? msg->msg_namelen : sizeof (struct sockaddr_in));
+		msg->msg_namelen = sizeof (struct sockaddr_in);
+	}
+	for (i = 0; i < msg->msg_iovlen && bytesread < copied; i++)
+	{
+		n = copied - bytesread;
+		if (n > msg->msg_iov[i].iov_len)
+			n = msg->msg_iov[i].iov_len;
+		if (fins_channel_get(r,msg->msg_iov[i].iov_base,n) != n)
+			return (-1);
+		bytesread += n;
+	}
+	msg->msg_controllen = 0;
+	msg->msg_flags = (length > copied) ? MSG_TRUNC : 0;
+
+return(bytesread);
+}
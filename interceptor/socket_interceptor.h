@@ -30,6 +30,8 @@
 
 /*additional headers for testing */
 #include "finsdebug.h"
+/** the shared memory channel to the socket jinni */
+#include "finsChannel.h"
 //#include "arp.c"
 
 /* to handle forking + pipes operations */
@@ -55,11 +57,7 @@ struct socketIdentifier
 pid_t processID;
 int socketDesc;
 int fakeID;
-char semaphore_name[30];
-char asemaphore_name[30];
-
-sem_t *s;		/** Named semaphore to protect the client named pipe between interceptor and Jinni */
-sem_t *as;		/** Additional named semaphore to force order between reading and writing to the pipe */
+unsigned int errors; /** the failures of the socket seen so far, see fins_socket_error */
 
 };
 
@@ -72,21 +70,81 @@ sem_t *as;		/** Additional named semaphore to force order between reading and wr
 //struct socketUniqueID socketsUniqueIDs[MAX_sockets];
 struct socketIdentifier FinsHistory[MAX_sockets];
 
+/** one bit per descriptor, set while it is a FINS socket descriptor in
+ * FinsHistory. The wrappers test it first so that a call on any other
+ * descriptor (files, stdout, other sockets) goes straight to the GNU C
+ * library, without a lookup in FinsHistory nor a getpid() */
+#define FINS_MAX_FD 65536
+uint64_t fins_fd_map[FINS_MAX_FD / 64];
+
+static inline int fins_fd_owned(int fd)
+{
+	return ((unsigned int) fd < FINS_MAX_FD
+			&& ((__atomic_load_n(&fins_fd_map[fd >> 6], __ATOMIC_RELAXED) >> (fd & 63)) & 1));
+}
+
+/** one bit per FINS socket descriptor set O_NONBLOCK (fcntl, FIONBIO or
+ * SOCK_NONBLOCK), its calls are sent to the jinni with MSG_DONTWAIT */
+uint64_t fins_fd_nonblock[FINS_MAX_FD / 64];
+
+static inline int fins_fd_nonblocking(int fd)
+{
+	return ((unsigned int) fd < FINS_MAX_FD
+			&& ((__atomic_load_n(&fins_fd_nonblock[fd >> 6], __ATOMIC_RELAXED) >> (fd & 63)) & 1));
+}
+
+static inline void fins_fd_set_nonblocking(int fd, int on)
+{
+	if ((unsigned int) fd >= FINS_MAX_FD)
+		return;
+	if (on)
+		__atomic_or_fetch(&fins_fd_nonblock[fd >> 6], 1ULL << (fd & 63), __ATOMIC_RELAXED);
+	else
+		__atomic_and_fetch(&fins_fd_nonblock[fd >> 6], ~(1ULL << (fd & 63)), __ATOMIC_RELAXED);
+}
+
 #define MAIN_SOCKET_CHANNEL "/tmp/fins/mainsocket_channel"
 #define CLIENT_CHANNEL_TX "/tmp/fins/processID_%d_TX_%d"
 #define CLIENT_CHANNEL_RX "/tmp/fins/processID_%d_RX_%d"
 
-/** The Global socket channel descriptor is used to communicate between the socket
- * interceptor and the socket jinni until they exchange the socket UNIQUE ID, then a separate
- * named pipe gets opened for the newly created socket */
-int socket_channel_desc;
-sem_t *main_channel_semaphore1;
-sem_t *main_channel_semaphore2;
+/** Every call is sent to the socket jinni as one record on the request ring
+ * of this process and answered on its response ring (see finsChannel.h).
+ * The named pipe opened for every socket only provides the descriptor
+ * returned to the application */
+struct finsChannel fins_channel;
+/** the socket table published by the jinni, getsockname, getpeername and
+ * getsockopt are answered from it without a call, see fins_socket_entry */
+struct finsSocketTable *fins_sockets;
+/** set from the FINS_SEND_ASYNC environment variable: sendto, send and write
+ * do not wait for the jinni, a failure is reported by the next of them on
+ * the socket or by SO_ERROR, see fins_sendto */
+int fins_send_async;
+/** held while a request is written, the request ring takes one writer at a time */
+pthread_mutex_t fins_channel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** A call waiting for its response. The responses come back in any order,
+ * the thread that reads the response ring hands every record to the call
+ * with its Id, see fins_call_response */
+struct finsCall
+{
+	uint32_t Id;
+	int Ready;	/** set once Header and Response hold the response */
+	struct finsChannelHeader Header;
+	struct finsChannelReader Response;	/** the rest of the record, in the ring */
+	struct finsCall *Next;
+};
+
+/** protects the list of the calls waiting for their responses, and the
+ * reading of the response ring */
+pthread_mutex_t fins_calls_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t fins_calls_cond = PTHREAD_COND_INITIALIZER;
+struct finsCall *fins_calls;
+/** 1 while a thread reads the response ring or holds a record of it */
+int fins_calls_reading;
+uint32_t fins_calls_id;
 
 
 sem_t FinsHistory_semaphore;
-char main_sem_name1[]="main_channel1";
-char main_sem_name2[]="main_channel2";
 #define MAX_parallel_processes 10
 /** Todo document the work on the differences between the use of processes level semaphores
  * and threads level semaphores! and how each one of them is important and where they were employed
@@ -157,6 +215,12 @@ struct socket {
 #define accept_call 16
 #define accept4_call 17
 #define shutdown_call 18
+#define sendmmsg_call 20
+#define recvmmsg_call 21
+/** FINS extensions, no libc counterpart */
+#define recv_zc_call 19
+/** sendto without a response, see fins_channel_credit */
+#define sendto_async_call 22
 /** overwriting the generic functions which write to a socket descriptor
  * in order to make sure that we cover as many applications as possible
  * This range of these functions will start from 30
@@ -197,54 +261,10 @@ int insertFinsHistory(pid_t value1, int value2, int value3)
 				{FinsHistory[i].processID = value1;
 				FinsHistory[i].socketDesc = value2;
 				FinsHistory[i].fakeID = value3;
-	sprintf(FinsHistory[i].semaphore_name,"socket%d_%d", FinsHistory[i].processID,FinsHistory[i].fakeID);
-	sprintf(FinsHistory[i].asemaphore_name,"socket%d_%da", FinsHistory[i].processID,FinsHistory[i].fakeID);
-
-	PRINT_DEBUG("%s, %s",FinsHistory[i].semaphore_name,FinsHistory[i].asemaphore_name );
-	/** the semaphore is initially locked
-	 * If O_CREAT is specified in oflag, then
-       the semaphore is created if it does not already exist.
-       */
-
-
-	//FinsHistory[i].s = sem_open(FinsHistory[i].semaphore_name, O_CREAT|O_EXCL,0644,0);
-//	FinsHistory[i].as = sem_open(FinsHistory[i].asemaphore_name, O_CREAT|O_EXCL,0644,0);
-
-	//	FinsHistory[i].s  = sem_open(FinsHistory[i].semaphore_name, 0);
-	//	FinsHistory[i].as = sem_open(FinsHistory[i].asemaphore_name, 0);
-	PRINT_DEBUG("");
-	errno = 0;
-//	if ( errno  == EEXIST )
-	//{
-	//	PRINT_DEBUG("errno is %d",errno);
-
-
-	do {
-			FinsHistory[i].s  = sem_open(FinsHistory[i].semaphore_name,  0);
-			FinsHistory[i].as = sem_open(FinsHistory[i].asemaphore_name, 0);
-			//PRINT_DEBUG("");
-	}
-	while (errno == ENOENT);
-
-	//}
-
-	if (errno == ENOENT)
-	PRINT_DEBUG("errno is %d",errno);
-						if (FinsHistory[i].s == SEM_FAILED || FinsHistory[i].as == SEM_FAILED  )
-						{
-							if (FinsHistory[i].s == SEM_FAILED  )
-								{PRINT_DEBUG("");
-								sem_unlink(FinsHistory[i].semaphore_name );
-								}
-							if  (FinsHistory[i].as == SEM_FAILED  )
-								{
-								PRINT_DEBUG("");
-								sem_unlink(FinsHistory[i].asemaphore_name );
-								}
-						exit(1);
-
-						}
-					//	sem_post(FinsHistory[i].s);
+				FinsHistory[i].errors = 0;
+				fins_fd_set_nonblocking(value2,0);
+				if ((unsigned int) value2 < FINS_MAX_FD)
+					__atomic_or_fetch(&fins_fd_map[value2 >> 6], 1ULL << (value2 & 63), __ATOMIC_RELEASE);
 				return(1);
 
 				}
@@ -262,11 +282,9 @@ int removeFinsHistory(pid_t target1, int target2)
 			{FinsHistory[i].processID = -1;
 			FinsHistory[i].socketDesc = -1;
 			FinsHistory[i].fakeID 	  = -1;
-			sem_close(FinsHistory[i].s);
-			sem_unlink(FinsHistory[i].semaphore_name);
-			sem_close(FinsHistory[i].as);
-			sem_unlink(FinsHistory[i].asemaphore_name);
-			sprintf(FinsHistory[i].semaphore_name,"NULL");
+			if ((unsigned int) target2 < FINS_MAX_FD)
+				__atomic_and_fetch(&fins_fd_map[target2 >> 6], ~(1ULL << (target2 & 63)), __ATOMIC_RELEASE);
+			fins_fd_set_nonblocking(target2,0);
 
 
 			return(1);}
@@ -278,8 +296,17 @@ return(0);
 }
 
 
-ssize_t read_msghdr_from_pipe(int sockfd,struct msghdr *msg);
-ssize_t write_msghdr_to_pipe(int sockfd,struct msghdr *msg);
+ssize_t read_msghdr_from_channel(struct finsChannelReader *r,struct msghdr *msg);
+ssize_t write_msghdr_to_channel(struct finsChannelWriter *w,const struct msghdr *msg);
+size_t msghdr_datalen(const struct msghdr *msg);
+int fins_sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+int fins_recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+		struct timespec *timeout);
+int fins_socket_error(int sockfd, struct finsSocketEntry *entry);
+
+/** zero copy receive, an extension for the applications built against FINS */
+int fins_recv_zc(int sockfd, void **ptr, size_t *len);
+void fins_recv_release(void *ptr);
 
 
 /** The functions pointers related section *
@@ -310,6 +337,12 @@ ssize_t write_msghdr_to_pipe(int sockfd,struct msghdr *msg);
 
   		ssize_t (*_recvmsg) (int __fd, struct msghdr *__message, int __flags);
 
+  		int (*_sendmmsg) (int __fd, struct mmsghdr *__vmessages, unsigned int __vlen,
+  					int __flags);
+
+  		int (*_recvmmsg) (int __fd, struct mmsghdr *__vmessages, unsigned int __vlen,
+  					int __flags, struct timespec *__tmo);
+
 
   		int (*_getsockopt) (int __fd, int __level, int __optname,
   				       void *__restrict __optval,
@@ -337,6 +370,9 @@ ssize_t write_msghdr_to_pipe(int sockfd,struct msghdr *msg);
   		  				       int __flags, __CONST_SOCKADDR_ARG __addr,
   		  				       socklen_t __addr_len);
   		ssize_t (*_write)	(int __fd, const void *__buf, size_t __count);
+  		int (*_close) (int __fd);
+  		int (*_fcntl) (int __fd, int __cmd, ...);
+  		int (*_ioctl) (int __fd, unsigned long int __request, ...);
 
 
 /** --------------------------------------------------------------------*/
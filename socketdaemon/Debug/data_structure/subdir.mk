@@ -4,14 +4,17 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../data_structure/finsPool.c \
 ../data_structure/queue.c \
 ../data_structure/queueModule.c 
 
 OBJS += \
+./data_structure/finsPool.o \
 ./data_structure/queue.o \
 ./data_structure/queueModule.o 
 
 C_DEPS += \
+./data_structure/finsPool.d \
 ./data_structure/queue.d \
 ./data_structure/queueModule.d 
 
@@ -4,12 +4,21 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../fins_headers/finsBuff.c \
+../fins_headers/finsChannel.c \
+../fins_headers/finsCsum.c \
 ../fins_headers/metadata.c 
 
 OBJS += \
+./fins_headers/finsBuff.o \
+./fins_headers/finsChannel.o \
+./fins_headers/finsCsum.o \
 ./fins_headers/metadata.o 
 
 C_DEPS += \
+./fins_headers/finsBuff.d \
+./fins_headers/finsChannel.d \
+./fins_headers/finsCsum.d \
 ./fins_headers/metadata.d 
 
 
@@ -17,6 +17,8 @@ C_SRCS += \
 ../ipv4/IP4_reass.c \
 ../ipv4/IP4_receive_fdf.c \
 ../ipv4/IP4_route_info.c \
+../ipv4/IP4_route_monitor.c \
+../ipv4/IP4_route_trie.c \
 ../ipv4/IP4_send_fdf.c \
 ../ipv4/ipv4.c 
 
@@ -34,6 +36,8 @@ OBJS += \
 ./ipv4/IP4_reass.o \
 ./ipv4/IP4_receive_fdf.o \
 ./ipv4/IP4_route_info.o \
+./ipv4/IP4_route_monitor.o \
+./ipv4/IP4_route_trie.o \
 ./ipv4/IP4_send_fdf.o \
 ./ipv4/ipv4.o 
 
@@ -51,6 +55,8 @@ C_DEPS += \
 ./ipv4/IP4_reass.d \
 ./ipv4/IP4_receive_fdf.d \
 ./ipv4/IP4_route_info.d \
+./ipv4/IP4_route_monitor.d \
+./ipv4/IP4_route_trie.d \
 ./ipv4/IP4_send_fdf.d \
 ./ipv4/ipv4.d 
 
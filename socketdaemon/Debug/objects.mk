@@ -4,4 +4,4 @@
 
 USER_OBJS :=
 
-LIBS := -lpthread -lconfig
+LIBS := -lpthread -lconfig -lrt
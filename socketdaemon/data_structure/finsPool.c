@@ -0,0 +1,241 @@
+/**
+ * @file finsPool.c
+ *
+ *  @date Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <finsPool.h>
+#include <finsdebug.h>
+
+/** the cache each thread holds for each pool, created on first use */
+static __thread struct finsPoolCache *fins_pool_tls[FINS_POOL_MAX_POOLS];
+
+/** distance between two objects of a slab, keeps every object 16 bytes aligned */
+static size_t fins_pool_stride(struct finsPool *pool)
+{
+
+	return ((sizeof(struct finsPoolObject) + pool->objSize + 15) & ~(size_t) 15);
+
+}
+
+/**@brief carves n new objects into the depot, pool->lock must be held
+ * @return 1 on success, 0 when out of memory
+ * */
+static int fins_pool_grow(struct finsPool *pool, unsigned int n)
+{
+	size_t stride = fins_pool_stride(pool);
+	char *slab;
+	struct finsPoolObject *obj;
+	unsigned int i;
+
+	/** slabs are never given back to malloc */
+	slab = (char *) malloc(stride * n);
+	if (slab == NULL)
+		return (0);
+
+	for (i = 0; i < n; i++)
+	{
+		obj = (struct finsPoolObject *) (slab + i * stride);
+		obj->owner = NULL;
+		obj->next = pool->depot;
+		pool->depot = obj;
+	}
+	pool->depotCount += n;
+	pool->created += n;
+
+	return (1);
+
+}
+
+/**@brief pre-sizes the pool so that the first n allocations never call malloc
+ * @return 1 on success, 0 when out of memory
+ * */
+int fins_pool_reserve(struct finsPool *pool, unsigned int n)
+{
+	int status = 1;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->created < n)
+		status = fins_pool_grow(pool, n - pool->created);
+	pthread_mutex_unlock(&pool->lock);
+
+	return (status);
+
+}
+
+static struct finsPoolCache *fins_pool_cache(struct finsPool *pool)
+{
+	struct finsPoolCache *cache = fins_pool_tls[pool->index];
+
+	if (cache != NULL)
+		return (cache);
+
+	/** caches live as long as the process, remote threads may still hold
+	 * objects owned by them */
+	if (posix_memalign((void **) &cache, 64, sizeof(struct finsPoolCache)) != 0)
+	{
+		PRINT_DEBUG("cannot allocate a cache for pool %s", pool->name);
+		exit(1);
+	}
+	memset(cache, 0, sizeof(struct finsPoolCache));
+	cache->pool = pool;
+
+	pthread_mutex_lock(&pool->lock);
+	cache->nextCache = pool->caches;
+	pool->caches = cache;
+	pthread_mutex_unlock(&pool->lock);
+
+	fins_pool_tls[pool->index] = cache;
+	return (cache);
+
+}
+
+/** takes up to FINS_POOL_BATCH objects from the depot, growing it if needed */
+static void fins_pool_refill(struct finsPool *pool, struct finsPoolCache *cache)
+{
+	struct finsPoolObject *obj;
+	unsigned int out;
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+
+	if (pool->depotCount < FINS_POOL_BATCH)
+		fins_pool_grow(pool, FINS_POOL_BATCH);
+
+	for (i = 0; i < FINS_POOL_BATCH && pool->depot != NULL; i++)
+	{
+		obj = pool->depot;
+		pool->depot = obj->next;
+		pool->depotCount--;
+
+		obj->owner = cache;
+		obj->next = cache->local;
+		cache->local = obj;
+		cache->nlocal++;
+	}
+
+	out = pool->created - pool->depotCount;
+	if (out > pool->highWater)
+		pool->highWater = out;
+
+	pthread_mutex_unlock(&pool->lock);
+
+}
+
+/** gives FINS_POOL_BATCH objects of a bloated local list back to the depot */
+static void fins_pool_drain(struct finsPool *pool, struct finsPoolCache *cache)
+{
+	struct finsPoolObject *obj;
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+
+	for (i = 0; i < FINS_POOL_BATCH; i++)
+	{
+		obj = cache->local;
+		cache->local = obj->next;
+		cache->nlocal--;
+
+		obj->owner = NULL;
+		obj->next = pool->depot;
+		pool->depot = obj;
+		pool->depotCount++;
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+}
+
+/**@brief allocates one object of pool->objSize bytes, its content is undefined
+ * @return the object, NULL only when the system is out of memory
+ * */
+void *fins_pool_alloc(struct finsPool *pool)
+{
+	struct finsPoolCache *cache = fins_pool_cache(pool);
+	struct finsPoolObject *obj;
+
+	if (cache->local == NULL)
+	{
+		/** take back whatever other threads freed for us */
+		cache->local = __atomic_exchange_n(&cache->remote, NULL, __ATOMIC_ACQUIRE);
+		for (obj = cache->local; obj != NULL; obj = obj->next)
+			cache->nlocal++;
+
+		if (cache->local == NULL)
+			fins_pool_refill(pool, cache);
+		if (cache->local == NULL)
+			return (NULL);
+	}
+
+	obj = cache->local;
+	cache->local = obj->next;
+	cache->nlocal--;
+	__atomic_store_n(&cache->allocs, cache->allocs + 1, __ATOMIC_RELAXED);
+
+	return ((void *) (obj + 1));
+
+}
+
+/**@brief returns an object to its pool, may be called from any thread
+ * @param obj an object returned by fins_pool_alloc, NULL is ignored
+ * */
+void fins_pool_free(void *obj)
+{
+	struct finsPoolObject *hdr;
+	struct finsPoolCache *owner;
+	struct finsPoolCache *cache;
+	struct finsPoolObject *head;
+
+	if (obj == NULL)
+		return;
+
+	hdr = ((struct finsPoolObject *) obj) - 1;
+	owner = hdr->owner;
+	cache = fins_pool_cache(owner->pool);
+	__atomic_store_n(&cache->frees, cache->frees + 1, __ATOMIC_RELAXED);
+
+	if (owner == cache)
+	{
+		hdr->next = cache->local;
+		cache->local = hdr;
+		if (++cache->nlocal > 2 * FINS_POOL_BATCH)
+			fins_pool_drain(owner->pool, cache);
+		return;
+	}
+
+	/** lock-free push onto the owner's remote list. The owner only ever
+	 * detaches the whole list, so there is no ABA to worry about */
+	head = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+	do
+	{
+		hdr->next = head;
+	} while (!__atomic_compare_exchange_n(&owner->remote, &head, hdr, 1,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+}
+
+/**@brief prints the size, the high-water mark and the current use of the pool
+ * */
+void fins_pool_report(struct finsPool *pool)
+{
+	struct finsPoolCache *cache;
+	unsigned long allocs = 0;
+	unsigned long frees = 0;
+	int threads = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (cache = pool->caches; cache != NULL; cache = cache->nextCache)
+	{
+		allocs += __atomic_load_n(&cache->allocs, __ATOMIC_RELAXED);
+		frees += __atomic_load_n(&cache->frees, __ATOMIC_RELAXED);
+		threads++;
+	}
+	PRINT_DEBUG("pool %s: %u objects of %lu bytes, high-water %u, in use %ld, %d threads",
+			pool->name, pool->created, (unsigned long) pool->objSize,
+			pool->highWater, (long) (allocs - frees), threads);
+	pthread_mutex_unlock(&pool->lock);
+
+}
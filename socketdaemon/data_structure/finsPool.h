@@ -0,0 +1,77 @@
+/**
+ * @file finsPool.h
+ *
+ * Fixed size object pools with per-thread caches.
+ *
+ * Every thread that allocates from a pool gets its own cache of free objects,
+ * so the common alloc/free pair is a couple of pointer moves with no lock and
+ * no shared cache line. Frames routinely cross threads (allocated by Capture,
+ * freed by UDP, ...), an object freed by a thread other than the one that
+ * allocated it is pushed onto the owning cache's remote list with a single
+ * CAS; the owner takes the whole list back with one atomic exchange when its
+ * local list runs dry. Caches exchange objects with the global depot of the
+ * pool in batches, the depot is the only place a mutex is taken.
+ *
+ *  @date Oct 17, 2026
+ */
+
+#ifndef FINSPOOL_H_
+#define FINSPOOL_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+/** number of distinct pools a thread may hold a cache for */
+#define FINS_POOL_MAX_POOLS 8
+/** objects moved between a thread cache and the depot at once */
+#define FINS_POOL_BATCH 32
+
+struct finsPoolCache;
+
+/** hidden header in front of every pooled object */
+struct finsPoolObject
+{
+	struct finsPoolObject *next;
+	struct finsPoolCache *owner;
+} __attribute__ ((aligned (16)));
+
+/** one per (thread, pool) */
+struct finsPoolCache
+{
+	/** touched by the owning thread only */
+	struct finsPoolObject *local;
+	unsigned int nlocal;
+	unsigned long allocs;
+	unsigned long frees;
+	struct finsPool *pool;
+	struct finsPoolCache *nextCache;
+
+	/** objects owned by this cache and freed by other threads */
+	struct finsPoolObject *remote __attribute__ ((aligned (64)));
+};
+
+struct finsPool
+{
+	const char *name;
+	size_t objSize;
+	int index;	/** slot of this pool in the per-thread cache table */
+
+	pthread_mutex_t lock;	/** protects everything below */
+	struct finsPoolObject *depot;
+	unsigned int depotCount;
+	unsigned int created;	/** objects carved so far */
+	unsigned int highWater;	/** max objects ever out of the depot at once */
+	struct finsPoolCache *caches;
+};
+
+/** pools are meant to be static, index must be unique among the pools and
+ * below FINS_POOL_MAX_POOLS */
+#define FINS_POOL_INITIALIZER(poolName, size, poolIndex) \
+	{ (poolName), (size), (poolIndex), PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, NULL }
+
+int fins_pool_reserve(struct finsPool *pool, unsigned int n);
+void *fins_pool_alloc(struct finsPool *pool);
+void fins_pool_free(void *obj);
+void fins_pool_report(struct finsPool *pool);
+
+#endif /* FINSPOOL_H_ */
@@ -1,61 +1,86 @@
         #include <queue.h>
         #include <fatal.h>
         #include <stdlib.h>
+        #include <string.h>
+        #include <limits.h>
+        #include <unistd.h>
+        #include <sys/syscall.h>
+        #include <linux/futex.h>
 
         #define MinQueueSize ( 5 )
 
-     /**   struct QueueRecord
-        {
-            int Capacity;
-            int Front;
-            int Rear;
-            int Size;
-            ElementType *Array;
-        };*/
+/** The indices are shared between exactly two threads, so plain loads/stores
+ * with acquire/release ordering are all the synchronisation the ring needs
+ */
+#define LOAD_ACQUIRE( p )		__atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define STORE_RELEASE( p, v )	__atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+/** counters are written by one thread and may be read by any */
+#define STAT_INC( p )			__atomic_store_n( (p), *(p) + 1, __ATOMIC_RELAXED )
 
 /* START: fig3_58.txt */
         int
         IsEmpty( Queue Q )
         {
-            return Q->Size == 0;
+            return LOAD_ACQUIRE( &Q->Rear ) == LOAD_ACQUIRE( &Q->Front );
         }
 /* END */
 
         int
         IsFull( Queue Q )
         {
-            return Q->Size == Q->Capacity;
+            return QueueSize( Q ) >= Q->Capacity;
+        }
+
+        int
+        QueueSize( Queue Q )
+        {
+            return (int)( LOAD_ACQUIRE( &Q->Rear ) - LOAD_ACQUIRE( &Q->Front ) );
         }
 
         Queue
         CreateQueue( const char* name,int MaxElements )
         {
             Queue Q;
+            unsigned int Capacity;
 
 /* 1*/      if( MaxElements < MinQueueSize )
 /* 2*/          Error( "Queue size is too small" );
 
-/* 3*/      Q = malloc( sizeof( struct QueueRecord ) );
-/* 4*/      if( Q == NULL )
+            /** round up to a power of two so that the slot is a mask, not a modulo */
+            Capacity = 1;
+            while( Capacity < MinQueueSize || Capacity < (unsigned int) MaxElements )
+                Capacity <<= 1;
+
+/* 3*/      if( posix_memalign( (void **) &Q, QUEUE_CACHELINE_SIZE, sizeof( struct QueueRecord ) ) != 0 )
 /* 5*/          FatalError( "Out of space!!!" );
+            memset( Q, 0, sizeof( struct QueueRecord ) );
 
-/* 6*/      Q->Array = malloc( sizeof( ElementType ) * MaxElements );
+/* 6*/      Q->Array = malloc( sizeof( ElementType ) * Capacity );
 /* 7*/      if( Q->Array == NULL )
 /* 8*/          FatalError( "Out of space!!!" );
-/* 9*/      Q->Capacity = MaxElements;
-			strcpy(Q->name,name);
+/* 9*/      Q->Capacity = Capacity;
+            Q->Mask = Capacity - 1;
+            InitDoorbell( &Q->OwnBell );
+            Q->Bell = &Q->OwnBell;
+            InitDoorbell( &Q->SpaceBell );
+            Q->Policy = QUEUE_DROP_TAIL;
+            Q->HighWater = Capacity;
+            Q->LowWater = Capacity / 2;
+			strncpy(Q->name,name,sizeof(Q->name) - 1);
 /*10*/      MakeEmpty( Q );
 
 /*11*/      return Q;
         }
 
 /* START: fig3_59.txt */
+        /** must not race with a producer or a consumer */
         void
         MakeEmpty( Queue Q )
         {
-            Q->Size = 0;
-            Q->Front = 1;
-            Q->Rear = 0;
+            Q->CachedRear = 0;
+            Q->CachedFront = 0;
+            STORE_RELEASE( &Q->Front, 0 );
+            STORE_RELEASE( &Q->Rear, 0 );
         }
 /* END */
 
@@ -70,92 +95,368 @@
             return (1);
         }
 
-/* START: fig3_60.txt */
+        /** must be called before the queue is handed to its threads
+         * @param HighWater number of elements at which Policy kicks in, at most
+         * the capacity of the queue (a power of two, at least MaxElements)
+         * @param LowWater a producer blocked under QUEUE_BLOCK resumes once the
+         * queue is down to LowWater elements, below HighWater
+         * @param Drop disposes of the elements evicted under QUEUE_DROP_HEAD
+         * @return 1 on success, 0 if the watermarks do not fit the queue
+         */
+        int
+        SetQueuePolicy( Queue Q, int Policy, unsigned int HighWater,
+                unsigned int LowWater, void (*Drop)( ElementType X ) )
+        {
+            if( HighWater == 0 || HighWater > Q->Capacity || LowWater >= HighWater )
+            {
+                Error( "Bad queue watermarks" );
+                return(0);
+            }
+            Q->Policy = Policy;
+            Q->HighWater = HighWater;
+            Q->LowWater = LowWater;
+            Q->Drop = Drop;
+            return(1);
+        }
+
+        /** producer side of a QUEUE_BLOCK queue, sleeps until the consumer
+         * brought the queue down to LowWater. May return spuriously */
+        static void
+        WaitSpace( Queue Q, unsigned int Rear )
+        {
+            struct Doorbell *B = &Q->SpaceBell;
+            int Key;
+
+            __atomic_add_fetch( &B->Sleepers, 1, __ATOMIC_SEQ_CST );
+            Key = __atomic_load_n( &B->Seq, __ATOMIC_SEQ_CST );
+
+            if( Rear - LOAD_ACQUIRE( &Q->Front ) > Q->LowWater )
+                syscall( SYS_futex, &B->Seq, FUTEX_WAIT_PRIVATE, Key, NULL, NULL, 0 );
+
+            __atomic_sub_fetch( &B->Sleepers, 1, __ATOMIC_RELAXED );
+        }
+
+        /** any thread, sleeps on the space doorbell of a QUEUE_BLOCK queue
+         * until the consumer brought it down to LowWater, so that a producer
+         * sharing the queue through a lock waits without holding it. May
+         * return spuriously, the caller re-checks under its lock */
+        void
+        WaitRoom( Queue Q )
+        {
+            struct Doorbell *B = &Q->SpaceBell;
+            int Key;
+
+            __atomic_add_fetch( &B->Sleepers, 1, __ATOMIC_SEQ_CST );
+            Key = __atomic_load_n( &B->Seq, __ATOMIC_SEQ_CST );
+
+            if( LOAD_ACQUIRE( &Q->Rear ) - LOAD_ACQUIRE( &Q->Front ) > Q->LowWater )
+                syscall( SYS_futex, &B->Seq, FUTEX_WAIT_PRIVATE, Key, NULL, NULL, 0 );
+
+            __atomic_sub_fetch( &B->Sleepers, 1, __ATOMIC_RELAXED );
+        }
+
+        /** consumer side of a QUEUE_BLOCK queue, after Front was moved.
+         * CachedRear may lag behind Rear, the producer re-checks anyway */
+        static void
+        ReleaseSpace( Queue Q, unsigned int Front )
+        {
+            if( (int)( Q->CachedRear - Front ) <= (int) Q->LowWater )
+                RingDoorbell( &Q->SpaceBell );
+        }
+
+        /** producer side, the queue holds HighWater elements or more.
+         * @return 1 once the policy made room for one more element, 0 if the
+         * element has to be refused
+         */
+        static int
+        MakeRoom( Queue Q, unsigned int Rear )
+        {
+            unsigned int Front;
+            ElementType Old;
+
+            switch( Q->Policy )
+            {
+            case QUEUE_BLOCK:
+                STAT_INC( &Q->Blocked );
+                while( Rear - ( Q->CachedFront = LOAD_ACQUIRE( &Q->Front ) ) > Q->LowWater )
+                    WaitSpace( Q, Rear );
+                return(1);
+
+            case QUEUE_DROP_HEAD:
+                Front = LOAD_ACQUIRE( &Q->Front );
+                while( Rear - Front >= Q->HighWater )
+                {
+                    /** the consumer may take the same element, whoever moves
+                     * Front first owns it */
+                    Old = Q->Array[ Front & Q->Mask ];
+                    if( __atomic_compare_exchange_n( &Q->Front, &Front, Front + 1, 0,
+                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) )
+                    {
+                        STAT_INC( &Q->Evicted );
+                        if( Q->Drop != NULL )
+                            Q->Drop( Old );
+                        Front++;
+                    }
+                }
+                Q->CachedFront = Front;
+                return(1);
+
+            default:
+                return(0);
+            }
+        }
 
+        /** consumer side, publishes Front + n
+         * @return 0 if the producer evicted elements meanwhile (QUEUE_DROP_HEAD
+         * only), the consumer then retries
+         */
         static int
-        Succ( int Value, Queue Q )
+        AdvanceFront( Queue Q, unsigned int Front, unsigned int n )
         {
-        	Value++;
-        	return (Value % Q->Capacity);
+            if( Q->Policy == QUEUE_DROP_HEAD )
+                return __atomic_compare_exchange_n( &Q->Front, &Front, Front + n, 0,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
 
-        	/* if( ++Value == Q->Capacity )
-                Value = 0;
-            return Value;*/
+            STORE_RELEASE( &Q->Front, Front + n );
+            if( Q->Policy == QUEUE_BLOCK )
+                ReleaseSpace( Q, Front + n );
+            return(1);
         }
 
+/* START: fig3_60.txt */
+
+    /** producer side only
+     * @return 1 on success, 0 if the element was refused (see enum QueuePolicy)
+     */
     int Enqueue( ElementType X, Queue Q )
         {
-            if( IsFull( Q ) )
+            unsigned int Rear = Q->Rear;
+            unsigned int Limit = Q->HighWater;
+
+            if( Q->Policy == QUEUE_DROP_PRIORITY && X->dataOrCtrl == CONTROL )
+                Limit = Q->Capacity;
+
+            if( Rear - Q->CachedFront >= Limit )
             {
-                Error( "Full queue" );
+                Q->CachedFront = LOAD_ACQUIRE( &Q->Front );
+                if( Rear - Q->CachedFront >= Limit && !MakeRoom( Q, Rear ) )
+                {
+                    STAT_INC( &Q->Dropped );
+                    return(0);
+                }
+            }
+
+            Q->Array[ Rear & Q->Mask ] = X;
+            STORE_RELEASE( &Q->Rear, Rear + 1 );
+            RingDoorbell( Q->Bell );
+            return(1);
+        }
+/* END */
+
+        /** producer side only, enqueues up to n elements with a single
+         * publication of Rear and a single doorbell ring. What does not fit
+         * under HighWater goes through Enqueue one by one for the policies that
+         * never refuse (QUEUE_BLOCK, QUEUE_DROP_HEAD)
+         * @return the number of elements actually enqueued (X[0..ret) )
+         */
+        int
+        EnqueueBurst( ElementType *X, int n, Queue Q )
+        {
+            unsigned int Rear = Q->Rear;
+            int Free;
+            int Count;
+
+            if( n <= 0 )
                 return(0);
+
+            Free = (int) Q->HighWater - (int)( Rear - Q->CachedFront );
+            if( Free < n )
+            {
+                Q->CachedFront = LOAD_ACQUIRE( &Q->Front );
+                Free = (int) Q->HighWater - (int)( Rear - Q->CachedFront );
             }
-           else
+            Count = Free < n ? Free : n;
+            if( Count > 0 )
             {
-                Q->Size++;
-                Q->Rear = Succ( Q->Rear, Q );
-                Q->Array[ Q->Rear ] = X;
-                return(1);
+                int i;
+
+                for( i = 0; i < Count; i++ )
+                    Q->Array[ ( Rear + i ) & Q->Mask ] = X[ i ];
+                STORE_RELEASE( &Q->Rear, Rear + Count );
+                RingDoorbell( Q->Bell );
             }
+            else
+                Count = 0;
+
+            if( Q->Policy == QUEUE_BLOCK || Q->Policy == QUEUE_DROP_HEAD )
+                while( Count < n && Enqueue( X[ Count ], Q ) )
+                    Count++;
+
+            return(Count);
         }
-/* END */
 
+        /** consumer side only, dequeues up to Max elements into X with a
+         * single publication of Front
+         * @return the number of elements dequeued, 0 when the queue is empty
+         */
+        int
+        DequeueBurst( ElementType *X, int Max, Queue Q )
+        {
+            unsigned int Front;
+            int Avail;
+            int n;
+            int i;
+
+            if( Max <= 0 )
+                return(0);
 
+            do
+            {
+                Front = LOAD_ACQUIRE( &Q->Front );
+                Avail = (int)( Q->CachedRear - Front );
+                if( Avail < Max )
+                {
+                    Q->CachedRear = LOAD_ACQUIRE( &Q->Rear );
+                    Avail = (int)( Q->CachedRear - Front );
+                }
+                n = Avail < Max ? Avail : Max;
+                if( n <= 0 )
+                    return(0);
+
+                for( i = 0; i < n; i++ )
+                    X[ i ] = Q->Array[ ( Front + i ) & Q->Mask ];
+            }
+            while( !AdvanceFront( Q, Front, n ) );
 
+            return(n);
+        }
+
+
+
+        /** consumer side only, not to be used on a QUEUE_DROP_HEAD queue
+         * (the element may be evicted before Dequeue) */
         ElementType
         Front( Queue Q )
         {
-            if( !IsEmpty( Q ) )
-                return Q->Array[ Q->Front ];
+            unsigned int Front = Q->Front;
+
+            if( Front == Q->CachedRear )
+                Q->CachedRear = LOAD_ACQUIRE( &Q->Rear );
+            if( Front != Q->CachedRear )
+                return Q->Array[ Front & Q->Mask ];
             Error( "Empty queue" );
             return 0;  /* Return value used to avoid warning */
         }
 
+        /** consumer side only */
         void
         Dequeue( Queue Q )
         {
-            if( IsEmpty( Q ) )
+            if( FrontAndDequeue( Q ) == NULL )
                 Error( "Empty queue" );
-            else
-            {
-                Q->Size--;
-                Q->Front = Succ( Q->Front, Q );
-            }
         }
 
+        /** consumer side only */
         ElementType
         FrontAndDequeue( Queue Q )
         {
-            ElementType X = (ElementType)malloc (sizeof(ElementType));
+            ElementType X;
+            unsigned int Front;
 
-            if( IsEmpty( Q ) )
-            {
-                //Error( "Empty queue" );
-               // PRINT_DEBUG("Empty queue");
-                free (X);
-                return (NULL);
-            }
-            else
+            do
             {
-                Q->Size--;
-                X = Q->Array[ Q->Front ];
-                Q->Array[ Q->Front ] = NULL;
-                Q->Front = Succ( Q->Front, Q );
-                return X;
+                Front = LOAD_ACQUIRE( &Q->Front );
+                if( (int)( Q->CachedRear - Front ) <= 0 )
+                {
+                    Q->CachedRear = LOAD_ACQUIRE( &Q->Rear );
+                    if( Q->CachedRear == Front )
+                    {
+                        //Error( "Empty queue" );
+                       // PRINT_DEBUG("Empty queue");
+                        return (NULL);
+                    }
+                }
+
+                X = Q->Array[ Front & Q->Mask ];
             }
+            while( !AdvanceFront( Q, Front, 1 ) );
+
+            return X;
 
         }
 
+/** consumer side only, frees whatever is still queued */
 int TerminateQueue(Queue Q)
         {
 
-        	int i =0;
-        	for (i=0; i< Q->Size ; i++)
-        		free (Q->Array[i]);
+        	ElementType X;
 
-        	Q->Size = 0;
+        	while ( (X = FrontAndDequeue( Q )) != NULL )
+        		free (X);
 
         	return(1);
 
 
         }
+
+
+        void
+        InitDoorbell( struct Doorbell *B )
+        {
+            B->Seq = 0;
+            B->Sleepers = 0;
+        }
+
+        /** must be called before the queue is handed to its producer/consumer threads.
+         * Every queue a consumer passes to WaitNotEmpty must share the same doorbell
+         */
+        void
+        AttachDoorbell( Queue Q, struct Doorbell *B )
+        {
+            Q->Bell = B;
+        }
+
+        /** producer side, called after the new Rear is published */
+        void
+        RingDoorbell( struct Doorbell *B )
+        {
+            /** orders the Rear store before the Sleepers load, pairs with the
+             * increment of Sleepers in WaitNotEmpty */
+            __atomic_thread_fence( __ATOMIC_SEQ_CST );
+            if( __atomic_load_n( &B->Sleepers, __ATOMIC_RELAXED ) == 0 )
+                return;
+
+            __atomic_add_fetch( &B->Seq, 1, __ATOMIC_SEQ_CST );
+            syscall( SYS_futex, &B->Seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+        }
+
+        /** consumer side, blocks until at least one of the n queues is non empty
+         * or B is rung. May return spuriously, callers re-check their queues.
+         * All the queues must be attached to B
+         */
+        void
+        WaitDoorbell( struct Doorbell *B, Queue *Qs, int n )
+        {
+            int Key;
+            int i;
+
+            __atomic_add_fetch( &B->Sleepers, 1, __ATOMIC_SEQ_CST );
+            Key = __atomic_load_n( &B->Seq, __ATOMIC_SEQ_CST );
+
+            for( i = 0; i < n; i++ )
+                if( Qs[ i ] != NULL && !IsEmpty( Qs[ i ] ) )
+                    break;
+
+            /** returns straight away if a producer rang since Key was read */
+            if( i == n )
+                syscall( SYS_futex, &B->Seq, FUTEX_WAIT_PRIVATE, Key, NULL, NULL, 0 );
+
+            __atomic_sub_fetch( &B->Sleepers, 1, __ATOMIC_RELAXED );
+        }
+
+        /** consumer side, same as WaitDoorbell on the doorbell of Qs[0] */
+        void
+        WaitNotEmpty( Queue *Qs, int n )
+        {
+            WaitDoorbell( Qs[0]->Bell, Qs, n );
+        }
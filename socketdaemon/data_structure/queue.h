@@ -1,3 +1,8 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define Error( Str )       fprintf( stderr, "%s\n", Str )
+#define FatalError( Str )   fprintf( stderr, "%s\n", Str ), exit( 1 )
 #include <finstypes.h>
 #include <finsdebug.h>
 /** Define the ElementType into the caller file */
@@ -8,32 +13,108 @@ typedef struct finsFrame* ElementType;
         #ifndef _Queue_h
         #define _Queue_h
 
+/** Size of a cache line on the targets we run on. The producer and the consumer
+ * indices live on separate lines so that the two threads do not keep stealing
+ * the same line from each other on every enqueue/dequeue
+ */
+#define QUEUE_CACHELINE_SIZE 64
+
+		/** Wakeup facility for consumers of one or more queues (an eventcount).
+		 * A consumer that found its queues empty announces itself in Sleepers,
+		 * re-checks the queues and then futex-waits on Seq. A producer only
+		 * bumps Seq and issues the wake syscall when Sleepers is non zero, so an
+		 * enqueue onto a queue whose consumer is busy costs no system call.
+		 * Several queues may share one doorbell (the switch waits on all of its
+		 * input queues at once).
+		 */
+		struct Doorbell
+		        {
+		            int Seq;
+		            int Sleepers;
+		        } __attribute__ ((aligned (QUEUE_CACHELINE_SIZE)));
+
+		/** What the producer does when the queue holds HighWater elements.
+		 * The producer is never made to wait except under QUEUE_BLOCK, every
+		 * element refused or evicted is counted
+		 */
+		enum QueuePolicy
+		        {
+		            QUEUE_DROP_TAIL = 0,	/** refuse the new element (the default) */
+		            QUEUE_DROP_HEAD,		/** evict the oldest element to make room */
+		            QUEUE_DROP_PRIORITY,	/** refuse data frames, control frames may
+		                                     * still use the room up to Capacity */
+		            QUEUE_BLOCK				/** sleep until the consumer has brought
+		                                     * the queue down to LowWater */
+		        };
 
-		//struct QueueRecord;
+		/** Lock-free single-producer/single-consumer ring.
+		 * Front and Rear are free running counters, the slot of a counter is
+		 * (counter & Mask) and the number of queued elements is (Rear - Front).
+		 * Only the producer thread writes Rear and only the consumer thread
+		 * writes Front, each index is published with release semantics and
+		 * read by the other side with acquire semantics. The one exception is
+		 * QUEUE_DROP_HEAD, under which the producer may advance Front too: both
+		 * sides then move Front with a compare-and-swap.
+		 */
 		 struct QueueRecord
 		        {
-		            int Capacity;
-		            int Front;
-		            int Rear;
-		            int Size;
+		            /** consumer side, written only by the reading thread */
+		            unsigned int Front __attribute__ ((aligned (QUEUE_CACHELINE_SIZE)));
+		            unsigned int CachedRear;	/** consumer's last snapshot of Rear */
+
+		            /** producer side, written only by the writing thread */
+		            unsigned int Rear __attribute__ ((aligned (QUEUE_CACHELINE_SIZE)));
+		            unsigned int CachedFront;	/** producer's last snapshot of Front */
+		            unsigned long Dropped;		/** elements refused */
+		            unsigned long Evicted;		/** elements dropped from the head */
+		            unsigned long Blocked;		/** times the producer had to wait */
+
+		            /** read-only after CreateQueue */
+		            unsigned int Capacity __attribute__ ((aligned (QUEUE_CACHELINE_SIZE)));
+		            unsigned int Mask;
 		            char name[50];
 		            int ID;
 
 		            ElementType *Array;
+
+		            /** set before the queue is handed to its threads, see SetQueuePolicy */
+		            int Policy;
+		            unsigned int HighWater;
+		            unsigned int LowWater;
+		            void (*Drop)( ElementType X );	/** disposes of evicted elements */
+
+		            /** consumer wakeup, points at OwnBell unless AttachDoorbell was used */
+		            struct Doorbell *Bell;
+		            struct Doorbell OwnBell;
+
+		            /** producer wakeup, rung by the consumer of a QUEUE_BLOCK queue */
+		            struct Doorbell SpaceBell;
 		        };
 
 		typedef struct QueueRecord *Queue;
 
         int IsEmpty( Queue Q );
         int IsFull( Queue Q );
+        int QueueSize( Queue Q );
         Queue CreateQueue( const char* name,int MaxElements );
         int DisposeQueue( Queue Q );
         void MakeEmpty( Queue Q );
         int Enqueue( ElementType X, Queue Q );
+        int EnqueueBurst( ElementType *X, int n, Queue Q );
+        int DequeueBurst( ElementType *X, int Max, Queue Q );
         ElementType Front( Queue Q );
         void Dequeue( Queue Q );
         ElementType FrontAndDequeue( Queue Q );
         int TerminateQueue(Queue Q);
+        int SetQueuePolicy( Queue Q, int Policy, unsigned int HighWater,
+                unsigned int LowWater, void (*Drop)( ElementType X ) );
+
+        void InitDoorbell( struct Doorbell *B );
+        void AttachDoorbell( Queue Q, struct Doorbell *B );
+        void RingDoorbell( struct Doorbell *B );
+        void WaitDoorbell( struct Doorbell *B, Queue *Qs, int n );
+        void WaitNotEmpty( Queue *Qs, int n );
+        void WaitRoom( Queue Q );
 
 
 
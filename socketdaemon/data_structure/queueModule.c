@@ -7,110 +7,188 @@
 
 
 #include <queueModule.h>
+#include <time.h>
+#include <unistd.h>
 
 
-/**@brief initializes a queue buffer between the switch and the module
- * @return pointer to the queue whose default name is Q
- * */
-finsQueue init_queue(const char* name, int size)
-{
+#ifdef FINS_FRAME_TRACKING
 
-	if (name == NULL)
-		return (CreateQueue("Q",size));
-	else
-		return (CreateQueue(name,size));
+/** every live frame, newest first */
+static struct finsFrame *trackedFrames = NULL;
+static pthread_mutex_t trackLock = PTHREAD_MUTEX_INITIALIZER;
 
+static long track_now(void)
+{
+	struct timespec ts;
 
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec);
 
 }
 
-int TerminateFinsQueue(finsQueue Q)
+static void track_insert(struct finsFrame *f)
 {
-	PRINT_DEBUG("222");
-	int counter=0;
-	int size = Q->Size;
-	int i;
-    //ElementType X = (ElementType)malloc (sizeof(ElementType));
-	int min;
-	int max;
-	if (Q->Front <= Q->Rear)
-		{min = Q->Front; max = Q->Rear;
 
-		for (i=min; i<=max;i++)
-				{
-					if (freeFinsFrame(Q->Array[i]) == 0)
-						{
-						PRINT_DEBUG("333");
+	f->track.born = f->track.lastTouch = track_now();
+	f->track.lastQueue = "none";
+	f->track.lastOp = FINS_TRACK_WRITE;
+	f->track.prev = NULL;
 
-						PRINT_DEBUG("Element number %d was already NULL before deleting",i);
+	pthread_mutex_lock(&trackLock);
+	f->track.next = trackedFrames;
+	if (trackedFrames != NULL)
+		trackedFrames->track.prev = f;
+	trackedFrames = f;
+	pthread_mutex_unlock(&trackLock);
 
+}
 
-						}
-					else
-					{
+static void track_remove(struct finsFrame *f)
+{
 
-						counter++;
+	pthread_mutex_lock(&trackLock);
+	if (f->track.prev != NULL)
+		f->track.prev->track.next = f->track.next;
+	else
+		trackedFrames = f->track.next;
+	if (f->track.next != NULL)
+		f->track.next->track.prev = f->track.prev;
+	pthread_mutex_unlock(&trackLock);
 
+}
 
-					}
-				}
+/** records the queue f is about to enter (or just left) */
+static void track_touch(struct finsFrame *f, finsQueue q, int op)
+{
 
+	f->track.lastQueue = q->name;
+	f->track.lastOp = op;
+	f->track.lastTouch = track_now();
 
-		}
-	else
+}
+
+/**@brief thread body, every FINS_FRAME_LEAK_SECONDS prints the frames that
+ * have been alive for longer than that, and where they were seen last
+ * */
+void *fins_frame_leak_report(void *arg)
+{
+	struct finsFrame *f;
+	long now;
+	int count;
+
+	while (1)
 	{
+		sleep(FINS_FRAME_LEAK_SECONDS);
+		now = track_now();
+		count = 0;
 
-		max = Q->Front; min = Q->Rear;
+		pthread_mutex_lock(&trackLock);
+		for (f = trackedFrames; f != NULL; f = f->track.next)
+		{
+			if (now - f->track.born < FINS_FRAME_LEAK_SECONDS)
+				continue;
+			count++;
+			PRINT_DEBUG("frame %p (%s) alive %lds, last %s queue %s %lds ago, refs %d",
+					(void *) f, f->dataOrCtrl == DATA ? "data" : "control",
+					now - f->track.born,
+					f->track.lastOp == FINS_TRACK_WRITE ? "written to" : "read from",
+					f->track.lastQueue, now - f->track.lastTouch, f->refCount);
+		}
+		pthread_mutex_unlock(&trackLock);
 
-		for (i=max; i<Q->Capacity;i++)
-				{
-					if (freeFinsFrame(Q->Array[i]) == 0)
-						{
-						PRINT_DEBUG("333");
+		if (count > 0)
+			PRINT_DEBUG("%d frames older than %ds", count, FINS_FRAME_LEAK_SECONDS);
+	}
 
-						PRINT_DEBUG("Element number %d was already NULL before deleting",i);
+	return (NULL);
 
+}
 
-						}
-					else
-					{
+#else
 
-						counter++;
+#define track_insert(f)
+#define track_remove(f)
+#define track_touch(f, q, op)
 
+#endif /* FINS_FRAME_TRACKING */
 
-					}
-				}
 
+/** frames evicted from a QUEUE_DROP_HEAD queue */
+static void drop_frame(struct finsFrame *ff)
+{
 
-		for (i=0; i<=min;i++)
-				{
-					if (freeFinsFrame(Q->Array[i]) == 0)
-						{
-						PRINT_DEBUG("333");
+	freeFinsFrame(ff);
 
-						PRINT_DEBUG("Element number %d was already NULL before deleting",i);
+}
 
+/**@brief initializes a queue buffer between the switch and the module.
+ * The queue refuses new frames once full (QUEUE_DROP_TAIL), see set_queue_policy
+ * @return pointer to the queue whose default name is Q
+ * */
+finsQueue init_queue(const char* name, int size)
+{
+	finsQueue q;
 
-						}
-					else
-					{
+	if (name == NULL)
+		q = CreateQueue("Q",size);
+	else
+		q = CreateQueue(name,size);
 
-						counter++;
+	q->Drop = drop_frame;
+	return (q);
 
+}
 
-					}
-				}
+/**@brief sets what a writer of q does once q holds high frames, to be called
+ * before the queue is used
+ * @param policy one of QUEUE_DROP_TAIL, QUEUE_DROP_HEAD, QUEUE_DROP_PRIORITY
+ * (control frames still get in) or QUEUE_BLOCK (the writer waits until the
+ * reader brought q down to low frames)
+ * @return 1 on success, 0 if the watermarks do not fit the queue
+ * */
+int set_queue_policy(finsQueue q, int policy, int high, int low)
+{
 
+	if (high <= 0 || low < 0)
+		return (0);
+	return (SetQueuePolicy(q, policy, high, low, drop_frame));
 
+}
 
+/**@brief prints the occupancy and the drop counters of q
+ * */
+void report_queue(finsQueue q)
+{
 
+	static const char *policies[] = { "drop-tail", "drop-head", "drop-priority", "block" };
 
-	}
+	PRINT_DEBUG("queue %s (%s, %u/%u): %d queued, %lu dropped, %lu evicted, %lu blocked",
+			q->name, policies[q->Policy], q->LowWater, q->HighWater, QueueSize(q),
+			__atomic_load_n(&q->Dropped, __ATOMIC_RELAXED),
+			__atomic_load_n(&q->Evicted, __ATOMIC_RELAXED),
+			__atomic_load_n(&q->Blocked, __ATOMIC_RELAXED));
 
+}
 
-	//while (checkEmpty(Q))
+/**@brief drains the queue and frees every frame still waiting in it
+ * @return 1 if every queued element was a valid frame, 0 otherwise
+ * */
+int TerminateFinsQueue(finsQueue Q)
+{
+	PRINT_DEBUG("222");
+	int counter=0;
+	int size = QueueSize(Q);
+	struct finsFrame *ff;
 
-	Q->Size = 0;
+	while ((ff = FrontAndDequeue(Q)) != NULL)
+	{
+		if (freeFinsFrame(ff) == 0)
+		{
+			PRINT_DEBUG("Element number %d was already NULL before deleting",counter);
+		}
+		else
+			counter++;
+	}
 
 		if (counter ==size)
 			return(1);
@@ -123,13 +201,7 @@ int TerminateFinsQueue(finsQueue Q)
 int DisposeFinsQueue(finsQueue Q)
 {
 
-
-				if( Q != NULL )
-	            {
-	               // freeFinsFrame(Q->Array );
-	                free(Q );
-	            }
-	            return (1);
+	return (DisposeQueue(Q));
 
 }
 /**@brief terminates the queue buffer between the switch and the module
@@ -145,33 +217,128 @@ int term_queue(finsQueue q){
 /**@brief insert a finsFrame into queue q
  * @param ff the pointer to the fins frame being written into the queue
  * @param q points to this queue being accessed
- * @return 1 on success, 0 on failure (most probably due to insufficient memory)
+ * @return 1 on success, the queue's consumer then owns ff. 0 on failure (the
+ * queue refused ff under its policy, and counted the drop), the caller still
+ * owns ff and must free it. A QUEUE_BLOCK queue never fails, the call sleeps
+ * instead while the queue is above its high watermark
  * @version 2  FIXED BY Abdallah
  * @version 3 Cancel all the previous work and use GDSL , Now we just wrapper the GDSL
+ * @version 4 lock-free single-producer/single-consumer ring, only the one thread
+ * producing into q may call this and no semaphore is needed around it
  *
  * */
 int write_queue(struct finsFrame *ff, finsQueue q)
 {
+	track_touch(ff, q, FINS_TRACK_WRITE);
 	return (Enqueue(ff,q));
 
 
 } // end of read_queue
 
-/**@brief allows a finsFrame to be dequeued; there is a need to preserve integrity and hence we need to lock in the duration
- * @param ff the pointer to received the fins frame being read from the queue
+/**@brief allows a finsFrame to be dequeued; only the one thread consuming
+ * from q may call this and no semaphore is needed around it
  * @param q points to the queue being accessed
- * @return 1 on success , 0 on failure
+ * @return the dequeued frame, NULL when the queue is empty
  * */
 
 struct finsFrame * read_queue(finsQueue q)
  {
+	struct finsFrame *ff = FrontAndDequeue(q);
 
-return (FrontAndDequeue(q));
+	if (ff != NULL)
+		track_touch(ff, q, FINS_TRACK_READ);
+	return (ff);
 
 
 
 } // end of read_queue
 
+/**@brief dequeues up to max frames from q in one go
+ * @param q points to the queue being accessed
+ * @param frames receives the dequeued frames in queue order
+ * @param max capacity of frames
+ * @return the number of frames dequeued, 0 when the queue is empty
+ * */
+int read_queue_burst(finsQueue q, struct finsFrame *frames[], int max)
+{
+	int n = DequeueBurst(frames,max,q);
+	int i;
+
+	for (i = 0; i < n; i++)
+		track_touch(frames[i], q, FINS_TRACK_READ);
+	return (n);
+
+}
+
+/**@brief inserts n frames into q in one go, the consumer is woken at most once
+ * @param q points to the queue being accessed
+ * @param frames the frames to insert, in order
+ * @param n number of frames
+ * @return the number of frames written; frames[ret..n) were not queued and
+ * still belong to the caller
+ * */
+int write_queue_burst(finsQueue q, struct finsFrame *frames[], int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		track_touch(frames[i], q, FINS_TRACK_WRITE);
+	return (EnqueueBurst(frames,n,q));
+
+}
+
+/**@brief the frames q takes before it reaches its high watermark, where a
+ * write_queue waits (QUEUE_BLOCK) or drops. Exact for the one producer of q,
+ * a producer that must not wait checks it first
+ * @return the room left, 0 when q is congested
+ * */
+int queue_room(finsQueue q)
+{
+	int room = (int) q->HighWater - QueueSize(q);
+
+	return ((room > 0) ? room : 0);
+
+}
+
+/**@brief blocks the calling thread until the consumer of q (a QUEUE_BLOCK
+ * queue) made room in it. The producers sharing q through a lock wait here
+ * without holding the lock, then check queue_room again under it
+ * @param q points to the queue being waited on
+ * */
+void wait_queue_room(finsQueue q)
+{
+
+	WaitRoom(q);
+
+}
+
+/**@brief blocks the calling (consumer) thread until q holds at least one frame,
+ * without spinning. The producer wakes it up through the queue doorbell.
+ * It may return early (signal, shared doorbell) so callers re-check q
+ * @param q points to the queue being waited on
+ * */
+void wait_queue(finsQueue q)
+{
+
+	WaitNotEmpty(&q,1);
+
+}
+
+/**@brief blocking version of read_queue, sleeps while q is empty
+ * @param q points to the queue being accessed
+ * @return the dequeued frame, never NULL
+ * */
+struct finsFrame * read_queue_wait(finsQueue q)
+{
+	struct finsFrame *ff;
+
+	while ((ff = read_queue(q)) == NULL)
+		wait_queue(q);
+
+	return (ff);
+
+}
+
 int checkEmpty( finsQueue Q )
     {
         return (IsEmpty(Q));
@@ -246,6 +413,8 @@ void print_finsFrame(struct finsFrame *fins_in){
 			i++;
 
 		}
+		if (fins_in->dataFrame.fragLength != 0)
+			PRINT_DEBUG("followed by %d bytes of fragment\n", fins_in->dataFrame.fragLength);
 
 
 	}
@@ -264,21 +433,116 @@ void print_finsFrame(struct finsFrame *fins_in){
 }
 
 
+/** frames and metadata come from separate pools so that a metadata can move
+ * from one frame to another */
+static struct finsPool finsFramePool = FINS_POOL_INITIALIZER("finsFrame", sizeof(struct finsFrame), 0);
+static struct finsPool metadataPool = FINS_POOL_INITIALIZER("metadata", sizeof(metadata), 1);
+
+/**@brief pre-sizes the frame and metadata pools, to be called once at startup
+ * before the module threads are created
+ * @param frames number of frames (and metadata) expected in flight at once
+ * */
+void init_frame_pools(unsigned int frames)
+{
+
+	if (!fins_pool_reserve(&finsFramePool, frames) ||
+			!fins_pool_reserve(&metadataPool, frames))
+	{
+		PRINT_DEBUG("could not reserve %u frames", frames);
+		exit(1);
+	}
+
+}
+
+/**@brief prints the high-water marks and the current use of the frame pools
+ * */
+void report_frame_pools(void)
+{
+
+	fins_pool_report(&finsFramePool);
+	fins_pool_report(&metadataPool);
+
+}
+
+/**@brief allocates a zeroed fins frame from the calling thread's pool cache
+ * @return the frame, the caller holds its only reference. Release it with
+ * freeFinsFrame
+ * */
+struct finsFrame * allocFinsFrame(void)
+{
+
+	struct finsFrame *f = (struct finsFrame *) fins_pool_alloc(&finsFramePool);
+
+	if (f == NULL)
+	{
+		PRINT_DEBUG("out of frames");
+		exit(1);
+	}
+	memset(f, 0, sizeof(struct finsFrame));
+	f->refCount = 1;
+	track_insert(f);
+	return (f);
+
+}
+
+/**@brief allocates and initializes an empty metadata
+ * @return the metadata, release it with releaseMetadata (or together with
+ * the frame it is attached to, by freeFinsFrame)
+ * */
+metadata * allocMetadata(void)
+{
+
+	metadata *meta = (metadata *) fins_pool_alloc(&metadataPool);
+
+	if (meta == NULL)
+	{
+		PRINT_DEBUG("out of metadata");
+		exit(1);
+	}
+	metadata_create(meta);
+	meta->refCount = 1;
+	return (meta);
+
+}
+
+/**@brief takes one more reference to meta, for a second frame to carry it.
+ * Shared metadata must not be written to anymore
+ * @return meta
+ * */
+metadata * holdMetadata(metadata *meta)
+{
+
+	__atomic_add_fetch(&meta->refCount, 1, __ATOMIC_RELAXED);
+	return (meta);
+
+}
+
+/**@brief drops one reference to meta, the last one returns it to its pool
+ * */
+void releaseMetadata(metadata *meta)
+{
+
+	if (meta == NULL)
+		return;
+	if (__atomic_sub_fetch(&meta->refCount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	metadata_destroy(meta);
+	fins_pool_free(meta);
+
+}
+
 struct finsFrame * buildFinsFrame(void)
 {
 
-	struct finsFrame *f = (struct finsFrame * ) malloc (sizeof(struct finsFrame));
+	struct finsFrame *f = allocFinsFrame();
 	 PRINT_DEBUG("2.1");
 	int linkvalue= 80211;
 	char linkname[]="linklayer";
 	unsigned char fakeDatav[] =  "loloa77a7";
 	unsigned char *fakeData =fakeDatav;
 
-	metadata *metaptr = (metadata *)malloc(sizeof (metadata));
+	metadata *metaptr = allocMetadata();
 
-	//metadata *metaptr;
-	PRINT_DEBUG("2.2");
-	metadata_create(metaptr);
 	PRINT_DEBUG("2.3");
 	metadata_addElement(metaptr,linkname,META_TYPE_INT);
 	PRINT_DEBUG("2.4");
@@ -297,24 +561,145 @@ return(f);
 		}
 
 
+/**@brief appends id to the destinations of f, the switch then delivers f to
+ * every module of the list (see cloneFinsFrame)
+ * @return 1 on success, 0 when out of memory
+ * */
+int addDestination(struct finsFrame *f, unsigned char id)
+{
+	struct destinationList *dest;
+	struct destinationList *node;
+
+	node = (struct destinationList *) malloc(sizeof(struct destinationList));
+	if (node == NULL)
+	{
+		PRINT_DEBUG("out of memory adding destination %d", id);
+		return (0);
+	}
+	node->id = id;
+	node->next = NULL;
+
+	for (dest = &f->destinationID; dest->next != NULL; dest = dest->next)
+		;
+	dest->next = node;
+
+	return (1);
+
+}
+
+/** the extra destinations (after the first one, embedded in the frame) are
+ * allocated by addDestination */
+static void freeDestinations(struct finsFrame *f)
+{
+	struct destinationList *dest;
+	struct destinationList *next;
+
+	for (dest = f->destinationID.next; dest != NULL; dest = next)
+	{
+		next = dest->next;
+		free(dest);
+	}
+	f->destinationID.next = NULL;
+
+}
+
+/**@brief makes another frame addressed to id alone, sharing the payload
+ * buffer and the metadata of f instead of copying them. Both frames are then
+ * read only, see unshareMetadata and fins_frame_push
+ * @return the new frame, released with freeFinsFrame like any other
+ * */
+struct finsFrame * cloneFinsFrame(struct finsFrame *f, unsigned char id)
+{
+
+	struct finsFrame *c = allocFinsFrame();
+
+	c->dataOrCtrl = f->dataOrCtrl;
+	c->destinationID.id = id;
+	c->destinationID.next = NULL;
+
+	if (f->dataOrCtrl == DATA)
+	{
+		c->dataFrame.directionFlag = f->dataFrame.directionFlag;
+		if (f->dataFrame.metaData != NULL)
+			c->dataFrame.metaData = holdMetadata(f->dataFrame.metaData);
+		if (f->dataFrame.buff != NULL)
+			fins_frame_attach(&c->dataFrame, fins_buff_hold(f->dataFrame.buff),
+					f->dataFrame.pdu - f->dataFrame.buff->data, f->dataFrame.pduLength);
+		else
+			/** a foreign pdu has no reference count, it cannot be shared */
+			fins_frame_copy_pdu(&c->dataFrame, f->dataFrame.pdu, f->dataFrame.pduLength);
+		if (f->dataFrame.fragBuff != NULL)
+			fins_frame_attach_frag(&c->dataFrame, fins_buff_hold(f->dataFrame.fragBuff),
+					f->dataFrame.frag - f->dataFrame.fragBuff->data, f->dataFrame.fragLength);
+		c->dataFrame.csum = f->dataFrame.csum;
+		c->dataFrame.csumValid = f->dataFrame.csumValid;
+	}
+	else
+		c->ctrlFrame = f->ctrlFrame;
+
+	return (c);
+
+}
+
+/**@brief to be called before writing into the metadata of a frame that may
+ * have been cloned: a metadata shared with other frames is replaced with a
+ * private copy
+ * @return the metadata of f, safe to write to
+ * */
+metadata * unshareMetadata(struct finsFrame *f)
+{
+	metadata *shared = f->dataFrame.metaData;
+	metadata *meta;
+
+	if (shared == NULL || __atomic_load_n(&shared->refCount, __ATOMIC_ACQUIRE) == 1)
+		return (shared);
+
+	meta = allocMetadata();
+	metadata_copy(meta, shared);
+	f->dataFrame.metaData = meta;
+	releaseMetadata(shared);
+
+	return (meta);
+
+}
+
+/**@brief takes one more reference to f, each holder then calls freeFinsFrame
+ * once. A frame with several holders must be treated as read only
+ * @return f
+ * */
+struct finsFrame * holdFinsFrame(struct finsFrame *f)
+{
+
+	__atomic_add_fetch(&f->refCount, 1, __ATOMIC_RELAXED);
+	return (f);
+
+}
+
+/**@brief drops one reference to f. The last one returns the frame to its pool,
+ * along with the references it holds to its metadata and buffer.
+ * Any thread may free a frame. A caller that moved the metadata to another
+ * frame must set dataFrame.metaData to NULL first
+ * @return 1 on success, 0 if f is NULL
+ * */
 int freeFinsFrame (struct finsFrame *f)
 {
-	PRINT_DEBUG("4444");
 
 	if (f == NULL)
 		return (0);
-	if ((f->dataFrame).metaData !=NULL )
+	if (__atomic_sub_fetch(&f->refCount, 1, __ATOMIC_ACQ_REL) != 0)
+		return (1);
+	track_remove(f);
+	freeDestinations(f);
+	if (f->dataOrCtrl == DATA && (f->dataFrame).metaData !=NULL )
 	{
-		PRINT_DEBUG("6666");
 
-		metadata_destroy((f->dataFrame).metaData);
-		PRINT_DEBUG("5555");
+		releaseMetadata((f->dataFrame).metaData);
 
 	}
-	PRINT_DEBUG("7777");
+	if (f->dataOrCtrl == DATA)
+		fins_frame_release_pdu(&f->dataFrame);
 
-		free(f);
-		PRINT_DEBUG("8888");
+	fins_pool_free(f);
 
 	return (1);
 
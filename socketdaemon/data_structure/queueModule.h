@@ -11,6 +11,8 @@
 #include <finstypes.h>
 #include <semaphore.h>
 #include <queue.h>
+#include <finsPool.h>
+#include <finsBuff.h>
 #include <sys/sem.h>
 #include <pthread.h>    /* POSIX Threads */
 
@@ -24,6 +26,8 @@ typedef Queue finsQueue;
 
 
 finsQueue init_queue(const char* name, int size);
+int set_queue_policy(finsQueue q, int policy, int high, int low);
+void report_queue(finsQueue q);
 int checkEmpty( finsQueue Q );
 int TerminateFinsQueue(finsQueue Q);
 int DisposeFinsQueue(finsQueue Q);
@@ -32,11 +36,31 @@ int term_queue(finsQueue q);
 int write_queue(struct finsFrame *ff, finsQueue q);
 
 struct finsFrame * read_queue(finsQueue q);
+struct finsFrame * read_queue_wait(finsQueue q);
+void wait_queue(finsQueue q);
+int read_queue_burst(finsQueue q, struct finsFrame *frames[], int max);
+int write_queue_burst(finsQueue q, struct finsFrame *frames[], int n);
+int queue_room(finsQueue q);
+void wait_queue_room(finsQueue q);
 
 struct finsFrame * buildFinsFrame(void);
+struct finsFrame * allocFinsFrame(void);
+struct finsFrame * holdFinsFrame(struct finsFrame *f);
+struct finsFrame * cloneFinsFrame(struct finsFrame *f, unsigned char id);
+int addDestination(struct finsFrame *f, unsigned char id);
+metadata * allocMetadata(void);
+metadata * holdMetadata(metadata *meta);
+metadata * unshareMetadata(struct finsFrame *f);
+void releaseMetadata(metadata *meta);
+void init_frame_pools(unsigned int frames);
+void report_frame_pools(void);
 
 int freeFinsFrame (struct finsFrame *f);
 
+#ifdef FINS_FRAME_TRACKING
+void *fins_frame_leak_report(void *arg);
+#endif
+
 
 
 
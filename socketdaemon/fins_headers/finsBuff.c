@@ -0,0 +1,260 @@
+/**
+ * @file finsBuff.c
+ *
+ *  @date Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <finsBuff.h>
+#include <finsdebug.h>
+
+struct finsChannelControl *fins_buff_pool = NULL;
+
+/** the finsBuff of each channel buffer, used by whoever holds the jinni's
+ * reference to the channel buffer */
+static struct finsBuff fins_buff_pool_heads[FINS_CHANNEL_BUFFERS];
+
+/**@brief allocates a buffer of size bytes, the caller holds its only reference
+ * */
+struct finsBuff *fins_buff_alloc(unsigned int size)
+{
+
+	struct finsBuff *buff = (struct finsBuff *) malloc(sizeof(struct finsBuff) + size);
+
+	if (buff == NULL)
+	{
+		PRINT_DEBUG("out of memory allocating a %u bytes buffer", size);
+		exit(1);
+	}
+	buff->refCount = 1;
+	buff->size = size;
+	buff->pool = 0;
+	buff->data = (unsigned char *) (buff + 1);
+	return (buff);
+
+}
+
+/**@brief same as fins_buff_alloc, the buffer is taken from the pool of the
+ * socket channel when there is one with a free buffer big enough. The finsBuff
+ * holds the pool reference until it is released
+ * */
+struct finsBuff *fins_buff_alloc_shared(unsigned int size)
+{
+	struct finsChannelControl *pool = __atomic_load_n(&fins_buff_pool, __ATOMIC_ACQUIRE);
+	struct finsBuff *buff;
+	int i;
+
+	if (pool == NULL || size > FINS_CHANNEL_BUFFER_SIZE)
+		return (fins_buff_alloc(size));
+	i = fins_channel_buffer_alloc(pool);
+	if (i == -1)
+	{
+		PRINT_DEBUG("the channel buffers are all in use");
+		return (fins_buff_alloc(size));
+	}
+
+	buff = &fins_buff_pool_heads[i];
+	buff->refCount = 1;
+	buff->size = size;
+	buff->pool = i + 1;
+	buff->data = pool->Buffers[i].Data;
+	return (buff);
+
+}
+
+/**@brief takes one more reference to buff
+ * @return buff
+ * */
+struct finsBuff *fins_buff_hold(struct finsBuff *buff)
+{
+
+	__atomic_add_fetch(&buff->refCount, 1, __ATOMIC_RELAXED);
+	return (buff);
+
+}
+
+/**@brief drops one reference to buff, the last one frees it (or gives it
+ * back to the pool, whose buffer may stay lent to a client)
+ * */
+void fins_buff_release(struct finsBuff *buff)
+{
+
+	if (buff == NULL)
+		return;
+	if (__atomic_sub_fetch(&buff->refCount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	if (buff->pool != 0)
+		fins_channel_buffer_put(fins_buff_pool, buff->pool - 1);
+	else
+		free(buff);
+
+}
+
+/** @return 1 when other frames hold references to the buffer of df, 0 also
+ * for a pdu that is not in a buffer */
+static int fins_frame_shared(struct finsDataFrame *df)
+{
+
+	if (df->buff == NULL)
+		return (0);
+	return (__atomic_load_n(&df->buff->refCount, __ATOMIC_ACQUIRE) > 1);
+
+}
+
+/**@brief makes [offset, offset + len) of buff the pdu of df, df takes over
+ * the caller's reference to buff
+ * @return the new pdu
+ * */
+unsigned char *fins_frame_attach(struct finsDataFrame *df, struct finsBuff *buff,
+		unsigned int offset, unsigned int len)
+{
+
+	df->buff = buff;
+	df->pdu = buff->data + offset;
+	df->pduLength = len;
+	return (df->pdu);
+
+}
+
+/**@brief gives df a fresh pdu of len bytes, with the standard head and tail room
+ * @return the pdu, to be filled by the caller
+ * */
+unsigned char *fins_frame_alloc_pdu(struct finsDataFrame *df, unsigned int len)
+{
+
+	return (fins_frame_attach(df, fins_buff_alloc(FINS_HEADROOM + len + FINS_TAILROOM),
+			FINS_HEADROOM, len));
+
+}
+
+/**@brief same as fins_frame_alloc_pdu, filled with a copy of src
+ * */
+unsigned char *fins_frame_copy_pdu(struct finsDataFrame *df, const unsigned char *src,
+		unsigned int len)
+{
+
+	memcpy(fins_frame_alloc_pdu(df, len), src, len);
+	return (df->pdu);
+
+}
+
+/**@brief drops the references df holds to its buffers. A pdu that is not
+ * backed by a buffer belongs to whoever set it and is left alone
+ * */
+void fins_frame_release_pdu(struct finsDataFrame *df)
+{
+
+	if (df->buff != NULL)
+		fins_buff_release(df->buff);
+	df->buff = NULL;
+	df->pdu = NULL;
+	df->pduLength = 0;
+	if (df->fragBuff != NULL)
+		fins_buff_release(df->fragBuff);
+	df->fragBuff = NULL;
+	df->frag = NULL;
+	df->fragLength = 0;
+
+}
+
+/**@brief makes [offset, offset + len) of buff the frag of df, the bytes sent
+ * after the pdu. df takes over the caller's reference to buff, the bytes are
+ * read only
+ * @return the new frag
+ * */
+unsigned char *fins_frame_attach_frag(struct finsDataFrame *df, struct finsBuff *buff,
+		unsigned int offset, unsigned int len)
+{
+
+	df->fragBuff = buff;
+	df->frag = buff->data + offset;
+	df->fragLength = len;
+	return (df->frag);
+
+}
+
+/** @return the bytes of the packet, pdu and frag */
+unsigned int fins_frame_length(struct finsDataFrame *df)
+{
+
+	return (df->pduLength + df->fragLength);
+
+}
+
+unsigned int fins_frame_headroom(struct finsDataFrame *df)
+{
+
+	if (df->buff == NULL)
+		return (0);
+	return (df->pdu - df->buff->data);
+
+}
+
+unsigned int fins_frame_tailroom(struct finsDataFrame *df)
+{
+
+	if (df->buff == NULL)
+		return (0);
+	return (df->buff->size - (df->pdu - df->buff->data) - df->pduLength);
+
+}
+
+/**@brief grows the pdu by len bytes at the front, for a header to be written
+ * into. When the headroom is too small, the buffer is shared with other frames
+ * or the pdu is not backed by a buffer, the pdu is first moved into a new
+ * buffer with the standard head and tail room
+ * @return the new start of the pdu
+ * */
+unsigned char *fins_frame_push(struct finsDataFrame *df, unsigned int len)
+{
+	struct finsBuff *old;
+	struct finsBuff *buff;
+
+	if (fins_frame_headroom(df) < len || fins_frame_shared(df))
+	{
+		PRINT_DEBUG("headroom %u < %u or shared buffer, reallocating", fins_frame_headroom(df), len);
+		old = df->buff;
+		buff = fins_buff_alloc(FINS_HEADROOM + len + df->pduLength + FINS_TAILROOM);
+		memcpy(buff->data + FINS_HEADROOM + len, df->pdu, df->pduLength);
+		fins_frame_attach(df, buff, FINS_HEADROOM + len, df->pduLength);
+		if (old != NULL)
+			fins_buff_release(old);
+	}
+
+	df->pdu -= len;
+	df->pduLength += len;
+	return (df->pdu);
+
+}
+
+/**@brief strips len bytes (a header already processed) off the front of the pdu
+ * @return the new start of the pdu, NULL if the pdu is shorter than len
+ * */
+unsigned char *fins_frame_pull(struct finsDataFrame *df, unsigned int len)
+{
+
+	if (df->pduLength < len)
+		return (NULL);
+	df->pdu += len;
+	df->pduLength -= len;
+	return (df->pdu);
+
+}
+
+/**@brief grows the pdu by len bytes at the end
+ * @return the first of the added bytes, NULL if the tailroom is too small,
+ * the buffer is shared or a frag follows the pdu
+ * */
+unsigned char *fins_frame_put(struct finsDataFrame *df, unsigned int len)
+{
+	unsigned char *tail;
+
+	if (fins_frame_tailroom(df) < len || fins_frame_shared(df) || df->fragLength != 0)
+		return (NULL);
+	tail = df->pdu + df->pduLength;
+	df->pduLength += len;
+	return (tail);
+
+}
@@ -0,0 +1,75 @@
+/**
+ * @file finsBuff.h
+ *
+ * @brief packet buffers with headroom and tailroom.
+ *
+ * A data frame's bytes live in a finsBuff, pdu/pduLength are the window
+ * of the buffer currently holding the packet. Every layer on the way down
+ * pushes its header into the headroom in front of pdu instead of allocating
+ * a new buffer and copying the payload behind the header; on the way up
+ * a layer pulls its header off the front of the window.
+ *
+ * A frame may also carry a second window, frag, sent right after pdu: the
+ * IPv4 fragments of a datagram each have their own header in pdu and a slice
+ * of the datagram's buffer in frag, so that fragmenting copies no payload.
+ * The layers below IPv4 only push headers, the Ethernet stub writes both
+ * windows out with one writev.
+ *
+ * The jinni receives the packets into buffers of the pool of the socket
+ * channel (fins_buff_alloc_shared), so that a packet can be lent to the
+ * client that reads it without being copied again.
+ *
+ * @date Oct 17, 2026
+ */
+
+#ifndef FINSBUFF_H_
+#define FINSBUFF_H_
+
+#include <finstypes.h>
+#include <finsChannel.h>
+
+/** room for the Ethernet (14), IPv4 (20) and UDP (8) headers, rounded up */
+#define FINS_HEADROOM 64
+/** room behind the packet, for fins_frame_put */
+#define FINS_TAILROOM 8
+
+/** A buffer may be shared by several frames (each holding one reference),
+ * the bytes of a shared buffer are read only: pushing a header onto a frame
+ * whose buffer is shared first moves its pdu into a private buffer
+ */
+struct finsBuff
+{
+	int refCount;
+	unsigned int size;	/** usable bytes in data */
+	int pool;	/** the channel buffer + 1 holding data, 0 if it was malloc'ed */
+	/** right behind the finsBuff when it was malloc'ed, else the Data of the
+	 * channel buffer. The finsBuff itself always stays in the jinni's memory,
+	 * the clients map the channel buffers writable */
+	unsigned char *data;
+};
+
+/** the pool of fins_buff_alloc_shared, NULL until the channel is created */
+extern struct finsChannelControl *fins_buff_pool;
+
+struct finsBuff *fins_buff_alloc(unsigned int size);
+struct finsBuff *fins_buff_alloc_shared(unsigned int size);
+struct finsBuff *fins_buff_hold(struct finsBuff *buff);
+void fins_buff_release(struct finsBuff *buff);
+
+unsigned char *fins_frame_attach(struct finsDataFrame *df, struct finsBuff *buff,
+		unsigned int offset, unsigned int len);
+unsigned char *fins_frame_alloc_pdu(struct finsDataFrame *df, unsigned int len);
+unsigned char *fins_frame_copy_pdu(struct finsDataFrame *df, const unsigned char *src,
+		unsigned int len);
+void fins_frame_release_pdu(struct finsDataFrame *df);
+unsigned char *fins_frame_attach_frag(struct finsDataFrame *df, struct finsBuff *buff,
+		unsigned int offset, unsigned int len);
+unsigned int fins_frame_length(struct finsDataFrame *df);
+
+unsigned int fins_frame_headroom(struct finsDataFrame *df);
+unsigned int fins_frame_tailroom(struct finsDataFrame *df);
+unsigned char *fins_frame_push(struct finsDataFrame *df, unsigned int len);
+unsigned char *fins_frame_pull(struct finsDataFrame *df, unsigned int len);
+unsigned char *fins_frame_put(struct finsDataFrame *df, unsigned int len);
+
+#endif /* FINSBUFF_H_ */
@@ -0,0 +1,241 @@
+/**
+ * @file finsChannel.h
+ *
+ * @brief shared memory channel between the socket interceptor and the jinni.
+ *
+ * The jinni creates one shared memory segment holding a slot per client
+ * process. A slot has a request ring (written by the client, read by the
+ * jinni) and a response ring (written by the jinni, read by the client).
+ * A call is one record in the ring: a finsChannelHeader followed by the
+ * arguments and the payload itself, copied in place, so a round trip costs no
+ * system call unless one side has to be woken up. The response to a call
+ * carries the Id of its request, responses may come back in any order.
+ *
+ * The segment also holds a pool of packet buffers. The jinni receives the
+ * packets straight into them and may lend one to a client, which reads the
+ * packet in place and gives the buffer back with fins_channel_buffer_return
+ * (see fins_recv_zc in the interceptor).
+ *
+ * A second segment, read only for the clients, publishes the socket table of
+ * the jinni, so that getsockname, getpeername and getsockopt are answered in
+ * the client without a call (see fins_sockets_lookup).
+ *
+ * A request may also be asynchronous: it gets no response, the client only
+ * needs a credit to post it (fins_channel_credit) and the jinni gives the
+ * credit back once the request is handled (fins_channel_complete). A failure
+ * is kept as the pending error of the socket in the socket table.
+ *
+ * Waiting is done on futexes living in the segment (eventcounts, as for the
+ * queue doorbells): a producer only makes the wake system call when the
+ * consumer announced that it went to sleep. The jinni sleeps on a single
+ * request doorbell shared by all the request rings.
+ *
+ * The interceptor keeps its own copy of this file and of finsChannel.c,
+ * the two copies must stay identical.
+ *
+ * @date Oct 17, 2026
+ */
+
+#ifndef FINSCHANNEL_H_
+#define FINSCHANNEL_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#define FINS_CHANNEL_NAME "/fins_channel"
+#define FINS_CHANNEL_MAGIC 0x46494e53
+/** client processes served at once */
+#define FINS_CHANNEL_MAX_CLIENTS 10
+/** bytes of each ring, a power of two. A record (a whole UDP datagram at
+ * most) has to fit in one ring */
+#define FINS_CHANNEL_RING_SIZE (1 << 18)
+/** datagrams of a sendmmsg or recvmmsg request, and the bytes its records may
+ * take, so that the next record fits in the ring as well */
+#define FINS_CHANNEL_MAX_BATCH 64
+#define FINS_CHANNEL_BATCH_BYTES (FINS_CHANNEL_RING_SIZE / 2)
+#define FINS_CHANNEL_CACHELINE 64
+/** buffers of the shared pool, and the bytes of each */
+#define FINS_CHANNEL_BUFFERS 1024
+#define FINS_CHANNEL_BUFFER_SIZE 4096
+/** asynchronous requests a client may have outstanding */
+#define FINS_CHANNEL_CREDITS 64
+#define FINS_SOCKETS_NAME "/fins_sockets"
+/** entries of the published socket table, MAX_sockets of the jinni */
+#define FINS_SOCKETS_MAX 100
+/** of the records, a jinni answers the requests of an other version with NACK */
+#define FINS_CHANNEL_VERSION 1
+
+/** the start of every request and response record */
+struct finsChannelHeader
+{
+	uint16_t Version;
+	uint16_t Code;	/** the opcode of a request, ACK or NACK in a response */
+	uint32_t Id;	/** chosen by the client, the response carries the Id of its request */
+	pid_t Pid;	/** the client process */
+};
+
+struct finsChannelBell
+{
+	int Seq;
+	int Sleepers;
+} __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+
+/** Single producer, single consumer byte ring. Head and Tail are free
+ * running counters, the bytes in use are (Tail - Head). A record is a
+ * 4 bytes length followed by that many bytes, wrapping around the end of
+ * Data as needed
+ */
+struct finsChannelRing
+{
+	/** consumer side */
+	unsigned int Head __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+	/** producer side */
+	unsigned int Tail __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+
+	struct finsChannelBell DataBell;	/** the consumer waits for records here */
+	struct finsChannelBell SpaceBell;	/** the producer waits for room here */
+
+	unsigned char Data[FINS_CHANNEL_RING_SIZE] __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+};
+
+/** the Pid of a slot whose process died, until the jinni hands it back */
+#define FINS_CHANNEL_DRAINING (-2)
+
+struct finsChannelClient
+{
+	/** 0 when the slot is free, else the process owning it or FINS_CHANNEL_DRAINING */
+	pid_t Pid __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+
+	struct finsChannelRing Request;
+	struct finsChannelRing Response;
+
+	/** asynchronous requests the jinni handled, the client posted up to
+	 * FINS_CHANNEL_CREDITS more */
+	unsigned int Completed __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+	struct finsChannelBell CreditBell;	/** the client waits for a credit here */
+};
+
+/** A buffer of the shared pool. The buffer is freed when the last reference
+ * is put back: the jinni holds one while it uses the buffer, a client one
+ * for each packet lent to it */
+struct finsChannelBuffer
+{
+	int Refs;
+	int Next;	/** the next free buffer + 1, while this one is free */
+	int Holder;	/** the client slot + 1 the buffer is lent to, 0 if none */
+
+	unsigned char Data[FINS_CHANNEL_BUFFER_SIZE] __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+};
+
+struct finsChannelControl
+{
+	unsigned int Magic;
+	unsigned int Size;	/** sizeof(struct finsChannelControl) of the creator */
+
+	/** rung by every client after it posts a request */
+	struct finsChannelBell RequestBell;
+
+	struct finsChannelClient Clients[FINS_CHANNEL_MAX_CLIENTS];
+
+	/** the free buffers, a stack shared by all the processes: the first free
+	 * buffer + 1 in the low 32 bits, a count of the changes in the high ones
+	 * so that a compare and swap cannot mistake an old top for the current one */
+	uint64_t FreeBuffers __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+	struct finsChannelBuffer Buffers[FINS_CHANNEL_BUFFERS];
+};
+
+/** An entry of the published socket table, a seqlock: Seq is odd while the
+ * jinni updates the entry, a reader copies the entry and retries if Seq
+ * changed meanwhile. The addresses are in network order, as in a sockaddr_in
+ */
+struct finsSocketEntry
+{
+	unsigned int Seq;
+	pid_t Pid;	/** the process owning the socket, 0 when the entry is free */
+	int Fd;	/** the socket as the process knows it to the jinni (its fakeID) */
+	int Type;
+	int Protocol;
+	uint16_t HostPort;
+	uint16_t DstPort;
+	uint32_t HostIP;
+	uint32_t DstIP;
+	int Error;	/** the last failure of an asynchronous request on the socket */
+	unsigned int Errors;	/** the failures so far, a client has not seen Error unless it saw this count */
+} __attribute__ ((aligned (FINS_CHANNEL_CACHELINE)));
+
+struct finsSocketTable
+{
+	unsigned int Magic;
+	unsigned int Size;	/** sizeof(struct finsSocketTable) of the creator */
+
+	struct finsSocketEntry Sockets[FINS_SOCKETS_MAX];
+};
+
+/** the client's view of the channel, see fins_channel_attach */
+struct finsChannel
+{
+	struct finsChannelControl *Control;
+	struct finsChannelClient *Client;
+	pid_t Pid;	/** the process that owns Client, fork gives the child a new slot */
+	unsigned int Issued;	/** asynchronous requests posted, see fins_channel_credit */
+};
+
+/** one record being written, the writer owns the reserved bytes until
+ * fins_channel_commit */
+struct finsChannelWriter
+{
+	struct finsChannelRing *Ring;
+	struct finsChannelBell *Bell;	/** rung on commit */
+	unsigned int Start;
+	unsigned int Pos;
+	unsigned int End;
+};
+
+/** one record being read, the bytes stay in the ring until fins_channel_finish */
+struct finsChannelReader
+{
+	struct finsChannelRing *Ring;
+	unsigned int Pos;
+	unsigned int End;
+	int Open;
+	int *Busy;	/** cleared by fins_channel_finish, see fins_channel_next_request */
+	struct finsChannelBell *Wake;	/** rung once Busy is cleared */
+};
+
+/** both sides */
+int fins_channel_put(struct finsChannelWriter *w, const void *src, unsigned int len);
+void fins_channel_commit(struct finsChannelWriter *w);
+int fins_channel_get(struct finsChannelReader *r, void *dst, unsigned int len);
+int fins_channel_get_inplace(struct finsChannelReader *r, const void **src, unsigned int len);
+void fins_channel_finish(struct finsChannelReader *r);
+
+/** the interceptor side */
+int fins_channel_attach(struct finsChannel *ch);
+int fins_channel_request(struct finsChannel *ch, struct finsChannelWriter *w, unsigned int len);
+void fins_channel_response(struct finsChannel *ch, struct finsChannelReader *r);
+int fins_channel_credit(struct finsChannel *ch, int wait);
+
+/** the buffer pool, both sides */
+int fins_channel_buffer_alloc(struct finsChannelControl *ctrl);
+int fins_channel_buffer_lend(struct finsChannelControl *ctrl, int buffer, int client);
+void fins_channel_buffer_put(struct finsChannelControl *ctrl, int buffer);
+void fins_channel_buffer_return(struct finsChannelControl *ctrl, int buffer, int client);
+int fins_channel_buffer_find(struct finsChannelControl *ctrl, const void *p);
+
+/** the published socket table */
+struct finsSocketTable *fins_sockets_create();
+void fins_sockets_publish(struct finsSocketTable *table, int index, const struct finsSocketEntry *entry);
+struct finsSocketTable *fins_sockets_attach();
+int fins_sockets_lookup(struct finsSocketTable *table, pid_t pid, int fd, struct finsSocketEntry *entry);
+
+/** the jinni side */
+struct finsChannelControl *fins_channel_create();
+int fins_channel_next_request(struct finsChannelControl *ctrl, struct finsChannelReader *r, int *scan,
+		int *busy);
+int fins_channel_release(struct finsChannelControl *ctrl, int client, int *busy);
+int fins_channel_find(struct finsChannelControl *ctrl, pid_t pid);
+int fins_channel_reply(struct finsChannelControl *ctrl, int client, struct finsChannelWriter *w,
+		unsigned int len);
+void fins_channel_complete(struct finsChannelControl *ctrl, pid_t pid);
+
+#endif /* FINSCHANNEL_H_ */
@@ -0,0 +1,345 @@
+/**
+ * @file finsCsum.c
+ *
+ *  @date Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "finsCsum.h"
+#include "finsdebug.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FINS_CSUM_X86 1
+#endif
+
+/** a kernel sums (and copies, when dst is not NULL) len bytes of src into
+ * the 64 bits accumulator sum, which it returns */
+typedef uint64_t (*fins_csum_kernel)(void *dst, const void *src, unsigned int len, uint64_t sum);
+
+/** the bytes left over by the vector kernels, and whole buffers on the other
+ * processors. Words are loaded with memcpy, src and dst need no alignment */
+static uint64_t fins_csum_scalar(void *dst, const void *src, unsigned int len, uint64_t sum)
+{
+	const unsigned char *s = (const unsigned char *) src;
+	unsigned char *d = (unsigned char *) dst;
+	uint64_t word;
+	uint32_t half;
+	uint16_t quarter;
+	uint16_t last = 0;
+
+	/** two 32 bits halves at a time, a 64 bits accumulator does not carry
+	 * out before 2^32 of them */
+	while (len >= 8)
+	{
+		memcpy(&word, s, 8);
+		if (d != NULL)
+		{
+			memcpy(d, &word, 8);
+			d += 8;
+		}
+		sum += (word & 0xffffffff) + (word >> 32);
+		s += 8;
+		len -= 8;
+	}
+	if (len >= 4)
+	{
+		memcpy(&half, s, 4);
+		if (d != NULL)
+		{
+			memcpy(d, &half, 4);
+			d += 4;
+		}
+		sum += half;
+		s += 4;
+		len -= 4;
+	}
+	if (len >= 2)
+	{
+		memcpy(&quarter, s, 2);
+		if (d != NULL)
+		{
+			memcpy(d, &quarter, 2);
+			d += 2;
+		}
+		sum += quarter;
+		s += 2;
+		len -= 2;
+	}
+	if (len == 1)
+	{
+		/** the odd byte is summed as if a zero byte followed it */
+		*(unsigned char *) &last = *s;
+		if (d != NULL)
+			*d = *s;
+		sum += last;
+	}
+	return (sum);
+
+}
+
+#ifdef FINS_CSUM_X86
+
+/** the 32 bits lanes of v are zero extended to 64 bits and added to acc,
+ * no lane carries out before 2^32 additions */
+__attribute__ ((target ("sse2")))
+static inline __m128i fins_csum_add_sse2(__m128i acc, __m128i v)
+{
+	__m128i zero = _mm_setzero_si128();
+
+	acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+	return (_mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero)));
+
+}
+
+__attribute__ ((target ("sse2")))
+static uint64_t fins_csum_sse2(void *dst, const void *src, unsigned int len, uint64_t sum)
+{
+	const unsigned char *s = (const unsigned char *) src;
+	unsigned char *d = (unsigned char *) dst;
+	__m128i acc0 = _mm_setzero_si128();
+	__m128i acc1 = _mm_setzero_si128();
+	__m128i v0;
+	__m128i v1;
+	uint64_t lanes[2];
+
+	/** two accumulators, the additions of one do not wait for the other */
+	while (len >= 32)
+	{
+		v0 = _mm_loadu_si128((const __m128i *) s);
+		v1 = _mm_loadu_si128((const __m128i *) (s + 16));
+		if (d != NULL)
+		{
+			_mm_storeu_si128((__m128i *) d, v0);
+			_mm_storeu_si128((__m128i *) (d + 16), v1);
+			d += 32;
+		}
+		acc0 = fins_csum_add_sse2(acc0, v0);
+		acc1 = fins_csum_add_sse2(acc1, v1);
+		s += 32;
+		len -= 32;
+	}
+	if (len >= 16)
+	{
+		v0 = _mm_loadu_si128((const __m128i *) s);
+		if (d != NULL)
+		{
+			_mm_storeu_si128((__m128i *) d, v0);
+			d += 16;
+		}
+		acc0 = fins_csum_add_sse2(acc0, v0);
+		s += 16;
+		len -= 16;
+	}
+	_mm_storeu_si128((__m128i *) lanes, _mm_add_epi64(acc0, acc1));
+	/** the lanes are below 2^37 each, their sum cannot overflow */
+	sum = fins_csum_scalar(d, s, len, sum);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return (sum + lanes[0] + lanes[1]);
+
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i fins_csum_add_avx2(__m256i acc, __m256i v)
+{
+	__m256i zero = _mm256_setzero_si256();
+
+	acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(v, zero));
+	return (_mm256_add_epi64(acc, _mm256_unpackhi_epi32(v, zero)));
+
+}
+
+__attribute__ ((target ("avx2")))
+static uint64_t fins_csum_avx2(void *dst, const void *src, unsigned int len, uint64_t sum)
+{
+	const unsigned char *s = (const unsigned char *) src;
+	unsigned char *d = (unsigned char *) dst;
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+	__m256i v0;
+	__m256i v1;
+	uint64_t lanes[4];
+
+	while (len >= 64)
+	{
+		v0 = _mm256_loadu_si256((const __m256i *) s);
+		v1 = _mm256_loadu_si256((const __m256i *) (s + 32));
+		if (d != NULL)
+		{
+			_mm256_storeu_si256((__m256i *) d, v0);
+			_mm256_storeu_si256((__m256i *) (d + 32), v1);
+			d += 64;
+		}
+		acc0 = fins_csum_add_avx2(acc0, v0);
+		acc1 = fins_csum_add_avx2(acc1, v1);
+		s += 64;
+		len -= 64;
+	}
+	if (len >= 32)
+	{
+		v0 = _mm256_loadu_si256((const __m256i *) s);
+		if (d != NULL)
+		{
+			_mm256_storeu_si256((__m256i *) d, v0);
+			d += 32;
+		}
+		acc0 = fins_csum_add_avx2(acc0, v0);
+		s += 32;
+		len -= 32;
+	}
+	_mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(acc0, acc1));
+	/** leaves the upper halves of the registers clean for SSE code */
+	_mm256_zeroupper();
+	sum = fins_csum_scalar(d, s, len, sum);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return (sum + lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+
+}
+
+#endif /* FINS_CSUM_X86 */
+
+static uint64_t fins_csum_select(void *dst, const void *src, unsigned int len, uint64_t sum);
+
+/** set by fins_csum_select at the first call, any thread may race to set it
+ * as they all pick the same kernel */
+static fins_csum_kernel fins_csum_impl = fins_csum_select;
+static const char *fins_csum_name = "none yet";
+
+static uint64_t fins_csum_select(void *dst, const void *src, unsigned int len, uint64_t sum)
+{
+	fins_csum_kernel kernel = fins_csum_scalar;
+	const char *name = "scalar";
+
+#ifdef FINS_CSUM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		kernel = fins_csum_avx2;
+		name = "avx2";
+	} else if (__builtin_cpu_supports("sse2"))
+	{
+		kernel = fins_csum_sse2;
+		name = "sse2";
+	}
+#endif
+	__atomic_store_n(&fins_csum_name, name, __ATOMIC_RELAXED);
+	__atomic_store_n(&fins_csum_impl, kernel, __ATOMIC_RELEASE);
+	PRINT_DEBUG("checksum kernel %s", name);
+	return (kernel(dst, src, len, sum));
+
+}
+
+/** folds the 64 bits accumulator into a 32 bits partial sum */
+static uint32_t fins_csum_fold64(uint64_t sum)
+{
+
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return ((uint32_t) sum);
+
+}
+
+/**@brief adds the len bytes of buf to the partial sum
+ * @return the new partial sum
+ * */
+uint32_t fins_csum_partial(const void *buf, unsigned int len, uint32_t sum)
+{
+	fins_csum_kernel kernel = __atomic_load_n(&fins_csum_impl, __ATOMIC_ACQUIRE);
+
+	return (fins_csum_fold64(kernel(NULL, buf, len, sum)));
+
+}
+
+/**@brief copies len bytes from src to dst (which must not overlap) and adds
+ * them to the partial sum on the way
+ * @return the new partial sum
+ * */
+uint32_t fins_csum_copy(void *dst, const void *src, unsigned int len, uint32_t sum)
+{
+	fins_csum_kernel kernel = __atomic_load_n(&fins_csum_impl, __ATOMIC_ACQUIRE);
+
+	return (fins_csum_fold64(kernel(dst, src, len, sum)));
+
+}
+
+/** @return the ones' complement sum of two partial sums */
+uint32_t fins_csum_add(uint32_t sum, uint32_t sum2)
+{
+
+	sum += sum2;
+	return (sum + (sum < sum2));
+
+}
+
+/**@brief adds sum2, the partial sum of a block starting offset bytes after
+ * the bytes of sum, to sum. A block at an odd offset has its bytes in the
+ * other halves of the words
+ * @return the partial sum of both
+ * */
+uint32_t fins_csum_block_add(uint32_t sum, uint32_t sum2, unsigned int offset)
+{
+
+	if (offset & 1)
+		sum2 = (sum2 >> 8) | (sum2 << 24);
+	return (fins_csum_add(sum, sum2));
+
+}
+
+/**@brief folds a partial sum into the checksum field of a header: a header
+ * summed with its checksum folds to 0
+ * @return the ones' complement of the 16 bits sum, as it is stored
+ * */
+uint16_t fins_csum_fold(uint32_t sum)
+{
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return ((uint16_t) ~sum);
+
+}
+
+/** @return the checksum of the len bytes of buf */
+uint16_t fins_csum(const void *buf, unsigned int len)
+{
+
+	return (fins_csum_fold(fins_csum_partial(buf, len, 0)));
+
+}
+
+/**@brief the checksum check of a header after a 16 bits field of it went
+ * from old to new (all three as they are in the header), without summing the
+ * header again: HC' = ~(~HC + ~m + m') (RFC 1624, eqn. 3)
+ * @return the new checksum
+ * */
+uint16_t fins_csum_update16(uint16_t check, uint16_t old, uint16_t new)
+{
+	uint32_t sum;
+
+	sum = (uint16_t) ~check;
+	sum += (uint16_t) ~old;
+	sum += new;
+	return (fins_csum_fold(sum));
+
+}
+
+/** same as fins_csum_update16, for a 32 bits field (an address) */
+uint16_t fins_csum_update32(uint16_t check, uint32_t old, uint32_t new)
+{
+	uint32_t sum;
+
+	sum = (uint16_t) ~check;
+	sum += (uint16_t) ~(old >> 16) + (uint16_t) ~(old & 0xffff);
+	sum += (new >> 16) + (new & 0xffff);
+	return (fins_csum_fold(sum));
+
+}
+
+const char *fins_csum_kernel_name(void)
+{
+
+	return (__atomic_load_n(&fins_csum_name, __ATOMIC_RELAXED));
+
+}
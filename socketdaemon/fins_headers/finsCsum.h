@@ -0,0 +1,40 @@
+/**
+ * @file finsCsum.h
+ *
+ * @brief the Internet checksum (RFC 1071) of IPv4, UDP and ICMP.
+ *
+ * A partial sum is the 32 bits ones' complement sum of the 16 bits words of
+ * some bytes, as they are in memory: the sum does not depend on the byte
+ * order, fins_csum_fold turns it into the checksum to store as is in a
+ * header. Sums of consecutive blocks add up with fins_csum_block_add.
+ *
+ * The kernel summing the bytes is picked at the first call: AVX2 or SSE2 on
+ * the x86 processors that have them, a 64 bits accumulator loop otherwise.
+ * fins_csum_copy sums the bytes while it copies them, for the copies the
+ * packets go through anyway (the payload of a send into its frame, the IPv4
+ * payload into the frame going up), so that the checksum costs no second
+ * pass over the data.
+ *
+ * @date Oct 17, 2026
+ */
+
+#ifndef FINSCSUM_H_
+#define FINSCSUM_H_
+
+#include <stdint.h>
+
+uint32_t fins_csum_partial(const void *buf, unsigned int len, uint32_t sum);
+uint32_t fins_csum_copy(void *dst, const void *src, unsigned int len, uint32_t sum);
+uint32_t fins_csum_add(uint32_t sum, uint32_t sum2);
+uint32_t fins_csum_block_add(uint32_t sum, uint32_t sum2, unsigned int offset);
+uint16_t fins_csum_fold(uint32_t sum);
+uint16_t fins_csum(const void *buf, unsigned int len);
+
+/** RFC 1624, the checksum of a header in which a field changed */
+uint16_t fins_csum_update16(uint16_t check, uint16_t old, uint16_t new);
+uint16_t fins_csum_update32(uint16_t check, uint32_t old, uint32_t new);
+
+/** the name of the kernel in use, for the debug messages */
+const char *fins_csum_kernel_name(void);
+
+#endif /* FINSCSUM_H_ */
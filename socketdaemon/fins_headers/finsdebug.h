@@ -9,6 +9,10 @@
 
 #define DEBUG
 #define ERROR
+/** keep every live frame on a list and report the ones still alive after
+ * FINS_FRAME_LEAK_SECONDS, with the queue they last went through */
+//#define FINS_FRAME_TRACKING
+#define FINS_FRAME_LEAK_SECONDS 10
 
 #ifdef DEBUG
 #define PRINT_DEBUG(format, args...) printf("DEBUG(%s, %d):"format"\n",__FILE__, __LINE__, ##args);
@@ -69,14 +69,28 @@ struct tableRecord *next;
 };
 
 
+struct finsBuff;
+
 struct finsDataFrame
 {
 
 /* Only for FINS DATA FRAMES */
 unsigned char directionFlag;
 unsigned int pduLength;
-unsigned char *pdu;
+unsigned char *pdu;	/** window of buff currently holding the packet (see finsBuff.h) */
 metadata *metaData;
+struct finsBuff *buff;	/** owns the bytes pdu points into, NULL for a foreign pdu */
+/** a second window of bytes following pdu on the wire, in a buffer shared
+ * with other frames (the payload of an IPv4 fragment, see IP4_out), fragLength
+ * is 0 when the packet is all in pdu */
+unsigned char *frag;
+unsigned int fragLength;
+struct finsBuff *fragBuff;
+/** the partial checksum (see finsCsum.h) of the bytes of pdu, summed while
+ * they were copied in, csumValid is 0 when there is none. A layer pushing or
+ * pulling a header uses it first, then clears csumValid */
+unsigned int csum;
+unsigned char csumValid;
 
 };
 
@@ -96,6 +110,26 @@ struct tableRecord *replyRecord;
 };
 
 
+#ifdef FINS_FRAME_TRACKING
+/** debug bookkeeping of a live frame, see fins_frame_leak_report */
+struct finsFrameTrack
+{
+struct finsFrame *prev;
+struct finsFrame *next;
+long born;				/** seconds (CLOCK_MONOTONIC) */
+long lastTouch;
+const char *lastQueue;	/** name of the last queue the frame went through */
+int lastOp;				/** FINS_TRACK_WRITE or FINS_TRACK_READ */
+};
+#define FINS_TRACK_WRITE 0
+#define FINS_TRACK_READ 1
+#endif
+
+/** Ownership: whoever holds a frame pointer owns one reference to the frame.
+ * write_queue hands the reference over to the queue's consumer (only when it
+ * succeeds), freeFinsFrame drops it. A data frame in turn owns one reference
+ * to its metadata and one to its buffer
+ */
 struct finsFrame
 {
 
@@ -108,6 +142,11 @@ struct finsDataFrame dataFrame;
 struct finsCtrlFrame ctrlFrame;
 };
 
+int refCount;	/** see holdFinsFrame/freeFinsFrame */
+#ifdef FINS_FRAME_TRACKING
+struct finsFrameTrack track;
+#endif
+
 };
 
 
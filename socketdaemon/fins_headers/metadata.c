@@ -47,12 +47,105 @@ return 1;
 */
 
 
+/** legacy key -> typed slot, several keys are synonyms of the same slot */
+static const struct
+{
+	const char *name;
+	int slot;
+} metadata_keys[] =
+{
+	{ "ipsrc", META_SLOT_SRCIP },
+	{ "srcip", META_SLOT_SRCIP },
+	{ "ipdst", META_SLOT_DSTIP },
+	{ "dstip", META_SLOT_DSTIP },
+	{ "portsrc", META_SLOT_SRCPORT },
+	{ "srcport", META_SLOT_SRCPORT },
+	{ "portdst", META_SLOT_DSTPORT },
+	{ "dstport", META_SLOT_DSTPORT },
+	{ "protocol", META_SLOT_PROTOCOL },
+	{ "ttl", META_SLOT_TTL },
+	{ "interface", META_SLOT_INTERFACE },
+	{ "timestamp", META_SLOT_TIMESTAMP },
+	{ "socketindex", META_SLOT_SOCKETINDEX },
+};
+
+#define METADATA_NUM_KEYS (sizeof(metadata_keys) / sizeof(metadata_keys[0]))
+
+/** @return the slot of a well-known key, -1 for an overflow key */
+static int metadata_slot(const char *target)
+{
+	unsigned int i;
+
+	for (i = 0; i < METADATA_NUM_KEYS; i++)
+		if (strcmp(metadata_keys[i].name, target) == 0)
+			return (metadata_keys[i].slot);
+	return (-1);
+
+}
+
+/** the old libconfig API worked on int, well-known slots are read and
+ * written as int through it */
+static int metadata_getSlot(metadata *mptr, int slot)
+{
+
+	switch (slot)
+	{
+	case META_SLOT_SRCIP:		return ((int) mptr->srcip);
+	case META_SLOT_DSTIP:		return ((int) mptr->dstip);
+	case META_SLOT_SRCPORT:		return (mptr->srcport);
+	case META_SLOT_DSTPORT:		return (mptr->dstport);
+	case META_SLOT_PROTOCOL:	return (mptr->protocol);
+	case META_SLOT_TTL:			return (mptr->ttl);
+	case META_SLOT_INTERFACE:	return (mptr->interface);
+	case META_SLOT_TIMESTAMP:	return ((int) mptr->timestamp);
+	case META_SLOT_SOCKETINDEX:	return (mptr->socketindex);
+	}
+	return (0);
+
+}
+
+static void metadata_setSlot(metadata *mptr, int slot, int value)
+{
+
+	switch (slot)
+	{
+	case META_SLOT_SRCIP:		metadata_set_srcip(mptr, value); break;
+	case META_SLOT_DSTIP:		metadata_set_dstip(mptr, value); break;
+	case META_SLOT_SRCPORT:		metadata_set_srcport(mptr, value); break;
+	case META_SLOT_DSTPORT:		metadata_set_dstport(mptr, value); break;
+	case META_SLOT_PROTOCOL:	metadata_set_protocol(mptr, value); break;
+	case META_SLOT_TTL:			metadata_set_ttl(mptr, value); break;
+	case META_SLOT_INTERFACE:	metadata_set_interface(mptr, value); break;
+	case META_SLOT_TIMESTAMP:	metadata_set_timestamp(mptr, (uint32_t) value); break;
+	case META_SLOT_SOCKETINDEX:	metadata_set_socketindex(mptr, value); break;
+	}
+
+}
+
+/** @return the overflow tree, created on first use */
+static config_t *metadata_overflow(metadata *mptr)
+{
+
+	if (mptr->overflow == NULL)
+	{
+		mptr->overflow = (config_t *) malloc(sizeof(config_t));
+		if (mptr->overflow == NULL)
+		{
+			PRINT_DEBUG("metadata overflow allocation failed");
+			exit(1);
+		}
+		config_init(mptr->overflow);
+	}
+	return (mptr->overflow);
+
+}
+
+
 void metadata_create(metadata *mptr)
 {
 
-PRINT_DEBUG();
-config_init(mptr);
-PRINT_DEBUG();
+	/** refCount is (re)set by allocMetadata, a bare metadata is not counted */
+	memset(mptr, 0, sizeof(metadata));
 
 return;
 
@@ -62,14 +155,72 @@ return;
 void metadata_destroy(metadata *metadata)
 {
 
-config_destroy(metadata);
+	if (metadata->overflow != NULL)
+	{
+		config_destroy(metadata->overflow);
+		free(metadata->overflow);
+		metadata->overflow = NULL;
+	}
+	metadata->present = 0;
+
+
+}
+
+
+/** @function copies every element of src into dst, which must be freshly
+ * created. The overflow tree, if any, is duplicated element by element
+ */
+void metadata_copy(metadata *dst, metadata *src)
+{
+
+	metadata_element *root, *handle;
+	int howManySettings;
+	int i;
+	int value;
 
+	dst->present = src->present;
+	dst->srcip = src->srcip;
+	dst->dstip = src->dstip;
+	dst->srcport = src->srcport;
+	dst->dstport = src->dstport;
+	dst->protocol = src->protocol;
+	dst->ttl = src->ttl;
+	dst->interface = src->interface;
+	dst->socketindex = src->socketindex;
+	dst->timestamp = src->timestamp;
+
+	if (src->overflow == NULL)
+		return;
+
+	root = config_root_setting(src->overflow);
+	howManySettings = config_setting_length(root);
+	for (i = 0; i < howManySettings; i++)
+	{
+		handle = config_setting_get_elem(root, i);
+		switch (config_setting_type(handle))
+		{
+		case CONFIG_TYPE_INT:
+			value = config_setting_get_int(handle);
+			metadata_writeToElement(dst, (char *) config_setting_name(handle), &value,
+					META_TYPE_INT);
+			break;
+		case CONFIG_TYPE_STRING:
+			metadata_writeToElement(dst, (char *) config_setting_name(handle),
+					(void *) config_setting_get_string(handle), META_TYPE_STRING);
+			break;
+		default:
+			PRINT_DEBUG(" wrong type found\n");
+			break;
+		}
+	}
 
 }
 
 
 /** @function read the value of a metaData element
  * returns the reading status FALSE/ TRUE
+ * A well-known element is returned as an int, whatever its slot type,
+ * the typed metadata_get_<field> accessors should be preferred
  */
 
 int metadata_readFromElement(metadata *cfgptr,const char *target, void *value)
@@ -78,8 +229,26 @@ int metadata_readFromElement(metadata *cfgptr,const char *target, void *value)
 
 metadata_element *root,*handle;
 int status;
+int slot = metadata_slot(target);
+
+if (slot >= 0)
+	{
+	if (!(cfgptr->present & (1u << slot)))
+		{
+		PRINT_DEBUG("%s is not found in the metadata", target);
+		return (CONFIG_FALSE);
+		}
+	*(int *)value = metadata_getSlot(cfgptr, slot);
+	return (CONFIG_TRUE);
+	}
+
+if (cfgptr->overflow == NULL)
+	{
+	PRINT_DEBUG("%s is not found in the metadata", target);
+	return (CONFIG_FALSE);
+	}
 
-root=config_root_setting(cfgptr);
+root=config_root_setting(cfgptr->overflow);
 handle = config_setting_get_member(root,target);
 if (handle == NULL)
 	{
@@ -114,6 +283,7 @@ return (status);
 /** @function set a value of metadata element that might exist or not exist
  * if it does not exist, it creates the element and set its value
  * if it already exists , it sets its value only
+ * A well-known element only takes META_TYPE_INT, value points to an int
  */
 int metadata_writeToElement(metadata *cfgptr,char *target, void *value, int type)
 {
@@ -121,7 +291,20 @@ int metadata_writeToElement(metadata *cfgptr,char *target, void *value, int type
 
 int status;
 metadata_element *root, *handle;
-root = config_root_setting(cfgptr);
+int slot = metadata_slot(target);
+
+if (slot >= 0)
+	{
+	if (type != CONFIG_TYPE_INT)
+		{
+		PRINT_DEBUG("%s only takes an int", target);
+		return (CONFIG_FALSE);
+		}
+	metadata_setSlot(cfgptr, slot, *(int *)value);
+	return (CONFIG_TRUE);
+	}
+
+root = config_root_setting(metadata_overflow(cfgptr));
 
 switch (type)
 			{
@@ -160,6 +343,7 @@ return (status);
 
 /** @function set the value of a MetaData element which is already
  * exist. If it is not found it returns an Error False Status
+ * Only overflow elements (see metadata_addElement) have a metadata_element
  */
 
 int metadata_setElement(metadata_element *element, void *value)
@@ -191,12 +375,19 @@ return (status);
 /** @function add a new metadata element to a pre-existing metadata
  * structure but doesn't set any value for that element
  * it returns a pointer to that new added element
+ * Well-known elements have no metadata_element, NULL is returned for them
  */
 
 metadata_element *metadata_addElement(metadata *cfgptr,char *elementName, int type)
 {
 metadata_element *root;
-root= config_root_setting(cfgptr);
+
+if (metadata_slot(elementName) >= 0)
+	{
+	PRINT_DEBUG("%s is a fixed slot, use metadata_writeToElement", elementName);
+	return (NULL);
+	}
+root= config_root_setting(metadata_overflow(cfgptr));
 return (config_setting_add(root,elementName, type));
 
 }
@@ -214,12 +405,29 @@ int metadata_print(metadata *cfgptr)
 	metadata_element *root,*handle;
 	int howManySettings;
 	int i=0;
+	int printed=0;
 	int type;
 	int value;
-	char *stringValue;
-	char *name;
+	const char *stringValue;
+	const char *name;
+	unsigned int k;
 
-	root=config_root_setting(cfgptr);
+	/** the first name of each slot in metadata_keys is its canonical one */
+	for (i=0; i< META_NUM_SLOTS; i++)
+	{
+		if (!(cfgptr->present & (1u << i)))
+			continue;
+		for (k = 0; metadata_keys[k].slot != i; k++)
+			;
+		PRINT_DEBUG("\n%s \\",metadata_keys[k].name);
+		PRINT_DEBUG("%d",metadata_getSlot(cfgptr, i));
+		printed++;
+	}
+
+	if (cfgptr->overflow == NULL)
+		return (printed);
+
+	root=config_root_setting(cfgptr->overflow);
 	howManySettings= config_setting_length(root);
 
 	for (i=0; i< howManySettings; i++)
@@ -250,7 +458,7 @@ int metadata_print(metadata *cfgptr)
 	}
 
 
-return(i);
+return(printed + i);
 }
 
 
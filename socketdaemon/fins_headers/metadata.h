@@ -3,6 +3,9 @@
 *
 * @date Aug 2, 2010
 * @version 1
+* @version 2 "Oct 17, 2026" the well-known fields live in typed slots of a
+* fixed record, only the other (experimental) keys still go through a
+* libconfig tree which is created the first time one of them is written
 * @author Abdallah Abdallah
 */
 
@@ -12,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "libconfig.h"
 #include <finsdebug.h>
 
@@ -24,15 +28,80 @@
 #define META_FALSE CONFIG_FALSE
 
 
-typedef config_t metadata;
+/** The well-known fields. Keys that are synonyms in the tree ("ipsrc" and
+ * "srcip", "portdst" and "dstport", ...) share one slot
+ */
+enum metadata_slot
+{
+	META_SLOT_SRCIP = 0,
+	META_SLOT_DSTIP,
+	META_SLOT_SRCPORT,
+	META_SLOT_DSTPORT,
+	META_SLOT_PROTOCOL,
+	META_SLOT_TTL,
+	META_SLOT_INTERFACE,
+	META_SLOT_TIMESTAMP,
+	META_SLOT_SOCKETINDEX,
+	META_NUM_SLOTS
+};
+
+typedef struct metadata
+{
+	uint32_t present;	/** bit (1 << slot) set once the slot has been written */
+
+	uint32_t srcip;
+	uint32_t dstip;
+	uint16_t srcport;
+	uint16_t dstport;
+	uint16_t protocol;
+	uint8_t ttl;
+	int32_t interface;
+	int32_t socketindex;
+	uint64_t timestamp;
+
+	config_t *overflow;	/** any other key, NULL until one is written */
+
+	int refCount;	/** frames sharing this metadata, see allocMetadata/holdMetadata */
+} metadata;
+
 typedef config_setting_t metadata_element;
 
 
+/** Typed accessors for the well-known fields, metadata_set_<field>(meta, value)
+ * and metadata_get_<field>(meta, &value). The getters return META_FALSE and
+ * leave value untouched when the field was never set, like
+ * metadata_readFromElement does
+ */
+#define METADATA_FIELD(field, type, slot) \
+static inline void metadata_set_##field(metadata *meta, type value) \
+{ \
+	meta->field = value; \
+	meta->present |= 1u << (slot); \
+} \
+static inline int metadata_get_##field(metadata *meta, type *value) \
+{ \
+	if (!(meta->present & (1u << (slot)))) \
+		return (META_FALSE); \
+	*value = meta->field; \
+	return (META_TRUE); \
+}
+
+METADATA_FIELD(srcip, uint32_t, META_SLOT_SRCIP)
+METADATA_FIELD(dstip, uint32_t, META_SLOT_DSTIP)
+METADATA_FIELD(srcport, uint16_t, META_SLOT_SRCPORT)
+METADATA_FIELD(dstport, uint16_t, META_SLOT_DSTPORT)
+METADATA_FIELD(protocol, uint16_t, META_SLOT_PROTOCOL)
+METADATA_FIELD(ttl, uint8_t, META_SLOT_TTL)
+METADATA_FIELD(interface, int32_t, META_SLOT_INTERFACE)
+METADATA_FIELD(socketindex, int32_t, META_SLOT_SOCKETINDEX)
+METADATA_FIELD(timestamp, uint64_t, META_SLOT_TIMESTAMP)
+
 
 void addSettings(metadata *cfgptr);
 void metadata_create(metadata *mptr);
 
 void metadata_destroy(metadata *metadata);
+void metadata_copy(metadata *dst, metadata *src);
 
 
 int metadata_readFromElement(metadata *cfgptr,const char *target, void *value);
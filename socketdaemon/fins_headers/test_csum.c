@@ -0,0 +1,220 @@
+/**@file test_csum.c
+ *@brief tests the checksum kernels of finsCsum.c against fins_csum_scalar
+ * and a plain RFC 1071 sum
+ *
+ * Built on its own: it includes finsCsum.c to reach the kernels, which are
+ * static there. Every kernel the processor has is run over random lengths of
+ * 0 to 2048 bytes at any alignment, summing only and summing while copying,
+ * then the partial sums of consecutive blocks are added at odd and even
+ * offsets and header checksums updated with fins_csum_update16/32
+ *@date Oct 17, 2026
+ */
+#include "finsCsum.c"
+
+#define TEST_ROUNDS	20000	/**<buffers summed by each kernel*/
+#define TEST_LENGTH	2048	/**<the longest buffer*/
+#define TEST_ALIGN	64	/**<the starts of the buffers are anywhere in this many bytes*/
+#define TEST_GUARD	0xa5	/**<the bytes around a copy, which it must leave*/
+
+static unsigned int failures;
+
+struct test_kernel
+{
+	const char *name;
+	fins_csum_kernel kernel;
+};
+
+static void test_fail(const char *what, const char *kernel, unsigned int len, unsigned int offset)
+{
+	printf("FAIL %s: %s, %u bytes at offset %u\n", what, kernel, len, offset);
+	failures++;
+}
+
+/**
+ * @brief RFC 1071 one word after the other, the words as they are in memory
+ * @return the partial sum folded into 16 bits
+ */
+static uint16_t reference_sum(const unsigned char *buf, unsigned int len, uint32_t sum)
+{
+	uint64_t total = (sum & 0xffff) + (sum >> 16);
+	uint16_t word;
+	unsigned int i;
+
+	for (i = 0; i + 1 < len; i += 2)
+	{
+		memcpy(&word, buf + i, 2);
+		total += word;
+	}
+	if (len & 1)
+	{
+		word = 0;
+		memcpy(&word, buf + len - 1, 1);
+		total += word;
+	}
+	while (total >> 16)
+		total = (total & 0xffff) + (total >> 16);
+	return ((uint16_t) total);
+}
+
+/** @return the partial sum folded into 16 bits, as reference_sum gives it */
+static uint16_t test_fold(uint32_t sum)
+{
+	return ((uint16_t) ~fins_csum_fold(sum));
+}
+
+static void test_kernels()
+{
+	struct test_kernel kernels[3];
+	unsigned int kernel_count = 0;
+	unsigned char src[TEST_LENGTH + TEST_ALIGN];
+	unsigned char dst[TEST_LENGTH + 2 * TEST_ALIGN];
+	unsigned int round;
+	unsigned int len;
+	unsigned int offset;
+	unsigned int dst_offset;
+	unsigned int i;
+	unsigned int k;
+	uint32_t sum;
+	uint16_t expected;
+
+	kernels[kernel_count].name = "scalar";
+	kernels[kernel_count++].kernel = fins_csum_scalar;
+#ifdef FINS_CSUM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+	{
+		kernels[kernel_count].name = "sse2";
+		kernels[kernel_count++].kernel = fins_csum_sse2;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		kernels[kernel_count].name = "avx2";
+		kernels[kernel_count++].kernel = fins_csum_avx2;
+	}
+#endif
+	for (k = 0; k < kernel_count; k++)
+		printf("kernel %s\n", kernels[k].name);
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		/** every length up to the vector widths, then any */
+		len = (round < 4 * TEST_ALIGN) ? round / 4 : (unsigned int) rand() % (TEST_LENGTH + 1);
+		offset = rand() % TEST_ALIGN;
+		dst_offset = rand() % TEST_ALIGN;
+		/** all ones some of the time, the sums then carry the most */
+		for (i = 0; i < sizeof(src); i++)
+			src[i] = (round % 8 == 0) ? 0xff : rand();
+		sum = (round % 3 == 0) ? 0 : ((uint32_t) rand() << 16) ^ rand();
+		expected = reference_sum(src + offset, len, sum);
+
+		for (k = 0; k < kernel_count; k++)
+		{
+			if (test_fold(fins_csum_fold64(kernels[k].kernel(NULL, src + offset, len, sum))) != expected)
+				test_fail("sum", kernels[k].name, len, offset);
+
+			memset(dst, TEST_GUARD, sizeof(dst));
+			if (test_fold(fins_csum_fold64(kernels[k].kernel(dst + dst_offset, src + offset, len, sum)))
+					!= expected)
+				test_fail("sum of a copy", kernels[k].name, len, offset);
+			if (memcmp(dst + dst_offset, src + offset, len) != 0)
+				test_fail("copy", kernels[k].name, len, offset);
+			for (i = 0; i < sizeof(dst); i++)
+				if ((i < dst_offset || i >= dst_offset + len) && dst[i] != TEST_GUARD)
+				{
+					test_fail("bytes around a copy", kernels[k].name, len, offset);
+					break;
+				}
+		}
+
+		/** the kernel picked for the process */
+		if (test_fold(fins_csum_partial(src + offset, len, sum)) != expected)
+			test_fail("fins_csum_partial", fins_csum_kernel_name(), len, offset);
+		if (test_fold(fins_csum_copy(dst + dst_offset, src + offset, len, sum)) != expected
+				|| memcmp(dst + dst_offset, src + offset, len) != 0)
+			test_fail("fins_csum_copy", fins_csum_kernel_name(), len, offset);
+	}
+}
+
+/**
+ * @brief the sum of a buffer cut in two blocks anywhere, odd offsets
+ * included, is the sum of the blocks added with fins_csum_block_add
+ */
+static void test_block_add()
+{
+	unsigned char buf[TEST_LENGTH];
+	unsigned int round;
+	unsigned int len;
+	unsigned int cut;
+	unsigned int i;
+	uint32_t sum;
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		len = rand() % (TEST_LENGTH + 1);
+		cut = (len == 0) ? 0 : rand() % (len + 1);
+		for (i = 0; i < len; i++)
+			buf[i] = rand();
+		sum = fins_csum_block_add(fins_csum_partial(buf, cut, 0),
+				fins_csum_partial(buf + cut, len - cut, 0), cut);
+		if (test_fold(sum) != reference_sum(buf, len, 0))
+			test_fail("fins_csum_block_add", fins_csum_kernel_name(), len, cut);
+	}
+}
+
+/**
+ * @brief a header whose 16 or 32 bits field changed, with its checksum
+ * updated, sums to 0 as if it had been summed again
+ */
+static void test_update()
+{
+	uint16_t header[10];	/** an IPv4 header, the checksum in header[5] */
+	unsigned int round;
+	unsigned int field;
+	unsigned int i;
+	uint16_t old16;
+	uint16_t new16;
+	uint32_t old32;
+	uint32_t new32;
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		for (i = 0; i < 10; i++)
+			header[i] = (round % 8 == 0) ? 0xffff : rand();
+		header[5] = 0;
+		header[5] = fins_csum(header, sizeof(header));
+		if (fins_csum(header, sizeof(header)) != 0)
+			test_fail("fins_csum", fins_csum_kernel_name(), sizeof(header), 0);
+
+		/** any field but the checksum (the ttl, the id, ...) */
+		field = rand() % 9;
+		if (field >= 5)
+			field++;
+		old16 = header[field];
+		new16 = (round % 4 == 0) ? (uint16_t) ~old16 : rand();
+		header[field] = new16;
+		header[5] = fins_csum_update16(header[5], old16, new16);
+		if (fins_csum(header, sizeof(header)) != 0)
+			test_fail("fins_csum_update16", fins_csum_kernel_name(), sizeof(header), field * 2);
+
+		/** the source or the destination address */
+		field = (rand() % 2) ? 6 : 8;
+		memcpy(&old32, &header[field], 4);
+		new32 = (round % 4 == 0) ? ~old32 : ((uint32_t) rand() << 16) ^ rand();
+		memcpy(&header[field], &new32, 4);
+		header[5] = fins_csum_update32(header[5], old32, new32);
+		if (fins_csum(header, sizeof(header)) != 0)
+			test_fail("fins_csum_update32", fins_csum_kernel_name(), sizeof(header), field * 2);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	test_kernels();
+	test_block_add();
+	test_update();
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return (failures ? 1 : 0);
+}
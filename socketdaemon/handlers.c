@@ -10,6 +10,7 @@
  */
 
 #include "handlers.h"
+#include <finsCsum.h>
 
 
 
@@ -19,13 +20,15 @@ extern  struct socketIdentifier FinsHistory[MAX_sockets];
 
 extern finsQueue Jinni_to_Switch_Queue;
 extern finsQueue Switch_to_Jinni_Queue;
-extern sem_t Jinni_to_Switch_Qsem;
-extern sem_t Switch_to_Jinni_Qsem;
 
 
-extern int socket_channel_desc;
-extern sem_t *meen_channel_semaphore1;
-extern sem_t *meen_channel_semaphore2;
+extern struct finsChannelControl *jinni_channel;
+extern struct finsSocketTable *jinni_sockets_table;
+extern pthread_rwlock_t jinniSockets_lock;
+extern pthread_mutex_t jinni_reply_lock[FINS_CHANNEL_MAX_CLIENTS];
+extern __thread uint32_t jinni_request_id;
+extern __thread int jinni_request_async;
+extern __thread int jinni_request_error;
 
 
 
@@ -99,51 +102,116 @@ int insertjinniSocket(pid_t processID, int sockfd,int fakeID,int type,int protoc
 				jinniSockets[i].type = type;
 
 				jinniSockets[i].protocol = protocol;
-				jinniSockets[i].dataQueue = init_queue(NULL,MAX_Queue_size);
-				sem_init(&jinniSockets[i].Qs,0,1);
+				jinniSockets[i].hostport = 0;
+				jinniSockets[i].dstport = 0;
+				jinniSockets[i].host_IP = 0;
+				jinniSockets[i].dst_IP = 0;
+				jinniSockets[i].error = 0;
+				jinniSockets[i].errors = 0;
+				/** the queue and its semaphore outlive the sockets of the
+				 * entry, see removejinniSocket */
+				if (jinniSockets[i].dataQueue == NULL)
+				{
+					jinniSockets[i].dataQueue = init_queue(NULL,MAX_Queue_size);
+					sem_init(&jinniSockets[i].Qs,0,1);
+				}
+				jinniSockets[i].waiters = NULL;
+				jinniSockets[i].ready = 0;
 
 sprintf(jinniSockets[i].name,"socket# %d.%d.%d", jinniSockets[i].processid,jinniSockets[i].sockfd,jinniSockets[i].jinniside_pipe_ds);
-sprintf(jinniSockets[i].semaphore_name,"socket%d_%d", jinniSockets[i].processid,jinniSockets[i].fakeID);
-sprintf(jinniSockets[i].asemaphore_name,"socket%d_%da", jinniSockets[i].processid,jinniSockets[i].fakeID);
+				jinni_socket_publish(i);
 
+				return(1);
+				}
+			}
+		PRINT_DEBUG("reached maximum # of processes to be served, FINS is out of sockets");
+		return(-1);
+}
 
+/**
+ * @brief publishes jinniSockets[index] to the clients (see finsChannel.h) after
+ * it changed. Called with jinniSockets_lock held for writing
+ */
+void jinni_socket_publish(int index)
+{
+	struct finsSocketEntry entry;
 
-/** TODO enable the internal semaphore */
+	memset(&entry,0,sizeof(entry));
+	if (jinniSockets[index].processid != -1)
+	{
+		entry.Pid = jinniSockets[index].processid;
+		entry.Fd = jinniSockets[index].sockfd;
+		entry.Type = jinniSockets[index].type;
+		entry.Protocol = jinniSockets[index].protocol;
+		/** the ports are kept in host order, the addresses in network order */
+		entry.HostPort = htons(jinniSockets[index].hostport);
+		entry.DstPort = htons(jinniSockets[index].dstport);
+		entry.HostIP = jinniSockets[index].host_IP;
+		entry.DstIP = jinniSockets[index].dst_IP;
+		entry.Error = jinniSockets[index].error;
+		entry.Errors = jinniSockets[index].errors;
+	}
+	fins_sockets_publish(jinni_sockets_table,index,&entry);
 
-		errno = 0;
-		/** the semaphore is initially unlocked */
-		jinniSockets[i].s  = sem_open(jinniSockets[i].semaphore_name,O_CREAT|O_EXCL,0644,1);
-		jinniSockets[i].as = sem_open(jinniSockets[i].asemaphore_name,O_CREAT|O_EXCL,0644,0);
-	//	jinniSockets[i].s  = sem_open(jinniSockets[i].semaphore_name,O_CREAT,0644,1);
-	//	jinniSockets[i].as = sem_open(jinniSockets[i].asemaphore_name,O_CREAT,0644,0);
-		PRINT_DEBUG("%s, %s",jinniSockets[i].semaphore_name, jinniSockets[i].asemaphore_name );
-		PRINT_DEBUG("errno is %d", errno);
+}
 
-				if (jinniSockets[i].s == SEM_FAILED || jinniSockets[i].as == SEM_FAILED)
-						{
-							jinniSockets[i].s  = sem_open(jinniSockets[i].semaphore_name,0);
-							jinniSockets[i].as = sem_open(jinniSockets[i].asemaphore_name,0);
-							PRINT_DEBUG();
+/**
+ * @brief ends the asynchronous request the calling thread handled on the
+ * socket index: its failure becomes the pending error of the socket, which
+ * the client reads from the socket table, and the client gets its credit back
+ */
+void jinni_async_complete(int senderid,int index)
+{
 
-						}
-		PRINT_DEBUG("errno is %d", errno);
-				if (jinniSockets[i].s == SEM_FAILED || jinniSockets[i].as == SEM_FAILED )
-						{
-							PRINT_DEBUG("");
-							sem_unlink(jinniSockets[i].semaphore_name );
-							exit(1);
+	if (jinni_request_error != 0)
+	{
+		pthread_rwlock_wrlock(&jinniSockets_lock);
+		jinniSockets[index].error = jinni_request_error;
+		jinniSockets[index].errors++;
+		jinni_socket_publish(index);
+		pthread_rwlock_unlock(&jinniSockets_lock);
+	}
+	fins_channel_complete(jinni_channel,senderid);
 
-						}
-				return(1);
-				}
-			}
-		PRINT_DEBUG("reached maximum # of processes to be served, FINS is out of sockets");
-		return(-1);
 }
 
+/**
+ * @brief keeps the pipe of the socket index readable exactly while its
+ * dataQueue holds frames: the client's descriptor is the other end of the
+ * pipe, so poll, select and epoll on it tell whether a receive would block.
+ * Called with Qs of the socket held, after the queue changed
+ */
+void jinni_socket_readiness(int index)
+{
+	char token = 0;
+	int ready = !checkEmpty(jinniSockets[index].dataQueue);
+
+	if (ready == jinniSockets[index].ready)
+		return;
+	if (ready)
+	{
+		if (write(jinniSockets[index].jinniside_pipe_ds,&token,1) != 1)
+			PRINT_DEBUG("socket %d readiness not signalled, errno %d",index,errno);
+	}
+	else
+	{
+		if (read(jinniSockets[index].jinniside_pipe_ds,&token,1) != 1)
+			PRINT_DEBUG("socket %d readiness not cleared, errno %d",index,errno);
+	}
+	jinniSockets[index].ready = ready;
+
+}
+
+static int reply_begin( int processid, uint32_t requestid, int status, struct finsChannelWriter *reply,
+		unsigned int len);
+static void reply_commit( int client, struct finsChannelWriter *reply);
+
 /**
  * @brief remove a jinni socket from
- * the jinni sockets array
+ * the jinni sockets array, once the client closed it. The frames still queued
+ * go back to their pools and the calls parked on the socket fail with EBADF.
+ * The queue and Qs are kept for the next socket of the entry: the receive
+ * paths only touch them with jinniSockets_lock held for reading
  * @param
  * @return value of 1 on success , -1 on failure
  */
@@ -152,21 +220,55 @@ int removejinniSocket(pid_t target1, int target2)
 {
 
 	int i=0;
-	for (i=0; i<MAX_sockets;i++)
-		{if ( (jinniSockets[i].processid == target1) && (jinniSockets[i].sockfd == target2))
-			{jinniSockets[i].processid = -1;
-			jinniSockets[i].sockfd = -1;
-			term_queue(jinniSockets[i].dataQueue);
-			sem_close(jinniSockets[i].s);
-			sem_unlink(jinniSockets[i].semaphore_name);
-			sem_close(jinniSockets[i].as);
-			sem_unlink(jinniSockets[i].asemaphore_name);
-			sprintf(jinniSockets[i].semaphore_name,"NULL");
-			return(1);
-
-			}
+	int error = EBADF;
+	int pipe_desc;
+	int client;
+	struct jinniWaiter *waiters;
+	struct jinniWaiter *waiter;
+	struct finsFrame *ff;
+	struct finsChannelWriter reply;
+
+	pthread_rwlock_wrlock(&jinniSockets_lock);
+	i = findjinniSocket(target1,target2);
+	if (i == -1)
+	{
+		pthread_rwlock_unlock(&jinniSockets_lock);
+		return(-1);
+	}
+	sem_wait(&(jinniSockets[i].Qs));
+		waiters = jinniSockets[i].waiters;
+		jinniSockets[i].waiters = NULL;
+		while ((ff = read_queue(jinniSockets[i].dataQueue)) != NULL)
+			freeFinsFrame(ff);
+		jinniSockets[i].ready = 0;
+	sem_post(&(jinniSockets[i].Qs));
+	jinniSockets[i].processid = -1;
+	jinniSockets[i].sockfd = -1;
+	jinniSockets[i].fakeID = -1;
+	/** no datagram may match the entry any more */
+	jinniSockets[i].hostport = 0;
+	jinniSockets[i].dstport = 0;
+	jinniSockets[i].host_IP = 0;
+	jinniSockets[i].dst_IP = 0;
+	pipe_desc = jinniSockets[i].jinniside_pipe_ds;
+	jinniSockets[i].jinniside_pipe_ds = -1;
+	jinni_socket_publish(i);
+	pthread_rwlock_unlock(&jinniSockets_lock);
+
+	close(pipe_desc);
+	while ((waiter = waiters) != NULL)
+	{
+		waiters = waiter->next;
+		client = reply_begin(waiter->senderid,waiter->requestid,NACK,&reply,sizeof(int));
+		if (client != -1)
+		{
+			fins_channel_put(&reply,&error,sizeof(int));
+			reply_commit(client,&reply);
 		}
-return(-1);
+		free(waiter);
+	}
+	return(1);
+
 } // end of removejinniSocket
 
 /**
@@ -209,42 +311,264 @@ int i=0;
  */
 
 
-int nack_write( int pipe_desc, int processid, int sockfd)
+/**
+ * @brief starts the response to the request requestid of the client processid,
+ * its header is written and len bytes are to follow. Several threads may answer
+ * the same client, the record is written under the reply lock of the client
+ * until reply_commit
+ * @return the slot of the client, -1 if the client is gone
+ */
+static int reply_begin( int processid, uint32_t requestid, int status, struct finsChannelWriter *reply,
+		unsigned int len)
+{
+	struct finsChannelHeader header;
+	int client;
+
+	client = fins_channel_find(jinni_channel,processid);
+	if (client == -1)
+	{
+		PRINT_DEBUG("process %d is no longer attached, reply dropped",processid);
+		return (-1);
+	}
+	pthread_mutex_lock(&jinni_reply_lock[client]);
+	if (fins_channel_reply(jinni_channel,client,reply,sizeof (struct finsChannelHeader) + len) == -1)
+	{
+		pthread_mutex_unlock(&jinni_reply_lock[client]);
+		PRINT_DEBUG("process %d is no longer attached, reply dropped",processid);
+		return (-1);
+	}
+	header.Version = FINS_CHANNEL_VERSION;
+	header.Code = status;
+	header.Id = requestid;
+	header.Pid = processid;
+	fins_channel_put(reply,&header,sizeof (struct finsChannelHeader));
+	return (client);
+
+}
+
+static void reply_commit( int client, struct finsChannelWriter *reply)
 {
-	int byteswritten;
-	int nack =NACK;
-	int index;
 
-	/** TODO lock the pipe before writing */
+	fins_channel_commit(reply);
+	pthread_mutex_unlock(&jinni_reply_lock[client]);
+
+}
 
-	write(pipe_desc,&processid,sizeof(int));
-	write(pipe_desc,&sockfd,sizeof(int));
-	write(pipe_desc,&nack,sizeof(int));
-	/**TODO unlock the pipe
-	 * check for failure of writing
-	 * return 1 on success -1 on failure
-	 * */
+/**
+ * @brief answers the request the calling thread is handling with a bare ACK
+ * or NACK
+ * @return 1 on success, -1 if the client is gone
+ */
+static int status_write( int processid, int status)
+{
+	struct finsChannelWriter reply;
+	int client;
 
+	if (jinni_request_async)
+	{
+		if (status != ACK)
+			jinni_request_error = EIO;
+		return (1);
+	}
+	client = reply_begin(processid,jinni_request_id,status,&reply,0);
+	if (client == -1)
+		return (-1);
+	reply_commit(client,&reply);
 
 	return (1);
 
+}
+
+int nack_write( int processid, int sockfd)
+{
+
+	PRINT_DEBUG("processid %d sockfd %d nack %d",processid, sockfd, NACK);
+	return (status_write(processid,NACK));
+
 } // end of nack_write
 
 
-int ack_write( int pipe_desc, int processid, int sockfd)
+/**
+ * @brief fails the request the calling thread is handling with error, an
+ * errno value the interceptor sets for the application
+ * @return 1 on success, -1 if the client is gone
+ */
+int error_write( int processid, int error)
+{
+	struct finsChannelWriter reply;
+	int client;
+
+	PRINT_DEBUG("processid %d error %d",processid, error);
+	if (jinni_request_async)
+	{
+		jinni_request_error = error;
+		return (1);
+	}
+	client = reply_begin(processid,jinni_request_id,NACK,&reply,sizeof(int));
+	if (client == -1)
+		return (-1);
+	fins_channel_put(&reply,&error,sizeof(int));
+	reply_commit(client,&reply);
+
+	return (1);
+
+}
+
+int ack_write( int processid, int sockfd)
 {
-	int byteswritten;
-	int ack =ACK;
-	/** TODO lock the pipe before writing */
-	PRINT_DEBUG("processid %d sockfd %d ack %d",processid, sockfd, ack);
-	write(pipe_desc,&processid,sizeof(int));
-	write(pipe_desc,&sockfd,sizeof(int));
-	write(pipe_desc,&ack,sizeof(int));
-	/**TODO unlock the pipe
-	 * check for failure of writing
-	 * return 1 on success -1 on failure
-	 * */
 
+	PRINT_DEBUG("processid %d sockfd %d ack %d",processid, sockfd, ACK);
+	return (status_write(processid,ACK));
+
+}
+
+/**
+ * @brief answers the request requestid with an ACK followed by received data:
+ * the source address if addr is not NULL, buflen and the buflen bytes of buf
+ * @return 1 on success, -1 if the client is gone
+ */
+int ack_write_data( int processid, uint32_t requestid, struct sockaddr_in *addr, u_char *buf, int buflen)
+{
+	struct finsChannelWriter reply;
+	int client;
+
+	client = reply_begin(processid,requestid,ACK,&reply,
+			sizeof(int) + sizeof(struct sockaddr_in) + buflen);
+	if (client == -1)
+		return (-1);
+	if (addr != NULL)
+		fins_channel_put(&reply,addr,sizeof(struct sockaddr_in));
+	fins_channel_put(&reply,&buflen,sizeof(int));
+	fins_channel_put(&reply,buf,buflen);
+	reply_commit(client,&reply);
+
+	return (1);
+
+}
+
+/**
+ * @brief answers the request the calling thread is handling with an ACK
+ * followed by count, the datagrams of a sendmmsg that were sent
+ * @return 1 on success, -1 if the client is gone
+ */
+int ack_write_count( int processid, int count)
+{
+	struct finsChannelWriter reply;
+	int client;
+
+	client = reply_begin(processid,jinni_request_id,ACK,&reply,sizeof(int));
+	if (client == -1)
+		return (-1);
+	fins_channel_put(&reply,&count,sizeof(int));
+	reply_commit(client,&reply);
+
+	return (1);
+
+}
+
+/**
+ * @brief answers the recvmmsg requestid with the n received datagrams of
+ * frames in one record: n, then for each datagram the source address, its
+ * length, the number of bytes that follow (the datagram truncated to the
+ * room datalens[i] of the client) and the bytes
+ * @return 1 on success, -1 if the client is gone
+ */
+int ack_write_batch( int processid, uint32_t requestid, struct finsFrame **frames, int *datalens, int n)
+{
+	struct finsChannelWriter reply;
+	struct sockaddr_in address;
+	unsigned int len;
+	int client;
+	int copied;
+	int length;
+	int i;
+
+	len = sizeof(int);
+	for (i = 0; i < n; i++)
+	{
+		copied = frames[i]->dataFrame.pduLength;
+		if (copied > datalens[i])
+			copied = datalens[i];
+		len += sizeof(struct sockaddr_in) + 2 * sizeof(int) + copied;
+	}
+
+	client = reply_begin(processid,requestid,ACK,&reply,len);
+	if (client == -1)
+		return (-1);
+	fins_channel_put(&reply,&n,sizeof(int));
+	for (i = 0; i < n; i++)
+	{
+		length = frames[i]->dataFrame.pduLength;
+		copied = (length > datalens[i]) ? datalens[i] : length;
+		recv_address(frames[i],&address);
+		fins_channel_put(&reply,&address,sizeof(struct sockaddr_in));
+		fins_channel_put(&reply,&length,sizeof(int));
+		fins_channel_put(&reply,&copied,sizeof(int));
+		fins_channel_put(&reply,frames[i]->dataFrame.pdu,copied);
+	}
+	reply_commit(client,&reply);
+
+	return (1);
+
+}
+
+/**
+ * @brief answers the zero copy receive requestid of processid with the pdu of
+ * df, lent in place: the response carries the channel buffer, the offset of
+ * the pdu in its Data and the length. A pdu that is not in a buffer of the pool
+ * (or whose buffer is lent already) is first copied into a free one. The client
+ * returns the buffer with fins_recv_release
+ * @return 1 on success, -1 if the client is gone or no buffer is free
+ */
+int ack_write_buffer( int processid, uint32_t requestid, struct finsDataFrame *df)
+{
+	struct finsChannelWriter reply;
+	int slot;
+	int client;
+	int buffer;
+	unsigned int offset;
+
+	slot = fins_channel_find(jinni_channel,processid);
+	if (slot == -1)
+	{
+		PRINT_DEBUG("process %d is no longer attached, reply dropped",processid);
+		return (-1);
+	}
+
+	buffer = (df->buff != NULL) ? df->buff->pool - 1 : -1;
+	if (buffer == -1 || fins_channel_buffer_lend(jinni_channel,buffer,slot) == -1)
+	{
+		buffer = -1;
+		if (df->pduLength <= FINS_CHANNEL_BUFFER_SIZE)
+			buffer = fins_channel_buffer_alloc(jinni_channel);
+		if (buffer == -1)
+		{
+			PRINT_DEBUG("no channel buffer for a pdu of %u bytes",df->pduLength);
+			client = reply_begin(processid,requestid,NACK,&reply,0);
+			if (client != -1)
+				reply_commit(client,&reply);
+			return (-1);
+		}
+		memcpy(jinni_channel->Buffers[buffer].Data,df->pdu,df->pduLength);
+		fins_channel_buffer_lend(jinni_channel,buffer,slot);
+		/** only the client's reference is left */
+		fins_channel_buffer_put(jinni_channel,buffer);
+		offset = 0;
+	}
+	else
+		offset = df->pdu - jinni_channel->Buffers[buffer].Data;
+
+	client = reply_begin(processid,requestid,ACK,&reply,3 * sizeof(int));
+	if (client == -1)
+	{
+		/** nobody is left to return it */
+		fins_channel_buffer_return(jinni_channel,buffer,slot);
+		return (-1);
+	}
+	fins_channel_put(&reply,&buffer,sizeof(int));
+	fins_channel_put(&reply,&offset,sizeof(int));
+	fins_channel_put(&reply,&df->pduLength,sizeof(int));
+	reply_commit(client,&reply);
 
 	return (1);
 
@@ -258,7 +582,7 @@ int ack_write( int pipe_desc, int processid, int sockfd)
 
 
 
-void socket_call_handler(pid_t senderProcessid)
+void socket_call_handler(pid_t senderProcessid,struct finsChannelReader *request)
 {
 	int numOfBytes = -1;
 	struct socket_call_msg msg;
@@ -267,8 +591,8 @@ void socket_call_handler(pid_t senderProcessid)
 	PRINT_DEBUG("%d",senderProcessid);
 	//sem_wait(meen_channel_semaphore);
 
-	numOfBytes = 	read(socket_channel_desc,&msg, sizeof (struct socket_call_msg) );
-	sem_post(meen_channel_semaphore2);
+	numOfBytes = 	fins_channel_get(request,&msg, sizeof (struct socket_call_msg) );
+	fins_channel_finish(request);
 
 			if ( (numOfBytes <= 0) || (numOfBytes != sizeof (struct socket_call_msg)) )
 			{
@@ -308,7 +632,7 @@ return;
  * End of socket_call_handler
  */
 
-void bind_call_handler(int senderid)
+void bind_call_handler(int senderid,struct finsChannelReader *request)
 {
 
 		int numOfBytes;
@@ -318,7 +642,7 @@ void bind_call_handler(int senderid)
 		struct sockaddr_in *addr;
 
 
-		numOfBytes = read(socket_channel_desc,&sockfd, sizeof (int) );
+		numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
 
 		if ( numOfBytes <= 0)
 			{
@@ -327,7 +651,7 @@ void bind_call_handler(int senderid)
 				exit(1);
 			}
 
-		numOfBytes = 	read(socket_channel_desc,&addrlen, sizeof (socklen_t) );
+		numOfBytes = 	fins_channel_get(request,&addrlen, sizeof (socklen_t) );
 
 		if ( numOfBytes <= 0)
 					{
@@ -338,8 +662,8 @@ void bind_call_handler(int senderid)
 
 		addr = (struct sockaddr_in *) malloc (addrlen);
 
-		numOfBytes =  read(socket_channel_desc,addr,addrlen  );
-		sem_post(meen_channel_semaphore2);
+		numOfBytes =  fins_channel_get(request,addr,addrlen  );
+		fins_channel_finish(request);
 		if ( numOfBytes <= 0)
 					{
 
@@ -351,9 +675,9 @@ void bind_call_handler(int senderid)
 		/** Unlock the main socket channel
 		 *
 		 */
-		/** TODO lock access to the jinnisockets */
+		pthread_rwlock_rdlock(&jinniSockets_lock);
 		index = findjinniSocket(senderid,sockfd);
-		/** TODO unlock access to the jinnisockets */
+		pthread_rwlock_unlock(&jinniSockets_lock);
 		/** if that requested socket does not exist !!
 		 * this means we can not even talk to the requester FINS crash as a response!!
 		 */
@@ -379,19 +703,42 @@ void bind_call_handler(int senderid)
  */
 
 
-void send_call_handler(int senderid)
+/**
+ * @brief reads the len bytes of the payload of a send from the request into
+ * data, summing them on the way (see finsCsum.h) for the UDP checksum
+ * @return the number of bytes read, the partial sum in *sum
+ */
+static int jinni_get_payload(struct finsChannelReader *request,u_char *data,unsigned int len,
+		uint32_t *sum)
+{
+	const void *src;
+	unsigned int got = 0;
+	int n;
+
+	*sum = 0;
+	/** the payload wraps around the end of the ring at most once */
+	while (got < len && (n = fins_channel_get_inplace(request,&src,len - got)) > 0)
+	{
+		*sum = fins_csum_block_add(*sum,fins_csum_copy(data + got,src,n,0),got);
+		got += n;
+	}
+	return (got);
+
+}
+
+void send_call_handler(int senderid,struct finsChannelReader *request)
 {
 
 		int numOfBytes;
 		int sockfd;
 		int index;
-		int datalen;
+		size_t datalen;
 		int flags;
 		u_char *data;
 
 
 
-		numOfBytes = read(socket_channel_desc,&sockfd, sizeof (int) );
+		numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
 
 		if ( numOfBytes <= 0)
 		{
@@ -401,7 +748,7 @@ void send_call_handler(int senderid)
 				}
 
 
-		numOfBytes = read(socket_channel_desc,&datalen, sizeof(size_t));
+		numOfBytes = fins_channel_get(request,&datalen, sizeof(size_t));
 		if ( numOfBytes <= 0)
 		{
 
@@ -409,14 +756,14 @@ void send_call_handler(int senderid)
 			exit(1);
 		}
 		data = (u_char *) malloc(datalen);
-		numOfBytes = read(socket_channel_desc,data, datalen);
+		numOfBytes = fins_channel_get(request,data, datalen);
 		if ( numOfBytes <= 0)
 		{
 
 			PRINT_DEBUG("READING ERROR! CRASH");
 			exit(1);
 		}
-		numOfBytes = read(socket_channel_desc,&flags, sizeof(int));
+		numOfBytes = fins_channel_get(request,&flags, sizeof(int));
 		if ( numOfBytes <= 0)
 		{
 
@@ -429,9 +776,9 @@ void send_call_handler(int senderid)
 /** Notice that send is only used with tcp connections since
  * the receiver is already known
  */
-/** TODO lock access to the jinnisockets */
+pthread_rwlock_rdlock(&jinniSockets_lock);
 index = findjinniSocket(senderid,sockfd);
-/** TODO unlock access to the jinnisockets */
+pthread_rwlock_unlock(&jinniSockets_lock);
 
 	if (index == -1)
 	{
@@ -442,7 +789,7 @@ index = findjinniSocket(senderid,sockfd);
 	if (jinniSockets[index].type != SOCK_STREAM)
 	{
 		PRINT_DEBUG("This socket is not SOCK_STREAM ! TYPE ERROR");
-		nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
+		nack_write(senderid,sockfd);
 	}
 
 	send_tcp(senderid,sockfd,datalen,data,flags);
@@ -455,22 +802,24 @@ index = findjinniSocket(senderid,sockfd);
 
 
 
-void sendto_call_handler(int senderid)
+void sendto_call_handler(int senderid,struct finsChannelReader *request)
 {
 
 			int numOfBytes;
 			int sockfd;
 			int index;
-			int datalen;
+			size_t datalen;
 			int flags;
 			u_char *data;
+			struct finsBuff *buff;
+			uint32_t sum;
 			socklen_t addrlen;
 			struct sockaddr *addr;
 
 
 			PRINT_DEBUG("");
 
-			numOfBytes = read(socket_channel_desc,&sockfd, sizeof (int) );
+			numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
 
 			if ( numOfBytes <= 0)
 			{
@@ -481,14 +830,14 @@ void sendto_call_handler(int senderid)
 
 			PRINT_DEBUG("");
 
-			numOfBytes = read(socket_channel_desc,&datalen, sizeof(size_t));
+			numOfBytes = fins_channel_get(request,&datalen, sizeof(size_t));
 			if ( numOfBytes <= 0)
 			{
 
 				PRINT_DEBUG("READING ERROR! CRASH");
 				exit(1);
 			}
-			PRINT_DEBUG("passed data len = %d",datalen);
+			PRINT_DEBUG("passed data len = %d",(int) datalen);
 			if (datalen <=0)
 			{
 				PRINT_DEBUG("DATA Field is empty!!");
@@ -496,10 +845,13 @@ void sendto_call_handler(int senderid)
 
 			}
 
-			data = (u_char *) malloc(datalen);
+			/** read the payload straight into a packet buffer, leaving room for
+			 * the UDP, IP and Ethernet headers in front of it */
+			buff = fins_buff_alloc(FINS_HEADROOM + datalen + FINS_TAILROOM);
+			data = buff->data + FINS_HEADROOM;
 			PRINT_DEBUG("");
 
-			numOfBytes = read(socket_channel_desc,data, datalen);
+			numOfBytes = jinni_get_payload(request,data, datalen,&sum);
 			if ( numOfBytes <= 0)
 			{
 
@@ -508,7 +860,7 @@ void sendto_call_handler(int senderid)
 			}
 			PRINT_DEBUG("");
 
-			numOfBytes = read(socket_channel_desc,&flags, sizeof(int));
+			numOfBytes = fins_channel_get(request,&flags, sizeof(int));
 			if ( numOfBytes <= 0)
 			{
 
@@ -517,7 +869,7 @@ void sendto_call_handler(int senderid)
 			}
 			PRINT_DEBUG("");
 
-			numOfBytes = read(socket_channel_desc,&addrlen, sizeof(socklen_t));
+			numOfBytes = fins_channel_get(request,&addrlen, sizeof(socklen_t));
 						if ( numOfBytes <= 0)
 						{
 
@@ -527,7 +879,7 @@ void sendto_call_handler(int senderid)
 						PRINT_DEBUG("");
 
 			addr = (struct sockaddr *)malloc(addrlen);
-			numOfBytes = read(socket_channel_desc,addr, addrlen);
+			numOfBytes = fins_channel_get(request,addr, addrlen);
 						if ( numOfBytes <= 0)
 						{
 
@@ -539,14 +891,14 @@ void sendto_call_handler(int senderid)
 	/** Unlock the main socket channel
 	 *
 	*/
-	sem_post(meen_channel_semaphore2);
+	fins_channel_finish(request);
 
 	PRINT_DEBUG("");
 
 
-	/** TODO lock access to the jinnisockets */
+	pthread_rwlock_rdlock(&jinniSockets_lock);
 		index = findjinniSocket(senderid,sockfd);
-/** TODO unlock access to the jinnisockets */
+	pthread_rwlock_unlock(&jinniSockets_lock);
 		PRINT_DEBUG("");
 
 	if (index == -1)
@@ -557,17 +909,16 @@ void sendto_call_handler(int senderid)
 	PRINT_DEBUG("");
 
 			if (jinniSockets[index].type == SOCK_DGRAM )
-				sendto_udp(senderid,sockfd,datalen,data,flags,addr,addrlen);
+				sendto_udp(senderid,sockfd,datalen,data,buff,sum,flags,addr,addrlen);
 			else if (jinniSockets[index].type == SOCK_STREAM )
 				sendto_tcp(senderid,sockfd,datalen,data,flags,addr,addrlen);
 			else
 					{
 				PRINT_DEBUG("unknown socket type has been read !!!");
-				sem_wait(jinniSockets[index].s);
-					nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-					sem_post(jinniSockets[index].as);
-				sem_post(jinniSockets[index].s);
+				nack_write(senderid,sockfd);
 					}
+			if (jinni_request_async)
+				jinni_async_complete(senderid,index);
 			PRINT_DEBUG();
 			return;
 
@@ -579,19 +930,19 @@ void sendto_call_handler(int senderid)
  * ------------------End of sendto_call_handler-----------------
  */
 
-void recv_call_handler(int senderid)
+void recv_call_handler(int senderid,struct finsChannelReader *request)
 {
 
 			int numOfBytes;
 			int sockfd;
 			int index;
-			int datalen;
+			size_t datalen;
 			int flags;
 			u_char *data;
 
 
 
-	numOfBytes = read(socket_channel_desc,&sockfd, sizeof (int) );
+	numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
 
 		if ( numOfBytes <= 0)
 			{
@@ -601,7 +952,7 @@ void recv_call_handler(int senderid)
 			}
 
 
-	numOfBytes = read(socket_channel_desc,&datalen, sizeof(size_t));
+	numOfBytes = fins_channel_get(request,&datalen, sizeof(size_t));
 			if ( numOfBytes <= 0)
 			{
 
@@ -609,7 +960,7 @@ void recv_call_handler(int senderid)
 				exit(1);
 			}
 
-	numOfBytes = read(socket_channel_desc,&flags, sizeof(int));
+	numOfBytes = fins_channel_get(request,&flags, sizeof(int));
 			if ( numOfBytes <= 0)
 			{
 
@@ -622,9 +973,9 @@ void recv_call_handler(int senderid)
 	/** Notice that send is only used with tcp connections since
 	 * the receiver is already known
 	 */
-	/** TODO lock access to the jinnisockets */
+	pthread_rwlock_rdlock(&jinniSockets_lock);
 	index = findjinniSocket(senderid,sockfd);
-	/** TODO unlock access to the jinnisockets */
+	pthread_rwlock_unlock(&jinniSockets_lock);
 
 		if (index == -1)
 		{
@@ -635,7 +986,7 @@ void recv_call_handler(int senderid)
 		if (jinniSockets[index].type != SOCK_STREAM)
 		{
 			PRINT_DEBUG("This socket is not SOCK_STREAM ! TYPE ERROR");
-			nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
+			nack_write(senderid,sockfd);
 		}
 
 		recv_tcp(senderid,sockfd,datalen,flags);
@@ -651,13 +1002,13 @@ void recv_call_handler(int senderid)
  */
 
 
-void recvfrom_call_handler(int senderid)
+void recvfrom_call_handler(int senderid,struct finsChannelReader *request)
 {
 
 			int numOfBytes;
 			int sockfd;
 			int index;
-			int datalen;
+			size_t datalen;
 			int flags;
 			int symbol;
 			u_char *data;
@@ -665,7 +1016,7 @@ void recvfrom_call_handler(int senderid)
 			struct sockaddr *addr;
 
 			PRINT_DEBUG();
-	numOfBytes = read(socket_channel_desc,&sockfd, sizeof (int) );
+	numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
 
 		if ( numOfBytes <= 0)
 			{
@@ -675,7 +1026,7 @@ void recvfrom_call_handler(int senderid)
 			}
 
 
-	numOfBytes = read(socket_channel_desc,&datalen, sizeof(size_t));
+	numOfBytes = fins_channel_get(request,&datalen, sizeof(size_t));
 			if ( numOfBytes <= 0)
 			{
 
@@ -683,7 +1034,7 @@ void recvfrom_call_handler(int senderid)
 				exit(1);
 			}
 
-	numOfBytes = read(socket_channel_desc,&flags, sizeof(int));
+	numOfBytes = fins_channel_get(request,&flags, sizeof(int));
 
 			if ( numOfBytes <= 0)
 			{
@@ -692,8 +1043,8 @@ void recvfrom_call_handler(int senderid)
 				exit(1);
 			}
 
-	numOfBytes = read(socket_channel_desc,&symbol, sizeof(int));
-	sem_post(meen_channel_semaphore2);
+	numOfBytes = fins_channel_get(request,&symbol, sizeof(int));
+	fins_channel_finish(request);
 
 						if ( numOfBytes <= 0)
 						{
@@ -708,9 +1059,9 @@ void recvfrom_call_handler(int senderid)
 	/** Notice that send is only used with tcp connections since
 	 * the receiver is already known
 	 */
-	/** TODO lock access to the jinnisockets */
+	pthread_rwlock_rdlock(&jinniSockets_lock);
 	index = findjinniSocket(senderid,sockfd);
-	/** TODO unlock access to the jinnisockets */
+	pthread_rwlock_unlock(&jinniSockets_lock);
 		if (index == -1)
 		{
 			PRINT_DEBUG("CRASH !!socket descriptor not found into jinni sockets");
@@ -735,10 +1086,7 @@ void recvfrom_call_handler(int senderid)
 		else
 		{
 			PRINT_DEBUG("This socket is of unknown type");
-			sem_wait(jinniSockets[index].s);
-			nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-				sem_post(jinniSockets[index].as);
-			sem_post(jinniSockets[index].s);
+			nack_write(senderid,sockfd);
 		}
 
 
@@ -803,13 +1151,219 @@ void	accept4_call_handler()
 
 }
 
-void	shutdown_call_handler()
+/**
+ * @brief the client closed the socket (see fins_shutdown in the interceptor),
+ * the jinni forgets it
+ */
+void	shutdown_call_handler(int senderid,struct finsChannelReader *request)
 {
 
+	int numOfBytes;
+	int sockfd;
+	int how;
+
+	numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
+	numOfBytes = (numOfBytes <= 0) ? numOfBytes : fins_channel_get(request,&how, sizeof(int));
+	fins_channel_finish(request);
+		if ( numOfBytes <= 0 )
+			{
+
+				PRINT_DEBUG("READING ERROR! CRASH");
+				exit(1);
+			}
 
+	PRINT_DEBUG("socket %d of %d shut down, how %d",sockfd,senderid,how);
+	if (removejinniSocket(senderid,sockfd) == -1)
+		error_write(senderid,EBADF);
+	else
+		ack_write(senderid,sockfd);
 
 }
 
+/**
+ * @brief sends a batch of datagrams from one request: the socket, the flags,
+ * the number of datagrams then for each one its address length, address,
+ * payload length and payload. The datagrams from the first one the jinni
+ * cannot send on are dropped, the client learns how many were sent
+ */
+void sendmmsg_call_handler(int senderid,struct finsChannelReader *request)
+{
+
+			struct jinniDatagram dgrams[FINS_CHANNEL_MAX_BATCH];
+			int numOfBytes;
+			int sockfd;
+			int index;
+			int flags;
+			int n;
+			int i;
+			size_t datalen;
+			socklen_t addrlen;
+
+	numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
+	numOfBytes = (numOfBytes <= 0) ? numOfBytes : fins_channel_get(request,&flags, sizeof(int));
+	numOfBytes = (numOfBytes <= 0) ? numOfBytes : fins_channel_get(request,&n, sizeof(int));
+		if ( numOfBytes <= 0 || n < 0 || n > FINS_CHANNEL_MAX_BATCH)
+			{
+
+				PRINT_DEBUG("READING ERROR! CRASH");
+				exit(1);
+			}
+
+	for (i = 0; i < n; i++)
+	{
+		if (fins_channel_get(request,&addrlen,sizeof(socklen_t)) != sizeof(socklen_t)
+				|| addrlen != sizeof(struct sockaddr_in))
+		{
+			PRINT_DEBUG("datagram %d has no IPv4 address, batch cut",i);
+			break;
+		}
+		fins_channel_get(request,&dgrams[i].addr,sizeof(struct sockaddr_in));
+		if (fins_channel_get(request,&datalen,sizeof(size_t)) != sizeof(size_t)
+				|| dgrams[i].addr.sin_family != AF_INET)
+		{
+			PRINT_DEBUG("datagram %d has no IPv4 address, batch cut",i);
+			break;
+		}
+		/** straight into a packet buffer, as sendto_call_handler */
+		dgrams[i].buff = fins_buff_alloc(FINS_HEADROOM + datalen + FINS_TAILROOM);
+		dgrams[i].data = dgrams[i].buff->data + FINS_HEADROOM;
+		dgrams[i].len = datalen;
+		if (jinni_get_payload(request,dgrams[i].data,datalen,&dgrams[i].sum) != (int) datalen)
+		{
+			PRINT_DEBUG("READING ERROR! CRASH");
+			exit(1);
+		}
+	}
+	n = i;
+	fins_channel_finish(request);
+
+	pthread_rwlock_rdlock(&jinniSockets_lock);
+	index = findjinniSocket(senderid,sockfd);
+	pthread_rwlock_unlock(&jinniSockets_lock);
+		if (index == -1)
+		{
+			PRINT_DEBUG("CRASH !!socket descriptor not found into jinni sockets");
+			exit(1);
+		}
+
+		if (jinniSockets[index].type == SOCK_DGRAM && n > 0)
+		{
+			sendmmsg_udp(senderid,sockfd,dgrams,n,flags);
+		}
+		else
+		{
+			PRINT_DEBUG("sendmmsg is only implemented for UDP sockets");
+			for (i = 0; i < n; i++)
+				fins_buff_release(dgrams[i].buff);
+			nack_write(senderid,sockfd);
+		}
+
+} // end of sendmmsg_call_handler()
+
+/**
+ * @brief receives a batch of datagrams in one response: the request holds the
+ * socket, the flags, the number of datagrams wanted and the room of the
+ * client for each one
+ */
+void recvmmsg_call_handler(int senderid,struct finsChannelReader *request)
+{
+
+			int datalens[FINS_CHANNEL_MAX_BATCH];
+			int numOfBytes;
+			int sockfd;
+			int index;
+			int flags;
+			int n;
+
+	numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
+	numOfBytes = (numOfBytes <= 0) ? numOfBytes : fins_channel_get(request,&flags, sizeof(int));
+	numOfBytes = (numOfBytes <= 0) ? numOfBytes : fins_channel_get(request,&n, sizeof(int));
+		if ( numOfBytes <= 0 || n <= 0 || n > FINS_CHANNEL_MAX_BATCH)
+			{
+
+				PRINT_DEBUG("READING ERROR! CRASH");
+				exit(1);
+			}
+	numOfBytes = fins_channel_get(request,datalens, n * sizeof(int));
+	fins_channel_finish(request);
+		if ( numOfBytes <= 0)
+			{
+
+				PRINT_DEBUG("READING ERROR! CRASH");
+				exit(1);
+			}
+
+	pthread_rwlock_rdlock(&jinniSockets_lock);
+	index = findjinniSocket(senderid,sockfd);
+	pthread_rwlock_unlock(&jinniSockets_lock);
+		if (index == -1)
+		{
+			PRINT_DEBUG("CRASH !!socket descriptor not found into jinni sockets");
+			exit(1);
+		}
+
+		if (jinniSockets[index].type == SOCK_DGRAM)
+		{
+			recvmmsg_udp(senderid,sockfd,n,datalens,flags);
+		}
+		else
+		{
+			PRINT_DEBUG("recvmmsg is only implemented for UDP sockets");
+			nack_write(senderid,sockfd);
+		}
+
+} // end of recvmmsg_call_handler()
+
+/**
+ * @brief receives the next datagram of a UDP socket without copying it into
+ * the response ring, see ack_write_buffer
+ */
+void recv_zc_call_handler(int senderid,struct finsChannelReader *request)
+{
+
+			int numOfBytes;
+			int sockfd;
+			int index;
+			int flags;
+
+	numOfBytes = fins_channel_get(request,&sockfd, sizeof (int) );
+		if ( numOfBytes <= 0)
+			{
+
+				PRINT_DEBUG("READING ERROR! CRASH");
+				exit(1);
+			}
+
+	numOfBytes = fins_channel_get(request,&flags, sizeof(int));
+	fins_channel_finish(request);
+		if ( numOfBytes <= 0)
+			{
+
+				PRINT_DEBUG("READING ERROR! CRASH");
+				exit(1);
+			}
+
+	pthread_rwlock_rdlock(&jinniSockets_lock);
+	index = findjinniSocket(senderid,sockfd);
+	pthread_rwlock_unlock(&jinniSockets_lock);
+		if (index == -1)
+		{
+			PRINT_DEBUG("CRASH !!socket descriptor not found into jinni sockets");
+			exit(1);
+		}
+
+		if (jinniSockets[index].type == SOCK_DGRAM)
+		{
+			recvfrom_udp(senderid,sockfd,0,flags,RECV_ZEROCOPY);
+		}
+		else
+		{
+			PRINT_DEBUG("zero copy receive is only implemented for UDP sockets");
+			nack_write(senderid,sockfd);
+		}
+
+} // end of recv_zc_call_handler()
+
 void	getsockname_call_handker()
 {
 
@@ -35,6 +35,8 @@
 #include <finsdebug.h>
 /** Additional header for meta-data manipulation */
 #include <metadata.h>
+/** the shared memory channel to the socket interceptor */
+#include <finsChannel.h>
 //#include "arp.c"
 
 /* to handle forking + pipes operations */
@@ -65,6 +67,16 @@ struct socket_call_msg
 };
 
 
+/** a blocking recvfrom waiting for a datagram, see recvfrom_udp */
+struct jinniWaiter
+{
+	pid_t senderid;
+	uint32_t requestid;	/** of the recvfrom request, the reply answers it */
+	int symbol;
+	int datalen;	/** the room of the client for the datagram */
+	struct jinniWaiter *next;
+};
+
 struct finssocket
 {
 
@@ -72,7 +84,7 @@ pid_t processid;
 int sockfd; /** it is equal to the value of the pipe descriptor from the client side */
 int fakeID; /** The ID given by the interceptor side to distinguish this socket from other sockets
 created by the sam process, it is used within the pipe name to open the correct pipe on both sides */
-int jinniside_pipe_ds;  /**  the descriptor to access the pipe from the jinni side */
+int jinniside_pipe_ds;  /**  the jinni end of the pipe the client uses as the socket descriptor */
 int type;
 int protocol;
 /** All the above already initialized using the insert function
@@ -85,11 +97,10 @@ char name[50];
 int     data_pipe[2];
 finsQueue dataQueue;
 sem_t Qs; /** The data Queue Semaphore Pointer*/
-
-char semaphore_name[30]; /** The client channel semaphore name */
-char asemaphore_name[30];
-sem_t *s; /** The client channel semaphore pointer*/
-sem_t *as;
+struct jinniWaiter *waiters; /** parked recvfrom calls, oldest first, protected by Qs */
+int ready; /** a token byte is in the pipe while dataQueue holds frames, protected by Qs */
+int error; /** the last failure of an asynchronous request, see jinni_async_complete */
+unsigned int errors; /** the failures so far */
 };
 
 struct socketIdentifier
@@ -112,16 +123,24 @@ int removejinniSocket(pid_t target1, int target2) ;
 
 int checkjinniports(uint16_t hostport, uint32_t hostip);
 
-int nack_write( int pipe_desc, int processid, int sockfd);
-
-int ack_write( int pipe_desc, int processid, int sockfd);
-
-void socket_call_handler(pid_t senderProcessid);
-void bind_call_handler(int senderid);
-void send_call_handler(int senderid);
-void sendto_call_handler(int senderid);
-void recv_call_handler(int senderid);
-void recvfrom_call_handler(int senderid);
+void jinni_socket_readiness(int index);
+void jinni_socket_publish(int index);
+void jinni_async_complete(int senderid,int index);
+int nack_write( int processid, int sockfd);
+int error_write( int processid, int error);
+
+int ack_write( int processid, int sockfd);
+int ack_write_data( int processid, uint32_t requestid, struct sockaddr_in *addr, u_char *buf, int buflen);
+int ack_write_buffer( int processid, uint32_t requestid, struct finsDataFrame *df);
+int ack_write_count( int processid, int count);
+int ack_write_batch( int processid, uint32_t requestid, struct finsFrame **frames, int *datalens, int n);
+
+void socket_call_handler(pid_t senderProcessid,struct finsChannelReader *request);
+void bind_call_handler(int senderid,struct finsChannelReader *request);
+void send_call_handler(int senderid,struct finsChannelReader *request);
+void sendto_call_handler(int senderid,struct finsChannelReader *request);
+void recv_call_handler(int senderid,struct finsChannelReader *request);
+void recvfrom_call_handler(int senderid,struct finsChannelReader *request);
 void	sendmsg_call_handler();
 void	recvmsg_call_handler();
 void	getsockopt_call_handler();
@@ -131,7 +150,10 @@ void	listen_call_handler();
 void	accept_call_handler();
 
 void	accept4_call_handler();
-void	shutdown_call_handler();
+void	shutdown_call_handler(int senderid,struct finsChannelReader *request);
+void sendmmsg_call_handler(int senderid,struct finsChannelReader *request);
+void recvmmsg_call_handler(int senderid,struct finsChannelReader *request);
+void recv_zc_call_handler(int senderid,struct finsChannelReader *request);
 void	getsockname_call_handker();
 
 
@@ -8,10 +8,8 @@
 #include "icmp.h"
 
 
-extern sem_t ICMP_to_Switch_Qsem;
 extern finsQueue ICMP_to_Switch_Queue;
 
-extern sem_t Switch_to_ICMP_Qsem;
 extern finsQueue Switch_to_ICMP_Queue;
 
 
@@ -19,9 +17,19 @@ extern finsQueue Switch_to_ICMP_Queue;
 
 void icmp_in(struct finsFrame *ff)
 {
+	uint32_t sum;
 
+	/** the checksum covers the whole message, IP summed it while it copied
+	 * the message into the frame */
+	if ((ff->dataFrame).csumValid)
+		sum = (ff->dataFrame).csum;
+	else
+		sum = fins_csum_partial((ff->dataFrame).pdu,(ff->dataFrame).pduLength,0);
+	if (fins_csum_fold(sum) != 0)
+		PRINT_DEBUG("ICMP message of %d bytes with a bad checksum",(ff->dataFrame).pduLength);
 
-
+	/** nothing is answered yet, the frame ends here */
+	freeFinsFrame(ff);
 
 
 
@@ -31,8 +39,7 @@ void icmp_in(struct finsFrame *ff)
 void icmp_out(struct finsFrame *ff)
 {
 
-
-
+	freeFinsFrame(ff);
 
 
 
@@ -47,16 +54,13 @@ void icmp_get_FF(struct finsFrame *ff)
 {
 
 
-	do {
-				sem_wait (&Switch_to_ICMP_Qsem);
-					ff = read_queue(Switch_to_ICMP_Queue);
-				sem_post (&Switch_to_ICMP_Qsem);
-			} while (ff == NULL);
+	ff = read_queue_wait(Switch_to_ICMP_Queue);
 
 
 	if(ff->dataOrCtrl == CONTROL){
 			// send to something to deal with FCF
 			PRINT_DEBUG("send to CONTROL HANDLER !");
+			freeFinsFrame(ff);
 		}
 		if( (ff->dataOrCtrl == DATA) && ( (ff->dataFrame).directionFlag == UP) )
 		{
@@ -82,7 +86,7 @@ void ICMP_init()
 
 			icmp_get_FF(pff);
 			PRINT_DEBUG("%d",(int)pff);
-			free(pff);
+			/** icmp_get_FF has consumed the frame */
 
 
 		}
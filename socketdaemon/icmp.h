@@ -11,6 +11,7 @@
 #include <metadata.h>
 #include <finsdebug.h>
 #include <queueModule.h>
+#include <finsCsum.h>
 
 
 
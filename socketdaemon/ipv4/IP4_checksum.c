@@ -4,21 +4,11 @@
  */
 
 #include "ipv4.h"
+#include <finsCsum.h>
 
-
+/* the header checksum, summed by the kernel of finsCsum.c. An odd length
+ * is summed as if a zero byte followed the last one */
 unsigned short IP4_checksum(struct ip4_packet* ptr, int length){
-int sum = 0;
-u_short ret = 0;
-unsigned short *w = (unsigned short*)ptr;
-int nleft = length;
-
-while(nleft > 1){
-sum += *w++;
-nleft -= 2;
-}
 
-sum = (sum >> 16) + (sum & 0xFFFF);
-sum += (sum >> 16);
-ret = ~sum;
-return(ret);
+return(fins_csum(ptr, length));
 }
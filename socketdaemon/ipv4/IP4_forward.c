@@ -8,6 +8,7 @@
 
 extern struct ip4_stats stats;
 
+/** @return 1 when ff was sent on, 0 when there is no route and the caller still owns ff */
 int IP4_forward(struct finsFrame *ff, struct ip4_packet* ppacket, IP4addr dest, uint16_t length)
 {
 	PRINT_DEBUG();
@@ -1,51 +1,28 @@
 #include "ipv4.h"
 
+/* The fragment of the datagram data (length bytes) starting at offset, of
+ * fragment_size bytes at most. Every fragment but the last carries a multiple
+ * of 8 bytes, fragment.last is the last byte of the fragment (included)
+ */
 struct ip4_fragment IP4_fragment_data(void *data, uint16_t length,
 		uint16_t offset, uint16_t fragment_size)
 {
 	struct ip4_fragment fragment;
-	if ((offset + fragment_size) >= length)
+
+	fragment_size &= ~7;
+	fragment.first = offset;
+	fragment.data = (char *) data + offset;
+	if (length - offset <= fragment_size)
 	{
-		fragment.first = offset;
-		fragment.last = length;
 		fragment.data_length = length - offset;
 		fragment.more_fragments = 0;
-		fragment.data = data + offset;
-		PRINT_DEBUG();
-		return (fragment);
-	}
-
-	/* Take care of a special case when the fragment is less than 8 bytes larger that then
-	 * the fragment size
-	 */
-	if ((offset + fragment_size + 8) > length)
+	} else
 	{
-		fragment.first = offset;
-		fragment.last = length - (length - offset) % 8;
-		fragment.data_length = fragment.last - fragment.first;
-
-#ifdef DEBUG
-		if (fragment.data_length % 8 != 0)
-		{
-			PRINT_DEBUG("Problem with fragment data length. Not a multiple of 8");
-		}
-#endif
-
+		fragment.data_length = fragment_size;
 		fragment.more_fragments = 1;
-		return (fragment);
-	}
-
-	fragment.first = offset;
-	fragment.last = offset + fragment_size;
-	fragment.data_length = fragment_size;
-#ifdef DEBUG
-	if (fragment.data_length % 8 != 0)
-	{
-		PRINT_DEBUG("Problem with fragment data length. Not a multiple of 8");
 	}
-#endif
-	fragment.more_fragments = 1;
-	PRINT_DEBUG();
+	fragment.last = offset + fragment.data_length - 1;
+	PRINT_DEBUG("fragment %d-%d of %d", fragment.first, fragment.last, length);
 
 	return (fragment);
 }
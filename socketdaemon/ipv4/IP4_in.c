@@ -5,12 +5,14 @@
  */
 
 #include "ipv4.h"
+#include <queueModule.h>
 
 extern struct ip4_stats stats;
 /**
  * @brief Function processing all the incoming packets
  *
  * Responsible for parsing, checking reassembling and passing packets out.
+ * IP4_in owns ff (ppacket points into its pdu), it either forwards it or frees it.
  */
 void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 {
@@ -38,7 +40,7 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 		stats.badver++;
 		stats.droppedtotal++;
 		PRINT_ERROR("Packet ID %d has a wrong IP version (%d)", header.id,header.version);
-		//free ppacket
+		freeFinsFrame(ff);
 		return;
 	}
 	PRINT_DEBUG();
@@ -49,7 +51,7 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 		stats.badhlen++;
 		stats.droppedtotal++;
 		PRINT_ERROR("Packet header length (%d) in packet ID %d is smaller than the defined minimum (20).",header.header_length, header.id);
-		//free ppacket
+		freeFinsFrame(ff);
 		return;
 	}
 	PRINT_DEBUG();
@@ -60,7 +62,7 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 		stats.badsum++;
 		stats.droppedtotal++;
 		PRINT_ERROR("Checksum check failed on packet ID %d, non zero result: %d",header.id, IP4_checksum(ppacket, IP4_HLEN(ppacket)));
-		//free ppacket
+		freeFinsFrame(ff);
 		return;
 	}
 	PRINT_DEBUG();
@@ -75,7 +77,7 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 		if (header.packet_length > len)
 		{
 			stats.droppedtotal++;
-			//free ppacket
+			freeFinsFrame(ff);
 			return;
 		}
 	}
@@ -94,7 +96,7 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 			return;
 		}
 		stats.droppedtotal++;
-		//free ppacket
+		freeFinsFrame(ff);
 		return;
 	}
 	PRINT_DEBUG();
@@ -105,7 +107,7 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 		stats.fragerror++;
 		stats.droppedtotal++;
 		PRINT_ERROR("Packet ID %d has both DF and MF flags set",header.id);
-		//free ppacket
+		freeFinsFrame(ff);
 		return;
 	}
 	/* If not fragmented, pass out. If fragmented, call reassembly algorithm.
@@ -119,20 +121,28 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len)
 		stats.delivered++;
 		PRINT_DEBUG();
 
-		IP4_send_fdf_in(&header, ppacket);
-		//free ppacket
+		IP4_send_fdf_in(ff, &header, ppacket);
 		return;
 	}
 	else
 	{
 		PRINT_DEBUG("Packet ID %d is fragmented", header.id);
 		struct ip4_packet* ppacket_reassembled = IP4_reass(&header, ppacket);
-		//free ppacket
-		if(ppacket_reassembled != NULL){
-			stats.delivered++;
-			stats.reassembled++;
-			IP4_send_fdf_in(&header, ppacket_reassembled);
+		/* IP4_reass keeps a copy of the fragment */
+		if(ppacket_reassembled == NULL){
+			freeFinsFrame(ff);
+			return;
 		}
+		stats.delivered++;
+		stats.reassembled++;
+		/* the frame of the last fragment carries the datagram on, in a
+		 * buffer that can be lent to the socket reading it */
+		fins_frame_release_pdu(&ff->dataFrame);
+		fins_frame_attach(&ff->dataFrame, fins_buff_alloc_shared(header.packet_length
+				+ FINS_TAILROOM), 0, header.packet_length);
+		memcpy(ff->dataFrame.pdu, ppacket_reassembled, header.packet_length);
+		free(ppacket_reassembled);
+		IP4_send_fdf_in(ff, &header, (struct ip4_packet*) ff->dataFrame.pdu);
 		return;
 	}
 
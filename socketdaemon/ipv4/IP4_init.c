@@ -11,8 +11,17 @@ extern struct ip4_stats stats;
 
 void IP4_init()
 {
+	pthread_t route_monitor;
+	struct ip4_routing_table *table = NULL;
+
 	construct_packet_buffer = (struct ip4_packet*) malloc(IP4_PCK_LEN);
-	routing_table=IP4_sort_routing_table(IP4_get_routing_table());
+	/** with no table to fall back on, a failed dump starts empty, the route
+	 * monitor dumps again */
+	if (IP4_get_routing_table(&table) == -1)
+		PRINT_DEBUG("no routing table yet");
+	IP4_route_publish(IP4_sort_routing_table(table));
+	/** keeps the routing table up to date with the kernel's */
+	pthread_create(&route_monitor,NULL,IP4_route_monitor,NULL);
 	memset(&stats,0,sizeof(struct ip4_stats));
 #ifdef DEBUG
 	IP4_print_routing_table(routing_table);
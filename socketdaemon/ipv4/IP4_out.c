@@ -6,90 +6,119 @@
  */
 
 #include "ipv4.h"
+#include <queueModule.h>
+#include <finsCsum.h>
 
 extern struct ip4_stats stats;
 
-//extern struct ip4_packet *construct_packet_buffer;
+/* Sends the length bytes of data of ff in fragments of IP4_PCK_LEN bytes at
+ * most. A fragment is a frame of its own: its pdu is the fragment header,
+ * its frag the slice of the buffer of ff holding its data, which all the
+ * fragments share instead of each getting a copy. ff is released
+ */
+static void IP4_fragment_out(struct finsFrame *ff, struct ip4_packet *header,
+		struct ip4_next_hop_info next_hop, uint16_t length)
+{
+	struct finsDataFrame *df = &ff->dataFrame;
+	struct finsFrame *fragment_frame;
+	struct ip4_fragment fragment;
+	uint16_t offset = 0;
+	uint16_t flags;
+	uint16_t fragoff;
+	uint16_t len;
+
+	/* a pdu which is not in a buffer cannot be shared */
+	if (df->buff == NULL)
+		fins_frame_copy_pdu(df, df->pdu, df->pduLength);
+
+	do
+	{
+		fragment = IP4_fragment_data(df->pdu, length, offset, IP4_PCK_LEN
+				- IP4_MIN_HLEN);
+		flags = fragment.more_fragments ? IP4_MF : 0;
+		fragoff = htons((flags << 13) | (fragment.first >> 3));
+		len = htons(fragment.data_length + IP4_MIN_HLEN);
+		if (offset == 0)
+		{
+			header->ip_fragoff = fragoff;
+			header->ip_len = len;
+			header->ip_cksum = 0;
+			header->ip_cksum = IP4_checksum(header, IP4_MIN_HLEN);
+		} else
+		{
+			/* only the offset and the length change from a fragment to the
+			 * next, the checksum is updated rather than summed again (RFC 1624) */
+			header->ip_cksum = fins_csum_update16(header->ip_cksum, header->ip_fragoff, fragoff);
+			header->ip_cksum = fins_csum_update16(header->ip_cksum, header->ip_len, len);
+			header->ip_fragoff = fragoff;
+			header->ip_len = len;
+		}
+
+		fragment_frame = allocFinsFrame();
+		fragment_frame->dataOrCtrl = DATA;
+		if (df->metaData != NULL)
+			fragment_frame->dataFrame.metaData = holdMetadata(df->metaData);
+		/* an empty pdu, IP4_send_fdf_out pushes the header into its headroom */
+		fins_frame_alloc_pdu(&fragment_frame->dataFrame, 0);
+		fins_frame_attach_frag(&fragment_frame->dataFrame, fins_buff_hold(df->buff),
+				(unsigned char *) fragment.data - df->buff->data, fragment.data_length);
+
+		stats.outfragments++;
+		IP4_send_fdf_out(fragment_frame, header, next_hop, fragment.data_length);
+		offset = fragment.last + 1;
+	} while (fragment.more_fragments);
+
+	stats.fragmented++;
+	freeFinsFrame(ff);
+}
+
 void IP4_out(struct finsFrame *ff, uint16_t length, IP4addr source,uint8_t protocol)
 {
 
 	PRINT_DEBUG("");
 	print_finsFrame(ff);
-	char *data = (char *)((ff->dataFrame).pdu);
 	PRINT_DEBUG("");
 
-	uint8_t more_fragments = 1;
-	uint16_t offset = 0;
 	IP4addr destination;
 
 	struct ip4_next_hop_info next_hop;
-	struct ip4_fragment fragment;
 	struct ip4_packet_header construct_packet;
 	struct ip4_packet *construct_packet_buffer;
 
 	construct_packet_buffer = &construct_packet;
 	PRINT_DEBUG("");
 
-	metadata_readFromElement(ff->dataFrame.metaData,"dstip",&destination);
+	uint32_t dstip = 0;
+	metadata_get_dstip(ff->dataFrame.metaData,&dstip);
+	destination = dstip;
 
 	PRINT_DEBUG("");
 
 	IP4_const_header(construct_packet_buffer, source, destination, protocol);
 	PRINT_DEBUG("");
-/** TODO
- * finding out what is wrong with the fragmentation and reimplement it
- * correctly
- * Notice that the current implementation support mutlithreading
- * while the basic opf the implemented fragmentation is based on having one
- * global packet to hold the contents
- */
-	/**
-	while (more_fragments)
+
+	next_hop = IP4_next_hop(destination);
+	if (next_hop.interface < 0)
 	{
-		fragment = IP4_fragment_data(data, length, offset, IP4_PCK_LEN
-				- IP4_MIN_HLEN);
-		memcpy(fragment.data, construct_packet_buffer->ip_data,
-				fragment.data_length);
-		construct_packet_buffer->ip_fragoff = htons(fragment.first >> 3);
-		construct_packet_buffer->ip_len = htons(fragment.data_length
-				+ IP4_MIN_HLEN);
-		more_fragments = fragment.more_fragments;
-		next_hop = IP4_next_hop(destination);
-		if (next_hop.interface>=0)
-		{
-			stats.outfragments++;
-			PRINT_DEBUG("");
-			print_finsFrame(ff);
-			IP4_send_fdf_out(ff, construct_packet_buffer, next_hop, fragment.data_length);
-		}
-		else
-		{
-			PRINT_DEBUG("No route to the destination, packet discarded");
-		}
-		more_fragments = fragment.more_fragments;
-		offset = fragment.last + 1;
+		PRINT_DEBUG("No route to the destination, packet discarded");
+		freeFinsFrame(ff);
+		return;
+	}
+
+	if (length > IP4_PCK_LEN - IP4_MIN_HLEN)
+	{
+		IP4_fragment_out(ff, construct_packet_buffer, next_hop, length);
+		return;
 	}
 
-*/
 	construct_packet_buffer->ip_fragoff = htons(0);
-	construct_packet_buffer->ip_id = htons(0);
 	construct_packet_buffer->ip_len = htons(length + IP4_MIN_HLEN);
 	construct_packet_buffer->ip_cksum = 0;
 	construct_packet_buffer->ip_cksum  = IP4_checksum(construct_packet_buffer,
 			IP4_MIN_HLEN);
 
-	next_hop = IP4_next_hop(destination);
-	if (next_hop.interface>=0)
-	{
-		//stats.outfragments++;
-		PRINT_DEBUG("");
-		print_finsFrame(ff);
-		IP4_send_fdf_out(ff, construct_packet_buffer, next_hop, length);
-	}
-	else
-			{
-				PRINT_DEBUG("No route to the destination, packet discarded");
-			}
-
+	PRINT_DEBUG("");
+	print_finsFrame(ff);
+	IP4_send_fdf_out(ff, construct_packet_buffer, next_hop, length);
 
 }
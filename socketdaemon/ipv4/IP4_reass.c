@@ -5,323 +5,370 @@
  *      Author: rado
  */
 
+#include <time.h>
 #include "ipv4.h"
 
-/* Variable pointing to the first element of a double
- * linked list holding partially received packets.
- * Must be global so the todo:TTL garbage collector
- * can clean it.
+extern struct ip4_stats stats;
+
+/* The datagrams being reassembled, hashed on (id, source, destination,
+ * protocol). Each one is also in the slot of the timer wheel of its deadline:
+ * a slot holds the datagrams due in the same second, the wheel turns as time
+ * goes by (IP4_reass_expire) and drops the datagrams of the slots it passes.
+ * As every datagram gets IP4_REASS_TTL seconds, the slots after the current
+ * tick hold them oldest first.
+ */
+static struct ip4_reass_list *ip4_reass_table[IP4_REASS_BUCKETS];
+static struct ip4_reass_list *ip4_reass_wheel[IP4_REASS_WHEEL];
+static unsigned long ip4_reass_tick;
+/* bytes taken by the datagrams being reassembled, at most IP4_REASS_BUDGET */
+static unsigned long ip4_reass_bytes;
+
+static unsigned long IP4_reass_now()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec);
+}
+
+static unsigned int IP4_reass_hash(struct ip4_header *pheader)
+{
+	uint32_t key = (uint32_t) pheader->source ^ (uint32_t) pheader->destination
+			^ ((uint32_t) pheader->id << 16) ^ pheader->protocol;
+
+	return ((key * 2654435761u) >> 16) & (IP4_REASS_BUCKETS - 1);
+}
+
+static struct ip4_reass_hole* IP4_new_hole(uint16_t first, uint16_t last,
+		struct ip4_reass_hole *next)
+{
+	struct ip4_reass_hole *hole = (struct ip4_reass_hole*) malloc(
+			sizeof(struct ip4_reass_hole));
+
+	hole->first = first;
+	hole->last = last;
+	hole->next_hole = next;
+	ip4_reass_bytes += sizeof(struct ip4_reass_hole);
+	return (hole);
+}
+
+static void IP4_free_hole(struct ip4_reass_hole *hole)
+{
+	ip4_reass_bytes -= sizeof(struct ip4_reass_hole);
+	free(hole);
+}
+
+/*
+ * Takes the datagram out of the table and the wheel and frees it
+ */
+static void IP4_free_packet_entry(struct ip4_reass_list *entry)
+{
+	struct ip4_reass_hole *hole;
+
+	if (entry->previous_packet == NULL)
+		ip4_reass_table[IP4_reass_hash(&entry->header)] = entry->next_packet;
+	else
+		entry->previous_packet->next_packet = entry->next_packet;
+	if (entry->next_packet != NULL)
+		entry->next_packet->previous_packet = entry->previous_packet;
+
+	if (entry->previous_timer == NULL)
+		ip4_reass_wheel[entry->deadline % IP4_REASS_WHEEL] = entry->next_timer;
+	else
+		entry->previous_timer->next_timer = entry->next_timer;
+	if (entry->next_timer != NULL)
+		entry->next_timer->previous_timer = entry->previous_timer;
+
+	while ((hole = entry->holes) != NULL)
+	{
+		entry->holes = hole->next_hole;
+		IP4_free_hole(hole);
+	}
+	ip4_reass_bytes -= sizeof(struct ip4_reass_list) + IP4_MIN_HLEN + entry->length;
+	free(entry->buffer);
+	free(entry);
+}
+
+/*
+ * Turns the timer wheel up to now, dropping the datagrams whose fragments
+ * did not all arrive in time
  */
-static struct ip4_reass_list *packet_list = NULL;
+void IP4_reass_expire()
+{
+	unsigned long now = IP4_reass_now();
+	struct ip4_reass_list *entry;
+	struct ip4_reass_list *next;
+
+	/* a whole turn visits every slot */
+	if (now - ip4_reass_tick > IP4_REASS_WHEEL)
+		ip4_reass_tick = now - IP4_REASS_WHEEL;
+	while (ip4_reass_tick < now)
+	{
+		ip4_reass_tick++;
+		for (entry = ip4_reass_wheel[ip4_reass_tick % IP4_REASS_WHEEL]; entry != NULL; entry = next)
+		{
+			next = entry->next_timer;
+			if (entry->deadline > ip4_reass_tick)
+				continue;
+			PRINT_DEBUG("Packet ID %d timed out during reassembly", entry->header.id);
+			stats.timedout++;
+			stats.droppedtotal++;
+			IP4_free_packet_entry(entry);
+		}
+	}
+}
+
+/*
+ * Makes room for bytes more bytes, dropping the oldest datagrams other than
+ * keep as needed.
+ * Returns 0 on success, -1 if that is not possible
+ */
+static int IP4_reass_reserve(struct ip4_reass_list *keep, unsigned long bytes)
+{
+	struct ip4_reass_list *oldest;
+	unsigned int i;
+
+	while (ip4_reass_bytes + bytes > IP4_REASS_BUDGET)
+	{
+		oldest = NULL;
+		for (i = 1; i <= IP4_REASS_WHEEL && oldest == NULL; i++)
+			for (oldest = ip4_reass_wheel[(ip4_reass_tick + i) % IP4_REASS_WHEEL];
+					oldest != NULL && oldest == keep; oldest = oldest->next_timer)
+				;
+		if (oldest == NULL)
+			return (-1);
+		PRINT_DEBUG("Packet ID %d dropped, out of reassembly memory", oldest->header.id);
+		stats.fragdropped++;
+		stats.droppedtotal++;
+		IP4_free_packet_entry(oldest);
+	}
+	return (0);
+}
 
 /*
  * Function that takes the header struct and the
  * raw IP data of a fragmented IP packet.
  * In case that this fragment is the last one missing to
- * reassemble an IP packet it returns a pointer to it.
+ * reassemble an IP packet it returns a pointer to it, to be freed by the
+ * caller, and pheader describes it.
  * In case it isn't it returns NULL
  */
 struct ip4_packet* IP4_reass(struct ip4_header *pheader,
 		struct ip4_packet *ppacket)
 {
 	struct ip4_reass_list *packet_entry;
+	struct ip4_fragment fragment;
+	struct ip4_packet *reassembled;
+	int status;
+
+	stats.fragments++;
+	IP4_reass_expire();
 
-	if (packet_list == NULL)
+	/* the bounds are checked before IP4_construct_fragment computes them in
+	 * 16 bits: a fragment reaching past the largest datagram, or shorter than
+	 * its own header, would wrap around */
+	if (pheader->packet_length < pheader->header_length
+			|| (unsigned int) pheader->fragmentation_offset * 8
+					+ (pheader->packet_length - pheader->header_length)
+					> IP4_MAXLEN - pheader->header_length)
 	{
-		packet_entry = packet_list = IP4_new_packet_entry(pheader, NULL, NULL);
-	} else
+		stats.fragdropped++;
+		stats.droppedtotal++;
+		return (NULL);
+	}
+
+	IP4_construct_fragment(pheader, ppacket, &fragment);
+	PRINT_DEBUG("Fragment.first: %d",fragment.first);
+	PRINT_DEBUG("Fragment.last: %d",fragment.last);
+	PRINT_DEBUG("Fragment.more_fragments: %d", fragment.more_fragments);
+	/* every fragment but the last carries a multiple of 8 bytes */
+	if (fragment.data_length == 0
+			|| (fragment.more_fragments && (fragment.data_length & 7))
+			|| fragment.last >= IP4_MAXLEN - IP4_MIN_HLEN)
 	{
-		packet_entry = packet_list;
-		while (1)
+		stats.fragdropped++;
+		stats.droppedtotal++;
+		return (NULL);
+	}
+
+	for (packet_entry = ip4_reass_table[IP4_reass_hash(pheader)]; packet_entry != NULL;
+			packet_entry = packet_entry->next_packet)
+		if ((packet_entry->header.id == pheader->id)
+				&& (packet_entry->header.source == pheader->source)
+				&& (packet_entry->header.protocol == pheader->protocol)
+				&& (packet_entry->header.destination == pheader->destination))
+			break;
+	if (packet_entry == NULL)
+	{
+		if (IP4_reass_reserve(NULL, sizeof(struct ip4_reass_list) + IP4_MIN_HLEN
+				+ sizeof(struct ip4_reass_hole)) == -1)
 		{
-			if ((packet_entry->header.id == pheader->id)
-					& (packet_entry->header.source == pheader->source)
-					& (packet_entry->header.protocol == pheader->protocol)
-					& (packet_entry->header.destination == pheader->destination))
-			{
-				break;
-			}
-			if (packet_entry->next_packet == NULL)
-			{
-				struct ip4_reass_list* new_packet_entry = IP4_new_packet_entry(
-						pheader, packet_entry, NULL);
-				packet_entry->next_packet = new_packet_entry;
-				packet_entry = new_packet_entry;
-				break;
-			}
-			packet_entry = packet_entry->next_packet;
+			stats.fragdropped++;
+			stats.droppedtotal++;
+			return (NULL);
 		}
+		packet_entry = IP4_new_packet_entry(pheader);
 	}
 
-	struct ip4_fragment* fragment = IP4_construct_fragment(pheader, ppacket);
-	PRINT_DEBUG("Packet pointer: %lu",(unsigned long)ppacket);
-	PRINT_DEBUG("Fragment.first: %d",fragment->first);
-	PRINT_DEBUG("Fragment.last: %d",fragment->last);
-	PRINT_DEBUG("Fragment.more_fragments: %d", fragment->more_fragments);
-	PRINT_DEBUG("Fragment.data: %lu", (unsigned long)fragment->data);
+	status = IP4_add_fragment(packet_entry, &fragment);
+	if (status == -1)
+	{
+		stats.fragdropped++;
+		stats.droppedtotal++;
+	}
+	if (status != 1)
+		return (NULL);
 
-	IP4_add_fragment(packet_entry, fragment);
+	/* the datagram takes the fixed header of this fragment, without options */
+	reassembled = (struct ip4_packet*) packet_entry->buffer;
+	memcpy(reassembled, ppacket, IP4_MIN_HLEN);
+	reassembled->ip_verlen = (IP4_VERSION << 4) | (IP4_MIN_HLEN >> 2);
+	reassembled->ip_len = htons(IP4_MIN_HLEN + packet_entry->total);
+	reassembled->ip_fragoff = 0;
+	pheader->header_length = IP4_MIN_HLEN;
+	pheader->packet_length = IP4_MIN_HLEN + packet_entry->total;
+	pheader->flags = 0;
+	pheader->fragmentation_offset = 0;
 
-	return (NULL);
+	/* the buffer is the caller's now */
+	ip4_reass_bytes -= packet_entry->length;
+	packet_entry->length = 0;
+	packet_entry->buffer = NULL;
+	IP4_free_packet_entry(packet_entry);
+	return (reassembled);
 }
 
-uint8_t IP4_add_fragment(struct ip4_reass_list *list,
+/*
+ * Adds the fragment to the datagram (RFC 815). The buffer of the datagram
+ * grows with the fragments, and takes the exact size of the datagram once
+ * its last fragment came.
+ * Returns 1 if the datagram is now complete, 0 if it is not yet, -1 if the
+ * fragment was dropped
+ */
+int IP4_add_fragment(struct ip4_reass_list *list,
 		struct ip4_fragment *fragment)
 {
-	int i;
-	uint8_t use_fragment = 0;
-	struct ip4_reass_hole *current_hole = NULL, *next_hole_abs_pointer,
-			*prev_hole_abs_pointer, *new_hole;
+	struct ip4_reass_hole **previous = &list->holes;
+	struct ip4_reass_hole *current_hole;
+	unsigned int length = list->length;
+	void *buffer;
 
-	for (i = 0; 1; i++)
+	if (list->total != 0 && fragment->last >= list->total)
+		return (-1);
+	/* a second last fragment has to end where the first one did */
+	if (!fragment->more_fragments && list->total != 0 && fragment->last + 1 != list->total)
+		return (-1);
+	if (!fragment->more_fragments && list->total == 0)
 	{
-		/* Step 1
-		 * Select the next hole descriptor from the hole descriptor
-		 * list. If there are no more entries, go to step eight.
-		 */
-		if (current_hole == NULL)
-		{
-			current_hole
-					= (struct ip4_reass_hole*) ((unsigned long) list->buffer
-							+ list->first_hole_rel_pointer);
-		} else if (current_hole->next_hole_rel_pointer != 0)
-		{
-			current_hole = IP4_next_hole(current_hole);
-		} else
-		{
-			break;
-		}
-		prev_hole_abs_pointer = IP4_previous_hole(current_hole);
-		next_hole_abs_pointer = IP4_next_hole(current_hole);
-
-		/* Step 2 & 3
-		 * 2. If fragment.first is greater than hole.last, go to step one.
-		 * 3. If fragment.last is less than hole.first, go to step one.
-		 */
-		if ((fragment->first > current_hole->last) || (fragment->last
-				< current_hole->first))
+		/* no byte past the end of the datagram may have come already */
+		for (current_hole = list->holes; current_hole->next_hole != NULL;
+				current_hole = current_hole->next_hole)
+			;
+		if (current_hole->first > fragment->last + 1)
+			return (-1);
+		length = fragment->last + 1;
+	} else if (fragment->last >= length)
+	{
+		/* grows by the 8 fragments of the usual MTU at least */
+		length = fragment->last + 1;
+		if (length < list->length + 8 * IP4_PCK_LEN)
+			length = list->length + 8 * IP4_PCK_LEN;
+		if (length > IP4_MAXLEN - IP4_MIN_HLEN)
+			length = IP4_MAXLEN - IP4_MIN_HLEN;
+	}
+	if (length != list->length)
+	{
+		if (length > list->length
+				&& IP4_reass_reserve(list, length - list->length + 2 * sizeof(struct ip4_reass_hole)) == -1)
+			return (-1);
+		buffer = realloc(list->buffer, IP4_MIN_HLEN + length);
+		if (buffer == NULL)
+			return (-1);
+		ip4_reass_bytes += length;
+		ip4_reass_bytes -= list->length;
+		list->buffer = buffer;
+		list->length = length;
+	}
+	if (!fragment->more_fragments)
+		list->total = fragment->last + 1;
+
+	/* Steps 1 to 7: the fragment fills (part of) every hole it overlaps */
+	while ((current_hole = *previous) != NULL)
+	{
+		if ((fragment->first > current_hole->last)
+				|| (fragment->last < current_hole->first))
 		{
-			use_fragment = 0;
+			previous = &current_hole->next_hole;
 			continue;
 		}
-		use_fragment = 1;
-
-		/* Step 4
-		 * Delete the current entry from the hole descriptor list.
-		 * -(Since  neither  step  two  nor step three was true, the
-		 * newly arrived fragment does interact with this  hole  in
-		 * some  way.    Therefore,  the current descriptor will no
-		 * longer be valid.  We will destroy it, and  in  the  next
-		 * two  steps  we  will  determine  whether  or  not  it is
-		 * necessary to create any new hole descriptors.)
-		 */
-		IP4_remove_hole(current_hole, list);
-
-		/* Step 5
-		 * If fragment.first is greater than hole.first, then  create  a
-		 * new  hole  descriptor "new_hole" with new_hole.first equal to
-		 * hole.first, and new_hole.last equal to  fragment.first  minus
-		 * one.
-		 */
+		*previous = current_hole->next_hole;
+		list->hole_count--;
 		if (fragment->first > current_hole->first)
 		{
-			new_hole = current_hole;
-			if (IP4_previous_hole(current_hole) == NULL)
-			{
-				new_hole->prev_hole_rel_pointer = 0;
-				list ->first_hole_rel_pointer = (unsigned long) new_hole
-						- (unsigned long) list->buffer;
-			} else
-			{
-				new_hole->prev_hole_rel_pointer = (unsigned long) new_hole
-						- (unsigned long) IP4_previous_hole(current_hole);
-				IP4_previous_hole(current_hole)->next_hole_rel_pointer
-						= new_hole->prev_hole_rel_pointer;
-			}
-
-			if (IP4_next_hole(current_hole) == NULL)
-			{
-				new_hole->next_hole_rel_pointer = 0;
-			} else
-			{
-				new_hole->next_hole_rel_pointer
-						= (unsigned long) IP4_next_hole(current_hole)
-								- (unsigned long) new_hole;
-				IP4_next_hole(current_hole)->prev_hole_rel_pointer
-						= new_hole->next_hole_rel_pointer;
-			}
-
-			new_hole->first = current_hole->first;
-			new_hole->last = fragment->first - 1;
+			*previous = IP4_new_hole(current_hole->first, fragment->first - 1, *previous);
+			previous = &(*previous)->next_hole;
 			list->hole_count++;
-			current_hole=new_hole;
 		}
-
-		/* Step 6
-		 * If fragment.last is less  than  hole.last  and  fragment.more_
-		 * fragments is true, then create a new hole descriptor
-		 * "new_hole", with new_hole.first equal to fragment.last plus
-		 * one and new_hole.last equal to hole.last.
-		 */
-		if ((fragment->last < current_hole->last) && (fragment->more_fragments
-				== 1))
+		if ((fragment->last < current_hole->last) && fragment->more_fragments)
 		{
-			new_hole = (struct ip4_reass_hole*) ((unsigned long) list->buffer
-					+ (unsigned long) fragment->last + 1);
-
-			if (IP4_previous_hole(current_hole) == NULL)
-			{
-				list->first_hole_rel_pointer = (unsigned long) new_hole
-						- (unsigned long) IP4_previous_hole(current_hole);
-				new_hole->prev_hole_rel_pointer = 0;
-			} else
-			{
-				new_hole->prev_hole_rel_pointer = (unsigned long) new_hole
-						- (unsigned long) IP4_previous_hole(current_hole);
-				IP4_previous_hole(current_hole)->next_hole_rel_pointer
-						= new_hole->prev_hole_rel_pointer;
-			}
-
-			if (IP4_next_hole(current_hole) == NULL)
-			{
-				new_hole->next_hole_rel_pointer = 0;
-			} else
-			{
-				new_hole->next_hole_rel_pointer
-						= (unsigned long) IP4_next_hole(current_hole)
-								- (unsigned long) new_hole;
-				IP4_next_hole(current_hole)->prev_hole_rel_pointer
-						= new_hole->next_hole_rel_pointer;
-			}
-
-			new_hole->first = fragment->last + 1;
-			new_hole->last = current_hole->last;
+			*previous = IP4_new_hole(fragment->last + 1, current_hole->last, *previous);
+			previous = &(*previous)->next_hole;
 			list->hole_count++;
-			current_hole=new_hole;
 		}
-
-		/* Step 7
-		 * Go to step one.
-		 */
+		IP4_free_hole(current_hole);
 	}
 
-	if (use_fragment == 1)
-	{
-		if (fragment->last < list->length)
-		{
-			memcpy((void *) ((unsigned long) list->buffer
-					+ (unsigned long) fragment->first),
-					(void *) fragment->data, fragment->data_length);
-		} else
-		{
-			/* todo: Packet reassembly buffer extension*/
-			PRINT_DEBUG("Packet buffer needs to be expanded to for packets larger than the defined initial buffer size.");
-		}
-	}
+	memcpy((uint8_t *) list->buffer + IP4_MIN_HLEN + fragment->first, fragment->data,
+			fragment->data_length);
 
 	/*
 	 * Step 8
 	 * If the hole descriptor list is now empty, the datagram is now
-	 * complete.  Pass it on to the higher level protocol  processor
-	 * for further handling.  Otherwise, return.
+	 * complete.
 	 */
-	if (list->hole_count == 0)
-	{
-		return (1);
-	} else
-	{
-		return (0);
-	}
+	return (list->holes == NULL);
 }
 
-struct ip4_reass_list* IP4_new_packet_entry(struct ip4_header* pheader,
-		struct ip4_reass_list* previous, struct ip4_reass_list* next)
+struct ip4_reass_list* IP4_new_packet_entry(struct ip4_header* pheader)
 {
 	struct ip4_reass_list* packet_list_entry = (struct ip4_reass_list*) malloc(
-			sizeof(struct ip4_reass_list*));
-	packet_list_entry->next_packet = next;
-	packet_list_entry->previous_packet = previous;
-	packet_list_entry = (struct ip4_reass_list*) malloc(
 			sizeof(struct ip4_reass_list));
+	unsigned int bucket = IP4_reass_hash(pheader);
+	unsigned int slot;
+
 	packet_list_entry->header = *pheader;
-	packet_list_entry->length = IP4_BUFFLEN;
-	packet_list_entry->buffer = (void *) malloc(IP4_BUFFLEN);
-	packet_list_entry->ttl = IP4_REASS_TTL;
-	packet_list_entry->first_hole_rel_pointer = 0;
+	packet_list_entry->length = 0;
+	packet_list_entry->total = 0;
+	packet_list_entry->buffer = malloc(IP4_MIN_HLEN);
 	packet_list_entry->hole_count = 1;
+	packet_list_entry->holes = IP4_new_hole(0, IP4_MAXLEN, NULL);
+	ip4_reass_bytes += sizeof(struct ip4_reass_list) + IP4_MIN_HLEN;
 
-	((struct ip4_reass_hole*) packet_list_entry->buffer)->first = 0;
-	((struct ip4_reass_hole*) packet_list_entry->buffer)->last = IP4_MAXLEN;
-	((struct ip4_reass_hole*) packet_list_entry->buffer)->next_hole_rel_pointer
-			= 0;
-	((struct ip4_reass_hole*) packet_list_entry->buffer)->prev_hole_rel_pointer
-			= 0;
+	packet_list_entry->previous_packet = NULL;
+	packet_list_entry->next_packet = ip4_reass_table[bucket];
+	if (packet_list_entry->next_packet != NULL)
+		packet_list_entry->next_packet->previous_packet = packet_list_entry;
+	ip4_reass_table[bucket] = packet_list_entry;
+
+	packet_list_entry->deadline = ip4_reass_tick + IP4_REASS_TTL;
+	slot = packet_list_entry->deadline % IP4_REASS_WHEEL;
+	packet_list_entry->previous_timer = NULL;
+	packet_list_entry->next_timer = ip4_reass_wheel[slot];
+	if (packet_list_entry->next_timer != NULL)
+		packet_list_entry->next_timer->previous_timer = packet_list_entry;
+	ip4_reass_wheel[slot] = packet_list_entry;
 	return (packet_list_entry);
 }
 
-struct ip4_fragment* IP4_construct_fragment(struct ip4_header* pheader,
-		struct ip4_packet* ppacket)
+void IP4_construct_fragment(struct ip4_header* pheader,
+		struct ip4_packet* ppacket, struct ip4_fragment *fragment)
 {
-	struct ip4_fragment* fragment = (struct ip4_fragment*) malloc(
-			sizeof(struct ip4_fragment));
 	fragment->first = (pheader->fragmentation_offset) * 8;
-	fragment->last = fragment->first + (pheader->packet_length
-			- pheader->header_length);
 	fragment->data_length = pheader->packet_length - pheader->header_length;
+	fragment->last = fragment->first + fragment->data_length - 1;
 	if (pheader->flags & IP4_MF)
 		fragment->more_fragments = 1;
 	else
 		fragment->more_fragments = 0;
 	fragment->data = (void*) ppacket + pheader->header_length;
-	return (fragment);
-}
-
-struct ip4_reass_hole* IP4_previous_hole(struct ip4_reass_hole* current_hole)
-{
-	if (current_hole->prev_hole_rel_pointer == 0)
-	{
-		return (NULL);
-	}
-	return ((struct ip4_reass_hole*) ((unsigned long) current_hole
-			+ current_hole->prev_hole_rel_pointer));
-}
-
-struct ip4_reass_hole* IP4_next_hole(struct ip4_reass_hole* current_hole)
-{
-	if (current_hole->next_hole_rel_pointer == 0)
-	{
-		return (NULL);
-	}
-	return ((struct ip4_reass_hole*) ((unsigned long) current_hole
-			+ current_hole->next_hole_rel_pointer));
-}
-
-void IP4_remove_hole(struct ip4_reass_hole* current_hole,
-		struct ip4_reass_list *list)
-{
-	struct ip4_reass_hole* next_hole = IP4_next_hole(current_hole);
-	struct ip4_reass_hole* previous_hole = IP4_previous_hole(current_hole);
-	if (previous_hole == NULL && next_hole == NULL)
-	{
-		list->first_hole_rel_pointer = 0;
-		list->hole_count = 0;
-		return;
-	}
-	if (next_hole == NULL)
-	{
-		previous_hole->next_hole_rel_pointer = 0;
-		list->hole_count--;
-		return;
-	}
-	if (previous_hole == NULL)
-	{
-		next_hole->prev_hole_rel_pointer = 0;
-		list->first_hole_rel_pointer += current_hole->next_hole_rel_pointer;
-		list->hole_count--;
-		return;
-	}
-	previous_hole->next_hole_rel_pointer += current_hole->next_hole_rel_pointer;
-	next_hole->prev_hole_rel_pointer += current_hole->prev_hole_rel_pointer;
-	list->hole_count--;
-	return;
 }
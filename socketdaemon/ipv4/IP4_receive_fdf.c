@@ -12,7 +12,6 @@
 extern IP4addr my_ip_addr;
 
 
-extern sem_t Switch_to_IPv4_Qsem;
 extern finsQueue Switch_to_IPv4_Queue;
 
 
@@ -21,12 +20,7 @@ void IP4_receive_fdf()
 {
 
 	struct finsFrame* pff = NULL;
-		do {
-			sem_wait(&Switch_to_IPv4_Qsem);
-				pff = read_queue(Switch_to_IPv4_Queue);
-			sem_post(&Switch_to_IPv4_Qsem);
-		}
-		while (pff == NULL);
+	pff = read_queue_wait(Switch_to_IPv4_Queue);
 
 
 
@@ -37,6 +31,7 @@ void IP4_receive_fdf()
 	if (pff->dataOrCtrl == CONTROL)
 	{
 			/** TODO:  Here goes code for control messages */
+		freeFinsFrame(pff);
 
 	}
 	else if (pff->dataOrCtrl == DATA)
@@ -66,12 +61,14 @@ void IP4_receive_fdf()
 		else
 		{
 			PRINT_DEBUG("Wrong value of fdf.directionFlag");
+			freeFinsFrame(pff);
 		}
 	}
 
 	else
 	{
 		PRINT_DEBUG("Wrong pff->dataOrCtrl value");
+		freeFinsFrame(pff);
 	}
 
 
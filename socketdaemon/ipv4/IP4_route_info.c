@@ -25,6 +25,18 @@ void IP4_print_routing_table(struct ip4_routing_table * table_pointer)
 	}
 }
 
+void IP4_free_routing_table(struct ip4_routing_table * table_pointer)
+{
+	struct ip4_routing_table *next_pointer;
+
+	while (table_pointer != NULL)
+	{
+		next_pointer = table_pointer->next_entry;
+		free(table_pointer);
+		table_pointer = next_pointer;
+	}
+}
+
 struct ip4_routing_table * IP4_sort_routing_table(
 		struct ip4_routing_table * table_pointer)
 {
@@ -40,7 +52,7 @@ struct ip4_routing_table * IP4_sort_routing_table(
 	{
 		swapped = 0;
 		previous = NULL;
-		current = table_pointer;
+		current = first;
 		while ((current!=NULL)&&(current->next_entry != NULL))
 		{
 			if (current->mask < current->next_entry->mask)
@@ -131,7 +143,11 @@ struct ip4_routing_table * parse_nlmsg(struct nlmsghdr* msg)
 	return (NULL);
 }
 
-struct ip4_routing_table * IP4_get_routing_table()
+/* Dumps the main routing table of the kernel into *table, NULL when it has
+ * no unicast route. Returns 0, or -1 if the dump failed: *table is then left
+ * alone, an incomplete dump is not an empty table
+ */
+int IP4_get_routing_table(struct ip4_routing_table **table)
 {
 	int nlmsg_len;
 	struct nlmsghdr* msg;
@@ -139,8 +155,9 @@ struct ip4_routing_table * IP4_get_routing_table()
 	char * receive_ptr;
 	unsigned int sock;
 	struct ip4_route_request route_req;
-	struct ip4_routing_table * routing_table;
+	struct ip4_routing_table * routing_table = NULL;
 	struct ip4_routing_table * current_table_entry;
+	int done;
 
 	unsigned int pid = (uint32_t) getpid();
 	unsigned int seq = (uint32_t) getppid();
@@ -148,7 +165,7 @@ struct ip4_routing_table * IP4_get_routing_table()
 	if ((sock = socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) == -1)
 	{
 		PRINT_DEBUG("couldn't open NETLINK_ROUTE socket");
-		return NULL;
+		return (-1);
 	}
 
 	/* prepare netlink message header*/
@@ -172,27 +189,41 @@ struct ip4_routing_table * IP4_get_routing_table()
 	if (result < 0)
 	{
 		PRINT_ERROR("Routing table request send error.");
-		return NULL;
+		close(sock);
+		return (-1);
 	}
 
 	memset(receive_buffer, 0, IP4_NETLINK_BUFF_SIZE);
 	receive_ptr = receive_buffer;
 	nlmsg_len = 0;
-	while (1)
+	done = 0;
+	while (!done)
 	{
+		/** every read starts over at the beginning of the buffer, a dump of
+		 * a big table takes many of them */
 		int msg_len = recv(sock, receive_ptr, IP4_NETLINK_BUFF_SIZE, 0);
 		if (msg_len < 0)
 		{
 			PRINT_ERROR("recv() error.");
-			return NULL; //ERROR
+			close(sock);
+			IP4_free_routing_table(routing_table);
+			return (-1); //ERROR
 		}
 		msg = (struct nlmsghdr *) receive_ptr;
-		if (msg->nlmsg_type == NLMSG_DONE)
-		{
-			break;
-		}
 		for (; 0 != NLMSG_OK(msg, msg_len); msg = NLMSG_NEXT(msg, msg_len))
 		{
+			if (msg->nlmsg_type == NLMSG_DONE)
+			{
+				done = 1;
+				break;
+			}
+			if (msg->nlmsg_type == NLMSG_ERROR && msg->nlmsg_seq == seq)
+			{
+				PRINT_ERROR("the kernel failed the routing table dump.");
+				close(sock);
+				IP4_free_routing_table(routing_table);
+				return (-1);
+			}
 			if (msg->nlmsg_seq == seq)
 			{
 				if (routing_table == NULL)
@@ -207,9 +238,10 @@ struct ip4_routing_table * IP4_get_routing_table()
 					}
 				}
 			}
-			receive_ptr = receive_ptr + msg_len;
-			nlmsg_len = nlmsg_len + msg_len;
 		}
+		nlmsg_len = nlmsg_len + msg_len;
 	}
-	return routing_table;
+	close(sock);
+	*table = routing_table;
+	return (0);
 }
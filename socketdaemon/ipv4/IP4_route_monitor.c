@@ -0,0 +1,115 @@
+/**
+ * @file IP4_route_monitor.c
+ * @brief keeps the routing table up to date with the kernel's
+ *
+ * A thread listens to the IPv4 route notifications of the kernel
+ * (RTMGRP_IPV4_ROUTE) and, after each burst of changes, dumps the table again
+ * and publishes it (IP4_route_publish). The lookups go on with the previous
+ * table meanwhile.
+ *
+ * @date Oct 17, 2026
+ */
+
+#include <errno.h>
+#include "ipv4.h"
+
+/** only this thread replaces it, see IP4_route_publish */
+extern struct ip4_routing_table* routing_table;
+
+/**@brief opens a NETLINK_ROUTE socket subscribed to the IPv4 route changes
+ * @return the socket, -1 on failure
+ */
+static int IP4_route_subscribe()
+{
+	struct sockaddr_nl address;
+	int sock;
+
+	sock = socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (sock == -1)
+	{
+		PRINT_DEBUG("couldn't open NETLINK_ROUTE socket");
+		return (-1);
+	}
+	memset(&address, 0, sizeof(struct sockaddr_nl));
+	address.nl_family = AF_NETLINK;
+	address.nl_groups = RTMGRP_IPV4_ROUTE;
+	if (bind(sock, (struct sockaddr *) &address, sizeof(struct sockaddr_nl)) == -1)
+	{
+		PRINT_DEBUG("couldn't subscribe to the route changes, errno %d", errno);
+		close(sock);
+		return (-1);
+	}
+	return (sock);
+
+}
+
+/**@brief the messages in buffer are route changes
+ * @return 1 if one of them is, 0 otherwise
+ */
+static int IP4_route_changed(char *buffer, int len)
+{
+	struct nlmsghdr *msg;
+
+	for (msg = (struct nlmsghdr *) buffer; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len))
+		if (msg->nlmsg_type == RTM_NEWROUTE || msg->nlmsg_type == RTM_DELROUTE)
+			return (1);
+	return (0);
+
+}
+
+/**@brief the route monitor thread, started by IP4_init
+ */
+void *IP4_route_monitor()
+{
+	char receive_buffer[IP4_NETLINK_BUFF_SIZE];
+	struct ip4_routing_table *table;
+	int sock;
+	int len;
+	int changed;
+
+	sock = IP4_route_subscribe();
+	if (sock == -1)
+		return (NULL);
+
+	while (1)
+	{
+		len = recv(sock, receive_buffer, IP4_NETLINK_BUFF_SIZE, 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		/** ENOBUFS: notifications were lost, the table is dumped anyway */
+		if (len < 0 && errno != ENOBUFS)
+		{
+			PRINT_ERROR("recv() error on the route monitor, errno %d", errno);
+			break;
+		}
+		changed = (len < 0) || IP4_route_changed(receive_buffer, len);
+
+		/** a burst of changes (an interface going down, a MANET topology
+		 * change) is one new table */
+		while ((len = recv(sock, receive_buffer, IP4_NETLINK_BUFF_SIZE, MSG_DONTWAIT)) != 0)
+		{
+			if (len < 0 && errno != ENOBUFS)
+				break;
+			changed |= (len < 0) || IP4_route_changed(receive_buffer, len);
+		}
+
+		if (!changed)
+			continue;
+		PRINT_DEBUG("the routes changed, reloading the routing table");
+		/** a failed dump keeps the current table, the changes that come
+		 * meanwhile are in the next dump anyway */
+		while (IP4_get_routing_table(&table) == -1)
+		{
+			PRINT_DEBUG("dumping the routing table failed, retrying");
+			sleep(IP4_ROUTE_RETRY_S);
+		}
+		IP4_route_publish(IP4_sort_routing_table(table));
+#ifdef DEBUG
+		IP4_print_routing_table(routing_table);
+#endif
+	}
+
+	close(sock);
+	return (NULL);
+
+}
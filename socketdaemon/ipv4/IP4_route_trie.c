@@ -0,0 +1,256 @@
+/**
+ * @file IP4_route_trie.c
+ * @brief the compiled routing table IP4_next_hop looks the routes up in
+ *
+ * A multibit trie of strides 16, 8 and 8 (the upper 16 bits of the
+ * destination index the root, the next two bytes a table of 256 slots each),
+ * so that a lookup takes one to three memory accesses whatever the number of
+ * routes. The prefixes are expanded to the stride boundaries: a /20 fills the
+ * 16 slots of its level 2 table it covers. The list returned by
+ * IP4_get_routing_table stays the routing table, the trie is built from it.
+ *
+ * A trie is never changed once published: a new table is compiled into a
+ * new trie which replaces the old one with an atomic swap (IP4_route_publish).
+ * The readers take no lock, the old trie is freed once every lookup that may
+ * still be using it is over (IP4_route_synchronize).
+ *
+ * @date Oct 17, 2026
+ */
+
+#include "ipv4.h"
+
+extern struct ip4_routing_table* routing_table;
+extern struct ip4_route_trie *route_trie;
+
+/** A thread looking routes up. seq is odd while the thread is in a lookup */
+struct ip4_route_reader
+{
+	unsigned long seq;
+} __attribute__ ((aligned (64)));
+
+static struct ip4_route_reader ip4_route_readers[IP4_ROUTE_READERS];
+static unsigned int ip4_route_reader_count;
+static __thread struct ip4_route_reader *ip4_route_self;
+
+/** the bits of the destination each level of the trie consumes */
+static const unsigned int ip4_trie_stride[IP4_TRIE_LEVELS] = { 16, 8, 8 };
+
+static uint32_t ip4_trie_mask(unsigned int length)
+{
+
+	if (length == 0)
+		return (0);
+	return (0xffffffffu << (IP4_ALEN * 8 - length));
+
+}
+
+/**@brief adds the route leaf for prefix/length. The routes have to be added
+ * in the order of their lengths, shortest first: a longer prefix then only
+ * overwrites the slots of the shorter ones it is more specific than
+ */
+static void ip4_trie_insert(struct ip4_route_trie *trie, uint32_t prefix, unsigned int length,
+		uint32_t leaf)
+{
+	uint32_t *slots = trie->root;
+	unsigned int depth = 0;	/** the bits of the destination consumed above slots */
+	unsigned int level = 0;
+	unsigned int first;
+	unsigned int count;
+	unsigned int i;
+	uint32_t *slot;
+
+	prefix &= ip4_trie_mask(length);
+	while (length > depth + ip4_trie_stride[level])
+	{
+		depth += ip4_trie_stride[level];
+		slot = &slots[(prefix >> (IP4_ALEN * 8 - depth)) & ((1u << ip4_trie_stride[level]) - 1)];
+		if (!(*slot & IP4_TRIE_TABLE))
+		{
+			/** the shorter prefix the slot held still covers the rest of the table */
+			for (i = 0; i < IP4_TRIE_TABLE_SIZE; i++)
+				trie->tables[trie->table_count][i] = *slot;
+			*slot = IP4_TRIE_TABLE | trie->table_count++;
+		}
+		slots = trie->tables[*slot & ~IP4_TRIE_TABLE];
+		level++;
+	}
+
+	depth += ip4_trie_stride[level];
+	first = (prefix >> (IP4_ALEN * 8 - depth)) & ((1u << ip4_trie_stride[level]) - 1);
+	count = 1u << (depth - length);
+	for (i = first; i < first + count; i++)
+		slots[i] = leaf;
+
+}
+
+/**@brief compiles the routes of table into a trie
+ * @return the trie, NULL if out of memory
+ */
+struct ip4_route_trie *IP4_route_trie_build(struct ip4_routing_table *table)
+{
+	struct ip4_route_trie *trie;
+	struct ip4_routing_table *current;
+	unsigned int tables = 0;
+	unsigned int length;
+	unsigned int i;
+
+	trie = (struct ip4_route_trie *) malloc(sizeof(struct ip4_route_trie));
+	if (trie == NULL)
+	{
+		PRINT_DEBUG("out of memory for the routing trie");
+		return (NULL);
+	}
+	memset(trie->root, 0, sizeof(trie->root));
+	trie->table_count = 0;
+	trie->route_count = 0;
+	trie->table = table;
+
+	/** every route longer than a stride adds one table per level at most */
+	for (current = table; current != NULL; current = current->next_entry)
+	{
+		trie->route_count++;
+		if (current->mask > ip4_trie_stride[0])
+			tables += (current->mask > ip4_trie_stride[0] + ip4_trie_stride[1]) ? 2 : 1;
+	}
+	trie->routes = (struct ip4_routing_table **) malloc(
+			(trie->route_count + 1) * sizeof(struct ip4_routing_table *));
+	trie->tables = (uint32_t (*)[IP4_TRIE_TABLE_SIZE]) malloc(
+			(tables + 1) * sizeof(uint32_t[IP4_TRIE_TABLE_SIZE]));
+	if (trie->routes == NULL || trie->tables == NULL)
+	{
+		PRINT_DEBUG("out of memory for the routing trie");
+		IP4_route_trie_free(trie);
+		return (NULL);
+	}
+	i = 0;
+	for (current = table; current != NULL; current = current->next_entry)
+		trie->routes[i++] = current;
+
+	/** of the routes of a same length, the first of the list is the one
+	 * that stays, as when the list was walked */
+	for (length = 0; length <= IP4_ALEN * 8; length++)
+		for (i = trie->route_count; i-- > 0;)
+			if (trie->routes[i]->mask == length)
+				ip4_trie_insert(trie, (uint32_t) trie->routes[i]->dst, length, i + 1);
+
+	PRINT_DEBUG("%u routes compiled into %u tables", trie->route_count, trie->table_count);
+	return (trie);
+
+}
+
+void IP4_route_trie_free(struct ip4_route_trie *trie)
+{
+
+	if (trie == NULL)
+		return;
+	free(trie->routes);
+	free(trie->tables);
+	free(trie);
+
+}
+
+/**@brief the longest prefix match of dst
+ * @return the route, NULL if none matches
+ */
+struct ip4_routing_table *IP4_route_trie_lookup(struct ip4_route_trie *trie, IP4addr dst)
+{
+	uint32_t address = (uint32_t) dst;
+	uint32_t slot;
+
+	slot = trie->root[address >> 16];
+	if (slot & IP4_TRIE_TABLE)
+	{
+		slot = trie->tables[slot & ~IP4_TRIE_TABLE][(address >> 8) & 0xff];
+		if (slot & IP4_TRIE_TABLE)
+			slot = trie->tables[slot & ~IP4_TRIE_TABLE][address & 0xff];
+	}
+	if (slot == 0)
+		return (NULL);
+	return (trie->routes[slot - 1]);
+
+}
+
+/**@brief starts a lookup, the trie returned stays valid until IP4_route_leave
+ * @return the current trie, NULL if there is none yet
+ */
+struct ip4_route_trie *IP4_route_enter()
+{
+	struct ip4_route_reader *self = ip4_route_self;
+	unsigned int i;
+
+	if (self == NULL)
+	{
+		i = __atomic_fetch_add(&ip4_route_reader_count, 1, __ATOMIC_SEQ_CST);
+		if (i >= IP4_ROUTE_READERS)
+		{
+			PRINT_DEBUG("more than %d threads look routes up", IP4_ROUTE_READERS);
+			exit(1);
+		}
+		self = ip4_route_self = &ip4_route_readers[i];
+	}
+
+	__atomic_store_n(&self->seq, self->seq + 1, __ATOMIC_RELAXED);
+	/** orders the store before the load of route_trie, pairs with the swap
+	 * in IP4_route_publish */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return (__atomic_load_n(&route_trie, __ATOMIC_ACQUIRE));
+
+}
+
+void IP4_route_leave()
+{
+
+	__atomic_store_n(&ip4_route_self->seq, ip4_route_self->seq + 1, __ATOMIC_RELEASE);
+
+}
+
+/**@brief waits for the end of the lookups that were going on when it was
+ * called. A lookup that started later sees the trie published before
+ */
+void IP4_route_synchronize()
+{
+	unsigned int count = __atomic_load_n(&ip4_route_reader_count, __ATOMIC_SEQ_CST);
+	unsigned long seq;
+	unsigned int i;
+
+	if (count > IP4_ROUTE_READERS)
+		count = IP4_ROUTE_READERS;
+	for (i = 0; i < count; i++)
+	{
+		seq = __atomic_load_n(&ip4_route_readers[i].seq, __ATOMIC_SEQ_CST);
+		if (!(seq & 1))
+			continue;
+		while (__atomic_load_n(&ip4_route_readers[i].seq, __ATOMIC_ACQUIRE) == seq)
+			usleep(IP4_ROUTE_GRACE_US);
+	}
+
+}
+
+/**@brief makes table (sorted) the routing table: compiles it into a trie,
+ * publishes the trie and frees the previous one with its table once no
+ * lookup uses them anymore. Called by one thread at a time
+ * @return 0 on success, -1 if out of memory (table is freed, the previous
+ * routing table stays)
+ */
+int IP4_route_publish(struct ip4_routing_table *table)
+{
+	struct ip4_route_trie *trie;
+	struct ip4_route_trie *old;
+
+	trie = IP4_route_trie_build(table);
+	if (trie == NULL)
+	{
+		IP4_free_routing_table(table);
+		return (-1);
+	}
+	routing_table = table;
+	old = __atomic_exchange_n(&route_trie, trie, __ATOMIC_SEQ_CST);
+	if (old != NULL)
+	{
+		IP4_route_synchronize();
+		IP4_free_routing_table(old->table);
+		IP4_route_trie_free(old);
+	}
+	return (0);
+
+}
@@ -7,18 +7,22 @@
 
 #include "ipv4.h"
 #include <queueModule.h>
+#include <finsCsum.h>
 
 
 extern finsQueue IPv4_to_Switch_Queue;
-extern sem_t IPv4_to_Switch_Qsem;
 
 
 
-void IP4_send_fdf_in(struct ip4_header* pheader, struct ip4_packet* ppacket)
+/**
+ * ff carries the packet, its pdu starting at ppacket. The same frame goes on
+ * up with the IP header pulled off its pdu: the payload stays in the buffer it
+ * was captured into, which can then be lent to the socket reading it
+ */
+void IP4_send_fdf_in(struct finsFrame *fins_frame, struct ip4_header* pheader,
+		struct ip4_packet* ppacket)
 {
 
-struct finsFrame *fins_frame = (struct finsFrame *)malloc(sizeof(struct finsFrame));
-char *data;
 PRINT_DEBUG("IP4_send_fdf_in() called");
 	fins_frame->dataOrCtrl = DATA;
 	switch (pheader->protocol)
@@ -36,28 +40,31 @@ PRINT_DEBUG("IP4_send_fdf_in() called");
 	PRINT_DEBUG();
 	fins_frame->destinationID.next = NULL;
 	fins_frame->dataFrame.directionFlag = UP;
+	/** the link layer may have padded the packet */
+	fins_frame_pull(&fins_frame->dataFrame, pheader->header_length);
 	fins_frame->dataFrame.pduLength = pheader->packet_length - pheader->header_length;
-//	fins_frame->dataFrame.pduLength = pheader->packet_length - 20;
-	data = (char *)malloc(pheader->packet_length - pheader->header_length );
-	memcpy(data,ppacket->ip_data,pheader->packet_length - pheader->header_length);
-	fins_frame->dataFrame.pdu = data ;
+	/** summed here for the checksum of the transport layer above */
+	fins_frame->dataFrame.csum = fins_csum_partial(fins_frame->dataFrame.pdu,
+			fins_frame->dataFrame.pduLength, 0);
+	fins_frame->dataFrame.csumValid = 1;
 /**	char ssss[20];
 	memcpy(ssss,(ppacket->ip_data)+ 8, (pheader->packet_length - pheader->header_length) -8);
 	ssss [(pheader->packet_length - pheader->header_length) -8 ];
 	PRINT_DEBUG("%s",ssss);
 */
-	metadata *ipv4_meta = (metadata *)malloc (sizeof(metadata));
-
-	metadata_create(ipv4_meta);
+	metadata *ipv4_meta = allocMetadata();
 
 	IP4addr srcaddress = ppacket->ip_src;
 	IP4addr dstaddress = ppacket->ip_dst;
 	uint16_t protocol = ppacket->ip_proto; /* protocol number should  be 17 from metadata */
 /** Filling into the metadata with sourceIP, DestinationIP, and ProtocolNumber */
 
-	metadata_writeToElement(ipv4_meta,"ipsrc",&srcaddress, META_TYPE_INT);
-	metadata_writeToElement(ipv4_meta,"ipdst",&dstaddress, META_TYPE_INT);
-	metadata_writeToElement(ipv4_meta,"protocol",&protocol, META_TYPE_INT);
+	metadata_set_srcip(ipv4_meta,srcaddress);
+	metadata_set_dstip(ipv4_meta,dstaddress);
+	metadata_set_protocol(ipv4_meta,protocol);
+	/** the metadata of the link layer is of no use above */
+	if (fins_frame->dataFrame.metaData != NULL)
+		releaseMetadata(fins_frame->dataFrame.metaData);
 	fins_frame->dataFrame.metaData = ipv4_meta;
 	PRINT_DEBUG("protocol %d ,srcip %d,dstip %d", protocol,srcaddress,dstaddress);
 
@@ -77,36 +84,30 @@ void IP4_send_fdf_out(struct finsFrame *ff, struct ip4_packet* ppacket,
 
 	}
 
-	print_finsFrame(ff);
-	struct finsFrame *fins_frame = (struct finsFrame *)malloc(sizeof(struct finsFrame));
-	char *data;
+	/** the IP header is written into the headroom in front of the transport
+	 * payload, the frame itself goes on down to the Ethernet stub */
 	PRINT_DEBUG("IP4_send_fdf_out() called.");
-	fins_frame->dataOrCtrl = DATA;
-	(fins_frame->destinationID).id = ETHERSTUBID;
-	(fins_frame->destinationID).next = NULL;
-	(fins_frame->dataFrame).directionFlag = DOWN;
-	(fins_frame->dataFrame.metaData) = ff->dataFrame.metaData;
-	(fins_frame->dataFrame).pduLength = length + IP4_MIN_HLEN;
-	//(fins_frame->dataFrame).pdu = (unsigned char *)ppacket;
-
-
-	data = (char *)malloc (length + IP4_MIN_HLEN);
-
-	memcpy(data,ppacket,IP4_MIN_HLEN);
-	memcpy(data + IP4_MIN_HLEN, ff->dataFrame.pdu, ff->dataFrame.pduLength);
-	(fins_frame->dataFrame).pdu = data;
+	if (fins_frame_length(&ff->dataFrame) != length)
+	{
+		PRINT_DEBUG("pdu length %d, expected %d", fins_frame_length(&ff->dataFrame), length);
+	}
+	memcpy(fins_frame_push(&ff->dataFrame, IP4_MIN_HLEN), ppacket, IP4_MIN_HLEN);
+	(ff->destinationID).id = ETHERSTUBID;
+	(ff->destinationID).next = NULL;
+	(ff->dataFrame).directionFlag = DOWN;
 
-	print_finsFrame(fins_frame);
-	free(ff);
+	print_finsFrame(ff);
 	//fins_frame.dataFrame.metaData = ..... // todo: meta data needs to be filled with the required info.
-	sendToSwitch_IPv4(fins_frame);
+	sendToSwitch_IPv4(ff);
 }
 
 //todo: needs to be replaced by something meaningful
 void sendToSwitch_IPv4(struct finsFrame *fins_frame)
 {
 
-	sem_wait(&IPv4_to_Switch_Qsem);
-		write_queue(fins_frame,IPv4_to_Switch_Queue);
-	sem_post(&IPv4_to_Switch_Qsem);
+	if (write_queue(fins_frame,IPv4_to_Switch_Queue) == 0)
+	{
+		PRINT_DEBUG("IPv4_to_Switch_Queue full, frame dropped");
+		freeFinsFrame(fins_frame);
+	}
 }
@@ -13,6 +13,7 @@
 IP4addr my_ip_addr;
 IP4addr my_mask;
 struct ip4_routing_table* routing_table;
+struct ip4_route_trie *route_trie;
 struct ip4_packet *construct_packet_buffer;
 struct ip4_stats stats;
 
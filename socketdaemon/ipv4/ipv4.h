@@ -14,6 +14,7 @@
 #include <arpa/inet.h>
 #include <linux/rtnetlink.h> 	// RT... stuff
 #include <unistd.h>  			// getpid(), getppid()
+#include <pthread.h>
 #include <inttypes.h>
 #include <netinet/in.h>
 //#include <stdarg.h>
@@ -108,23 +109,27 @@ struct ip4_stats
 
 };
 
-struct ip4_reass_list
-{
-	struct ip4_reass_list *next_packet, *previous_packet;
-	uint8_t ttl;
-	struct ip4_header header;
-	int first_hole_rel_pointer;
-	void *buffer;
-	uint16_t length;
-	uint16_t hole_count;
-};
-
+/* The bytes of a datagram being reassembled that are still missing (RFC 815) */
 struct ip4_reass_hole
 {
 	uint16_t first;
 	uint16_t last;
-	uint16_t next_hole_rel_pointer;
-	uint16_t prev_hole_rel_pointer;
+	struct ip4_reass_hole *next_hole;
+};
+
+/* A datagram being reassembled, in its bucket of the hash table and in the
+ * slot of the timer wheel of its deadline */
+struct ip4_reass_list
+{
+	struct ip4_reass_list *next_packet, *previous_packet;	/* the bucket */
+	struct ip4_reass_list *next_timer, *previous_timer;	/* the wheel slot */
+	unsigned long deadline;	/* the tick (second) the datagram is dropped at */
+	struct ip4_header header;
+	struct ip4_reass_hole *holes;	/* in order, none once the datagram is complete */
+	void *buffer;	/* IP4_MIN_HLEN bytes for the header, then the data */
+	uint16_t length;	/* the data bytes buffer has room for */
+	uint16_t total;	/* the data bytes of the datagram, 0 until its last fragment came */
+	uint16_t hole_count;
 };
 
 struct ip4_fragment
@@ -154,6 +159,30 @@ struct ip4_routing_table
 	struct ip4_routing_table * next_entry;
 };
 
+/** the routing table compiled for the lookups, see IP4_route_trie.c. A
+ * slot holds 0 (no route), the index + 1 of a route in routes, or
+ * IP4_TRIE_TABLE | the index of the next level table in tables */
+#define IP4_TRIE_LEVELS		3
+#define IP4_TRIE_TABLE_SIZE	256
+#define IP4_TRIE_TABLE		0x80000000u
+
+struct ip4_route_trie
+{
+	uint32_t root[1 << 16];
+	uint32_t (*tables)[IP4_TRIE_TABLE_SIZE];
+	unsigned int table_count;
+	struct ip4_routing_table **routes;
+	unsigned int route_count;
+	struct ip4_routing_table *table;	/** the list the trie was built from */
+};
+
+/** the threads looking routes up, see IP4_route_enter */
+#define IP4_ROUTE_READERS	16
+/** how often IP4_route_synchronize checks a reader still in a lookup */
+#define IP4_ROUTE_GRACE_US	50
+/** how long the route monitor waits to dump the routes again after a failed dump (s) */
+#define IP4_ROUTE_RETRY_S	1
+
 struct ip4_next_hop_info
 {
 	IP4addr address;
@@ -168,6 +197,9 @@ struct ip4_next_hop_info
 #define	IP4_MAXLEN		65535	/* Maximum IP datagram length (bytes)					*/
 #define IP4_BUFFLEN		9000	/* Initial reassembly buffer size (bytes)				*/
 #define IP4_REASS_TTL	60		/* Time (sec) to wait for fragments of packet to arrive	*/
+#define IP4_REASS_BUCKETS	1024	/* hash buckets of the reassembly table, a power of two	*/
+#define IP4_REASS_WHEEL	64		/* slots (of a second) of the reassembly timer wheel, > IP4_REASS_TTL */
+#define IP4_REASS_BUDGET	(1 << 20)	/* bytes all the datagrams being reassembled may take */
 #define IP4_PCK_LEN		1500	/* Length of IP packets to be constructed				*/
 /* IPv4 masks*/
 #define	IP4_MF			0x1		/* more fragments bit			*/
@@ -234,22 +266,18 @@ void IP4_in(struct finsFrame *ff, struct ip4_packet* ppacket, int len);
 unsigned short IP4_checksum(struct ip4_packet* ptr, int length);
 int IP4_dest_check(IP4addr destination);
 //void IP4_reass(void);
-void IP4_send_fdf_in(struct ip4_header*, struct ip4_packet*);
+void IP4_send_fdf_in(struct finsFrame *ff, struct ip4_header*, struct ip4_packet*);
 
 void IP4_send_fdf_out(struct finsFrame *ff, struct ip4_packet* ppacket,
 		struct ip4_next_hop_info next_hop, uint16_t length);
 
-uint8_t IP4_add_fragment(struct ip4_reass_list*, struct ip4_fragment*);
+int IP4_add_fragment(struct ip4_reass_list*, struct ip4_fragment*);
 struct ip4_packet* IP4_reass(struct ip4_header *header,
 		struct ip4_packet *packet);
-struct ip4_reass_list* IP4_new_packet_entry(struct ip4_header* pheader,
-		struct ip4_reass_list* previous, struct ip4_reass_list* next);
-struct ip4_fragment* IP4_construct_fragment(struct ip4_header* pheader,
-		struct ip4_packet* ppacket);
-struct ip4_reass_hole* IP4_previous_hole(struct ip4_reass_hole* current_hole);
-struct ip4_reass_hole* IP4_next_hole(struct ip4_reass_hole* current_hole);
-void IP4_remove_hole(struct ip4_reass_hole* current_hole,
-		struct ip4_reass_list *list);
+void IP4_reass_expire();
+struct ip4_reass_list* IP4_new_packet_entry(struct ip4_header* pheader);
+void IP4_construct_fragment(struct ip4_header* pheader,
+		struct ip4_packet* ppacket, struct ip4_fragment *fragment);
 void IP4_const_header(struct ip4_packet *packet, IP4addr source, IP4addr destination,
 		uint8_t protocol);
 struct ip4_fragment IP4_fragment_data(void *data, uint16_t length,
@@ -258,10 +286,19 @@ struct ip4_fragment IP4_fragment_data(void *data, uint16_t length,
 void IP4_out(struct finsFrame *ff, uint16_t length, IP4addr source,uint8_t protocol);
 
 
-struct ip4_routing_table * IP4_get_routing_table();
+int IP4_get_routing_table(struct ip4_routing_table **table);
 struct ip4_routing_table * IP4_sort_routing_table(
 		struct ip4_routing_table * table_pointer);
 void IP4_print_routing_table(struct ip4_routing_table * table_pointer);
+struct ip4_route_trie *IP4_route_trie_build(struct ip4_routing_table *table);
+void IP4_route_trie_free(struct ip4_route_trie *trie);
+struct ip4_routing_table *IP4_route_trie_lookup(struct ip4_route_trie *trie, IP4addr dst);
+struct ip4_route_trie *IP4_route_enter();
+void IP4_route_leave();
+void IP4_route_synchronize();
+int IP4_route_publish(struct ip4_routing_table *table);
+void IP4_free_routing_table(struct ip4_routing_table *table_pointer);
+void *IP4_route_monitor();
 void IP4_init();
 struct ip4_next_hop_info IP4_next_hop(IP4addr dst);
 int IP4_forward(struct finsFrame *ff, struct ip4_packet* ppacket, IP4addr dest, uint16_t length);
@@ -0,0 +1,292 @@
+/**@file test_reass.c
+ *@brief tests the reassembly of IP4_reass.c
+ *
+ * Built on its own, with IP4_reass.c. The datagrams are sent as fragments
+ * out of order and overlapping, with duplicate and inconsistent last
+ * fragments; every datagram completed has to be complete exactly when its
+ * last byte came and carry the bytes sent. The timer wheel and the byte
+ * budget are run on a clock the test sets, see clock_gettime below
+ *@date Oct 17, 2026
+ */
+#include <time.h>
+#include <sys/syscall.h>
+#include "ipv4.h"
+
+#define TEST_ROUNDS		500	/**<datagrams sent as random fragments*/
+#define TEST_LENGTH		20000	/**<the largest of these datagrams (bytes of data)*/
+#define TEST_BIG		60000	/**<the first fragment of the datagrams filling the budget*/
+#define TEST_BIG_COUNT	30	/**<datagrams sent to overflow the budget*/
+
+struct ip4_stats stats;
+
+static unsigned int failures;
+static time_t test_now = 1000;	/**<the seconds of CLOCK_MONOTONIC*/
+
+/**
+ * @brief the reassembly reads the time through clock_gettime, the test
+ * moves CLOCK_MONOTONIC itself so that it does not wait for the timeouts
+ */
+int clock_gettime(clockid_t clock, struct timespec *tp)
+{
+	if (clock != CLOCK_MONOTONIC)
+		return (syscall(SYS_clock_gettime, clock, tp));
+	tp->tv_sec = test_now;
+	tp->tv_nsec = 0;
+	return (0);
+}
+
+/**
+ * @brief the byte at position of the data of datagram id
+ */
+static uint8_t test_byte(uint16_t id, unsigned int position)
+{
+	return ((id * 131 + position * 7 + (position >> 8)) & 0xff);
+}
+
+static void test_fail(const char *what, uint16_t id)
+{
+	printf("FAIL %s: datagram %u\n", what, id);
+	failures++;
+}
+
+/**
+ * @brief sends IP4_reass the fragment of datagram id of the length bytes
+ * at offset and checks the datagram if it is complete
+ * @return 1 if the datagram was completed by the fragment, 0 otherwise
+ */
+static int send_fragment(uint16_t id, unsigned int offset, unsigned int length, int more)
+{
+	struct ip4_header header;
+	struct ip4_packet *reassembled;
+	uint8_t *fragment;
+	uint8_t *data;
+	unsigned int total;
+	unsigned int i;
+
+	fragment = (uint8_t *) malloc(IP4_MIN_HLEN + length);
+	memset(fragment, 0, IP4_MIN_HLEN);
+	for (i = 0; i < length; i++)
+		fragment[IP4_MIN_HLEN + i] = test_byte(id, offset + i);
+
+	memset(&header, 0, sizeof(struct ip4_header));
+	header.source = IP4_ADR_P2N(10,0,0,1);
+	header.destination = IP4_ADR_P2N(10,0,0,2);
+	header.version = IP4_VERSION;
+	header.header_length = IP4_MIN_HLEN;
+	header.packet_length = IP4_MIN_HLEN + length;
+	header.id = id;
+	header.flags = more ? IP4_MF : 0;
+	header.fragmentation_offset = offset / 8;
+	header.ttl = IP4_INIT_TTL;
+	header.protocol = IPPROTO_UDP;
+
+	reassembled = IP4_reass(&header, (struct ip4_packet *) fragment);
+	free(fragment);
+	if (reassembled == NULL)
+		return (0);
+
+	total = header.packet_length - IP4_MIN_HLEN;
+	if (header.header_length != IP4_MIN_HLEN || header.fragmentation_offset != 0
+			|| ntohs(reassembled->ip_len) != header.packet_length)
+		test_fail("header of the reassembled datagram", id);
+	data = (uint8_t *) reassembled + IP4_MIN_HLEN;
+	for (i = 0; i < total; i++)
+		if (data[i] != test_byte(id, i))
+		{
+			test_fail("data of the reassembled datagram", id);
+			break;
+		}
+	free(reassembled);
+	return (1);
+}
+
+/**
+ * @brief sends the datagram id of total bytes as random fragments, in any
+ * order and overlapping each other, then what is still missing if need be.
+ * The datagram has to complete with the fragment that brings its last
+ * missing byte and not before
+ */
+static void test_random_fragments(uint16_t id, unsigned int total)
+{
+	uint8_t covered[TEST_LENGTH];
+	unsigned int missing = total;
+	unsigned int offset;
+	unsigned int length;
+	unsigned int sent;
+	unsigned int i;
+	int last_sent = 0;
+	int more;
+	int complete;
+
+	memset(covered, 0, total);
+	for (sent = 0; missing != 0 || !last_sent; sent++)
+	{
+		if (sent < 20)
+		{
+			offset = 8 * (rand() % ((total + 7) / 8));
+			length = 8 + 8 * (rand() % 200);
+		}
+		else
+		{
+			/** the first hole, then the last fragment */
+			for (offset = 0; offset < total && covered[offset]; offset++)
+				;
+			if (offset == total)
+				offset = (total - 1) & ~7u;
+			offset &= ~7u;
+			length = (IP4_PCK_LEN - IP4_MIN_HLEN) & ~7u;
+		}
+		more = 1;
+		if (offset + length >= total)
+		{
+			length = total - offset;
+			more = 0;
+			last_sent = 1;
+		}
+		for (i = offset; i < offset + length; i++)
+			if (!covered[i])
+			{
+				covered[i] = 1;
+				missing--;
+			}
+		complete = send_fragment(id, offset, length, more);
+		if (complete != (missing == 0 && last_sent))
+		{
+			test_fail(complete ? "completed too early" : "not completed", id);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief last fragments sent again, and last fragments that end elsewhere
+ * than the first one did
+ */
+static void test_last_fragments()
+{
+	unsigned int dropped;
+
+	/** the same last fragment twice, before and after the first fragment */
+	if (send_fragment(1000, 800, 100, 0) || send_fragment(1000, 800, 100, 0)
+			|| !send_fragment(1000, 0, 800, 1))
+		test_fail("duplicate last fragment", 1000);
+	/** between the other fragments, and once the datagram is complete */
+	if (send_fragment(1001, 800, 100, 0) || send_fragment(1001, 0, 400, 1)
+			|| send_fragment(1001, 800, 100, 0) || !send_fragment(1001, 400, 400, 1)
+			|| send_fragment(1001, 800, 100, 0))
+		test_fail("duplicate last fragment", 1001);
+
+	/** a last fragment ending earlier or later than the first one is dropped */
+	dropped = stats.fragdropped;
+	if (send_fragment(1002, 800, 100, 0) || send_fragment(1002, 800, 40, 0)
+			|| send_fragment(1002, 800, 200, 0) || send_fragment(1002, 896, 8, 1))
+		test_fail("inconsistent last fragment", 1002);
+	if (stats.fragdropped != dropped + 3)
+		test_fail("inconsistent last fragments not dropped", 1002);
+	if (!send_fragment(1002, 0, 800, 1))
+		test_fail("datagram after inconsistent last fragments", 1002);
+
+	/** bytes past the end of the datagram came before its last fragment */
+	dropped = stats.fragdropped;
+	if (send_fragment(1003, 800, 400, 1) || send_fragment(1003, 400, 100, 0))
+		test_fail("last fragment before bytes already come", 1003);
+	if (stats.fragdropped != dropped + 1)
+		test_fail("last fragment before bytes already come not dropped", 1003);
+	send_fragment(1003, 0, 800, 1);
+	if (!send_fragment(1003, 1200, 8, 0))
+		test_fail("datagram after an early last fragment", 1003);
+}
+
+/**
+ * @brief datagrams whose fragments do not all come in IP4_REASS_TTL
+ * seconds are dropped, the others complete
+ */
+static void test_expiry()
+{
+	unsigned int timedout;
+
+	/** from no datagram pending */
+	test_now += IP4_REASS_TTL;
+	IP4_reass_expire();
+	timedout = stats.timedout;
+
+	send_fragment(2000, 0, 800, 1);
+	test_now += IP4_REASS_TTL - 1;
+	IP4_reass_expire();
+	if (stats.timedout != timedout || !send_fragment(2000, 800, 100, 0))
+		test_fail("datagram completed in time", 2000);
+
+	send_fragment(2001, 0, 800, 1);
+	test_now += IP4_REASS_TTL;
+	IP4_reass_expire();
+	if (stats.timedout != timedout + 1)
+		test_fail("datagram not timed out", 2001);
+	if (send_fragment(2001, 800, 100, 0))
+		test_fail("datagram completed after it timed out", 2001);
+
+	/** the clock jumps by more than a turn of the wheel */
+	send_fragment(2002, 0, 800, 1);
+	test_now += 10 * IP4_REASS_WHEEL;
+	IP4_reass_expire();
+	if (stats.timedout != timedout + 3)
+		test_fail("datagrams not timed out after a jump", 2002);
+	if (send_fragment(2002, 800, 100, 0))
+		test_fail("datagram completed after a jump", 2002);
+
+	/** the ones of the other slots stay */
+	send_fragment(2003, 0, 800, 1);
+	test_now += 1;
+	send_fragment(2004, 0, 800, 1);
+	test_now += IP4_REASS_TTL - 1;
+	IP4_reass_expire();
+	if (send_fragment(2003, 800, 100, 0) || !send_fragment(2004, 800, 100, 0))
+		test_fail("datagrams of consecutive slots", 2003);
+}
+
+/**
+ * @brief once IP4_REASS_BUDGET bytes are taken, the oldest datagrams are
+ * dropped to make room for the new ones
+ */
+static void test_budget()
+{
+	unsigned int dropped = stats.fragdropped;
+	unsigned int timedout = stats.timedout;
+	unsigned int i;
+
+	for (i = 0; i < TEST_BIG_COUNT; i++)
+	{
+		send_fragment(3000 + i, 0, TEST_BIG, 1);
+		test_now += 1;
+	}
+	if (stats.fragdropped == dropped || stats.timedout != timedout)
+		test_fail("no datagram dropped over the budget", 3000);
+
+	/** the newest completes, most recent first */
+	for (i = TEST_BIG_COUNT; i-- > TEST_BIG_COUNT - (IP4_REASS_BUDGET / TEST_BIG) / 2;)
+		if (!send_fragment(3000 + i, TEST_BIG, 100, 0))
+			test_fail("datagram dropped within the budget", 3000 + i);
+	if (send_fragment(3000, TEST_BIG, 100, 0))
+		test_fail("oldest datagram not dropped", 3000);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int round;
+
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+		test_random_fragments(round, 1 + rand() % TEST_LENGTH);
+	if (stats.fragdropped != 0)
+		test_fail("fragments dropped", 0);
+	test_last_fragments();
+	test_expiry();
+	test_budget();
+
+	/** what is left times out */
+	test_now += IP4_REASS_WHEEL + IP4_REASS_TTL;
+	IP4_reass_expire();
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return (failures ? 1 : 0);
+}
@@ -0,0 +1,300 @@
+/**@file test_route_trie.c
+ *@brief tests the routing trie of IP4_route_trie.c against the linear walk
+ * of the sorted routing list IP4_next_hop used to do
+ *
+ * Built on its own, with IP4_route_trie.c, IP4_route_info.c and
+ * IP4_next_hop.c. Random tables of overlapping prefixes of every length
+ * (/0 and /32 included) are published, then routes are deleted and replaced
+ * and the table published again. Every destination looked up has to get the
+ * same route from the trie as from the list
+ *@date Oct 17, 2026
+ */
+#include "ipv4.h"
+
+#define TEST_ROUNDS		50	/**<tables published from scratch*/
+#define TEST_ROUTES		200	/**<routes of a table*/
+#define TEST_CHANGES	20	/**<deletions and replacements of a table*/
+#define TEST_LOOKUPS	20000	/**<destinations looked up in a table*/
+
+struct ip4_routing_table* routing_table;
+struct ip4_route_trie *route_trie;
+
+static unsigned int failures;
+
+static uint32_t test_random()
+{
+	return (((uint32_t) rand() << 16) ^ (uint32_t) rand());
+}
+
+static uint32_t test_mask(unsigned int length)
+{
+	if (length == 0)
+		return (0);
+	return (0xffffffffu << (32 - length));
+}
+
+/**
+ * @brief the route the list walk finds for dst: the list is sorted longest
+ * prefix first, so the first route that matches is the longest match, and
+ * of the routes of a same length the one listed first
+ */
+static struct ip4_routing_table *linear_lookup(struct ip4_routing_table *table, uint32_t dst)
+{
+	uint32_t mask;
+
+	for (; table != NULL; table = table->next_entry)
+	{
+		mask = test_mask(table->mask);
+		if (((uint32_t) table->dst & mask) == (dst & mask))
+			return (table);
+	}
+	return (NULL);
+}
+
+/**
+ * @brief a route of random length, half of them more or less specific
+ * than a route already in table so that the prefixes overlap
+ */
+static struct ip4_routing_table *gen_route(struct ip4_routing_table *table, unsigned int count)
+{
+	struct ip4_routing_table *route;
+	struct ip4_routing_table *base;
+	unsigned int length;
+	unsigned int i;
+
+	route = (struct ip4_routing_table *) malloc(sizeof(struct ip4_routing_table));
+	memset(route, 0, sizeof(struct ip4_routing_table));
+	switch (rand() % 8)
+	{
+	case 0:
+		length = 0;
+		break;
+	case 1:
+		length = 32;
+		break;
+	default:
+		length = rand() % 33;
+		break;
+	}
+	route->dst = test_random();
+	if (table != NULL && rand() % 2)
+	{
+		base = table;
+		for (i = rand() % count; i > 0 && base->next_entry != NULL; i--)
+			base = base->next_entry;
+		route->dst = (base->dst & test_mask(base->mask)) | (test_random() & ~test_mask(base->mask));
+	}
+	/** the host bits of dst are left in, the lookups have to ignore them */
+	route->mask = length;
+	route->gw = test_random() % 4 ? test_random() : 0;
+	route->interface = rand() % 4;
+	route->metric = rand() % 100;
+	return (route);
+}
+
+static struct ip4_routing_table *copy_table(struct ip4_routing_table *table)
+{
+	struct ip4_routing_table *first = NULL;
+	struct ip4_routing_table **last = &first;
+
+	for (; table != NULL; table = table->next_entry)
+	{
+		*last = (struct ip4_routing_table *) malloc(sizeof(struct ip4_routing_table));
+		memcpy(*last, table, sizeof(struct ip4_routing_table));
+		last = &(*last)->next_entry;
+	}
+	*last = NULL;
+	return (first);
+}
+
+/**
+ * @brief a destination inside one of the routes of table, at a boundary of
+ * it or anywhere
+ */
+static uint32_t gen_dst(struct ip4_routing_table *table, unsigned int count)
+{
+	struct ip4_routing_table *route = table;
+	uint32_t mask;
+	unsigned int i;
+
+	if (table == NULL || rand() % 4 == 0)
+		return (test_random());
+	for (i = rand() % count; i > 0 && route->next_entry != NULL; i--)
+		route = route->next_entry;
+	mask = test_mask(route->mask);
+	switch (rand() % 4)
+	{
+	case 0:
+		return ((uint32_t) route->dst & mask);
+	case 1:
+		return (((uint32_t) route->dst & mask) | ~mask);
+	case 2:
+		/** just past either end of the prefix */
+		return ((((uint32_t) route->dst & mask) | ~mask) + 1);
+	default:
+		return (((uint32_t) route->dst & mask) | (test_random() & ~mask));
+	}
+}
+
+static unsigned int table_count(struct ip4_routing_table *table)
+{
+	unsigned int count = 0;
+
+	for (; table != NULL; table = table->next_entry)
+		count++;
+	return (count);
+}
+
+/**
+ * @brief publishes a copy of table (sorted) and compares the lookups of
+ * the trie, through IP4_next_hop as well, with the list walk
+ */
+static void check_table(struct ip4_routing_table *table, const char *what)
+{
+	struct ip4_routing_table *published;
+	struct ip4_routing_table *expected;
+	struct ip4_routing_table *found;
+	struct ip4_next_hop_info info;
+	unsigned int count;
+	unsigned int i;
+	uint32_t dst;
+
+	published = IP4_sort_routing_table(copy_table(table));
+	if (IP4_route_publish(published) != 0)
+	{
+		printf("FAIL %s: the table was not published\n", what);
+		failures++;
+		return;
+	}
+	count = table_count(published);
+	if (count != table_count(table))
+	{
+		printf("FAIL %s: %u routes published out of %u\n", what, count, table_count(table));
+		failures++;
+	}
+	for (i = 0; i < TEST_LOOKUPS; i++)
+	{
+		dst = gen_dst(published, count);
+		expected = linear_lookup(published, dst);
+		found = IP4_route_trie_lookup(route_trie, dst);
+		info = IP4_next_hop(dst);
+		if (found != expected
+				|| (expected == NULL && info.interface != -1)
+				|| (expected != NULL && (info.interface != (int) expected->interface
+						|| info.address != (expected->gw ? expected->gw : dst))))
+		{
+			printf("FAIL %s: %u.%u.%u.%u matches /%d, the trie gives /%d\n", what,
+					dst >> 24, (dst >> 16) & 0xff, (dst >> 8) & 0xff, dst & 0xff,
+					expected ? (int) expected->mask : -1, found ? (int) found->mask : -1);
+			failures++;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief the routes whose prefix is made of whole strides, plus the ones
+ * the random tables hardly ever produce
+ */
+static void test_fixed()
+{
+	static const struct { uint32_t dst; unsigned int mask; } routes[] = {
+		{ 0x00000000, 0 }, { 0x0a000000, 8 }, { 0x0a000000, 16 }, { 0x0a000000, 24 },
+		{ 0x0a000000, 32 }, { 0x0a000001, 32 }, { 0x0a0000ff, 32 }, { 0x0a0001f0, 28 },
+		{ 0x0a010000, 15 }, { 0x0a010000, 17 }, { 0xffffffff, 32 }, { 0xfffffff0, 28 },
+		{ 0x80000000, 1 }, { 0x0a000000, 8 } };
+	struct ip4_routing_table *table = NULL;
+	struct ip4_routing_table *route;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
+	{
+		route = (struct ip4_routing_table *) malloc(sizeof(struct ip4_routing_table));
+		memset(route, 0, sizeof(struct ip4_routing_table));
+		route->dst = routes[i].dst;
+		route->mask = routes[i].mask;
+		route->gw = i;
+		route->interface = i;
+		route->next_entry = table;
+		table = route;
+	}
+	check_table(table, "fixed table");
+
+	/** without the default route */
+	route = table;
+	while (route->next_entry->next_entry != NULL)
+		route = route->next_entry;
+	free(route->next_entry);
+	route->next_entry = NULL;
+	check_table(table, "fixed table without /0");
+
+	check_table(NULL, "empty table");
+	IP4_free_routing_table(table);
+}
+
+static void test_random_tables()
+{
+	struct ip4_routing_table *table;
+	struct ip4_routing_table *route;
+	struct ip4_routing_table **link;
+	unsigned int count;
+	unsigned int round;
+	unsigned int change;
+	unsigned int i;
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		table = NULL;
+		count = 1 + rand() % TEST_ROUTES;
+		for (i = 0; i < count; i++)
+		{
+			route = gen_route(table, i);
+			route->next_entry = table;
+			table = route;
+		}
+		check_table(table, "random table");
+
+		for (change = 0; change < TEST_CHANGES && table != NULL; change++)
+		{
+			link = &table;
+			for (i = rand() % count; i > 0 && (*link)->next_entry != NULL; i--)
+				link = &(*link)->next_entry;
+			route = *link;
+			if (rand() % 2)
+			{
+				/** deleted */
+				*link = route->next_entry;
+				free(route);
+				count--;
+				check_table(table, "route deleted");
+			}
+			else
+			{
+				/** replaced by another route, of the same prefix or not */
+				*link = gen_route(table, count);
+				if (rand() % 2)
+				{
+					(*link)->dst = route->dst;
+					(*link)->mask = route->mask;
+				}
+				(*link)->next_entry = route->next_entry;
+				free(route);
+				check_table(table, "route replaced");
+			}
+		}
+		IP4_free_routing_table(table);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	test_fixed();
+	test_random_tables();
+
+	IP4_free_routing_table(routing_table);
+	IP4_route_trie_free(route_trie);
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return (failures ? 1 : 0);
+}
@@ -34,15 +34,23 @@
  */
 
 struct finssocket jinniSockets[MAX_sockets];
+/** taken by every access to the entries of jinniSockets, for writing when an
+ * entry is inserted, bound or removed. The receive paths keep it for reading
+ * while they use the queue of the entry, which removejinniSocket empties */
+pthread_rwlock_t jinniSockets_lock = PTHREAD_RWLOCK_INITIALIZER;
 struct socketIdentifier FinsHistory[MAX_sockets];
 /** The list of major Queues which connect the modules to each other
  * including the switch module
- * The list of Semaphores which protect the Queues
+ * Every queue has exactly one producer and one consumer thread so they are
+ * lock-free SPSC rings and need no protecting semaphores (the jinni workers
+ * take turns through Jinni_to_Switch_lock)
  */
 /**TODO The queues might be moved later to another Master file */
 
 finsQueue Jinni_to_Switch_Queue;
 finsQueue Switch_to_Jinni_Queue;
+/** the jinni workers all produce into Jinni_to_Switch_Queue, one at a time */
+pthread_mutex_t Jinni_to_Switch_lock = PTHREAD_MUTEX_INITIALIZER;
 
 finsQueue Switch_to_UDP_Queue;
 finsQueue UDP_to_Switch_Queue;
@@ -63,40 +71,42 @@ finsQueue Switch_to_ICMP_Queue;
 finsQueue ICMP_to_Switch_Queue;
 
 
-sem_t ICMP_to_Switch_Qsem;
-sem_t Switch_to_ICMP_Qsem;
-
-sem_t Jinni_to_Switch_Qsem;
-sem_t Switch_to_Jinni_Qsem;
-
-
-sem_t Switch_to_UDP_Qsem;
-sem_t UDP_to_Switch_Qsem;
-
-sem_t Switch_to_TCP_Qsem;
-sem_t TCP_to_Switch_Qsem;
-
-sem_t Switch_to_IPv4_Qsem;
-sem_t IPv4_to_Switch_Qsem;
-
-sem_t Switch_to_ARP_Qsem;
-sem_t ARP_to_Switch_Qsem;
-
-sem_t Switch_to_EtherStub_Qsem;
-sem_t EtherStub_to_Switch_Qsem;
-
-finsQueue modules_IO_queues[MAX_modules];
-sem_t *IO_queues_sem[MAX_modules];
-
 /** ----------------------------------------------------------*/
 
-int socket_channel_desc=-1;
+/** The channel shared with every intercepted process, requests come in and
+ * replies go out through it */
+struct finsChannelControl *jinni_channel;
+/** jinniSockets as the clients see it, see jinni_socket_publish */
+struct finsSocketTable *jinni_sockets_table;
+/** A request handed by the dispatcher (jinni) to a worker. The worker reads
+ * the request in place from the ring of the client, the next request of the
+ * client is only dispatched once the handler finished reading this one (see
+ * fins_channel_next_request), so the queue holds one request per client at
+ * most */
+struct jinniWork
+{
+	struct finsChannelReader request;
+	int client;
+};
+struct jinniWork jinni_work[FINS_CHANNEL_MAX_CLIENTS];
+int jinni_work_head;
+int jinni_work_count;
+pthread_mutex_t jinni_work_lock = PTHREAD_MUTEX_INITIALIZER;
+sem_t jinni_work_items;
+/** set while a request of the client of that slot is being read */
+int jinni_busy[FINS_CHANNEL_MAX_CLIENTS];
+/** the workers and readFromSwitch_to_Jinni may answer the same client at
+ * once, a response record is written under the lock of the client */
+pthread_mutex_t jinni_reply_lock[FINS_CHANNEL_MAX_CLIENTS];
+/** the Id of the request the worker thread is handling, the replies written
+ * by the thread answer it (see ack_write) */
+__thread uint32_t jinni_request_id;
+/** set while the request is asynchronous: its replies are not written, a
+ * failure is kept in jinni_request_error instead (see jinni_async_complete) */
+__thread int jinni_request_async;
+__thread int jinni_request_error;
 int capture_pipe_fd;	/** capture file descriptor to read from capturer */
 int inject_pipe_fd;		/** inject file descriptor to read from capturer */
-sem_t *meen_channel_semaphore1;
-sem_t *meen_channel_semaphore2;
-char meen_sem_name1[]="main_channel1";
-char meen_sem_name2[]="main_channel2";
 
 /** Ethernet Stub Variables  */
 #define CAPTURE_PIPE "/tmp/fins/fins_capture"
@@ -115,6 +125,7 @@ void init_jinnisockets()
 			jinniSockets[i].processid = -1;
 			jinniSockets[i].sockfd = -1;
 			jinniSockets[i].fakeID = -1;
+			jinniSockets[i].waiters = NULL;
 	  		}
 
 
@@ -125,137 +136,101 @@ void Queues_init()
 
 	Jinni_to_Switch_Queue = init_queue("jinni2switch",MAX_Queue_size);
 	Switch_to_Jinni_Queue = init_queue("switch2jinni",MAX_Queue_size);
-	modules_IO_queues[0]= Jinni_to_Switch_Queue;
-	modules_IO_queues[1]= Switch_to_Jinni_Queue;
-	sem_init(&Jinni_to_Switch_Qsem,0,1);
-	sem_init(&Switch_to_Jinni_Qsem,0,1);
-	IO_queues_sem[0] = &Jinni_to_Switch_Qsem;
-	IO_queues_sem[1] = &Switch_to_Jinni_Qsem;
+	/** a sendto() caller waits for room rather than losing its datagram */
+	set_queue_policy(Jinni_to_Switch_Queue,QUEUE_BLOCK,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	fins_register_module(JINNIID,Jinni_to_Switch_Queue,Switch_to_Jinni_Queue);
 
 	UDP_to_Switch_Queue = init_queue("udp2switch",MAX_Queue_size);
 	Switch_to_UDP_Queue = init_queue("switch2udp",MAX_Queue_size);
-	modules_IO_queues[2] = UDP_to_Switch_Queue;
-	modules_IO_queues[3] = Switch_to_UDP_Queue;
-	sem_init(&UDP_to_Switch_Qsem,0,1);
-	sem_init(&Switch_to_UDP_Qsem,0,1);
-	IO_queues_sem[2] = &UDP_to_Switch_Qsem;
-	IO_queues_sem[3] = &Switch_to_UDP_Qsem;
+	fins_register_module(UDPID,UDP_to_Switch_Queue,Switch_to_UDP_Queue);
 
 	TCP_to_Switch_Queue = init_queue("tcp2switch",MAX_Queue_size);
 	Switch_to_TCP_Queue = init_queue("switch2tcp",MAX_Queue_size);
-	modules_IO_queues[4] = TCP_to_Switch_Queue;
-	modules_IO_queues[5] = Switch_to_TCP_Queue;
-	sem_init(&TCP_to_Switch_Qsem,0,1);
-	sem_init(&Switch_to_TCP_Qsem,0,1);
-	IO_queues_sem[4] = &TCP_to_Switch_Qsem;
-	IO_queues_sem[5] = &Switch_to_TCP_Qsem;
+	fins_register_module(TCPID,TCP_to_Switch_Queue,Switch_to_TCP_Queue);
 
 
 
 	IPv4_to_Switch_Queue = init_queue("ipv42switch",MAX_Queue_size);
 	Switch_to_IPv4_Queue = init_queue("switch2ipv4",MAX_Queue_size);
-	modules_IO_queues[6] = IPv4_to_Switch_Queue;
-	modules_IO_queues[7] = Switch_to_IPv4_Queue;
-	sem_init(&IPv4_to_Switch_Qsem,0,1);
-	sem_init(&Switch_to_IPv4_Qsem,0,1);
-	IO_queues_sem[6] = &IPv4_to_Switch_Qsem;
-	IO_queues_sem[7] = &Switch_to_IPv4_Qsem;
+	fins_register_module(IPV4ID,IPv4_to_Switch_Queue,Switch_to_IPv4_Queue);
 
 
 
 
 	ARP_to_Switch_Queue = init_queue("arp2switch",MAX_Queue_size);
 	Switch_to_ARP_Queue = init_queue("switch2arp",MAX_Queue_size);
-	modules_IO_queues[8] = ARP_to_Switch_Queue;
-	modules_IO_queues[9] = Switch_to_ARP_Queue;
-	sem_init(&ARP_to_Switch_Qsem,0,1);
-	sem_init(&Switch_to_ARP_Qsem,0,1);
-	IO_queues_sem[8] = &ARP_to_Switch_Qsem;
-	IO_queues_sem[9] = &Switch_to_ARP_Qsem;
+	fins_register_module(ARPID,ARP_to_Switch_Queue,Switch_to_ARP_Queue);
 
 
 	EtherStub_to_Switch_Queue =  init_queue("etherstub2switch",MAX_Queue_size);
 	Switch_to_EtherStub_Queue =  init_queue("switch2etherstub",MAX_Queue_size);
-	modules_IO_queues[10] = EtherStub_to_Switch_Queue;
-	modules_IO_queues[11] = Switch_to_EtherStub_Queue;
-	sem_init(&EtherStub_to_Switch_Qsem,0,1);
-	sem_init(&Switch_to_EtherStub_Qsem,0,1);
-	IO_queues_sem[10] = &EtherStub_to_Switch_Qsem;
-	IO_queues_sem[11] = &Switch_to_EtherStub_Qsem;
+	fins_register_module(ETHERSTUBID,EtherStub_to_Switch_Queue,Switch_to_EtherStub_Queue);
 
 
 	ICMP_to_Switch_Queue = init_queue("icmp2switch",MAX_Queue_size);
 	Switch_to_ICMP_Queue = init_queue("switch2icmp",MAX_Queue_size);
-		modules_IO_queues[12] = ICMP_to_Switch_Queue;
-		modules_IO_queues[13] = Switch_to_ICMP_Queue;
-		sem_init(&ICMP_to_Switch_Qsem,0,1);
-		sem_init(&Switch_to_ICMP_Qsem,0,1);
-		IO_queues_sem[12] = &ICMP_to_Switch_Qsem;
-		IO_queues_sem[13] = &Switch_to_ICMP_Qsem;
-
-
+	fins_register_module(ICMPID,ICMP_to_Switch_Queue,Switch_to_ICMP_Queue);
+
+	/** the switch must never wait on a module, a congested module loses
+	 * data frames but keeps receiving control frames */
+	set_queue_policy(Switch_to_Jinni_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	set_queue_policy(Switch_to_UDP_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	set_queue_policy(Switch_to_TCP_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	set_queue_policy(Switch_to_IPv4_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	set_queue_policy(Switch_to_ARP_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	set_queue_policy(Switch_to_EtherStub_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
+	set_queue_policy(Switch_to_ICMP_Queue,QUEUE_DROP_PRIORITY,QUEUE_HIGH_WATER,QUEUE_LOW_WATER);
 
 }
 
-
-void jinni_init()
+/**@brief prints the drop counters of the switch queues
+ * */
+void report_queues()
 {
 
-	/** the semaphore is initially locked */
-		//meen_channel_semaphore1 = sem_open(meen_sem_name1,O_CREAT|O_EXCL,0644,0);
-	meen_channel_semaphore1 = sem_open(meen_sem_name1,O_CREAT,0644,0);
-
-	/**	if (meen_channel_semaphore1 == SEM_FAILED)
-		{
-			meen_channel_semaphore1 = sem_open(meen_sem_name1,0);
+	report_queue(Jinni_to_Switch_Queue);
+	report_queue(Switch_to_Jinni_Queue);
+	report_queue(UDP_to_Switch_Queue);
+	report_queue(Switch_to_UDP_Queue);
+	report_queue(IPv4_to_Switch_Queue);
+	report_queue(Switch_to_IPv4_Queue);
+	report_queue(EtherStub_to_Switch_Queue);
+	report_queue(Switch_to_EtherStub_Queue);
+	report_queue(ICMP_to_Switch_Queue);
+	report_queue(Switch_to_ICMP_Queue);
 
 
-		} */
-		if (meen_channel_semaphore1 == SEM_FAILED)
-			{
-				PRINT_DEBUG("meen_channel_semaphore failed to launch");
-				sem_unlink(meen_sem_name1);
-				exit(1);
+}
 
-			}
-		//meen_channel_semaphore2 = sem_open(meen_sem_name2,O_CREAT|O_EXCL,0644,0);
-	meen_channel_semaphore2 = sem_open(meen_sem_name2,O_CREAT,0644,0);
-	/**	if (meen_channel_semaphore2 == SEM_FAILED)
-		{
 
-			meen_channel_semaphore2 = sem_open(meen_sem_name2,0);
+void jinni_init()
+{
 
+	/** the channel has to exist before the first client attaches to it */
+	jinni_channel = fins_channel_create();
 
-		} */
-		if (meen_channel_semaphore2 == SEM_FAILED)
+		if (jinni_channel == NULL)
 			{
-				PRINT_DEBUG("meen_channel_semaphore failed to launch");
-				sem_unlink(meen_sem_name2);
-				exit(1);
-
+			PRINT_DEBUG("socket jinni failed to create the socket channel \n");
+			exit(EXIT_FAILURE);
 			}
+		__atomic_store_n(&fins_buff_pool,jinni_channel,__ATOMIC_RELEASE);
 
-
-
-		PRINT_DEBUG("6666");
-
-
-		PRINT_DEBUG("Jinni was blocked waiting at mkfifo, it had just cross it");
-		socket_channel_desc = open(MAIN_SOCKET_CHANNEL, O_RDONLY);
-		PRINT_DEBUG("5555");
-
-		if (socket_channel_desc == -1)
+	jinni_sockets_table = fins_sockets_create();
+		if (jinni_sockets_table == NULL)
 			{
-			PRINT_DEBUG("socket geni failed to open the socket channel \n");
+			PRINT_DEBUG("socket jinni failed to create the socket table \n");
 			exit(EXIT_FAILURE);
 			}
 
-		 /** Notice that the meen_channel_semaphore is a semaphore shared among processes
-		  * (It is processes level semaphore, NOT threads level)
+		 /** Notice that the channel is shared among processes, its rings and
+		  * doorbells live in shared memory (see finsChannel.h)
 		  */
-		/** Needs NPTL because LinuxThreads does not support sharing semaphores between processes */
-
 
+	int i;
+	for (i = 0; i < FINS_CHANNEL_MAX_CLIENTS; i++)
+		pthread_mutex_init(&jinni_reply_lock[i],NULL);
+	sem_init(&jinni_work_items,0,0);
 
 }
 
@@ -265,9 +240,10 @@ void *readFromSwitch_to_Jinni()
 {
 
 			struct finsFrame *ff;
-			int protocol;
+			uint16_t protocol;
 			int index;
 			int status;
+			struct jinniWaiter *waiter;
 			uint16_t dstport,hostport;
 			uint32_t dstip,hostip;
 			 PRINT_DEBUG("readFromSwitch_to_Jinni THREAD");
@@ -275,29 +251,21 @@ void *readFromSwitch_to_Jinni()
 
 		while(1)
 		{
-					sem_wait(&Switch_to_Jinni_Qsem);
-					ff= read_queue(Switch_to_Jinni_Queue);
-					sem_post(&Switch_to_Jinni_Qsem);
-
-						if (ff==NULL)
-						{
-
-						continue;
-						}
+					ff= read_queue_wait(Switch_to_Jinni_Queue);
 
 			if (ff->dataOrCtrl == CONTROL)
 					{
-
+				freeFinsFrame(ff);
 					}
 			else if (ff->dataOrCtrl == DATA)
 					{
 
-			metadata_readFromElement(ff->dataFrame.metaData,"portdst",&dstport);
-			metadata_readFromElement(ff->dataFrame.metaData,"portsrc",&hostport);
-			metadata_readFromElement(ff->dataFrame.metaData,"ipdst",&dstip);
-			metadata_readFromElement(ff->dataFrame.metaData,"ipsrc",&hostip);
+			metadata_get_dstport(ff->dataFrame.metaData,&dstport);
+			metadata_get_srcport(ff->dataFrame.metaData,&hostport);
+			metadata_get_dstip(ff->dataFrame.metaData,&dstip);
+			metadata_get_srcip(ff->dataFrame.metaData,&hostip);
 
-			metadata_readFromElement(ff->dataFrame.metaData,"protocol",&protocol);
+			metadata_get_protocol(ff->dataFrame.metaData,&protocol);
 PRINT_DEBUG("NETFORMAT %d,%d,%d,%d,%d,",protocol,hostip,dstip,hostport,dstport);
 
 			protocol = ntohs(protocol);
@@ -307,20 +275,44 @@ PRINT_DEBUG("NETFORMAT %d,%d,%d,%d,%d,",protocol,hostip,dstip,hostport,dstport);
 			hostip = ntohl(hostip );
 
 PRINT_DEBUG("NETFORMAT %d,%d,%d,%d,%d,",protocol,hostip,dstip,hostport,dstport);
+				pthread_rwlock_rdlock(&jinniSockets_lock);
 				index = matchjinniSocket(dstport,dstip,protocol);
 				PRINT_DEBUG("index %d", index);
 							if (index != -1)
 							{
+					PRINT_DEBUG("pdu lenght %d",ff->dataFrame.pduLength);
+					/** the oldest recvfrom parked on the socket gets the frame,
+					 * otherwise ff belongs to the socket once queued, do not
+					 * touch it after */
+					status = 1;
 					sem_wait( & (jinniSockets[index].Qs));
-						write_queue(ff,jinniSockets[index].dataQueue);
+						waiter = jinniSockets[index].waiters;
+						if (waiter != NULL)
+							jinniSockets[index].waiters = waiter->next;
+						else
+						{
+							status = write_queue(ff,jinniSockets[index].dataQueue);
+							jinni_socket_readiness(index);
+						}
 					sem_post( &(jinniSockets[index].Qs));
-					PRINT_DEBUG("pdu lenght %d",ff->dataFrame.pduLength);
+					pthread_rwlock_unlock(&jinniSockets_lock);
+					if (waiter != NULL)
+					{
+						recvfrom_reply(ff,waiter->senderid,waiter->requestid,waiter->symbol,waiter->datalen);
+						free(waiter);
+					}
+					else if (status == 0)
+					{
+						PRINT_DEBUG("socket %d queue full, frame dropped", index);
+						freeFinsFrame(ff);
+					}
 
 							}
 
 							else
 							{
 								PRINT_DEBUG();
+								pthread_rwlock_unlock(&jinniSockets_lock);
 
 								freeFinsFrame(ff);
 							}
@@ -328,7 +320,7 @@ PRINT_DEBUG("NETFORMAT %d,%d,%d,%d,%d,",protocol,hostip,dstip,hostport,dstport);
 			else
 			{
 				PRINT_DEBUG();
-
+				freeFinsFrame(ff);
 
 
 			} // end of if , else if , else statement
@@ -342,75 +334,22 @@ PRINT_DEBUG("NETFORMAT %d,%d,%d,%d,%d,",protocol,hostip,dstip,hostport,dstport);
 
 
 
-void *jinni()
+/**@brief runs the handler of one request
+ * */
+void jinni_handle(pid_t sender,u_int opcode,struct finsChannelReader *request)
 {
 
-	static int numberOfSockets=0;
-	//int socket_channel_desc;
-	struct  socketUniqueID socketID;
-	char client_pipe[256];
-	int numOfBytes=0;
-	u_int opcode;
-	pid_t sender;
-
-	/** 1. init the Jinni sockets database
-	 * 2. Init the queues connecting Jinnin to thw FINS Switch
-	 */
-
-//	init_jinnisockets();
-//	Queues_init();
-	jinni_init();
-
-
-	int counter = 0;
-	 PRINT_DEBUG("");
-	 sem_post(meen_channel_semaphore2);
-	while (1)
-	{
-
-		/**TODO lock the pipe before reading
-		*	to make sure no other thread read at the same time
-		 * */
-
-		PRINT_DEBUG("COUNTER = %d",counter);
-		int tester;
-		errno = 0;
-	/**	sem_getvalue(meen_channel_semaphore1,&tester);
-		PRINT_DEBUG ("errno %d", errno);
-			PRINT_DEBUG("tester = %d",tester);
-	 */
-			sem_wait(meen_channel_semaphore1);
-			sem_wait(meen_channel_semaphore2);
-			PRINT_DEBUG("7777");
-
-			numOfBytes = read(socket_channel_desc,&sender, sizeof (pid_t));
-			numOfBytes = read(socket_channel_desc, &opcode, sizeof (u_int));
-			PRINT_DEBUG("%d", sender);
-			//read(socket_channel_desc, &sender,sizeof(int));
-			//read(socket_channel_desc, &opcode, sizeof(int));
-	//sem_post(meen_channel_semaphore);
-
-		if ( numOfBytes <= 0)
-				{
-					PRINT_DEBUG("READING ERROR");
-					counter++;
-					continue;
-
-				}
-
-		 PRINT_DEBUG("8888");
-
 				switch (opcode)
 				{
 
 				case socket_call:
-					socket_call_handler(sender);
+					socket_call_handler(sender,request);
 					break;
 				case  socketpair_call:
 					socketpair_call_handler();
 					break;
 				case bind_call :
-					bind_call_handler(sender);
+					bind_call_handler(sender,request);
 					break;
 				case getsockname_call:
 					getsockname_call_handker();
@@ -422,16 +361,17 @@ void *jinni()
 					getpeername_call_handler();
 					break;
 				case send_call :
-					send_call_handler(sender);
+					send_call_handler(sender,request);
 					break;
 				case recv_call :
-					recv_call_handler(sender);
+					recv_call_handler(sender,request);
 					break;
 				case sendto_call:
-					sendto_call_handler(sender);
+				case sendto_async_call:
+					sendto_call_handler(sender,request);
 					break;
 				case recvfrom_call:
-					recvfrom_call_handler(sender);
+					recvfrom_call_handler(sender,request);
 					break;
 				case sendmsg_call :
 					sendmsg_call_handler();
@@ -455,20 +395,134 @@ void *jinni()
 					accept4_call_handler();
 					break;
 				case shutdown_call :
-					shutdown_call_handler();
+					shutdown_call_handler(sender,request);
+					break;
+				case sendmmsg_call :
+					sendmmsg_call_handler(sender,request);
+					break;
+				case recvmmsg_call :
+					recvmmsg_call_handler(sender,request);
+					break;
+				case recv_zc_call :
+					recv_zc_call_handler(sender,request);
 					break;
 				default:
 					{
-						PRINT_DEBUG("unknown opcode read from the socket main channel ! CRASHING");
-						/** a function must be called to clean and reset the pipe
-						 * to original conditions before crashing
-						 */
-						exit(1);
+						/** every request is a record of its own, an unknown one
+						 * is skipped without losing track of the next */
+						PRINT_DEBUG("unknown opcode %d read from the socket channel, skipped",opcode);
+						break;
 					}
 
 
 				} /** end of switch */
 
+}
+
+/**@brief a worker thread, handles the requests queued by jinni() one at a time.
+ * A blocking recvfrom does not hold the worker, it is parked on its socket
+ * (see recvfrom_udp)
+ * */
+void *jinni_worker()
+{
+
+	struct jinniWork work;
+	struct finsChannelHeader header;
+	int numOfBytes=0;
+
+	while (1)
+	{
+		sem_wait(&jinni_work_items);
+		pthread_mutex_lock(&jinni_work_lock);
+			work = jinni_work[jinni_work_head];
+			jinni_work_head = (jinni_work_head + 1) % FINS_CHANNEL_MAX_CLIENTS;
+			jinni_work_count--;
+		pthread_mutex_unlock(&jinni_work_lock);
+
+			numOfBytes = fins_channel_get(&work.request,&header, sizeof (struct finsChannelHeader));
+			PRINT_DEBUG("%d", header.Pid);
+
+		if ( numOfBytes != sizeof (struct finsChannelHeader))
+		{
+			PRINT_DEBUG("READING ERROR");
+		}
+		else if (header.Version != FINS_CHANNEL_VERSION)
+		{
+			PRINT_DEBUG("request of version %d from %d refused",header.Version,header.Pid);
+			fins_channel_finish(&work.request);
+			jinni_request_id = header.Id;
+			nack_write(header.Pid,-1);
+		}
+		else
+		{
+			jinni_request_id = header.Id;
+			jinni_request_async = (header.Code == sendto_async_call);
+			jinni_request_error = 0;
+			jinni_handle(header.Pid,header.Code,&work.request);
+			jinni_request_async = 0;
+		}
+
+				/** hands the ring space back, in case the handler did not */
+				fins_channel_finish(&work.request);
+	}
+
+}
+
+
+/**@brief the dispatcher: takes the requests of the clients in turn and hands
+ * them to the worker threads, so that a slow call of one client does not
+ * hold the others
+ * */
+void *jinni()
+{
+
+	struct jinniWork work;
+	pthread_t workers[JINNI_WORKERS];
+	int scan = 0;
+	int i;
+
+	/** 1. init the Jinni sockets database
+	 * 2. Init the queues connecting Jinnin to thw FINS Switch
+	 */
+
+//	init_jinnisockets();
+//	Queues_init();
+	jinni_init();
+
+	for (i = 0; i < JINNI_WORKERS; i++)
+		pthread_create(&workers[i],NULL,jinni_worker,NULL);
+
+
+	int counter = 0;
+	 PRINT_DEBUG("");
+	while (1)
+	{
+
+		PRINT_DEBUG("COUNTER = %d",counter);
+
+			/** sleeps until one of the clients whose previous request was
+			 * read posts a request */
+			work.client = fins_channel_next_request(jinni_channel,&work.request,&scan,jinni_busy);
+			if (work.client == -1)
+			{
+				/** a dead client's slot nobody reads any more, handed back
+				 * once no response to it is being written */
+				for (i = 0; i < FINS_CHANNEL_MAX_CLIENTS; i++)
+				{
+					pthread_mutex_lock(&jinni_reply_lock[i]);
+					fins_channel_release(jinni_channel,i,jinni_busy);
+					pthread_mutex_unlock(&jinni_reply_lock[i]);
+				}
+				continue;
+			}
+
+		/** there is room, every queued item belongs to a different client */
+		pthread_mutex_lock(&jinni_work_lock);
+			jinni_work[(jinni_work_head + jinni_work_count) % FINS_CHANNEL_MAX_CLIENTS] = work;
+			jinni_work_count++;
+		pthread_mutex_unlock(&jinni_work_lock);
+		sem_post(&jinni_work_items);
+
 				counter++;
 	}/**end of while */
 
@@ -482,6 +536,7 @@ void *Capture()
 {
 
 	char *data;
+	struct finsBuff *buff;
 	int datalen;
 	int numBytes;
 	int capture_pipe_fd;
@@ -515,13 +570,18 @@ while (1)
 				PRINT_DEBUG("numBytes written %d\n", numBytes);
 				break;
 			}
-		data = (char *)malloc (datalen);
+		/** the frame keeps the whole buffer, the Ethernet header in front of the
+		 * pdu becomes headroom. The buffer comes from the channel pool, the
+		 * payload can then be lent to the client as is (see recv_zc_call_handler) */
+		buff = fins_buff_alloc_shared(datalen + FINS_TAILROOM);
+		data = (char *) buff->data;
 
 		numBytes = read(capture_pipe_fd, data,datalen );
 
 		if (numBytes <= 0)
 			{
 				PRINT_DEBUG("numBytes written %d\n", numBytes);
+				fins_buff_release(buff);
 				break;
 			}
 
@@ -529,7 +589,7 @@ while (1)
 
 		print_frame(data,datalen);
 
-		ff = (struct finsFrame *) malloc(sizeof(struct finsFrame));
+		ff = allocFinsFrame();
 
 		PRINT_DEBUG("%d", ff);
 
@@ -538,8 +598,7 @@ while (1)
 		 * 2. pre-process the frame in order to extract the metadata
 		 * 3. build a finsFrame and insert it into EtherStub_to_Switch_Queue
 		 */
-		ether_meta = (metadata *)malloc(sizeof(metadata));
-		metadata_create(ether_meta);
+		ether_meta = allocMetadata();
 
 	memcpy(ethersrc,((struct sniff_ethernet *)data)->ether_shost,ETHER_ADDR_LEN);
 	PRINT_DEBUG();
@@ -556,8 +615,7 @@ while (1)
 
 	(ff->dataFrame).directionFlag = UP;
 	ff->dataFrame.metaData = ether_meta;
-	ff->dataFrame.pduLength = datalen - SIZE_ETHERNET;
-	ff->dataFrame.pdu =  data + SIZE_ETHERNET;
+	fins_frame_attach(&ff->dataFrame, buff, SIZE_ETHERNET, datalen - SIZE_ETHERNET);
 
 //memcpy( ff->dataFrame.pdu , data + SIZE_ETHERNET ,datalen- SIZE_ETHERNET);
 
@@ -567,9 +625,11 @@ while (1)
 
 	PRINT_DEBUG();
 
-	sem_wait(&EtherStub_to_Switch_Qsem);
-		write_queue(ff,EtherStub_to_Switch_Queue);
-	sem_post(&EtherStub_to_Switch_Qsem);
+	if (write_queue(ff,EtherStub_to_Switch_Queue) == 0)
+	{
+		PRINT_DEBUG("EtherStub_to_Switch_Queue full, frame dropped");
+		freeFinsFrame(ff);
+	}
 	PRINT_DEBUG();
 
 	} // end of while loop
@@ -587,9 +647,9 @@ void *Inject()
 	//char data[]="loloa7aa7a";
 	char *frame;
 	int datalen = 10;
-	int framelen;
 	int inject_pipe_fd;
 	int numBytes;
+	struct iovec iov[3];
 	struct finsFrame *ff=NULL;
 	struct ipv4_packet *packet;
 	IP4addr destination;
@@ -615,12 +675,8 @@ void *Inject()
 	 * 2) extract the data (Ethernet Frame) to be sent
 	 * 3) Inject the Ethernet Frame into the injection Pipe
 	 */
-			sem_wait(&Switch_to_EtherStub_Qsem);
-			ff = read_queue(Switch_to_EtherStub_Queue);
-			sem_post(&Switch_to_EtherStub_Qsem);
+			ff = read_queue_wait(Switch_to_EtherStub_Queue);
 			/** ff->finsDataFrame is an IPv4 packet */
-			if (ff == NULL)
-				continue;
 
 //	metadata_readFromElement(ff->dataFrame.metaData,"dstip",&destination);
 //	loop_host = (struct hostent *) gethostbyname((char *)"");
@@ -636,8 +692,8 @@ void *Inject()
 //	}
 
 
-	framelen = ff->dataFrame.pduLength;
-	frame = (char *)malloc (framelen + SIZE_ETHERNET);
+	/** the IP packet was built with enough headroom for the Ethernet header */
+	frame = (char *) fins_frame_push(&ff->dataFrame, SIZE_ETHERNET);
 	//char dest[]={0x00,0x1d,0x09,0xb3,0x55,0x5e};
 	//char src[]={0x00,0x1d,0x09,0xb3,0x55,0x5e};
 
@@ -649,27 +705,27 @@ void *Inject()
 	memcpy(((struct sniff_ethernet *)frame)->ether_shost,src,ETHER_ADDR_LEN);
 	((struct sniff_ethernet *)frame)->ether_type=htons(0x0800);
 
-	memcpy(frame+SIZE_ETHERNET,(ff->dataFrame).pdu,framelen);
-	datalen = framelen + SIZE_ETHERNET;
+	datalen = fins_frame_length(&ff->dataFrame);
 //	print_finsFrame(ff);
 			PRINT_DEBUG("jinni inject to ethernet stub \n");
-			numBytes = write(inject_pipe_fd,&datalen, sizeof(int));
-		if (numBytes <= 0)
-			{
-				PRINT_DEBUG("numBytes written %d\n", numBytes);
-				return (0);
-			}
-
-	numBytes = write(inject_pipe_fd,frame, datalen );
+	/** the length, then the headers and the payload, which an IPv4 fragment
+	 * keeps apart in its frag (see IP4_out) */
+	iov[0].iov_base = &datalen;
+	iov[0].iov_len = sizeof(int);
+	iov[1].iov_base = frame;
+	iov[1].iov_len = ff->dataFrame.pduLength;
+	iov[2].iov_base = ff->dataFrame.frag;
+	iov[2].iov_len = ff->dataFrame.fragLength;
+	numBytes = writev(inject_pipe_fd, iov, ff->dataFrame.fragLength != 0 ? 3 : 2);
 
 		if (numBytes <= 0)
 			{
 				PRINT_DEBUG("numBytes written %d\n", numBytes);
+				freeFinsFrame(ff);
 				return (0);
 			}
 
 		freeFinsFrame(ff);
-		free(frame);
 	} // end of while loop
 
 
@@ -743,6 +799,7 @@ int main()
 	*/
 
 		init_jinnisockets();
+		init_frame_pools(FRAME_POOL_SIZE);
 		Queues_init();
 
 		cap_inj_init();
@@ -769,6 +826,9 @@ int main()
 	pthread_t etherStub_injecting;
 
 	pthread_t swito_thread;
+#ifdef FINS_FRAME_TRACKING
+	pthread_t leak_report;
+#endif
 
 
 
@@ -784,6 +844,9 @@ int main()
 
 	pthread_create(&etherStub_capturing,NULL,Capture,NULL);
 	pthread_create(&etherStub_injecting,NULL,Inject,NULL);
+#ifdef FINS_FRAME_TRACKING
+	pthread_create(&leak_report,NULL,fins_frame_leak_report,NULL);
+#endif
 
 
 
@@ -794,6 +857,9 @@ int main()
 	pthread_join(etherStub_capturing,NULL);
 	pthread_join(etherStub_injecting,NULL);
 
+	report_frame_pools();
+	report_queues();
+
 	while (1)
 		{
 
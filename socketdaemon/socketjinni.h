@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 
 
@@ -36,6 +37,8 @@
 #include <finsdebug.h>
 /** Additional header for meta-data manipulation */
 #include <metadata.h>
+/** the shared memory channel to the socket interceptor */
+#include <finsChannel.h>
 #include "wifidemux.h"
 //#include "arp.c"
 
@@ -45,9 +48,15 @@
 
 #define MAX_sockets 100
 #define MAX_parallel_threads 10
+/** threads handling the requests of the clients, see jinni() */
+#define JINNI_WORKERS 4
 #define MAX_Queue_size 1000
+/** frames (and metadata) preallocated at startup, one module queue worth each */
+#define FRAME_POOL_SIZE (7 * MAX_Queue_size)
+/** watermarks of the switch queues, see Queues_init */
+#define QUEUE_HIGH_WATER (MAX_Queue_size * 3 / 4)
+#define QUEUE_LOW_WATER (MAX_Queue_size / 2)
 #define MAX_parallel_processes 10
-#define MAX_modules 	14
 #define SNAP_LEN 4096
 
 
@@ -62,6 +71,16 @@ struct  socketUniqueID
 	int socketDesc;
 };
 
+/** a blocking recvfrom waiting for a datagram, see recvfrom_udp */
+struct jinniWaiter
+{
+	pid_t senderid;
+	uint32_t requestid;	/** of the recvfrom request, the reply answers it */
+	int symbol;
+	int datalen;	/** the room of the client for the datagram */
+	struct jinniWaiter *next;
+};
+
 struct finssocket
 {
 
@@ -69,7 +88,7 @@ pid_t processid;
 int sockfd; /** it is equal to the value of the pipe descriptor from the client side */
 int fakeID; /** The ID given by the interceptor side to distinguish this socket from other sockets
 created by the sam process, it is used within the pipe name to open the correct pipe on both sides */
-int jinniside_pipe_ds;  /**  the descriptor to access the pipe from the jinni side */
+int jinniside_pipe_ds;  /**  the jinni end of the pipe the client uses as the socket descriptor */
 int type;
 int protocol;
 /** All the above already initialized using the insert function
@@ -82,10 +101,10 @@ char name[50];
 int     data_pipe[2];
 finsQueue dataQueue;
 sem_t Qs; /** The data Queue Semaphore Pointer*/
-char semaphore_name[30]; /** The client channel semaphore name */
-char asemaphore_name[30];
-sem_t *s; /** The client channel semaphore pointer*/
-sem_t *as;
+struct jinniWaiter *waiters; /** parked recvfrom calls, oldest first, protected by Qs */
+int ready; /** a token byte is in the pipe while dataQueue holds frames, protected by Qs */
+int error; /** the last failure of an asynchronous request, see jinni_async_complete */
+unsigned int errors; /** the failures so far */
 };
 
 
@@ -123,8 +142,14 @@ int checkjinniports(uint16_t hostport);
 
 void jinni_init();
 void Queues_init();
-int ack_write(int pipe_desc,int processid,int sockfd);
-int nack_write( int pipe_desc, int processid, int sockfd);
+void report_queues();
+int ack_write(int processid,int sockfd);
+void jinni_socket_readiness(int index);
+void jinni_socket_publish(int index);
+void jinni_async_complete(int senderid,int index);
+int nack_write( int processid, int sockfd);
+int error_write( int processid, int error);
+void recvfrom_reply(struct finsFrame *ff,int senderid,uint32_t requestid,int symbol,int datalen);
 
 
 
@@ -150,21 +175,27 @@ int nack_write( int pipe_desc, int processid, int sockfd);
 #define accept_call 16
 #define accept4_call 17
 #define shutdown_call 18
+#define sendmmsg_call 20
+#define recvmmsg_call 21
+/** FINS extensions, no libc counterpart */
+#define recv_zc_call 19
+/** sendto without a response, see fins_channel_credit */
+#define sendto_async_call 22
 #define ACK 	200
 #define NACK 	6666
 
 
 	/** calls handling functions */
-		void 	socket_call_handler(pid_t senderProcessid);
+		void 	socket_call_handler(pid_t senderProcessid,struct finsChannelReader *request);
 		void 	socketpair_call_handler();
-		void 	bind_call_handler(int senderid);
+		void 	bind_call_handler(int senderid,struct finsChannelReader *request);
 		void	getsockname_call_handker();
 		void	connect_call_handler();
 		void	getpeername_call_handler();
-		void	send_call_handler(int senderid);
-		void	recv_call_handler(int senderid);
-		void	sendto_call_handler();
-		void	recvfrom_call_handler();
+		void	send_call_handler(int senderid,struct finsChannelReader *request);
+		void	recv_call_handler(int senderid,struct finsChannelReader *request);
+		void	sendto_call_handler(int senderid,struct finsChannelReader *request);
+		void	recvfrom_call_handler(int senderid,struct finsChannelReader *request);
 		void	sendmsg_call_handler();
 		void	recvmsg_call_handler();
 		void	getsockopt_call_handler();
@@ -172,7 +203,10 @@ int nack_write( int pipe_desc, int processid, int sockfd);
 		void	listen_call_handler();
 		void	accept_call_handler();
 		void	accept4_call_handler();
-		void	shutdown_call_handler();
+		void	shutdown_call_handler(int senderid,struct finsChannelReader *request);
+		void	sendmmsg_call_handler(int senderid,struct finsChannelReader *request);
+		void	recvmmsg_call_handler(int senderid,struct finsChannelReader *request);
+		void	recv_zc_call_handler(int senderid,struct finsChannelReader *request);
 
 
  /** special functions to print the data within a frame for testing*/
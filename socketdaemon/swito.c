@@ -10,170 +10,230 @@
 #include <metadata.h>
 #include <queueModule.h>
 
-#define MAX_modules 12
+/** maximum number of frames the switch takes from one module queue per pass */
+#define SWITCH_BURST 32
 
 
-extern finsQueue Jinni_to_Switch_Queue;
-extern finsQueue Switch_to_Jinni_Queue;
+/** switch->module queue of every registered module, indexed by module ID */
+static finsQueue switch_dispatch[MAX_MODULE_IDS];
 
-extern finsQueue Switch_to_UDP_Queue;
-extern finsQueue UDP_to_Switch_Queue;
+/** module->switch queues, the ones the switch reads from. Entries are
+ * appended by fins_register_module and published through switch_num_inputs
+ */
+static finsQueue switch_input_queues[MAX_SWITCH_INPUTS];
+static int switch_num_inputs = 0;
 
-extern finsQueue Switch_to_TCP_Queue;
-extern finsQueue TCP_to_Switch_Queue;
+/** one doorbell shared by all the queues the switch reads from, so that
+ * the switch can sleep until any module hands it a frame
+ */
+static struct Doorbell switch_doorbell = { 0, 0 };
 
-extern finsQueue Switch_to_ARP_Queue;
-extern finsQueue ARP_to_Switch_Queue;
+/** serialises registrations against each other, never taken by the switch */
+static pthread_mutex_t switch_register_lock = PTHREAD_MUTEX_INITIALIZER;
 
-extern finsQueue Switch_to_IPv4_Queue;
-extern finsQueue IPv4_to_Switch_Queue;
 
+/**@brief plugs a module into the switch
+ * @param id the module ID frames are addressed to (destinationID.id)
+ * @param in_q the queue the module writes into, read by the switch. May be NULL
+ * for a module that never sends
+ * @param out_q the queue the switch forwards frames addressed to id into
+ * @return 1 on success, 0 if id is already registered or the switch cannot
+ * take more input queues
+ *
+ * May be called before or after the switch thread is started, but the module
+ * must not write into in_q before the call returns.
+ * */
+int fins_register_module(unsigned char id, finsQueue in_q, finsQueue out_q)
+{
+	int n;
 
-extern finsQueue Switch_to_EtherStub_Queue;
-extern finsQueue EtherStub_to_Switch_Queue;
+	pthread_mutex_lock(&switch_register_lock);
 
-extern finsQueue Switch_to_ICMP_Queue;
-extern finsQueue ICMP_to_Switch_Queue;
+	if (__atomic_load_n(&switch_dispatch[id], __ATOMIC_RELAXED) != NULL)
+	{
+		pthread_mutex_unlock(&switch_register_lock);
+		PRINT_DEBUG("module %d is already registered", id);
+		return (0);
+	}
 
-extern sem_t ICMP_to_Switch_Qsem;
-extern sem_t Switch_to_ICMP_Qsem;
+	n = switch_num_inputs;
+	if (in_q != NULL)
+	{
+		if (n == MAX_SWITCH_INPUTS)
+		{
+			pthread_mutex_unlock(&switch_register_lock);
+			PRINT_DEBUG("switch is full, module %d not registered", id);
+			return (0);
+		}
+		AttachDoorbell(in_q, &switch_doorbell);
+		switch_input_queues[n] = in_q;
+		__atomic_store_n(&switch_num_inputs, n + 1, __ATOMIC_RELEASE);
+	}
 
+	__atomic_store_n(&switch_dispatch[id], out_q, __ATOMIC_RELEASE);
 
+	pthread_mutex_unlock(&switch_register_lock);
+	/** a sleeping switch has to pick up the new input queue */
+	RingDoorbell(&switch_doorbell);
+	PRINT_DEBUG("module %d registered", id);
 
-extern sem_t Jinni_to_Switch_Qsem;
-extern sem_t Switch_to_Jinni_Qsem;
+	return (1);
 
+}
 
-extern sem_t Switch_to_UDP_Qsem;
-extern sem_t UDP_to_Switch_Qsem;
+/** frames heading to the same module, collected during one burst */
+struct switch_group
+{
+	unsigned char id;
+	finsQueue q;
+	int n;
+	struct finsFrame *frames[SWITCH_BURST];
+};
+
+/** frames of one burst (and their clones) grouped by destination */
+struct switch_groups
+{
+	int ngroups;
+	struct switch_group group[SWITCH_BURST];
+};
+
+/** hands a group over to its module with a single burst write */
+static void switch_flush_group(struct switch_group *g)
+{
+	int i, written;
+
+	if (g->q == NULL)
+	{
+		PRINT_DEBUG("Unknown Destination %d, %d frames", g->id, g->n);
+		for (i = 0; i < g->n; i++)
+			freeFinsFrame(g->frames[i]);
+		g->n = 0;
+		return;
+	}
+
+	written = write_queue_burst(g->q, g->frames, g->n);
+	PRINT_DEBUG("Queue %d +%d", g->id, written);
+
+	/** the destination queue is above its high watermark, its policy decides
+	 * frame by frame (control frames may still get in) and counts the drops */
+	for (i = written; i < g->n; i++)
+		if (write_queue(g->frames[i], g->q) == 0)
+			freeFinsFrame(g->frames[i]);
+	g->n = 0;
+
+}
+
+static void switch_flush(struct switch_groups *groups)
+{
+	int j;
 
-extern sem_t Switch_to_TCP_Qsem;
-extern sem_t TCP_to_Switch_Qsem;
+	for (j = 0; j < groups->ngroups; j++)
+		switch_flush_group(&groups->group[j]);
+	groups->ngroups = 0;
 
-extern sem_t Switch_to_IPv4_Qsem;
-extern sem_t IPv4_to_Switch_Qsem;
+}
 
-extern sem_t Switch_to_ARP_Qsem;
-extern sem_t ARP_to_Switch_Qsem;
+/** adds ff to the group of its (single) destination. A full group, or a full
+ * group table, is flushed first so fan-out never overflows the burst arrays */
+static void switch_add(struct switch_groups *groups, struct finsFrame *ff)
+{
+	unsigned char id = ff->destinationID.id;
+	struct switch_group *g;
+	int j;
+
+	for (j = 0; j < groups->ngroups; j++)
+		if (groups->group[j].id == id)
+			break;
+	if (j == groups->ngroups)
+	{
+		if (j == SWITCH_BURST)
+		{
+			switch_flush(groups);
+			j = 0;
+		}
+		groups->group[j].id = id;
+		groups->group[j].q = __atomic_load_n(&switch_dispatch[id], __ATOMIC_ACQUIRE);
+		groups->group[j].n = 0;
+		groups->ngroups++;
+	}
+
+	g = &groups->group[j];
+	if (g->n == SWITCH_BURST)
+		switch_flush_group(g);
+	g->frames[g->n++] = ff;
+
+}
+
+/**@brief forwards one burst read from a module queue. The frames are grouped by
+ * destination (keeping their relative order) and every group is handed over
+ * with a single burst write.
+ * A frame whose destinationList has more than one entry is delivered to each
+ * of them: every extra destination gets a clone sharing the payload and the
+ * metadata of the original (see cloneFinsFrame), nothing is copied
+ * */
+static void switch_forward_burst(struct finsFrame *burst[], int n)
+{
+	struct switch_groups groups;
+	struct destinationList *dest;
+	struct destinationList *next;
+	int i;
 
-extern sem_t Switch_to_EtherStub_Qsem;
-extern sem_t EtherStub_to_Switch_Qsem;
+	groups.ngroups = 0;
 
+	for (i = 0; i < n; i++)
+	{
+		/** the clones are taken before the original is handed over */
+		dest = burst[i]->destinationID.next;
+		burst[i]->destinationID.next = NULL;
+		for (; dest != NULL; dest = next)
+		{
+			next = dest->next;
+			switch_add(&groups, cloneFinsFrame(burst[i], dest->id));
+			free(dest);
+		}
+		switch_add(&groups, burst[i]);
+	}
 
-extern finsQueue modules_IO_queues[MAX_modules];
-extern sem_t *IO_queues_sem[MAX_modules];
+	switch_flush(&groups);
 
+}
 
 void init_switch()
 {
 
 	PRINT_DEBUG("SWITCH Module started");
 	int i;
-	struct finsFrame *ff=NULL;
-	struct finsFrame *ff_src;
-
-	struct finsFrame *ff_dst;
+	int n;
+	struct finsFrame *burst[SWITCH_BURST];
 	int counter=0;
+	int found;
+	int ninputs;
 
 			while (1)
 			{
-				/** the receiving Queues are only the even numbers
-				 * 0,2,4,6,8,10. This is why we increase the counter by 2
-				 */
-				for(i= 0; i< MAX_modules; i=i+2)
+				found = 0;
+				/** picks up modules registered since the previous round */
+				ninputs = __atomic_load_n(&switch_num_inputs, __ATOMIC_ACQUIRE);
+
+				for(i= 0; i< ninputs; i++)
 				{
 
-					sem_wait(IO_queues_sem[i]);
-					ff = read_queue(modules_IO_queues[i]);
-					sem_post(IO_queues_sem[i]);
+					n = read_queue_burst(switch_input_queues[i], burst, SWITCH_BURST);
 
-		if (ff != NULL)
+		if (n > 0)
 		{
-			counter++;
+			counter += n;
+			found = 1;
+			switch_forward_burst(burst, n);
+			PRINT_DEBUG("Counter %d", counter);
 
-				switch  (ff->destinationID.id)
-				{
-
-						case ARPID:
-						{
-					sem_wait(&Switch_to_ARP_Qsem);
-					write_queue(ff,Switch_to_ARP_Queue);
-					sem_post(&Switch_to_ARP_Qsem);
-						break;
-
-						}
-						case JINNIID:
-						{
-							PRINT_DEBUG("Jinni Queue +1");
-					sem_wait(&Switch_to_Jinni_Qsem);
-					write_queue(ff,Switch_to_Jinni_Queue);
-					sem_post(&Switch_to_Jinni_Qsem);
-
-					break;
-						}
-						case UDPID:
-						{
-							PRINT_DEBUG("UDP Queue +1");
-					sem_wait(&Switch_to_UDP_Qsem);
-					write_queue(ff,Switch_to_UDP_Queue);
-					sem_post(&Switch_to_UDP_Qsem);
-					break;
-						}
-						case  TCPID:
-						{
-							PRINT_DEBUG("TCP Queue +1");
-					sem_wait(&Switch_to_TCP_Qsem);
-					write_queue(ff,Switch_to_TCP_Queue);
-					sem_post(&Switch_to_TCP_Qsem);
-					break;
-						}
-					case IPV4ID:
-					{
-						PRINT_DEBUG("IP Queue +1");
-					sem_wait(&Switch_to_IPv4_Qsem);
-					write_queue(ff,Switch_to_IPv4_Queue);
-					sem_post(&Switch_to_IPv4_Qsem);
-					break;
-					}
-					case ETHERSTUBID:
-					{
-						PRINT_DEBUG("EtherStub Queue +1");
-					sem_wait(&Switch_to_EtherStub_Qsem);
-					write_queue(ff, Switch_to_EtherStub_Queue);
-					sem_post(&Switch_to_EtherStub_Qsem);
-					break;
-					}
-					case ICMPID:
-					{
-						PRINT_DEBUG("ICMP Queue +1");
-					sem_wait(&Switch_to_ICMP_Qsem);
-					write_queue(ff, Switch_to_ICMP_Queue);
-					sem_post(&Switch_to_ICMP_Qsem);
-					break;
-					}
-					default:
-					{
-						PRINT_DEBUG("Unknown Destination");
-					//	free(ff);
-						break;
-
-					}
-
-
-				} // end of Switch statement
-				PRINT_DEBUG("Counter %d", counter);
-
-
-		} // end of if (ff != NULL )
-		else
-		{	//PRINT_DEBUG("No frame read from Queue # %d", i);
-
-		}
+		} // end of if (n > 0 )
 
 				} //end of for For loop (Round Robin reading from Modules)
 
-
-
+				/** a whole round found nothing, sleep until some module writes */
+				if (!found)
+					WaitDoorbell(&switch_doorbell, switch_input_queues, ninputs);
 
 			} // end of while loop
 
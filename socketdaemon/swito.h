@@ -8,7 +8,15 @@
 #ifndef SWITO_H_
 #define SWITO_H_
 
+#include <queueModule.h>
+
+/** module IDs are one byte (destinationID.id), hence one dispatch slot per value */
+#define MAX_MODULE_IDS 256
+/** maximum number of module->switch queues */
+#define MAX_SWITCH_INPUTS 32
+
 void init_switch();
+int fins_register_module(unsigned char id, finsQueue in_q, finsQueue out_q);
 
 
 #endif /* SWITO_H_ */
@@ -13,6 +13,7 @@
 #include <string.h>
 #include <finstypes.h>
 #include "udp.h"
+#include <queueModule.h>
 
 int UDP_InputQueue_Read_local(struct finsFrame *pff_local) {
 	struct finsFrame *pff = 0;
@@ -29,13 +30,17 @@ int UDP_InputQueue_Read_local(struct finsFrame *pff_local) {
 			memcpy((pff_local->dataFrame.pdu)+U_HEADER_LEN, pff->dataFrame.pdu,
 					pff->dataFrame.pduLength);
 			free(pff->dataFrame.pdu);
-			free(pff);
+			/** the metadata now belongs to pff_local */
+			pff->dataFrame.metaData = NULL;
+			freeFinsFrame(pff);
 		} else {
 			pff_local->dataFrame.pdu = malloc(pff->dataFrame.pduLength);
 			memcpy(pff_local->dataFrame.pdu, pff->dataFrame.pdu,
 					pff->dataFrame.pduLength);
 			free(pff->dataFrame.pdu);
-			free(pff);
+			/** the metadata now belongs to pff_local */
+			pff->dataFrame.metaData = NULL;
+			freeFinsFrame(pff);
 		}
 	} else {
 		//todo: do the copy for control if requested by Abdallah
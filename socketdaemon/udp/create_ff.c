@@ -10,6 +10,7 @@
 #include <string.h>
 #include <finstypes.h>
 #include "udp.h"
+#include <queueModule.h>
 
 /**@brief generates and returns a new Fins Frame using the paramters provided
  * @param dataOrCtrl tells whether or not to make an FCF or FDF
@@ -26,10 +27,7 @@ extern struct udp_statistics udpStat;
 struct finsFrame* create_ff(int dataOrCtrl, int direction, int destID,
 		int PDU_length, unsigned char* PDU, metadata  *meta)
 {
-struct finsFrame *ff = (struct finsFrame *)malloc(sizeof(struct finsFrame));
-char *data;
-data = (char *) malloc(PDU_length);
-memcpy(data,PDU,PDU_length);
+struct finsFrame *ff = allocFinsFrame();
 
 	if (dataOrCtrl == DATA)
 	{
@@ -38,8 +36,7 @@ memcpy(data,PDU,PDU_length);
 		ff->destinationID.next=NULL;
 
 		ff->dataFrame.directionFlag = direction;
-		ff->dataFrame.pduLength = PDU_length;
-		ff->dataFrame.pdu = data;
+		fins_frame_copy_pdu(&ff->dataFrame, PDU, PDU_length);
 		ff->dataFrame.metaData = meta;
 	//	memcpy(&ff.dataFrame.metaData, metadata, MAX_METADATASIZE);
 	}
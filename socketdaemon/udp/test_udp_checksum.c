@@ -0,0 +1,237 @@
+/**@file test_udp_checksum.c
+ *@brief tests the UDP checksum end to end: udp_out computes it over the
+ * pseudoheader of the address IPv4 sends from, udp_in verifies it
+ *
+ * Built on its own, with udp.c, udp_in.c, udp_out.c, UDP_checksum.c and the
+ * fins_headers and data_structure sources. Every datagram udp_out sends is
+ * handed back to udp_in as IPv4 delivers it, its payload summed by IPv4 or
+ * not; it has to come through intact, and be dropped once a bit of it flipped
+ *@date Oct 17, 2026
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <finstypes.h>
+#include <finsBuff.h>
+#include <finsCsum.h>
+#include <queueModule.h>
+#include <ipv4.h>
+#include "udp.h"
+
+#define TEST_ROUNDS		2000	/**<datagrams sent*/
+#define TEST_LENGTH		1472	/**<the longest payload*/
+#define TEST_DST		IP4_ADR_P2N(10,1,2,3)
+#define TEST_SRCPORT	4000
+#define TEST_DSTPORT	53
+
+finsQueue UDP_to_Switch_Queue;
+finsQueue Switch_to_UDP_Queue;
+IP4addr my_ip_addr;
+
+extern struct udp_statistics udpStat;
+
+static unsigned int failures;
+
+static void test_fail(const char *what, unsigned int len)
+{
+	printf("FAIL %s: %u bytes of payload\n", what, len);
+	failures++;
+}
+
+/**
+ * @brief sends the payload down through udp_out, as the jinni does
+ * @param summed the payload comes with its partial sum
+ * @return the frame udp_out hands to IPv4, its pdu the datagram
+ */
+static struct finsFrame *test_send(const unsigned char *payload, unsigned int len, int summed)
+{
+	struct finsFrame *ff;
+	metadata *meta;
+	unsigned char *pdu;
+
+	ff = allocFinsFrame();
+	ff->dataOrCtrl = DATA;
+	ff->destinationID.id = UDPID;
+	ff->destinationID.next = NULL;
+	ff->dataFrame.directionFlag = DOWN;
+	meta = allocMetadata();
+	metadata_set_dstip(meta, TEST_DST);
+	/** bound to INADDR_ANY, IPv4 sends from my_ip_addr */
+	metadata_set_srcip(meta, 0);
+	metadata_set_dstport(meta, TEST_DSTPORT);
+	metadata_set_srcport(meta, TEST_SRCPORT);
+	ff->dataFrame.metaData = meta;
+	pdu = fins_frame_alloc_pdu(&ff->dataFrame, len);
+	memcpy(pdu, payload, len);
+	if (summed)
+	{
+		ff->dataFrame.csum = fins_csum_partial(pdu, len, 0);
+		ff->dataFrame.csumValid = 1;
+	}
+
+	udp_out(ff);
+	return (read_queue(UDP_to_Switch_Queue));
+}
+
+/**
+ * @brief hands the datagram to udp_in as IPv4 delivers it, from my_ip_addr
+ * to TEST_DST
+ * @param summed IPv4 summed the datagram on its way up
+ * @return 1 if udp_in passed the payload on to the sockets, intact; 0 if it
+ * dropped the datagram
+ */
+static int test_receive(const unsigned char *datagram, unsigned int len, int summed,
+		const unsigned char *payload)
+{
+	struct finsFrame *ff;
+	metadata *meta;
+	unsigned char *pdu;
+	int delivered;
+
+	ff = allocFinsFrame();
+	ff->dataOrCtrl = DATA;
+	ff->destinationID.id = UDPID;
+	ff->destinationID.next = NULL;
+	ff->dataFrame.directionFlag = UP;
+	/** IPv4 leaves the addresses as they are in its header */
+	meta = allocMetadata();
+	metadata_set_srcip(meta, htonl(my_ip_addr));
+	metadata_set_dstip(meta, htonl(TEST_DST));
+	metadata_set_protocol(meta, UDP_PROTOCOL);
+	ff->dataFrame.metaData = meta;
+	pdu = fins_frame_alloc_pdu(&ff->dataFrame, len);
+	memcpy(pdu, datagram, len);
+	if (summed)
+	{
+		ff->dataFrame.csum = fins_csum_partial(pdu, len, 0);
+		ff->dataFrame.csumValid = 1;
+	}
+
+	udp_in(ff);
+	ff = read_queue(UDP_to_Switch_Queue);
+	if (ff == NULL)
+		return (0);
+	delivered = ff->destinationID.id == SOCKETSTUBID
+			&& ff->dataFrame.pduLength == len - U_HEADER_LEN
+			&& memcmp(ff->dataFrame.pdu, payload, len - U_HEADER_LEN) == 0;
+	if (!delivered)
+		test_fail("payload passed on", len - U_HEADER_LEN);
+	freeFinsFrame(ff);
+	return (1);
+}
+
+/**
+ * @brief every datagram sent is received, summed by the jinni and IPv4 or
+ * not; with a bit flipped it is dropped
+ */
+static void test_round_trip()
+{
+	unsigned char payload[TEST_LENGTH];
+	unsigned char datagram[U_HEADER_LEN + TEST_LENGTH];
+	struct finsFrame *ff;
+	struct udp_header *header;
+	unsigned int round;
+	unsigned int len;
+	unsigned int position;
+	unsigned int i;
+	unsigned int bad;
+
+	for (round = 0; round < TEST_ROUNDS; round++)
+	{
+		len = (round < 16) ? round : rand() % (TEST_LENGTH + 1);
+		for (i = 0; i < len; i++)
+			payload[i] = (round % 8 == 0) ? 0xff : rand();
+
+		ff = test_send(payload, len, round & 1);
+		if (ff == NULL || ff->dataFrame.pduLength != U_HEADER_LEN + len)
+		{
+			test_fail("datagram sent", len);
+			if (ff != NULL)
+				freeFinsFrame(ff);
+			continue;
+		}
+		memcpy(datagram, ff->dataFrame.pdu, U_HEADER_LEN + len);
+		freeFinsFrame(ff);
+		header = (struct udp_header *) datagram;
+		if (header->u_cksum == IGNORE_CHEKSUM || ntohs(header->u_len) != U_HEADER_LEN + len
+				|| ntohs(header->u_src) != TEST_SRCPORT || ntohs(header->u_dst) != TEST_DSTPORT)
+			test_fail("header sent", len);
+
+		bad = udpStat.badChecksum;
+		if (!test_receive(datagram, U_HEADER_LEN + len, round & 2, payload)
+				|| udpStat.badChecksum != bad)
+			test_fail("datagram received", len);
+
+		/** any bit but the ones of the length, which is checked first */
+		do
+			position = rand() % (U_HEADER_LEN + len);
+		while (position == 4 || position == 5);
+		datagram[position] ^= 1 << (rand() % 8);
+		if (header->u_cksum == IGNORE_CHEKSUM)
+			continue;
+		if (test_receive(datagram, U_HEADER_LEN + len, round & 2, payload)
+				|| udpStat.badChecksum != bad + 1)
+			test_fail("corrupt datagram dropped", len);
+	}
+}
+
+/**
+ * @brief a datagram whose checksum comes to 0 is sent with 0xffff, 0 would
+ * read as no checksum; one sent without a checksum is taken as is
+ */
+static void test_zero_checksum()
+{
+	unsigned char payload[64];
+	unsigned char datagram[U_HEADER_LEN + 64];
+	struct finsFrame *ff;
+	struct udp_header *header = (struct udp_header *) datagram;
+	unsigned int i;
+	unsigned int nochecksum;
+	uint32_t word;
+	uint16_t half;
+	uint16_t check;
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = rand();
+	ff = test_send(payload, sizeof(payload), 0);
+	check = ((struct udp_header *) ff->dataFrame.pdu)->u_cksum;
+	freeFinsFrame(ff);
+
+	/** adding the checksum to a word of the payload makes the sum 0xffff */
+	memcpy(&half, payload, 2);
+	word = half + check;
+	half = (word & 0xffff) + (word >> 16);
+	memcpy(payload, &half, 2);
+
+	ff = test_send(payload, sizeof(payload), 1);
+	memcpy(datagram, ff->dataFrame.pdu, sizeof(datagram));
+	freeFinsFrame(ff);
+	if (header->u_cksum != 0xffff)
+		test_fail("checksum of 0 sent as 0xffff", sizeof(payload));
+	if (!test_receive(datagram, sizeof(datagram), 0, payload)
+			|| !test_receive(datagram, sizeof(datagram), 1, payload))
+		test_fail("datagram with the checksum 0xffff received", sizeof(payload));
+
+	nochecksum = udpStat.noChecksum;
+	header->u_cksum = IGNORE_CHEKSUM;
+	if (!test_receive(datagram, sizeof(datagram), 1, payload)
+			|| udpStat.noChecksum != nochecksum + 1)
+		test_fail("datagram without checksum received", sizeof(payload));
+}
+
+int main(int argc, char *argv[])
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	UDP_to_Switch_Queue = init_queue("udp_to_switch", 8);
+	my_ip_addr = IP4_ADR_P2N(192,168,1,28);
+
+	test_round_trip();
+	test_zero_checksum();
+
+	term_queue(UDP_to_Switch_Queue);
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return (failures ? 1 : 0);
+}
@@ -17,19 +17,20 @@
 
 
 struct udp_statistics udpStat;
-extern sem_t UDP_to_Switch_Qsem;
 extern finsQueue UDP_to_Switch_Queue;
 
-extern sem_t Switch_to_UDP_Qsem;
 extern finsQueue Switch_to_UDP_Queue;
 
 
+/**@brief hands ff over to the switch, ff is dropped when the queue is full */
 void sendToSwitch(struct finsFrame *ff)
 {
 
-	sem_wait(&UDP_to_Switch_Qsem);
-		write_queue(ff,UDP_to_Switch_Queue);
-	sem_post(&UDP_to_Switch_Qsem);
+	if (write_queue(ff,UDP_to_Switch_Queue) == 0)
+	{
+		PRINT_DEBUG("UDP_to_Switch_Queue full, frame dropped");
+		freeFinsFrame(ff);
+	}
 
 }
 
@@ -40,11 +41,7 @@ void udp_get_FF()
 {
 
 	struct finsFrame *ff;
-	do {
-			sem_wait (&Switch_to_UDP_Qsem);
-				ff = read_queue(Switch_to_UDP_Queue);
-			sem_post (&Switch_to_UDP_Qsem);
-		} while (ff == NULL);
+	ff = read_queue_wait(Switch_to_UDP_Queue);
 
 
 	udpStat.totalRecieved++;
@@ -52,6 +49,7 @@ void udp_get_FF()
 	if(ff->dataOrCtrl == CONTROL){
 		// send to something to deal with FCF
 		PRINT_DEBUG("send to CONTROL HANDLER !");
+		freeFinsFrame(ff);
 	}
 	if( (ff->dataOrCtrl == DATA) && ( (ff->dataFrame).directionFlag == UP) )
 	{
@@ -91,6 +91,7 @@ struct udp_statistics{
 void udp_init();
 unsigned short UDP_checksum(struct udp_packet* pcket,
 		struct udp_metadata_parsed* meta);
+unsigned short UDP_checksum_sum(struct udp_metadata_parsed* meta, uint32_t sum);
 void udp_in(struct finsFrame* ff);
 void udp_out(struct finsFrame* ff);
 struct finsFrame* create_ff(int dataOrCtrl, int direction, int destID,
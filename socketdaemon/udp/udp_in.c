@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <arpa/inet.h>
+#include <queueModule.h>
 #include "udp.h"
 
 
@@ -15,9 +17,10 @@
  * @brief removes the UDP header information from an incoming datagram passing it on to the socket.
  * @param ff- the fins frame most likely recieved from IP through the dataswitch.
  *
- * udp_in moves the UDP header information into the metadata. Then it constructs a new FDF destined
- * for the socket with this new metadata.The PDU now points to the data that was inside of the UDP
- * datagram. Prior to this however, the checksum is verified.
+ * udp_in moves the UDP header information into the metadata. Then it pulls the header off the
+ * PDU, which now points to the data that was inside of the UDP datagram, and forwards the same
+ * FDF to the socket. Prior to this however, the checksum is verified.
+ * udp_in owns ff, it either passes it on or frees it.
  */
 
 
@@ -26,19 +29,17 @@ extern struct udp_statistics udpStat;
 void udp_in(struct finsFrame* ff)
 {
 
-	struct finsFrame *newFF;
-
 	/* read the FDF and make sure everything is correct*/
 	if (ff->dataOrCtrl != DATA ) {
-		// release FDF here
+		freeFinsFrame(ff);
 		return;
 	}
 	if (ff->dataFrame.directionFlag != UP) {
-		// release FDF here
+		freeFinsFrame(ff);
 		return;
 	}
 	if (ff->destinationID.id != UDPID) {
-		// release FDF here
+		freeFinsFrame(ff);
 		return;
 	}
 
@@ -49,13 +50,16 @@ void udp_in(struct finsFrame* ff)
 	metadata* meta = ff->dataFrame.metaData;
 
 	uint16_t protocol_type;
-	unsigned long srcip;
-	unsigned long dstip;
+	uint32_t srcip;
+	uint32_t dstip;
+	uint16_t datagram_length;
+	unsigned short checksum;
+	struct udp_metadata_parsed parsed_meta;
 
 
-	metadata_readFromElement(meta,"protocol",&protocol_type);
-	metadata_readFromElement(meta,"ipsrc",&srcip);
-	metadata_readFromElement(meta,"ipdst",&dstip);
+	metadata_get_protocol(meta,&protocol_type);
+	metadata_get_srcip(meta,&srcip);
+	metadata_get_dstip(meta,&dstip);
 
 	PRINT_DEBUG("UDP_in");
 
@@ -78,21 +82,41 @@ void udp_in(struct finsFrame* ff)
 		udpStat.totalBadDatagrams++;
 		PRINT_DEBUG("UDP_in");
 
+		freeFinsFrame(ff);
 		return;
 	}
 	PRINT_DEBUG("UDP_in");
 
+	/* the datagram has to fit in what IP delivered */
+	datagram_length = ntohs(packet->u_len);
+	if (datagram_length < U_HEADER_LEN || datagram_length > (ff->dataFrame).pduLength) {
+		udpStat.mismatchingLengths++;
+		udpStat.totalBadDatagrams++;
+		PRINT_DEBUG("UDP_in");
+
+		freeFinsFrame(ff);
+		return;
+	}
+
 	/* the packet is does have an "Ignore checksum" value and fails the checksum, it is thrown away */
-	/** TODO Correct the implementation of the function UDP_checksum
-	 * Now it will be called as a dummy function
-	 * */
-/**
 	if (packet->u_cksum != IGNORE_CHEKSUM ){
-			if(UDP_checksum(packet, meta) != 0) {
+			/** IP leaves the addresses in the metadata in network order */
+			parsed_meta.u_IPsrc = srcip;
+			parsed_meta.u_IPdst = dstip;
+			parsed_meta.u_prcl = htons(UDP_PROTOCOL);
+			parsed_meta.u_pslen = packet->u_len;
+			/** IP summed the datagram while it copied it into the frame */
+			if ((ff->dataFrame).csumValid && datagram_length == (ff->dataFrame).pduLength)
+				checksum = UDP_checksum_sum(&parsed_meta, (ff->dataFrame).csum);
+			else
+				checksum = UDP_checksum((struct udp_packet *) packet, &parsed_meta);
+			(ff->dataFrame).csumValid = 0;
+			if(checksum != 0) {
 				udpStat.badChecksum++;
 				udpStat.totalBadDatagrams ++;
 				PRINT_DEBUG("UDP_in");
 
+				freeFinsFrame(ff);
 				return;
 			}
 
@@ -102,37 +126,36 @@ void udp_in(struct finsFrame* ff)
 
 	}
 	PRINT_DEBUG("UDP_in");
-*/
 //metadata *udp_meta = (metadata *)malloc (sizeof(metadata));
 //metadata_create(udp_meta);
 	PRINT_DEBUG("%d , %d, %d, %d, %d", protocol_type,srcip,dstip,
 			packet->u_dst,packet->u_src);
 
-	metadata_writeToElement(meta,"portdst",&packet->u_dst,META_TYPE_INT);
-	metadata_writeToElement(meta,"portsrc",&packet->u_src,META_TYPE_INT);
+	/** the frame may be a clone handed to several modules */
+	meta = unshareMetadata(ff);
+	metadata_set_dstport(meta,packet->u_dst);
+	metadata_set_srcport(meta,packet->u_src);
 	/* put the header into the meta data*/
 //	meta->u_destPort = packet->u_dst;
 //	meta->u_srcPort = packet->u_src;
 
-	/* construct a FDF to send to the sockets */
-	PRINT_DEBUG("UDP_in");
-
-	ff->dataFrame.pdu = ff->dataFrame.pdu + U_HEADER_LEN;
+	/* the same FDF goes on up to the sockets, minus the UDP header */
 	PRINT_DEBUG("UDP_in");
 	PRINT_DEBUG("PDU Length including UDP header %d", (ff->dataFrame).pduLength);
-	PRINT_DEBUG("PDU Length %d", ((ff->dataFrame).pduLength) - U_HEADER_LEN);
-
-	//newFF = create_ff(DATA, UP, SOCKETSTUBID, ((int)(ff->dataFrame.pdu) - U_HEADER_LEN), &((ff->dataFrame).pdu), meta);
-	newFF = create_ff(DATA, UP, SOCKETSTUBID, ((ff->dataFrame).pduLength) - U_HEADER_LEN, ((ff->dataFrame).pdu), meta);
 
-	PRINT_DEBUG("PDU Length %d", (newFF->dataFrame).pduLength);
+	if (fins_frame_pull(&ff->dataFrame, U_HEADER_LEN) == NULL) {
+		udpStat.totalBadDatagrams++;
+		freeFinsFrame(ff);
+		return;
+	}
+	PRINT_DEBUG("PDU Length %d", (ff->dataFrame).pduLength);
 
-	//print_finsFrame(newFF);
+	ff->destinationID.id = SOCKETSTUBID;
+	ff->destinationID.next = NULL;
 
-	//freeFinsFrame(ff);
 	PRINT_DEBUG("UDP_in");
 
-	sendToSwitch(newFF);
+	sendToSwitch(ff);
 }
 
 
@@ -10,6 +10,10 @@
 #include <stdint.h>
 #include <string.h>
 #include <finstypes.h>
+#include <finsBuff.h>
+#include <finsCsum.h>
+#include <queueModule.h>
+#include <ipv4.h>
 #include "udp.h"
 
 /**
@@ -24,24 +28,25 @@
 
 
 extern struct udp_statistics udpStat;
+/** the address IPv4 sends every datagram from (see IP4_receive_fdf), in host order */
+extern IP4addr my_ip_addr;
 
 void udp_out(struct finsFrame* ff)
 {
 
-	struct finsFrame* newFF;
 	struct udp_metadata_parsed parsed_meta;
 
 	/* read the FDF and make sure everything is correct*/
 	if (ff->dataOrCtrl != DATA) {
-		// release FDF here
+		freeFinsFrame(ff);
 		return;
 	}
 	if (ff->dataFrame.directionFlag != DOWN) {
-		// release FDF here
+		freeFinsFrame(ff);
 		return;
 	}
 	if (ff->destinationID.id != UDPID) {
-		// release FDF here
+		freeFinsFrame(ff);
 		return;
 	}
 
@@ -49,114 +54,72 @@ void udp_out(struct finsFrame* ff)
 
 	print_finsFrame(ff);
 
-	struct udp_header packet;
-	struct udp_packet check_packet;
-	u_char test[100];
+	struct udp_header *packet;
 	metadata* meta = (ff->dataFrame).metaData;
 
-	u_char *udp_dataunit = (u_char *)malloc( (ff->dataFrame).pduLength + U_HEADER_LEN );
-
 /** constructs the UDP packet from the FDF and the meta data */
 	PRINT_DEBUG("%d", ff->dataFrame.pduLength);
 
-	uint32_t dstbuf;
-	uint32_t srcbuf;
+	uint16_t dstbuf;
+	uint16_t srcbuf;
 	uint32_t dstip;
-	uint32_t srcip;
 
 	PRINT_DEBUG("UDP_out");
-	metadata_readFromElement(meta,"dstport",&dstbuf);
-	metadata_readFromElement(meta,"srcport",&srcbuf);
-	metadata_readFromElement(meta,"dstip",&dstip);
-	metadata_readFromElement(meta,"srcip",&srcip);
-/** fixing the values because of the conflict between uint16 type and
- * the 32 bit META_INT_TYPE
- */
-	packet.u_dst = dstbuf;
-	packet.u_src = srcbuf;
+	metadata_get_dstport(meta,&dstbuf);
+	metadata_get_srcport(meta,&srcbuf);
+	metadata_get_dstip(meta,&dstip);
 
-	PRINT_DEBUG("%d, %d", (packet.u_dst),(packet.u_src));
-
-	(packet.u_dst) = htons(packet.u_dst);
-	(packet.u_src) = htons(packet.u_src);
 	/* calculates the UDP length by adding the UDP header length to the length of the data */
 	int packet_length;
-	packet_length= ( ((ff->dataFrame).pduLength) + U_HEADER_LEN );;
-	packet.u_len = htons( ((ff->dataFrame).pduLength) + U_HEADER_LEN );
+	packet_length= ( ((ff->dataFrame).pduLength) + U_HEADER_LEN );
 
+	/** the header goes into the headroom right in front of the payload,
+	 * the payload itself is not copied */
+	packet = (struct udp_header *) fins_frame_push(&ff->dataFrame, U_HEADER_LEN);
 
- /** TODO ignore the checksum for now
- * Will be fixed later
- */
-	/** Invalidation disabled value = 0xfed2*/
+	packet->u_dst = dstbuf;
+	packet->u_src = srcbuf;
 
+	PRINT_DEBUG("%d, %d", (packet->u_dst),(packet->u_src));
 
-	parsed_meta.u_destPort = htons( packet.u_dst);
-	parsed_meta.u_srcPort = htons( packet.u_src);
+	(packet->u_dst) = htons(packet->u_dst);
+	(packet->u_src) = htons(packet->u_src);
+	packet->u_len = htons( packet_length );
+
+
+	parsed_meta.u_destPort = htons( packet->u_dst);
+	parsed_meta.u_srcPort = htons( packet->u_src);
 	parsed_meta.u_IPdst = htonl( dstip);
-	parsed_meta.u_IPsrc = htonl( dstip);
+	/** the pseudoheader has the source IPv4 writes into the header, not the
+	 * address the socket is bound to, which may be INADDR_ANY */
+	parsed_meta.u_IPsrc = htonl( my_ip_addr);
 	parsed_meta.u_pslen = htons( packet_length);
 	parsed_meta.u_prcl = htons( UDP_PROTOCOL);
-	packet.u_cksum = 0;
-
+	/* stores a value of zero in the checksum field so that it can be calculated */
+	packet->u_cksum = 0;
+	/** the payload was summed while the jinni copied it in, only the header is left */
+	if ((ff->dataFrame).csumValid)
+		packet->u_cksum = UDP_checksum_sum(&parsed_meta,
+				fins_csum_partial(packet, U_HEADER_LEN, (ff->dataFrame).csum));
+	else
+		packet->u_cksum = UDP_checksum((struct udp_packet *) packet,&parsed_meta);
+	(ff->dataFrame).csumValid = 0;
+	/** a checksum of 0 would read as no checksum, its ones' complement twin is sent */
+	if (packet->u_cksum == IGNORE_CHEKSUM)
+		packet->u_cksum = 0xffff;
+
+
+PRINT_DEBUG("%d,%d,%d,%d", packet->u_src,packet->u_dst,packet->u_len,packet->u_cksum);
 
-	memcpy(&check_packet,&packet,U_HEADER_LEN);
-	memcpy(&check_packet,ff->dataFrame.pdu,ff->dataFrame.pduLength);
-	packet.u_cksum = UDP_checksum(&check_packet,&parsed_meta);																			/* stores a value of zero in the checksum field so that it can be calculated */
-
-
-PRINT_DEBUG("%d,%d,%d,%d", packet.u_src,packet.u_dst,packet.u_len,packet.u_cksum);
-
-//	packet.u_cksum = UDP_checksum(&packet, meta);												/* calculates ands stores the real checksum in the checksum field */
 /* need to be careful in the line ^ above ^, the metadata needs to have the source and destination IPS in order to calculate the checksum */
 
-	//printf("The checksum Value is %d", packet.u_cksum);
-	int i=0;
-	while (i < ff->dataFrame.pduLength)
-	{
-		PRINT_DEBUG("%d",ff->dataFrame.pdu[i]);
-		i++;
-
-	}
-	PRINT_DEBUG("UDP_out");
-	memcpy(udp_dataunit, &packet, U_HEADER_LEN);											/* copies the UDP packet into the memory that has been allocated for the PDU */
-//	PRINT_DEBUG("%d, %d",(ff->dataFrame).pdu, ff->dataFrame.pduLength);
-
-	memcpy(udp_dataunit + U_HEADER_LEN ,(ff->dataFrame).pdu, ff->dataFrame.pduLength);		/* moves the pointer 8 bytes to account for those empty 8 bytes*/;
-//	PRINT_DEBUG("%d",packet.u_len);
+	/* the same frame goes on down to IPv4 */
+	ff->destinationID.id = IPV4ID;
+	ff->destinationID.next = NULL;
 
-/**
-	memcpy(test, udp_dataunit, packet_length);
-	test [packet_length] = '\0';
-	i=0;
-	while (i < packet_length)
-	{
-		PRINT_DEBUG("%d",test[i]);
-		i++;
-
-	}
-
-
-
-	//free (ff->dataFrame.pdu);
-	PRINT_DEBUG("%s",test);
-	PRINT_DEBUG("%d",udp_dataunit);
-	*/
-
-	ff->dataFrame.pdu = udp_dataunit;
-	/* creates a new FDF to be sent out */
-	PRINT_DEBUG("%d",ff->dataFrame.pdu);
-
-	PRINT_DEBUG("UDP_out");
-
-	newFF = create_ff(DATA, DOWN, IPV4ID, packet_length, ff->dataFrame.pdu, ff->dataFrame.metaData);
-
-	PRINT_DEBUG("%d",newFF->dataFrame.pdu);
-
-
-	print_finsFrame(newFF);
+	print_finsFrame(ff);
 	udpStat.totalSent++;
 	PRINT_DEBUG("UDP_out");
 
-	sendToSwitch(newFF);
+	sendToSwitch(ff);
 }
@@ -16,17 +16,16 @@
 extern struct finssocket jinniSockets[MAX_sockets];
 extern finsQueue Jinni_to_Switch_Queue;
 extern finsQueue Switch_to_Jinni_Queue;
-extern sem_t *meen_channel_semaphore1;
-extern sem_t *meen_channel_semaphore2;
-extern sem_t Jinni_to_Switch_Qsem;
-extern sem_t Switch_to_Jinni_Qsem;
+extern pthread_mutex_t Jinni_to_Switch_lock;
+extern pthread_rwlock_t jinniSockets_lock;
+extern __thread uint32_t jinni_request_id;
 //extern struct socketIdentifier FinsHistory[MAX_sockets];
 
 struct finsFrame *get_fake_frame()
 {
 
 
-		struct finsFrame *f = (struct finsFrame * ) malloc (sizeof(struct finsFrame));
+		struct finsFrame *f = allocFinsFrame();
 		 PRINT_DEBUG("2.1");
 
 		 int linkvalue= 80211;
@@ -36,9 +35,6 @@ struct finsFrame *get_fake_frame()
 		//fakeData = "loloa7aa7a";
 
 
-		metadata *metaptr = (metadata *)malloc(sizeof (metadata));
-
-
 		PRINT_DEBUG("2.2");
 	//	metadata_create(metaptr);
 		PRINT_DEBUG("2.3");
@@ -72,146 +68,80 @@ struct finsFrame *get_fake_frame()
  *
  */
 
-int readFrom_fins(int senderid,int sockfd,u_char **buf,int *buflen,int symbol,struct sockaddr_in *address, int block_flag)
+/**@brief fills address with the sender of the received datagram ff
+ * */
+void recv_address(struct finsFrame *ff,struct sockaddr_in *address)
 {
 
-	/**TODO MUST BE FIXED LATER
-	 * force symbol to become zero
-	 */
-	symbol = 0;
-	struct finsFrame *ff=NULL;
-	int index;
-	uint16_t srcport;
-	uint32_t srcip;
-	struct sockaddr_in * addr_in= (struct sockaddr_in * )address;
-	index = findjinniSocket(senderid,sockfd);
-	PRINT_DEBUG("index = %d",index);
-	/**
-	 * It keeps looping as a bad method to implement the blocking feature
-	 * of recvfrom. In case it is not blocking then the while loop should
-	 * be replaced with only a single trial !
-	 *
-	 */
-
-	PRINT_DEBUG();
-	if (block_flag == 1)
-	{
-		PRINT_DEBUG();
-
+	uint16_t srcport = 0;
+	uint32_t srcip = 0;
 
+	/** both are kept in network format in the metadata */
+	metadata_get_srcport(ff->dataFrame.metaData,&srcport);
+	metadata_get_srcip(ff->dataFrame.metaData,&srcip);
+	memset(address,0,sizeof(struct sockaddr_in));
+	address->sin_family = AF_INET;
+	address->sin_port = srcport;
+	address->sin_addr.s_addr = srcip;
 
-		do
-			{
-
-					sem_wait(&(jinniSockets[index].Qs));
-			//		PRINT_DEBUG();
-
-
-					ff= read_queue(jinniSockets[index].dataQueue);
-				//	ff = get_fake_frame();
-//					PRINT_DEBUG();
+}
 
-					sem_post(&(jinniSockets[index].Qs));
-			}
-		while(ff == NULL);
-			PRINT_DEBUG();
+/**@brief completes a recvfrom of the client with the datagram ff, the payload
+ * goes from the frame straight into the response ring. ff is freed
+ * @param requestid the Id of the recvfrom request
+ * @param symbol RECV_DATA, RECV_ADDRESS, RECV_ZEROCOPY or RECV_BATCH
+ * @param datalen the room of the client for the payload, RECV_BATCH only
+ * */
+void recvfrom_reply(struct finsFrame *ff,int senderid,uint32_t requestid,int symbol,int datalen)
+{
 
+	struct sockaddr_in address;
 
-	}
-	else
+	PRINT_DEBUG("PDU lenght %d",ff->dataFrame.pduLength);
+	if (symbol == RECV_ZEROCOPY)
 	{
-		PRINT_DEBUG();
-
-					sem_wait(&(jinniSockets[index].Qs));
-						//ff= read_queue(jinniSockets[index].dataQueue);
-					/**	ff = get_fake_frame();
-						print_finsFrame(ff); */
-					ff= read_queue(jinniSockets[index].dataQueue);
-
-					sem_post(&(jinniSockets[index].Qs));
-
+		ack_write_buffer(senderid,requestid,&ff->dataFrame);
+		freeFinsFrame(ff);
+		return;
 	}
-
-	if (ff == NULL)
+	if (symbol == RECV_BATCH)
 	{
-		//free(ff);
-		return(0);
+		ack_write_batch(senderid,requestid,&ff,&datalen,1);
+		freeFinsFrame(ff);
+		return;
 	}
-	PRINT_DEBUG("PDU lenght %d",ff->dataFrame.pduLength);
-
-	//*buf = (u_char *)malloc(sizeof(ff->dataFrame.pduLength));
-	//memcpy(*buf,ff->dataFrame.pdu,ff->dataFrame.pduLength);
-	memcpy(buf,ff->dataFrame.pdu,ff->dataFrame.pduLength);
-	*buflen = ff->dataFrame.pduLength;
-
-	PRINT_DEBUG();
-
-	if (symbol == 0)
-		{
-//		address = NULL;
-		PRINT_DEBUG();
-	//	freeFinsFrame(ff);
-
-		return (1);
-		}
-	PRINT_DEBUG();
-
-	if (metadata_readFromElement(ff->dataFrame.metaData,"hostport",&srcport) == 0 )
-		{
-			address->sin_port = 0;
-					return (1);
-		}
-	if (metadata_readFromElement(ff->dataFrame.metaData,"hostip",&srcip) == 0 )
-		{
-				address->sin_addr.s_addr =0;
-						return (1);
-		}
-
-	addr_in->sin_port = srcport;
-	addr_in->sin_addr.s_addr = srcip;
-
+	if (symbol == RECV_ADDRESS)
+		recv_address(ff,&address);
 
+	ack_write_data(senderid,requestid,(symbol == RECV_ADDRESS) ? &address : NULL,
+			ff->dataFrame.pdu,ff->dataFrame.pduLength);
 
-/**TODO Free the finsFrame
- * This is the final consumer
- * call finsFrame_free(Struct finsFrame** ff)
+/** This is the final consumer of ff
  */
-	PRINT_DEBUG();
-
-	//freeFinsFrame(ff);
-
-/** Finally succeeded
- *
- */
-return(1);
-
+	freeFinsFrame(ff);
 
-} //end of readFrom_fins
+} //end of recvfrom_reply
 
 
-int jinni_UDP_to_fins(u_char *dataLocal,int len,uint16_t dstport,uint32_t dst_IP_netformat,
+/**@brief builds the outgoing UDP frame around the payload read from the client
+ * @param buff the buffer holding the payload, the frame takes over the
+ * caller's reference to it
+ * @param dataLocal the payload inside buff, the bytes in front of it are the
+ * headroom the lower layers write their headers into
+ * @param sum the partial checksum of the payload (see jinni_get_payload)
+ * */
+struct finsFrame *jinni_UDP_frame(struct finsBuff *buff,u_char *dataLocal,int len,uint32_t sum,uint16_t dstport,uint32_t dst_IP_netformat,
 		uint16_t hostport,uint32_t host_IP_netformat)
 {
 
-struct finsFrame *ff= (struct finsFrame *) malloc(sizeof (struct finsFrame));
+struct finsFrame *ff= allocFinsFrame();
 
-metadata *udpout_meta = (metadata *)malloc(sizeof(metadata));
+metadata *udpout_meta = allocMetadata();
 
 	PRINT_DEBUG();
 
-	metadata_create(udpout_meta);
-
-	if ( udpout_meta == NULL )
-	{
-		PRINT_DEBUG("metadata creation failed");
-		free(ff);
-		exit(1);
-
-
-	}
-
-	/** metadata_writeToElement() set the value of an element if it already exist
-	 * or it creates the element and set its value in case it is new
+	/** metadata_set_<field>() sets the value of a well-known element whether
+	 * it was already set or not
 	 */
 	PRINT_DEBUG("%d, %d, %d, %d", dstport,dst_IP_netformat,hostport,
 		host_IP_netformat);
@@ -219,10 +149,10 @@ metadata *udpout_meta = (metadata *)malloc(sizeof(metadata));
 	uint32_t dstprt= dstport;
 	uint32_t hostprt = hostport;
 
-	metadata_writeToElement(udpout_meta,"dstport",&dstport,META_TYPE_INT);
-	metadata_writeToElement(udpout_meta,"srcport",&hostport,META_TYPE_INT);
-	metadata_writeToElement(udpout_meta,"dstip",&dst_IP_netformat,META_TYPE_INT);
-	metadata_writeToElement(udpout_meta,"srcip",&host_IP_netformat,META_TYPE_INT);
+	metadata_set_dstport(udpout_meta,dstport);
+	metadata_set_srcport(udpout_meta,hostport);
+	metadata_set_dstip(udpout_meta,dst_IP_netformat);
+	metadata_set_srcip(udpout_meta,host_IP_netformat);
 
 
 	ff->dataOrCtrl = DATA;
@@ -232,25 +162,64 @@ metadata *udpout_meta = (metadata *)malloc(sizeof(metadata));
 	ff->destinationID.id = UDPID;
 	ff->destinationID.next = NULL;
 	(ff->dataFrame).directionFlag = DOWN;
-	(ff->dataFrame).pduLength = len;
-	(ff->dataFrame).pdu = dataLocal;
+	fins_frame_attach(&ff->dataFrame, buff, dataLocal - buff->data, len);
+	/** summed while it was read from the channel, udp_out only adds the header */
+	(ff->dataFrame).csum = sum;
+	(ff->dataFrame).csumValid = 1;
 	(ff->dataFrame).metaData = udpout_meta ;
 
-/**TODO insert the frame into jinni_to_switch queue
- * check if insertion succeeded or not then
- * return 1 on success, or -1 on failure
+	return (ff);
+
+}
+
+/**@brief queues the UDP frame built by jinni_UDP_frame towards the switch
+ * @param buff the frame takes over the caller's reference to it (and drops it
+ * if the frame cannot be queued)
+ * @param blocking 0 for a non-blocking send, which does not wait for room
+ * in Jinni_to_Switch_Queue
+ * @return 1 on success, 0 on failure, -1 if the send would have to wait
+ * */
+int jinni_UDP_to_fins(struct finsBuff *buff,u_char *dataLocal,int len,uint32_t sum,uint16_t dstport,uint32_t dst_IP_netformat,
+		uint16_t hostport,uint32_t host_IP_netformat,int blocking)
+{
+
+struct finsFrame *ff;
+int status;
+
+	ff = jinni_UDP_frame(buff,dataLocal,len,sum,dstport,dst_IP_netformat,hostport,host_IP_netformat);
+
+/** every jinni worker produces into jinni_to_switch queue, which only takes
+ * one producer at a time
  * */
 	PRINT_DEBUG("");
-sem_wait(&Jinni_to_Switch_Qsem);
-if (write_queue(ff,Jinni_to_Switch_Queue))
+	pthread_mutex_lock(&Jinni_to_Switch_lock);
+		/** a full queue is waited for without the lock, the other workers
+		 * keep sending (or failing with EAGAIN) meanwhile */
+		while (blocking && queue_room(Jinni_to_Switch_Queue) == 0)
+		{
+			pthread_mutex_unlock(&Jinni_to_Switch_lock);
+			wait_queue_room(Jinni_to_Switch_Queue);
+			pthread_mutex_lock(&Jinni_to_Switch_lock);
+		}
+		if (queue_room(Jinni_to_Switch_Queue) == 0)
+			status = -1;
+		else
+			status = write_queue(ff,Jinni_to_Switch_Queue);
+	pthread_mutex_unlock(&Jinni_to_Switch_lock);
+if (status == -1)
+{
+	PRINT_DEBUG("Jinni_to_Switch_Queue is congested");
+	freeFinsFrame(ff);
+	return(-1);
+}
+if (status)
 {
 
-sem_post(&Jinni_to_Switch_Qsem);
 PRINT_DEBUG("");
 	return(1);
 }
-sem_post(&Jinni_to_Switch_Qsem);
 PRINT_DEBUG("");
+	freeFinsFrame(ff);
 
 	return(0);
 
@@ -274,16 +243,20 @@ void socket_udp(int domain, int type,int protocol,int sockfd,int fakeID,pid_t pr
 	char clientName[200];
 	int index;
 	int pipe_desc;
-	int tester;
-	/** TODO lock the pipe semaphore then open the pipe*/
 
-	insertjinniSocket(processid, sockfd,fakeID,type,protocol);
+	pthread_rwlock_wrlock(&jinniSockets_lock);
+		insertjinniSocket(processid, sockfd,fakeID,type,protocol);
+		index = findjinniSocket(processid,sockfd);
+	pthread_rwlock_unlock(&jinniSockets_lock);
 
 	PRINT_DEBUG();
+	/** the client uses its end of this pipe as the socket descriptor. It is
+	 * opened read-write here so that the open does not wait for the client,
+	 * which only opens its end once it has read the ACK. The jinni both writes
+	 * and takes back the readiness token, see jinni_socket_readiness */
 	sprintf(clientName,CLIENT_CHANNEL_RX,processid,fakeID);
 	mkfifo(clientName,0777);
-	pipe_desc = open(clientName,O_WRONLY);
-	index = findjinniSocket(processid,sockfd);
+	pipe_desc = open(clientName,O_RDWR | O_NONBLOCK);
 
 		if (index < 0)
 				{
@@ -294,21 +267,8 @@ void socket_udp(int domain, int type,int protocol,int sockfd,int fakeID,pid_t pr
 	PRINT_DEBUG("0000");
 
 	jinniSockets[index].jinniside_pipe_ds = pipe_desc;
-/** Now the client can proceed to next step after openning the pipe */
-	PRINT_DEBUG("0002");
-	sem_getvalue(jinniSockets[index].s, &tester);
-	PRINT_DEBUG("tester = %d", tester);
-
-
-	PRINT_DEBUG("0001");
 
-
-
-	sem_wait(jinniSockets[index].s);
-		ack_write(pipe_desc,processid,sockfd);
-	sem_post(jinniSockets[index].as);
-	/** TODO unlock the semaphore */
-	sem_post(jinniSockets[index].s);
+	ack_write(processid,sockfd);
 	PRINT_DEBUG("0003");
 
 	return;
@@ -327,10 +287,9 @@ void bind_udp(int sender,int sockfd,struct sockaddr *addr)
 
 	struct sockaddr_in *address;
 	address = (struct sockaddr_in *) addr;
-	/** TODO lock access to the jinnisockets */
-
+	pthread_rwlock_rdlock(&jinniSockets_lock);
 	index = findjinniSocket(sender,sockfd);
-	/** TODO unlock access to the jinnisockets */
+	pthread_rwlock_unlock(&jinniSockets_lock);
 		if (index == -1)
 				{
 					PRINT_DEBUG("socket descriptor not found into jinni sockets");
@@ -340,16 +299,9 @@ void bind_udp(int sender,int sockfd,struct sockaddr *addr)
 	if (address->sin_family != AF_INET )
 	{
 		PRINT_DEBUG("Wrong address family");
-		sem_wait(jinniSockets[index].s);
-		nack_write(jinniSockets[index].jinniside_pipe_ds,sender,sockfd);
-			sem_post(jinniSockets[index].as);
-		sem_post(jinniSockets[index].s);
+		nack_write(sender,sockfd);
 	}
 
-	/**TODO lock the jinni sockets */
-
-
-
 	if (index == -1)
 			{
 				PRINT_DEBUG("socket descriptor not found into jinni sockets");
@@ -360,15 +312,16 @@ void bind_udp(int sender,int sockfd,struct sockaddr *addr)
 	hostport = ntohs(address->sin_port);
 	host_IP_netformat = (address->sin_addr).s_addr;
 /** check if the same port and address have been both used earlier or not
- * it returns (-1) in case they already exist, so that we should not reuse them
+ * it returns (-1) in case they already exist, so that we should not reuse them.
+ * The check and the update below are one step, two workers must not bind
+ * the same port at once
  * */
+	pthread_rwlock_wrlock(&jinniSockets_lock);
 	if (checkjinniports(hostport, host_IP_netformat) == -1)
 		{
+			pthread_rwlock_unlock(&jinniSockets_lock);
 			PRINT_DEBUG("this port is not free");
-			sem_wait(jinniSockets[index].s);
-			nack_write(jinniSockets[index].jinniside_pipe_ds,sender,sockfd);
-				sem_post(jinniSockets[index].as);
-			sem_post(jinniSockets[index].s);
+			nack_write(sender,sockfd);
 
 				free(addr);
 				return;
@@ -380,14 +333,13 @@ void bind_udp(int sender,int sockfd,struct sockaddr *addr)
 	 * */
 	/** Reverse again because it was reversed by the application itself */
 		//hostport = ntohs(address->sin_port);
-/** TODO lock and unlock the protecting semaphores before making
- * any modiciations to the contents of the jinniSockets database
- */
 PRINT_DEBUG("%d,%d,%d",(address->sin_addr).s_addr, ntohs(address->sin_port),
 		address->sin_family);
 
 	jinniSockets[index].hostport = ntohs(address->sin_port);
 	jinniSockets[index].host_IP = (address->sin_addr).s_addr;
+	jinni_socket_publish(index);
+	pthread_rwlock_unlock(&jinniSockets_lock);
 
 	/** Reverse again because it was reversed by the application itself
 	 * In our example it is not reversed */
@@ -397,10 +349,7 @@ PRINT_DEBUG("%d,%d,%d",(address->sin_addr).s_addr, ntohs(address->sin_port),
 	 * sending to the fins core
 	 */
 
-	sem_wait(jinniSockets[index].s);
-	ack_write(jinniSockets[index].jinniside_pipe_ds,sender,sockfd);
-		sem_post(jinniSockets[index].as);
-	sem_post(jinniSockets[index].s);
+	ack_write(sender,sockfd);
 
 	free(addr);
 	return;
@@ -450,7 +399,22 @@ void send_udp(int senderid,int sockfd,int datalen,u_char *data,int flags )
 
 
 
-void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,int flags,
+/**@brief the ports and addresses of a datagram sent from the socket index to
+ * address, all kept in host order until later action taken
+ * */
+static void send_addresses(int index,struct sockaddr_in *address,uint16_t *dstport,uint32_t *dst_IP,
+		uint16_t *hostport,uint32_t *host_IP)
+{
+
+*dstport =ntohs( address->sin_port); /** reverse it since it is in network order after application used htons */
+*dst_IP = ntohl(address-> sin_addr.s_addr);/** it is in network format since application used htonl */
+//*hostport = jinniSockets[index].hostport;
+*hostport = 3000;
+*host_IP = jinniSockets[index].host_IP;
+
+}
+
+void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,struct finsBuff *buff,uint32_t sum,int flags,
 		struct sockaddr *addr,socklen_t addrlen)
 {
 
@@ -461,6 +425,7 @@ void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,int flags,
 
 		int len=datalen;
 		int index;
+		int status;
 
 		/** check if the original call is either (sendto) or (send) or (write)*/
 		if ( (addr == NULL) &&  (addrlen == 0) && (flags != -1000) )
@@ -499,12 +464,11 @@ void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,int flags,
 
 		struct sockaddr_in *address;
 		address = (struct sockaddr_in *) addr;
-		/** TODO lock access to the jinnisockets */
-
+		pthread_rwlock_rdlock(&jinniSockets_lock);
 		index = findjinniSocket(senderid,sockfd);
+		pthread_rwlock_unlock(&jinniSockets_lock);
 		PRINT_DEBUG("");
 
-		/** TODO unlock access to the jinnisockets */
 		if (index == -1)
 			{
 				PRINT_DEBUG("CRASH !! socket descriptor not found into jinni sockets");
@@ -516,13 +480,7 @@ void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,int flags,
 			PRINT_DEBUG("Wrong address family");
 			PRINT_DEBUG("");
 
-			sem_wait(jinniSockets[index].s);
-				PRINT_DEBUG("");
-
-				nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-				sem_post(jinniSockets[index].as);
-
-			sem_post(jinniSockets[index].s);
+			nack_write(senderid,sockfd);
 			PRINT_DEBUG("");
 
 		}
@@ -531,15 +489,7 @@ void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,int flags,
  * the new created location is the one to be included into the newly created finsFrame*/
 		PRINT_DEBUG("");
 
-/** Keep all ports and addresses in host order until later  action taken */
-dstport =ntohs( address->sin_port); /** reverse it since it is in network order after application used htons */
-if (dst_IP != INADDR_LOOPBACK)
-dst_IP = ntohl(address-> sin_addr.s_addr);/** it is in network format since application used htonl */
-else
-	dst_IP = ntohl(address-> sin_addr.s_addr);
-//hostport = jinniSockets[index].hostport;
-hostport = 3000;
-host_IP = jinniSockets[index].host_IP;
+send_addresses(index,address,&dstport,&dst_IP,&hostport,&host_IP);
 PRINT_DEBUG("");
 
 PRINT_DEBUG("%d,%d,%d,%d", dst_IP, dstport, host_IP,hostport);
@@ -550,29 +500,22 @@ PRINT_DEBUG("");
 /** the meta-data paraters are all passes by copy starting from this point
  *
  */
-if (jinni_UDP_to_fins(data,len,dstport,dst_IP,hostport,host_IP)== 1)
+status = jinni_UDP_to_fins(buff,data,len,sum,dstport,dst_IP,hostport,host_IP,!(flags & MSG_DONTWAIT));
+if (status == 1)
 
 {
 	PRINT_DEBUG("");
  /** TODO prevent the socket interceptor from holding this semaphore before we reach this point */
-	sem_wait(jinniSockets[index].s);
-		PRINT_DEBUG("");
-
-		ack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-		sem_post(jinniSockets[index].as);
-
-	sem_post(jinniSockets[index].s);
+	ack_write(senderid,sockfd);
 	PRINT_DEBUG("");
 
 }
+else if (status == -1)
+	error_write(senderid,EAGAIN);
 else
 {
 	PRINT_DEBUG("socketjinni failed to accomplish sendto");
-	sem_wait(jinniSockets[index].s);
-		nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-		sem_post(jinniSockets[index].as);
-
-	sem_post(jinniSockets[index].s);
+	nack_write(senderid,sockfd);
 
 }
 
@@ -582,109 +525,207 @@ return;
 } //end of sendto_udp
 
 
-void recvfrom_udp(int senderid,int sockfd,int datalen,int flags, int symbol )
+/**@brief parks the receive request the calling thread is handling on the
+ * socket index, it is completed by readFromSwitch_to_Jinni through
+ * recvfrom_reply. Called with Qs of the socket held
+ * */
+static void recv_park(int index,int senderid,int symbol,int datalen)
 {
 
+	struct jinniWaiter *waiter;
+	struct jinniWaiter **tail;
 
-		//u_char *buf= NULL;
-	u_char buf[MAX_DATA_PER_UDP];
-		int buflen=0;
-		int index;
-		int i;
-		struct sockaddr_in *address = (struct sockaddr_in *)malloc (sizeof(struct sockaddr_in));
+	waiter = (struct jinniWaiter *) malloc(sizeof(struct jinniWaiter));
+	waiter->senderid = senderid;
+	waiter->requestid = jinni_request_id;
+	waiter->symbol = symbol;
+	waiter->datalen = datalen;
+	waiter->next = NULL;
+	for (tail = &jinniSockets[index].waiters; *tail != NULL; tail = &(*tail)->next)
+		;
+	*tail = waiter;
 
-		int blocking_flag;
-		blocking_flag = 1;
-		/** TODO handle flags cases */
-		switch (flags)
-		{
-
-		default:
-		break;
+}
 
+void recvfrom_udp(int senderid,int sockfd,int datalen,int flags, int symbol )
+{
 
-		}
+		struct finsFrame *ff;
+		int index;
 
+		int blocking_flag;
+		/** the interceptor adds MSG_DONTWAIT for a socket set O_NONBLOCK */
+		blocking_flag = !(flags & MSG_DONTWAIT);
 
-		/** TODO lock access to the jinnisockets */
 
+		/** held while the queue is used, the socket may be closed meanwhile */
+		pthread_rwlock_rdlock(&jinniSockets_lock);
 		index = findjinniSocket(senderid,sockfd);
-		/** TODO unlock access to the jinnisockets */
 			if (index == -1)
 				{
+				pthread_rwlock_unlock(&jinniSockets_lock);
 				PRINT_DEBUG("socket descriptor not found into jinni sockets");
-				exit(1);
+				error_write(senderid,EBADF);
+				return;
 				}
 
 		PRINT_DEBUG("index = %d",index);
-			PRINT_DEBUG();
 
-/** the meta-data parameters are all passed by copy starting from this point
- *
- */
-
-	if ( readFrom_fins(senderid,sockfd,&buf,&buflen,symbol,address,blocking_flag)== 1)
+	/** An empty queue parks a blocking call on the socket instead of holding
+	 * this worker: readFromSwitch_to_Jinni completes it with the next datagram.
+	 * Both sides decide under Qs, so a datagram is either queued or handed to
+	 * a parked call, never both
+	 */
+	sem_wait(&(jinniSockets[index].Qs));
+		ff = read_queue(jinniSockets[index].dataQueue);
+		jinni_socket_readiness(index);
+		if (ff == NULL && blocking_flag == 1)
+			recv_park(index,senderid,symbol,datalen);
+	sem_post(&(jinniSockets[index].Qs));
+	pthread_rwlock_unlock(&jinniSockets_lock);
+
+	if (ff != NULL)
 	{
+		recvfrom_reply(ff,senderid,jinni_request_id,symbol,datalen);
+	}
+	else if (blocking_flag == 0)
+	{
+		PRINT_DEBUG("no datagram for a non-blocking recvfrom");
+		error_write(senderid,EAGAIN);
+	}
+	else
+	{
+		PRINT_DEBUG("recvfrom of %d parked on socket %d",senderid,index);
+	}
 
+return;
+}
 
-		if (symbol == 0)
-		{
-			sem_wait(jinniSockets[index].s);
-
-				ack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-				buf[buflen] = '\0';
-				PRINT_DEBUG("%d",buflen );
-				PRINT_DEBUG("%s",buf);
-				write(jinniSockets[index].jinniside_pipe_ds,&buflen,sizeof(int));
-				write(jinniSockets[index].jinniside_pipe_ds,buf,buflen);
-				sem_post(jinniSockets[index].as);
-			sem_post(jinniSockets[index].s);
-			PRINT_DEBUG();
+/**@brief sends the n datagrams of a sendmmsg of the client in one burst into
+ * Jinni_to_Switch_Queue, and answers with the number of datagrams queued.
+ * The frames take over the references to the buffers of dgrams
+ * */
+void sendmmsg_udp(int senderid,int sockfd,struct jinniDatagram *dgrams,int n,int flags)
+{
 
-		//	free(buf);
-			PRINT_DEBUG();
+		struct finsFrame *frames[FINS_CHANNEL_MAX_BATCH];
+		uint16_t hostport;
+		uint16_t dstport;
+		uint32_t host_IP;
+		uint32_t dst_IP;
+		int index;
+		int queued;
+		int room;
+		int i;
 
-		}
-		else if (symbol == 1 )
+		if (flags & ~UDP_SEND_FLAGS)
+			{
+				PRINT_DEBUG("sendmmsg flags %x not supported",flags & ~UDP_SEND_FLAGS);
+				for (i = 0; i < n; i++)
+					fins_buff_release(dgrams[i].buff);
+				error_write(senderid,EOPNOTSUPP);
+				return;
+			}
+		pthread_rwlock_rdlock(&jinniSockets_lock);
+		index = findjinniSocket(senderid,sockfd);
+		pthread_rwlock_unlock(&jinniSockets_lock);
+		if (index == -1)
+			{
+				PRINT_DEBUG("CRASH !! socket descriptor not found into jinni sockets");
+				exit(1);
+			}
+
+	for (i = 0; i < n; i++)
+	{
+		send_addresses(index,&dgrams[i].addr,&dstport,&dst_IP,&hostport,&host_IP);
+		frames[i] = jinni_UDP_frame(dgrams[i].buff,dgrams[i].data,dgrams[i].len,dgrams[i].sum,dstport,dst_IP,
+				hostport,host_IP);
+	}
+
+	/** one producer at a time, the switch is woken once for what fits below
+	 * the watermark. A non-blocking batch stops there, a blocking one waits
+	 * for room without the lock, as jinni_UDP_to_fins does */
+	queued = 0;
+	pthread_mutex_lock(&Jinni_to_Switch_lock);
+		while (1)
 		{
+			room = queue_room(Jinni_to_Switch_Queue);
+			if (room > n - queued)
+				room = n - queued;
+			queued += write_queue_burst(Jinni_to_Switch_Queue,frames + queued,room);
+			if (queued == n || (flags & MSG_DONTWAIT))
+				break;
+			pthread_mutex_unlock(&Jinni_to_Switch_lock);
+			wait_queue_room(Jinni_to_Switch_Queue);
+			pthread_mutex_lock(&Jinni_to_Switch_lock);
+		}
+	pthread_mutex_unlock(&Jinni_to_Switch_lock);
+	PRINT_DEBUG("%d of %d datagrams queued",queued,n);
+	for (i = queued; i < n; i++)
+		freeFinsFrame(frames[i]);
+
+	if (queued == 0 && (flags & MSG_DONTWAIT))
+		error_write(senderid,EAGAIN);
+	else if (queued == 0)
+		nack_write(senderid,sockfd);
+	else
+		ack_write_count(senderid,queued);
 
-			sem_wait(jinniSockets[index].s);
+} //end of sendmmsg_udp
 
-			ack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-			PRINT_DEBUG();
-			write(jinniSockets[index].jinniside_pipe_ds,address,sizeof(struct sockaddr_in));
-			write(jinniSockets[index].jinniside_pipe_ds,&buflen,sizeof(int));
-			write(jinniSockets[index].jinniside_pipe_ds,buf,buflen);
+/**@brief answers a recvmmsg of the client with up to n datagrams already
+ * queued on the socket, in one response. An empty queue parks the call, it
+ * is then completed with the first datagram to arrive (EAGAIN under
+ * MSG_DONTWAIT)
+ * @param datalens the room of the client for each datagram, a longer one is
+ * truncated
+ * */
+void recvmmsg_udp(int senderid,int sockfd,int n,int *datalens,int flags)
+{
 
-				sem_post(jinniSockets[index].as);
+		struct finsFrame *frames[FINS_CHANNEL_MAX_BATCH];
+		int index;
+		int i;
 
-			sem_post(jinniSockets[index].s);
-		}
-		else
-		{
+		if (flags & ~UDP_RECV_FLAGS)
+			{
+				PRINT_DEBUG("recvmmsg flags %x not supported",flags & ~UDP_RECV_FLAGS);
+				error_write(senderid,EOPNOTSUPP);
+				return;
+			}
+		/** held while the queue is used, as in recvfrom_udp */
+		pthread_rwlock_rdlock(&jinniSockets_lock);
+		index = findjinniSocket(senderid,sockfd);
+			if (index == -1)
+				{
+				pthread_rwlock_unlock(&jinniSockets_lock);
+				PRINT_DEBUG("socket descriptor not found into jinni sockets");
+				error_write(senderid,EBADF);
+				return;
+				}
 
-		}
+	sem_wait(&(jinniSockets[index].Qs));
+		n = read_queue_burst(jinniSockets[index].dataQueue,frames,n);
+		jinni_socket_readiness(index);
+		if (n == 0 && !(flags & MSG_DONTWAIT))
+			recv_park(index,senderid,RECV_BATCH,datalens[0]);
+	sem_post(&(jinniSockets[index].Qs));
+	pthread_rwlock_unlock(&jinniSockets_lock);
 
+	if (n == 0 && (flags & MSG_DONTWAIT))
+	{
+		PRINT_DEBUG("no datagram for a non-blocking recvmmsg");
+		error_write(senderid,EAGAIN);
+		return;
 	}
-	else
+	if (n == 0)
 	{
-		PRINT_DEBUG("socketjinni failed to accomplish recvfrom");
-		sem_wait(jinniSockets[index].s);
-		nack_write(jinniSockets[index].jinniside_pipe_ds,senderid,sockfd);
-
-			sem_post(jinniSockets[index].as);
-
-		sem_post(jinniSockets[index].s);
+		PRINT_DEBUG("recvmmsg of %d parked on socket %d",senderid,index);
+		return;
 	}
-	PRINT_DEBUG();
-
-/** TODO find a way to release these buffers later
- * using free here causing a segmentation fault
- */
-//free(address);
-//free(buf);
-
-return;
-}
+	ack_write_batch(senderid,jinni_request_id,frames,datalens,n);
+	for (i = 0; i < n; i++)
+		freeFinsFrame(frames[i]);
 
+} //end of recvmmsg_udp
 
@@ -10,13 +10,39 @@
 
 #define MAX_DATA_PER_UDP 4096
 
+/** how recvfrom_reply answers, the symbol of recvfrom_udp */
+#define RECV_DATA 0	/** the payload only */
+#define RECV_ADDRESS 1	/** the address of the sender, then the payload */
+#define RECV_ZEROCOPY 2	/** the payload lent in its channel buffer, see ack_write_buffer */
+#define RECV_BATCH 3	/** a recvmmsg response, see ack_write_batch */
+
+/** the flags a UDP send takes, all but MSG_DONTWAIT change nothing for a
+ * datagram that is queued at once */
+#define UDP_SEND_FLAGS (MSG_CONFIRM | MSG_DONTROUTE | MSG_DONTWAIT | MSG_EOR | MSG_MORE | MSG_NOSIGNAL)
+/** the flags a UDP receive takes, a recvmmsg returns once one datagram at
+ * least is there, which is MSG_WAITFORONE */
+#define UDP_RECV_FLAGS (MSG_DONTWAIT | MSG_WAITFORONE)
+
 
 #include "handlers.h"
 
+/** one datagram of a sendmmsg, its payload is data inside buff */
+struct jinniDatagram
+{
+	struct finsBuff *buff;
+	u_char *data;
+	int len;
+	uint32_t sum;	/** the partial checksum of data, see finsCsum.h */
+	struct sockaddr_in addr;
+};
 
-int jinni_UDP_to_fins(u_char *dataLocal,int len,uint16_t dstport,uint32_t dst_IP_netformat,
+struct finsFrame *jinni_UDP_frame(struct finsBuff *buff,u_char *dataLocal,int len,uint32_t sum,uint16_t dstport,uint32_t dst_IP_netformat,
 		uint16_t hostport,uint32_t host_IP_netformat);
-int readFrom_fins(int senderid,int sockfd,u_char **buf,int *buflen,int symbol,struct sockaddr_in *address, int block_flag);
+
+int jinni_UDP_to_fins(struct finsBuff *buff,u_char *dataLocal,int len,uint32_t sum,uint16_t dstport,uint32_t dst_IP_netformat,
+		uint16_t hostport,uint32_t host_IP_netformat,int blocking);
+void recvfrom_reply(struct finsFrame *ff,int senderid,uint32_t requestid,int symbol,int datalen);
+void recv_address(struct finsFrame *ff,struct sockaddr_in *address);
 
 		void socket_udp(int domain, int type,int protocol,int sockfd,int fakeID,int processid);
 		void 	socketpair_udp();
@@ -28,10 +54,12 @@ int readFrom_fins(int senderid,int sockfd,u_char **buf,int *buflen,int symbol,st
 		void	recv_udp(); /** UDP DOESN NOT IMPLEMENT recv without sender */
 		void write_udp (int senderid,int sockfd,int datalen,u_char *data);
 		void send_udp(int senderid,int sockfd,int datalen,u_char *data,int flags );
-		void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,int flags,
+		void sendto_udp(int senderid,int sockfd,int datalen,u_char *data,struct finsBuff *buff,uint32_t sum,int flags,
 		struct sockaddr *addr,socklen_t addrlen);
 
 		void recvfrom_udp(int senderid,int sockfd,int datalen,int flags, int symbol );
+		void sendmmsg_udp(int senderid,int sockfd,struct jinniDatagram *dgrams,int n,int flags);
+		void recvmmsg_udp(int senderid,int sockfd,int n,int *datalens,int flags);
 		void	sendmsg_udp();
 		void	recvmsg_udp();
 		void	getsockopt_udp();